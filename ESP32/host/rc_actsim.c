@@ -0,0 +1,541 @@
+// Linux harness for the actuation engine (main/actuator.c): simulated control packets with network
+// jitter, loss and stalls go in, the fixed-rate outputs come out, on a virtual clock.
+//
+//   rc_actsim run [--rate HZ] [--interval MS] [--jitter MS] [--loss PCT] [--stall MS] [--legacy]
+//                 [--duration S] [--seed N] [--csv FILE]
+//   rc_actsim selftest
+//
+// The operator input is a fixed drive pattern (full throttle, coast, brake, reverse; steering that
+// sweeps left and right). With --legacy it is sent as 6-byte legacy frames (bang-bang throttle,
+// STEER in 0..10 steps). Packets go out every --interval and arrive after a random delay of up to
+// --jitter; every 3 s the link stalls for --stall and what was sent meanwhile arrives in a burst.
+// Sequencing is the firmware's (rc_proto_session_accept), so reordered packets are dropped as stale.
+//
+// The report compares the engine's outputs with applying each packet directly (what the firmware
+// did before): peak rate and acceleration per axis, tracking error against the operator's input,
+// and the cost of actuator_tick() on this machine.
+
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "actuator.h"
+#include "rc_config.h"
+#include "rc_proto.h"
+#include "selftest.h"
+
+typedef struct
+{
+	int rate_hz;
+	int interval_ms;
+	int jitter_ms;
+	int loss_pct;
+	int stall_ms;
+	bool legacy;
+	int duration_s;
+	uint32_t seed;
+	const char *csv;
+} options_t;
+
+static options_t opt = {
+	.rate_hz = ACT_RATE_HZ,
+	.interval_ms = ACT_INTERVAL_MS,
+	.jitter_ms = 15,
+	.loss_pct = 2,
+	.stall_ms = 120,
+	.legacy = false,
+	.duration_s = 20,
+	.seed = 1,
+	.csv = NULL,
+};
+
+static uint32_t rng_state;
+
+static uint32_t rng(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static act_config_t default_config(void)
+{
+	const act_config_t cfg = {
+		.period_us = 1000000 / (uint32_t)opt.rate_hz,
+		.throttle = {ACT_THROTTLE_SLEW, ACT_THROTTLE_ACCEL},
+		.steer = {ACT_STEER_SLEW, ACT_STEER_ACCEL},
+		.brake_slew = ACT_BRAKE_SLEW,
+		.interval_us = ACT_INTERVAL_MS * 1000,
+		.extrapolate_us = ACT_EXTRAPOLATE_MS * 1000,
+		.timeout_us = ACT_TIMEOUT_MS * 1000,
+	};
+	return cfg;
+}
+
+// --- operator and link ---
+
+// The drive pattern at time t: 4 s cycle of forward / coast / brake / reverse, steering a triangle
+// wave with a 1.5 s period.
+static rc_control_t operator_input(int64_t t_us)
+{
+	rc_control_t c = {0};
+	const int64_t phase = t_us % 4000000;
+	if (phase < 1000000)
+		c.throttle = 26000;
+	else if (phase < 2000000)
+		c.throttle = 0;
+	else if (phase < 2500000)
+		c.flags = RC_CTRL_FLAG_BRAKE;
+	else
+		c.throttle = -13000;
+	const int64_t s = t_us % 1500000;
+	const int64_t tri = (s < 750000) ? s : 1500000 - s; // 0..750000
+	c.steer = (int16_t)((tri - 375000) * 26000 / 375000);
+	return c;
+}
+
+// What the operator's input looks like after the sender's encoding.
+static rc_control_t encode_input(const rc_control_t *in, uint16_t seq)
+{
+	if (!opt.legacy)
+	{
+		rc_control_t c = *in;
+		c.seq = seq;
+		return c;
+	}
+	const bool brake = (in->flags & RC_CTRL_FLAG_BRAKE) != 0;
+	const int steer = 5 + (in->steer * 5 + (in->steer >= 0 ? RC_AXIS_MAX / 2 : -RC_AXIS_MAX / 2)) / RC_AXIS_MAX;
+	const uint8_t legacy[RC_PROTO_LEGACY_LEN] = {
+		(uint8_t)(in->throttle > 0), (uint8_t)(in->throttle < 0), 0, 0, (uint8_t)brake, (uint8_t)steer,
+	};
+	rc_control_t c;
+	rc_proto_from_legacy(legacy, &c);
+	return c;
+}
+
+typedef struct
+{
+	int64_t arrive_us;
+	rc_control_t ctrl;
+} packet_t;
+
+static int cmp_packet(const void *a, const void *b)
+{
+	const int64_t x = ((const packet_t *)a)->arrive_us, y = ((const packet_t *)b)->arrive_us;
+	return (x > y) - (x < y);
+}
+
+// Every packet of the run, sorted by arrival time.
+static size_t make_packets(packet_t *out, size_t cap, int64_t duration_us)
+{
+	size_t n = 0;
+	uint16_t seq = 0;
+	const int64_t interval = (int64_t)opt.interval_ms * 1000;
+	for (int64_t t = 0; t < duration_us && n < cap; t += interval)
+	{
+		seq++;
+		if (opt.loss_pct > 0 && (int)(rng() % 100) < opt.loss_pct)
+			continue;
+		int64_t arrive = t + 2000 + (opt.jitter_ms > 0 ? (int64_t)(rng() % (uint32_t)(opt.jitter_ms * 1000)) : 0);
+		// Link stall at the start of every 3 s: queued packets come out together at its end.
+		const int64_t stall_start = t / 3000000 * 3000000 + 1500000;
+		const int64_t stall_end = stall_start + (int64_t)opt.stall_ms * 1000;
+		if (arrive >= stall_start && arrive < stall_end)
+			arrive = stall_end + (int64_t)(rng() % 1000);
+		const rc_control_t in = operator_input(t);
+		out[n++] = (packet_t){arrive, encode_input(&in, seq)};
+	}
+	qsort(out, n, sizeof(packet_t), cmp_packet);
+	return n;
+}
+
+// --- output analysis ---
+
+typedef struct
+{
+	int32_t prev;
+	int64_t prev_rate;
+	bool have_prev;
+	bool have_rate;
+	int64_t max_rate;  // units/s
+	int64_t max_accel; // units/s^2, only between two ticks without brake
+	double err_sum;    // |out - input|
+	uint32_t n;
+} axis_stats_t;
+
+static void axis_note(axis_stats_t *s, int32_t v, int32_t input, uint32_t dt_us, bool accel_valid)
+{
+	if (s->have_prev)
+	{
+		const int64_t rate = ((int64_t)v - s->prev) * 1000000 / dt_us;
+		if (llabs(rate) > s->max_rate)
+			s->max_rate = llabs(rate);
+		if (s->have_rate && accel_valid)
+		{
+			const int64_t acc = (rate - s->prev_rate) * 1000000 / dt_us;
+			if (llabs(acc) > s->max_accel)
+				s->max_accel = llabs(acc);
+		}
+		s->prev_rate = rate;
+		s->have_rate = true;
+	}
+	s->prev = v;
+	s->have_prev = true;
+	s->err_sum += abs(v - input);
+	s->n++;
+}
+
+typedef struct
+{
+	axis_stats_t throttle;
+	axis_stats_t steer;
+} run_stats_t;
+
+typedef struct
+{
+	run_stats_t engine;
+	run_stats_t raw;
+	act_stats_t act;
+	uint32_t packets;
+	uint32_t stale;
+	int64_t tick_ns_max;
+	double tick_ns_avg;
+} sim_result_t;
+
+static int sim_run(sim_result_t *res, FILE *csv)
+{
+	memset(res, 0, sizeof(*res));
+	const int64_t duration = (int64_t)opt.duration_s * 1000000;
+	const size_t cap = (size_t)(duration / (opt.interval_ms * 1000)) + 2;
+	packet_t *pk = (packet_t *)malloc(cap * sizeof(packet_t));
+	if (!pk)
+		return -1;
+	const size_t npk = make_packets(pk, cap, duration);
+
+	const act_config_t cfg = default_config();
+	actuator_t a;
+	actuator_init(&a, &cfg, 0);
+	rc_proto_session_t sess = {0};
+	rc_control_t raw = {.flags = RC_CTRL_FLAG_BRAKE};
+	size_t next = 0;
+	bool prev_brake = true;
+	int64_t tick_ns_sum = 0;
+	uint32_t ticks = 0;
+	if (csv)
+		fprintf(csv, "t_ms,in_throttle,in_steer,raw_throttle,raw_steer,out_throttle,out_steer,brake\n");
+
+	for (int64_t t = cfg.period_us; t <= duration; t += cfg.period_us)
+	{
+		for (; next < npk && pk[next].arrive_us <= t; next++)
+		{
+			const rc_control_t *c = &pk[next].ctrl;
+			const bool fresh = (c->flags & RC_CTRL_FLAG_LEGACY) || rc_proto_session_accept(&sess, c->seq, pk[next].arrive_us);
+			if (!fresh)
+			{
+				res->stale++;
+				continue;
+			}
+			res->packets++;
+			raw = *c;
+			actuator_setpoint(&a, c, pk[next].arrive_us);
+		}
+		const int64_t t0 = now_ns();
+		const act_output_t out = actuator_tick(&a, t);
+		const int64_t cost = now_ns() - t0;
+		tick_ns_sum += cost;
+		ticks++;
+		if (cost > res->tick_ns_max)
+			res->tick_ns_max = cost;
+
+		const rc_control_t in = operator_input(t);
+		const int32_t in_throttle = (in.flags & RC_CTRL_FLAG_BRAKE) ? 0 : in.throttle;
+		const int32_t raw_throttle = (raw.flags & RC_CTRL_FLAG_BRAKE) ? 0 : raw.throttle;
+		axis_note(&res->engine.throttle, out.throttle, in_throttle, cfg.period_us, !out.brake && !prev_brake);
+		axis_note(&res->engine.steer, out.steer, in.steer, cfg.period_us, true);
+		axis_note(&res->raw.throttle, raw_throttle, in_throttle, cfg.period_us, true);
+		axis_note(&res->raw.steer, raw.steer, in.steer, cfg.period_us, true);
+		prev_brake = out.brake;
+		if (csv)
+			fprintf(csv, "%.1f,%d,%d,%d,%d,%d,%d,%d\n", (double)t / 1000.0, in_throttle, in.steer, raw_throttle,
+					raw.steer, out.throttle, out.steer, out.brake ? 1 : 0);
+	}
+	res->act = a.stats;
+	res->tick_ns_avg = ticks ? (double)tick_ns_sum / ticks : 0.0;
+	free(pk);
+	return 0;
+}
+
+static void print_axis(const char *name, const axis_stats_t *e, const axis_stats_t *r)
+{
+	printf("%-9s %14.0f %14.0f %16.0f %16.0f %9.2f%% %9.2f%%\n", name, (double)r->max_rate, (double)e->max_rate,
+		   (double)r->max_accel, (double)e->max_accel, r->n ? 100.0 * r->err_sum / r->n / RC_AXIS_MAX : 0.0,
+		   e->n ? 100.0 * e->err_sum / e->n / RC_AXIS_MAX : 0.0);
+}
+
+static int cmd_run(void)
+{
+	rng_state = opt.seed ? opt.seed : 1;
+	FILE *csv = NULL;
+	if (opt.csv && !(csv = fopen(opt.csv, "w")))
+	{
+		perror(opt.csv);
+		return 1;
+	}
+	sim_result_t res;
+	const int rc = sim_run(&res, csv);
+	if (csv)
+		fclose(csv);
+	if (rc != 0)
+		return 1;
+
+	printf("%d Hz, packets every %d ms (+0..%d ms jitter, %d%% loss, %d ms stall every 3 s)%s, %d s\n", opt.rate_hz,
+		   opt.interval_ms, opt.jitter_ms, opt.loss_pct, opt.stall_ms, opt.legacy ? ", legacy frames" : "",
+		   opt.duration_s);
+	printf("%-9s %14s %14s %16s %16s %10s %10s\n", "axis", "raw rate/s", "out rate/s", "raw accel/s2", "out accel/s2",
+		   "raw err", "out err");
+	print_axis("throttle", &res.engine.throttle, &res.raw.throttle);
+	print_axis("steer", &res.engine.steer, &res.raw.steer);
+	printf("packets %u applied, %u stale; interval estimate %.1f ms; %u ticks extrapolated, %u held, %u failsafes, "
+		   "%u late\n",
+		   res.packets, res.stale, res.act.interval_us / 1000.0, res.act.extrapolated, res.act.held,
+		   res.act.failsafes, res.act.late_packets);
+	printf("actuator_tick: %.0f ns avg, %lld ns max (host)\n", res.tick_ns_avg, (long long)res.tick_ns_max);
+	return 0;
+}
+
+// --- selftest ---
+
+typedef struct
+{
+	actuator_t a;
+	int64_t t;
+	act_output_t out;
+} bench_t;
+
+// Ticks until `until_us`; returns the largest per-tick change of steer.
+static int32_t advance(bench_t *b, int64_t until_us, int32_t *min_steer, int32_t *max_steer)
+{
+	int32_t max_step = 0;
+	while (b->t + (int64_t)b->a.cfg.period_us <= until_us)
+	{
+		b->t += b->a.cfg.period_us;
+		const int32_t prev = b->out.steer;
+		b->out = actuator_tick(&b->a, b->t);
+		if (abs(b->out.steer - prev) > max_step)
+			max_step = abs(b->out.steer - prev);
+		if (min_steer && b->out.steer < *min_steer)
+			*min_steer = b->out.steer;
+		if (max_steer && b->out.steer > *max_steer)
+			*max_steer = b->out.steer;
+	}
+	return max_step;
+}
+
+static void send(bench_t *b, int16_t throttle, int16_t steer, uint8_t flags)
+{
+	const rc_control_t c = {.throttle = throttle, .steer = steer, .flags = flags};
+	actuator_setpoint(&b->a, &c, b->t);
+}
+
+static void bench_init(bench_t *b)
+{
+	const act_config_t cfg = default_config();
+	memset(b, 0, sizeof(*b));
+	actuator_init(&b->a, &cfg, 0);
+}
+
+static int cmd_selftest(void)
+{
+	opt.rate_hz = 200;
+	const act_config_t cfg = default_config();
+	const int32_t tick_slew_steer = (int32_t)((int64_t)ACT_STEER_SLEW * cfg.period_us / 1000000);
+
+	// Simulated drives (v2 and legacy, jittery link with stalls): limits hold, the engine is smoother
+	// than applying packets directly and costs a bounded amount per tick.
+	for (int legacy = 0; legacy < 2; legacy++)
+	{
+		opt.legacy = legacy != 0;
+		rng_state = 7;
+		sim_result_t r;
+		expect(sim_run(&r, NULL) == 0, "simulation");
+		// One unit of rounding per tick shows up as 200 units/s of rate and 40000 units/s^2 of accel.
+		const int64_t rate_tol = 2 * opt.rate_hz, acc_tol = 2 * (int64_t)opt.rate_hz * opt.rate_hz;
+		expect(r.engine.throttle.max_rate <= (int64_t)ACT_BRAKE_SLEW + rate_tol, "throttle rate limit");
+		expect(r.engine.steer.max_rate <= (int64_t)ACT_STEER_SLEW + rate_tol, "steer slew limit");
+		expect(r.engine.throttle.max_accel <= (int64_t)ACT_THROTTLE_ACCEL + acc_tol, "throttle accel limit");
+		expect(r.engine.steer.max_accel <= (int64_t)ACT_STEER_ACCEL + acc_tol, "steer accel limit");
+		expect(r.engine.steer.max_rate * 4 < r.raw.steer.max_rate, "steer smoother than raw packets");
+		expect(r.act.extrapolated > 0 && r.act.failsafes == 0, "stalls bridged without failsafe");
+		expect(r.engine.steer.err_sum / r.engine.steer.n < 0.15 * RC_AXIS_MAX, "steer tracks the input");
+		expect(r.tick_ns_avg < 20000, "tick cost bounded");
+	}
+
+	// A step is reached without overshoot, within interpolation + slew time.
+	bench_t b;
+	bench_init(&b);
+	int32_t lo = 0, hi = 0;
+	for (int i = 0; i < 10; i++)
+	{
+		send(&b, 0, 20000, 0);
+		advance(&b, b.t + 50000, &lo, &hi);
+	}
+	expect(hi <= 20000 && lo >= 0, "step without overshoot");
+	expect(b.out.steer == 20000, "step reached");
+	bench_init(&b);
+	send(&b, 0, 20000, 0);
+	advance(&b, 50000 + 20000LL * 1000000 / ACT_STEER_SLEW + 30000, NULL, NULL);
+	expect(b.out.steer == 20000, "step time");
+
+	// Coarse packets (a 3000-unit ramp step every 50 ms) come out in small ticks.
+	bench_init(&b);
+	int32_t max_step = 0;
+	for (int i = 1; i <= 8; i++)
+	{
+		send(&b, 0, (int16_t)(i * 3000), 0);
+		const int32_t s = advance(&b, b.t + 50000, NULL, NULL);
+		if (i > 2 && s > max_step)
+			max_step = s;
+	}
+	expect(max_step <= 3000 / 10 + 40 && max_step <= tick_slew_steer, "interpolated ramp");
+
+	// A late packet: the trend continues for the extrapolation window, then holds; when the packet
+	// arrives there is no jump.
+	const int32_t before = b.out.steer;
+	advance(&b, b.t + 50000 + ACT_EXTRAPOLATE_MS * 1000 + 20000, NULL, NULL);
+	expect(b.a.stats.extrapolated > 0 && b.a.stats.held > 0, "extrapolated then held");
+	expect(b.out.steer > before && b.out.steer <= 8 * 3000 + 3000 * ACT_EXTRAPOLATE_MS / 50 + 100,
+		   "extrapolation bounded");
+	send(&b, 0, 9 * 3000, 0);
+	expect(advance(&b, b.t + 50000, NULL, NULL) <= tick_slew_steer, "no jump after a late packet");
+
+	// Brake: throttle to 0 within full / brake_slew.
+	bench_init(&b);
+	for (int i = 0; i < 20; i++)
+	{
+		send(&b, 30000, 0, 0);
+		advance(&b, b.t + 50000, NULL, NULL);
+	}
+	expect(b.out.throttle == 30000 && !b.out.brake, "full throttle");
+	send(&b, 30000, 0, RC_CTRL_FLAG_BRAKE);
+	advance(&b, b.t + 30000LL * 1000000 / ACT_BRAKE_SLEW + cfg.period_us, NULL, NULL);
+	expect(b.out.throttle == 0 && b.out.brake, "brake");
+
+	// Silence: failsafe after the timeout, resumes with the next packet.
+	bench_init(&b);
+	for (int i = 0; i < 20; i++)
+	{
+		send(&b, 30000, 10000, 0);
+		advance(&b, b.t + 50000, NULL, NULL);
+	}
+	advance(&b, b.t + ACT_TIMEOUT_MS * 1000 + 30000LL * 1000000 / ACT_BRAKE_SLEW + 20000, NULL, NULL);
+	expect(b.a.stats.failsafes == 1 && b.out.throttle == 0 && b.out.brake, "failsafe");
+	expect(b.out.steer == 0, "failsafe centers steering");
+	send(&b, 10000, 0, 0);
+	advance(&b, b.t + 300000, NULL, NULL);
+	expect(!b.out.brake && b.out.throttle == 10000 && b.a.stats.failsafes == 1, "resume after failsafe");
+
+	// Vision steering (overrides at ~30 fps) keeps running after the operator stops: steer follows
+	// vision, but the failsafe still stops the car and vision can't steer it afterwards.
+	bench_init(&b);
+	for (int i = 0; i < 20; i++)
+	{
+		send(&b, 20000, 8000, 0); // operator packet, steering already merged from vision
+		for (int f = 0; f < 3; f++)
+		{
+			const rc_control_t v = {.throttle = 20000, .steer = 8000};
+			actuator_override(&b.a, &v, b.t);
+			advance(&b, b.t + 16667, NULL, NULL);
+		}
+	}
+	expect(abs(b.out.steer - 8000) < 50 && abs(b.out.throttle - 20000) < 50 && b.a.stats.packets == 20,
+		   "vision steers");
+	const int64_t silent_until = b.t + ACT_TIMEOUT_MS * 1000 + 20000LL * 1000000 / ACT_BRAKE_SLEW + 20000;
+	while (b.t < silent_until)
+	{
+		const rc_control_t v = {.throttle = 20000, .steer = 8000};
+		actuator_override(&b.a, &v, b.t);
+		advance(&b, b.t + 33333, NULL, NULL);
+	}
+	expect(b.a.stats.failsafes == 1 && b.out.throttle == 0 && b.out.brake, "failsafe with vision running");
+	expect(b.out.steer == 0, "vision doesn't steer in failsafe");
+
+	// The interval estimate follows the sender.
+	bench_init(&b);
+	for (int i = 0; i < 60; i++)
+	{
+		send(&b, 0, 0, 0);
+		advance(&b, b.t + 40000, NULL, NULL);
+	}
+	expect(b.a.interval_us > 38000 && b.a.interval_us < 42000, "interval estimate");
+
+	// actuator_stop zeroes at once.
+	actuator_stop(&b.a, b.t);
+	b.out = actuator_tick(&b.a, b.t + cfg.period_us);
+	expect(b.out.throttle == 0 && b.out.steer == 0 && b.out.brake, "stop");
+
+	char json[256];
+	expect(actuator_json(json, sizeof(json), &b.a) > 0, "json");
+	expect(actuator_json(json, 32, &b.a) == 0, "short buffer");
+
+	return selftest_done();
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+			"usage: %s run [--rate HZ] [--interval MS] [--jitter MS] [--loss PCT] [--stall MS] [--legacy]\n"
+			"              [--duration S] [--seed N] [--csv FILE]\n"
+			"       %s selftest\n",
+			argv0, argv0);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option longopts[] = {
+		{"rate", required_argument, NULL, 'r'},     {"interval", required_argument, NULL, 'i'},
+		{"jitter", required_argument, NULL, 'j'},   {"loss", required_argument, NULL, 'l'},
+		{"stall", required_argument, NULL, 's'},    {"legacy", no_argument, NULL, 'L'},
+		{"duration", required_argument, NULL, 'd'}, {"seed", required_argument, NULL, 'S'},
+		{"csv", required_argument, NULL, 'c'},      {"help", no_argument, NULL, '?'},
+		{NULL, 0, NULL, 0},
+	};
+	int ch;
+	while ((ch = getopt_long(argc, argv, "", longopts, NULL)) != -1)
+	{
+		switch (ch)
+		{
+		case 'r': opt.rate_hz = atoi(optarg); break;
+		case 'i': opt.interval_ms = atoi(optarg); break;
+		case 'j': opt.jitter_ms = atoi(optarg); break;
+		case 'l': opt.loss_pct = atoi(optarg); break;
+		case 's': opt.stall_ms = atoi(optarg); break;
+		case 'L': opt.legacy = true; break;
+		case 'd': opt.duration_s = atoi(optarg); break;
+		case 'S': opt.seed = (uint32_t)strtoul(optarg, NULL, 10); break;
+		case 'c': opt.csv = optarg; break;
+		default: usage(argv[0]); return 2;
+		}
+	}
+
+	const int nargs = argc - optind;
+	if (nargs == 1 && strcmp(argv[optind], "selftest") == 0)
+		return cmd_selftest();
+	if (nargs != 1 || strcmp(argv[optind], "run") != 0 || opt.rate_hz <= 0 || opt.rate_hz > 10000 ||
+		opt.interval_ms <= 0 || opt.duration_s <= 0 || opt.jitter_ms < 0 || opt.stall_ms < 0)
+	{
+		usage(argv[0]);
+		return 2;
+	}
+	return cmd_run();
+}
@@ -0,0 +1,989 @@
+// Host benchmarks for the firmware's portable pixel kernels (and the abbreviated JPEG split, whose
+// byte savings are reported alongside). "B out" is the output size per frame, e.g. the payload of
+// the packed RAWH formats.
+//
+// Each benchmark first checks its kernel against a straightforward reference implementation and
+// fails (exit code 1) on mismatch, then reports time per frame. Numbers are for the host CPU;
+// use them to compare kernel variants, not to predict absolute ESP32 timings.
+
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "img_scale.h"
+#include "rc_frame.h"
+#include "vision.h"
+#include "ws_lite.h"
+
+typedef struct
+{
+	int width;
+	int height;
+	int min_ms; // run each benchmark for at least this long
+	const char *filter;
+	const char *jpeg_file; // real frame for the abbreviated JPEG benchmark
+} options_t;
+
+static options_t opt = {.width = 320, .height = 240, .min_ms = 300, .filter = NULL};
+static int failures = 0;
+
+typedef void (*bench_fn_t)(void *ctx);
+
+static bool selected(const char *name)
+{
+	return !opt.filter || strstr(name, opt.filter) != NULL;
+}
+
+// Runs fn until min_ms elapsed and prints the mean time per call.
+static void bench_run(const char *name, bench_fn_t fn, void *ctx, size_t out_bytes)
+{
+	fn(ctx); // warm-up
+	uint64_t iters = 0;
+	const int64_t start = ws_now_us();
+	int64_t now = start;
+	while (now - start < (int64_t)opt.min_ms * 1000)
+	{
+		for (int i = 0; i < 8; i++)
+			fn(ctx);
+		iters += 8;
+		now = ws_now_us();
+	}
+	const double us = (double)(now - start) / (double)iters;
+	const double mpix = (double)opt.width * opt.height / us;
+	printf("%-36s %9.1f us/frame %8.1f Mpix/s %9zu B out\n", name, us, mpix, out_bytes);
+}
+
+static void check(const char *name, bool ok, const char *detail)
+{
+	if (!ok)
+	{
+		printf("FAIL %s: %s\n", name, detail);
+		failures++;
+	}
+}
+
+static uint8_t *make_rgb565(int w, int h)
+{
+	uint8_t *buf = (uint8_t *)malloc((size_t)w * h * 2);
+	uint32_t seed = 12345;
+	for (int i = 0; i < w * h; i++)
+	{
+		seed = seed * 1103515245u + 12345u;
+		// Smooth gradient plus noise so box filtering does some real averaging.
+		const int x = i % w, y = i / w;
+		const uint16_t r = (uint16_t)(((x * 31) / w + (seed >> 28)) & 31);
+		const uint16_t g = (uint16_t)(((y * 63) / h + (seed >> 26)) & 63);
+		const uint16_t b = (uint16_t)((seed >> 16) & 31);
+		const uint16_t pix = (uint16_t)((r << 11) | (g << 5) | b);
+		buf[2 * i] = (uint8_t)(pix >> 8);
+		buf[2 * i + 1] = (uint8_t)pix;
+	}
+	return buf;
+}
+
+// --- downscale ---
+
+typedef struct
+{
+	const uint8_t *src;
+	uint8_t *dst;
+	int factor;
+	size_t out;
+} scale_ctx_t;
+
+static void run_rgb565(void *p)
+{
+	scale_ctx_t *c = (scale_ctx_t *)p;
+	c->out = img_scale_rgb565(c->src, opt.width, opt.height, c->factor, c->dst);
+}
+
+static void run_rgb565_gray(void *p)
+{
+	scale_ctx_t *c = (scale_ctx_t *)p;
+	c->out = img_scale_rgb565_to_gray8(c->src, opt.width, opt.height, c->factor, c->dst);
+}
+
+static void run_gray8(void *p)
+{
+	scale_ctx_t *c = (scale_ctx_t *)p;
+	c->out = img_scale_gray8(c->src, opt.width, opt.height, c->factor, c->dst);
+}
+
+static void run_yuv422_gray(void *p)
+{
+	scale_ctx_t *c = (scale_ctx_t *)p;
+	c->out = img_scale_yuv422_to_gray8(c->src, opt.width, opt.height, c->factor, c->dst);
+}
+
+// Reference: float average of bit-replicated 8-bit channels, BT.601-ish luma.
+static double ref_luma(const uint8_t *src, int w, int x0, int y0, int f)
+{
+	double sum = 0.0;
+	for (int dy = 0; dy < f; dy++)
+		for (int dx = 0; dx < f; dx++)
+		{
+			const uint8_t *p = src + 2 * ((size_t)(y0 + dy) * w + x0 + dx);
+			const unsigned v = ((unsigned)p[0] << 8) | p[1];
+			const unsigned r5 = v >> 11, g6 = (v >> 5) & 63, b5 = v & 31;
+			const double r8 = (r5 << 3) | (r5 >> 2), g8 = (g6 << 2) | (g6 >> 4), b8 = (b5 << 3) | (b5 >> 2);
+			sum += (77.0 * r8 + 150.0 * g8 + 29.0 * b8) / 256.0;
+		}
+	return sum / (f * f);
+}
+
+static void bench_downscale(void)
+{
+	const int w = opt.width, h = opt.height;
+	uint8_t *rgb = make_rgb565(w, h);
+	uint8_t *gray = (uint8_t *)malloc((size_t)w * h);
+	uint8_t *dst = (uint8_t *)malloc((size_t)w * h * 2);
+	(void)img_scale_rgb565_to_gray8(rgb, w, h, 1, gray);
+	// YUYV with the same luma; chroma bytes are noise the kernel must not read.
+	uint8_t *yuv = (uint8_t *)malloc((size_t)w * h * 2);
+	for (int i = 0; i < w * h; i++)
+	{
+		yuv[2 * i] = gray[i];
+		yuv[2 * i + 1] = (uint8_t)(i * 37 + 11);
+	}
+
+	static const int factors[] = {1, 2, 4};
+	for (size_t i = 0; i < sizeof(factors) / sizeof(factors[0]); i++)
+	{
+		const int f = factors[i];
+		scale_ctx_t ctx = {.src = rgb, .dst = dst, .factor = f};
+		char name[64];
+
+		snprintf(name, sizeof(name), "scale/rgb565_to_gray8 x%d", f);
+		if (selected(name))
+		{
+			run_rgb565_gray(&ctx);
+			double worst = 0.0;
+			for (int y = 0; y < h / f; y++)
+				for (int x = 0; x < w / f; x++)
+				{
+					const double d = ctx.dst[y * (w / f) + x] - ref_luma(rgb, w, x * f, y * f, f);
+					if (d > worst || -d > worst)
+						worst = (d < 0) ? -d : d;
+				}
+			check(name, worst <= 1.5, "luma differs from reference by more than 1.5");
+			bench_run(name, run_rgb565_gray, &ctx, ctx.out);
+		}
+
+		snprintf(name, sizeof(name), "scale/rgb565 x%d", f);
+		if (selected(name))
+		{
+			run_rgb565(&ctx);
+			bool ok = ctx.out == (size_t)(w / f) * (h / f) * 2;
+			// Block average per channel must match an exact integer reference (round half up).
+			for (int y = 0; y < h / f && ok; y++)
+				for (int x = 0; x < w / f && ok; x++)
+				{
+					unsigned rs = 0, gs = 0, bs = 0;
+					for (int dy = 0; dy < f; dy++)
+						for (int dx = 0; dx < f; dx++)
+						{
+							const uint8_t *p = rgb + 2 * ((size_t)(y * f + dy) * w + x * f + dx);
+							const unsigned v = ((unsigned)p[0] << 8) | p[1];
+							rs += v >> 11;
+							gs += (v >> 5) & 63;
+							bs += v & 31;
+						}
+					const unsigned n = (unsigned)(f * f);
+					const unsigned exp = (((rs + n / 2) / n) << 11) | (((gs + n / 2) / n) << 5) | ((bs + n / 2) / n);
+					const uint8_t *o = ctx.dst + 2 * ((size_t)y * (w / f) + x);
+					ok = (((unsigned)o[0] << 8) | o[1]) == exp;
+				}
+			check(name, ok, "channel averages differ from reference");
+			bench_run(name, run_rgb565, &ctx, ctx.out);
+		}
+
+		snprintf(name, sizeof(name), "scale/gray8 x%d", f);
+		if (selected(name))
+		{
+			ctx.src = gray;
+			run_gray8(&ctx);
+			check(name, ctx.out == (size_t)(w / f) * (h / f), "unexpected output size");
+			bench_run(name, run_gray8, &ctx, ctx.out);
+			ctx.src = rgb;
+		}
+
+		snprintf(name, sizeof(name), "scale/yuv422_to_gray8 x%d", f);
+		if (selected(name))
+		{
+			ctx.src = yuv;
+			run_yuv422_gray(&ctx);
+			bool ok = ctx.out == (size_t)(w / f) * (h / f);
+			for (int y = 0; y < h / f && ok; y++)
+				for (int x = 0; x < w / f && ok; x++)
+				{
+					unsigned s = 0;
+					for (int dy = 0; dy < f; dy++)
+						for (int dx = 0; dx < f; dx++)
+							s += gray[(size_t)(y * f + dy) * w + x * f + dx];
+					const unsigned n = (unsigned)(f * f);
+					ok = ctx.dst[y * (w / f) + x] == (s + n / 2) / n;
+				}
+			check(name, ok, "luma averages differ from reference");
+			bench_run(name, run_yuv422_gray, &ctx, ctx.out);
+			ctx.src = rgb;
+		}
+	}
+
+	free(rgb);
+	free(gray);
+	free(yuv);
+	free(dst);
+}
+
+// --- receiver-side decode (main/rc_frame.c) ---
+
+typedef struct
+{
+	const uint8_t *src;
+	uint8_t *dst;
+	size_t pixels;
+} px_ctx_t;
+
+static void run_swap16(void *p)
+{
+	px_ctx_t *c = (px_ctx_t *)p;
+	rc_px_swap16(c->dst, c->src, c->pixels);
+}
+
+static void run_gray_expand(void *p)
+{
+	px_ctx_t *c = (px_ctx_t *)p;
+	rc_px_gray8_to_rgb565le(c->dst, c->src, c->pixels);
+}
+
+static void run_rgb888(void *p)
+{
+	px_ctx_t *c = (px_ctx_t *)p;
+	rc_px_rgb565be_to_rgb888(c->dst, c->src, c->pixels);
+}
+
+// Bit replication stays within 1 of the exact scaling and keeps both ends (0 -> 0, max -> 255).
+static bool channel_ok(unsigned out, unsigned c, unsigned max)
+{
+	const int exact = (int)((c * 255 + max / 2) / max);
+	const int d = (int)out - exact;
+	return d >= -1 && d <= 1 && (c != 0 || out == 0) && (c != max || out == 255);
+}
+
+static void bench_decode(void)
+{
+	const int w = opt.width, h = opt.height;
+	// Odd pixel count so the per-pixel tails run too.
+	const size_t pixels = (size_t)w * h - 1;
+	uint8_t *rgb = make_rgb565(w, h);
+	uint8_t *gray = (uint8_t *)malloc((size_t)w * h);
+	uint8_t *dst = (uint8_t *)malloc((size_t)w * h * 3);
+	(void)img_scale_rgb565_to_gray8(rgb, w, h, 1, gray);
+	char name[64];
+
+	snprintf(name, sizeof(name), "decode/rawh");
+	if (selected(name))
+	{
+		uint8_t hdr[RC_FRAME_RAWH_LEN];
+		rc_rawh_t parsed;
+		bool ok = rc_rawh_write(hdr, sizeof(hdr), RC_FRAME_RGB565, (uint16_t)w, (uint16_t)h, (uint32_t)(w * h * 2)) ==
+					  RC_FRAME_RAWH_LEN &&
+				  rc_rawh_parse(hdr, sizeof(hdr), &parsed) == RC_RAWH_OK && parsed.width == w && parsed.height == h &&
+				  parsed.format == RC_FRAME_RGB565;
+		hdr[13] ^= 1; // payload length no longer matches w * h * bpp
+		ok = ok && rc_rawh_parse(hdr, sizeof(hdr), &parsed) == RC_RAWH_BAD_SIZE;
+		ok = ok && rc_rawh_parse(hdr, sizeof(hdr) - 1, &parsed) == RC_RAWH_BAD_LEN;
+
+		// Header, interleaved control message, payload that happens to start like a JPEG.
+		rc_frame_rx_t rx;
+		memset(&rx, 0, sizeof(rx));
+		rc_frame_t f;
+		uint8_t payload[8] = {0xFF, 0xD8};
+		const uint8_t ack[5] = {0xC5, 0x24, 1, 0, 0};
+		(void)rc_rawh_write(hdr, sizeof(hdr), RC_FRAME_GRAY8, 4, 2, sizeof(payload));
+		ok = ok && rc_frame_rx_feed(&rx, hdr, sizeof(hdr), &f) == RC_FRAME_RX_NONE;
+		ok = ok && rc_frame_rx_feed(&rx, ack, sizeof(ack), &f) == RC_FRAME_RX_NONE;
+		ok = ok && rc_frame_rx_feed(&rx, payload, sizeof(payload), &f) == RC_FRAME_RX_RAW && f.hdr.width == 4 &&
+			 f.len == sizeof(payload);
+		ok = ok && rc_frame_rx_feed(&rx, payload, 2, &f) == RC_FRAME_RX_JPEG && rx.frames == 2 && rx.orphans == 0;
+		check(name, ok, "RAWH encode/parse/receive round trip");
+	}
+
+	snprintf(name, sizeof(name), "decode/chunks");
+	if (selected(name))
+	{
+		// The gray frame in 1000-byte chunk messages with an ack after every chunk, then a gap.
+		const size_t len = (size_t)w * h;
+		uint8_t *msg = (uint8_t *)malloc(1000 + RC_FRAME_CHUNK_HDR_LEN);
+		rc_chunk_rx_t rx;
+		memset(&rx, 0, sizeof(rx));
+		rx.buf = dst;
+		rx.cap = len;
+		const uint8_t ack[5] = {0xC5, 0x24, 1, 0, 0};
+		const uint8_t *out = NULL;
+		size_t out_len = 0;
+		bool ok = msg != NULL;
+		for (size_t off = 0; off < len && ok; off += 1000)
+		{
+			const size_t n = (len - off < 1000) ? len - off : 1000;
+			(void)rc_chunk_write_header(msg, RC_FRAME_CHUNK_HDR_LEN, 7, (uint32_t)off, off + n == len);
+			memcpy(msg + RC_FRAME_CHUNK_HDR_LEN, gray + off, n);
+			const rc_chunk_result_t r = rc_chunk_rx_feed(&rx, msg, n + RC_FRAME_CHUNK_HDR_LEN, &out, &out_len);
+			ok = (r == ((off + n == len) ? RC_CHUNK_DONE : RC_CHUNK_PARTIAL)) &&
+				 rc_chunk_rx_feed(&rx, ack, sizeof(ack), &out, &out_len) == RC_CHUNK_NONE;
+		}
+		ok = ok && out_len == len && memcmp(out, gray, len) == 0;
+		if (ok && len > 2000)
+		{
+			(void)rc_chunk_write_header(msg, RC_FRAME_CHUNK_HDR_LEN, 8, 0, false);
+			ok = rc_chunk_rx_feed(&rx, msg, 1000 + RC_FRAME_CHUNK_HDR_LEN, &out, &out_len) == RC_CHUNK_PARTIAL;
+			(void)rc_chunk_write_header(msg, RC_FRAME_CHUNK_HDR_LEN, 8, 2000, true);
+			ok = ok && rc_chunk_rx_feed(&rx, msg, 1000 + RC_FRAME_CHUNK_HDR_LEN, &out, &out_len) == RC_CHUNK_ERROR &&
+				 rx.dropped == 1;
+		}
+		free(msg);
+		check(name, ok, "chunk reassembly round trip / gap detection");
+	}
+
+	px_ctx_t ctx = {.src = rgb, .dst = dst, .pixels = pixels};
+
+	snprintf(name, sizeof(name), "decode/rgb565_swap16");
+	if (selected(name))
+	{
+		run_swap16(&ctx);
+		bool ok = true;
+		for (size_t i = 0; i < pixels && ok; i++)
+			ok = dst[2 * i] == rgb[2 * i + 1] && dst[2 * i + 1] == rgb[2 * i];
+		check(name, ok, "bytes not swapped per pixel");
+		bench_run(name, run_swap16, &ctx, pixels * 2);
+	}
+
+	snprintf(name, sizeof(name), "decode/gray8_to_rgb565le");
+	if (selected(name))
+	{
+		ctx.src = gray;
+		run_gray_expand(&ctx);
+		bool ok = true;
+		for (size_t i = 0; i < pixels && ok; i++)
+		{
+			const unsigned y = gray[i];
+			const unsigned exp = ((y >> 3) << 11) | ((y >> 2) << 5) | (y >> 3);
+			ok = (dst[2 * i] | ((unsigned)dst[2 * i + 1] << 8)) == exp;
+		}
+		check(name, ok, "expanded pixel differs from reference");
+		bench_run(name, run_gray_expand, &ctx, pixels * 2);
+		ctx.src = rgb;
+	}
+
+	snprintf(name, sizeof(name), "decode/rgb565_to_rgb888");
+	if (selected(name))
+	{
+		run_rgb888(&ctx);
+		bool ok = true;
+		for (size_t i = 0; i < pixels && ok; i++)
+		{
+			const unsigned v = ((unsigned)rgb[2 * i] << 8) | rgb[2 * i + 1];
+			ok = channel_ok(dst[3 * i], v >> 11, 31) && channel_ok(dst[3 * i + 1], (v >> 5) & 63, 63) &&
+				 channel_ok(dst[3 * i + 2], v & 31, 31);
+		}
+		check(name, ok, "RGB888 channel differs from reference");
+		bench_run(name, run_rgb888, &ctx, pixels * 3);
+	}
+
+	free(rgb);
+	free(gray);
+	free(dst);
+}
+
+// --- packed low-bit-depth formats (img_scale.c encode, rc_frame.c decode) ---
+
+typedef struct
+{
+	const uint8_t *src;
+	uint8_t *dst;
+	int width;
+	int height;
+	int factor;
+	uint8_t format;
+	int dither;
+	size_t out;
+} pack_ctx_t;
+
+static void run_pack(void *p)
+{
+	pack_ctx_t *c = (pack_ctx_t *)p;
+	if (c->format == RC_FRAME_RGB332)
+		c->out = img_scale_rgb565_to_rgb332(c->src, c->width, c->height, c->factor, c->dither, c->dst);
+	else
+		c->out = img_scale_rgb565_to_gray_packed(c->src, c->width, c->height, c->factor,
+												 (int)rc_frame_bits(c->format), c->dither, c->dst);
+}
+
+static void run_unpack_gray(void *p)
+{
+	pack_ctx_t *c = (pack_ctx_t *)p;
+	c->out = rc_px_unpack_gray8(c->dst, c->src, c->format, (uint16_t)c->width, (uint16_t)c->height);
+}
+
+static void run_rgb332_rgb888(void *p)
+{
+	pack_ctx_t *c = (pack_ctx_t *)p;
+	rc_px_rgb332_to_rgb888(c->dst, c->src, (size_t)c->width * c->height);
+	c->out = (size_t)c->width * c->height * 3;
+}
+
+// Reference threshold: 4x4 Bayer matrix, scaled to 16 * m + 8.
+static unsigned ref_threshold(bool dither, int x, int y)
+{
+	static const unsigned m[4][4] = {{0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+	return dither ? 16 * m[y & 3][x & 3] + 8 : 128;
+}
+
+// Packs `rgb` (w x h, factor f) and checks the decoded frame against the GRAY8 kernel quantized
+// with the reference thresholds: every level must match exactly.
+static bool pack_gray_ok(const uint8_t *rgb, int w, int h, int f, uint8_t format, bool dither, uint8_t *packed,
+						 uint8_t *unpacked, uint8_t *gray)
+{
+	const int ow = w / f, oh = h / f;
+	const unsigned bits = rc_frame_bits(format), max = (1u << bits) - 1, step = 255 / max;
+	pack_ctx_t c = {.src = rgb, .dst = packed, .width = w, .height = h, .factor = f, .format = format,
+					.dither = dither};
+	run_pack(&c);
+	if (c.out != rc_frame_payload_len(format, (uint16_t)ow, (uint16_t)oh) ||
+		rc_px_unpack_gray8(unpacked, packed, format, (uint16_t)ow, (uint16_t)oh) != (size_t)ow * oh)
+		return false;
+	(void)img_scale_rgb565_to_gray8(rgb, w, h, f, gray);
+	for (int y = 0; y < oh; y++)
+		for (int x = 0; x < ow; x++)
+		{
+			const unsigned q = (gray[y * ow + x] * max + ref_threshold(dither, x, y)) >> 8;
+			if (unpacked[y * ow + x] != q * step)
+				return false;
+		}
+	return true;
+}
+
+// RGB332 against the source channels: within half a level (plus rounding) without dithering; with
+// dithering the frame mean of each channel must stay within 2 of the source.
+static bool pack_rgb332_ok(const uint8_t *rgb, int w, int h, bool dither, uint8_t *packed, uint8_t *rgb888)
+{
+	pack_ctx_t c = {.src = rgb, .dst = packed, .width = w, .height = h, .factor = 1, .format = RC_FRAME_RGB332,
+					.dither = dither};
+	run_pack(&c);
+	if (c.out != (size_t)w * h)
+		return false;
+	rc_px_rgb332_to_rgb888(rgb888, packed, (size_t)w * h);
+	double sum_src[3] = {0}, sum_out[3] = {0};
+	for (int i = 0; i < w * h; i++)
+	{
+		const unsigned v = ((unsigned)rgb[2 * i] << 8) | rgb[2 * i + 1];
+		const unsigned r5 = v >> 11, g6 = (v >> 5) & 63, b5 = v & 31;
+		const int src[3] = {(int)((r5 << 3) | (r5 >> 2)), (int)((g6 << 2) | (g6 >> 4)), (int)((b5 << 3) | (b5 >> 2))};
+		static const int half[3] = {255 / 7 / 2 + 2, 255 / 7 / 2 + 2, 255 / 3 / 2 + 2};
+		for (int k = 0; k < 3; k++)
+		{
+			const int d = rgb888[3 * i + k] - src[k];
+			if (!dither && (d > half[k] || -d > half[k]))
+				return false;
+			sum_src[k] += src[k];
+			sum_out[k] += rgb888[3 * i + k];
+		}
+	}
+	for (int k = 0; k < 3; k++)
+	{
+		const double d = (sum_out[k] - sum_src[k]) / (w * h);
+		if (dither && (d > 2.0 || d < -2.0))
+			return false;
+	}
+	return true;
+}
+
+static void bench_pack(void)
+{
+	const int w = opt.width, h = opt.height;
+	uint8_t *rgb = make_rgb565(w, h);
+	uint8_t *packed = (uint8_t *)malloc((size_t)w * h);
+	uint8_t *unpacked = (uint8_t *)malloc((size_t)w * h * 3);
+	uint8_t *gray = (uint8_t *)malloc((size_t)w * h);
+	char name[64];
+
+	snprintf(name, sizeof(name), "pack/rawh");
+	if (selected(name))
+	{
+		// Odd width: rows are padded to whole bytes.
+		uint8_t hdr[RC_FRAME_RAWH_LEN];
+		rc_rawh_t parsed;
+		const uint16_t ow = (uint16_t)(w - 1);
+		const uint32_t len4 = (uint32_t)((ow + 1) / 2) * (uint32_t)h;
+		bool ok = rc_frame_payload_len(RC_FRAME_GRAY4, ow, (uint16_t)h) == len4 &&
+				  rc_frame_payload_len(RC_FRAME_GRAY2, 5, 1) == 2 && rc_frame_payload_len(RC_FRAME_RGB332, 5, 1) == 5;
+		(void)rc_rawh_write(hdr, sizeof(hdr), RC_FRAME_GRAY4, ow, (uint16_t)h, len4);
+		ok = ok && rc_rawh_parse(hdr, sizeof(hdr), &parsed) == RC_RAWH_OK && parsed.format == RC_FRAME_GRAY4;
+		(void)rc_rawh_write(hdr, sizeof(hdr), RC_FRAME_GRAY4, ow, (uint16_t)h, (uint32_t)ow * (uint32_t)h / 2);
+		ok = ok && rc_rawh_parse(hdr, sizeof(hdr), &parsed) == RC_RAWH_BAD_SIZE;
+		hdr[5] = RC_FRAME_FORMAT_COUNT;
+		ok = ok && rc_rawh_parse(hdr, sizeof(hdr), &parsed) == RC_RAWH_BAD_FORMAT;
+		check(name, ok, "packed RAWH payload length / parse");
+	}
+
+	snprintf(name, sizeof(name), "pack/tails");
+	if (selected(name))
+	{
+		// Widths that end mid-word and mid-byte, both dither settings.
+		bool ok = true;
+		for (int tw = w - 7; tw < w && ok; tw++)
+			for (int d = 0; d < 2 && ok; d++)
+				ok = pack_gray_ok(rgb, tw, 8, 1, RC_FRAME_GRAY4, d, packed, unpacked, gray) &&
+					 pack_gray_ok(rgb, tw, 8, 1, RC_FRAME_GRAY2, d, packed, unpacked, gray) &&
+					 pack_rgb332_ok(rgb, tw, 8, false, packed, unpacked);
+		check(name, ok, "partial words / bytes differ from reference");
+	}
+
+	static const uint8_t formats[] = {RC_FRAME_GRAY4, RC_FRAME_GRAY2, RC_FRAME_RGB332};
+	static const int factors[] = {1, 2, 4};
+	for (size_t fi = 0; fi < sizeof(formats) / sizeof(formats[0]); fi++)
+		for (size_t i = 0; i < sizeof(factors) / sizeof(factors[0]); i++)
+			for (int d = 0; d < 2; d++)
+			{
+				const uint8_t format = formats[fi];
+				const int f = factors[i];
+				snprintf(name, sizeof(name), "pack/rgb565_to_%s%s x%d", rc_frame_format_name(format),
+						 d ? "+dither" : "", f);
+				if (!selected(name))
+					continue;
+				const bool ok = (format == RC_FRAME_RGB332)
+									? (f != 1 || pack_rgb332_ok(rgb, w, h, d, packed, unpacked))
+									: pack_gray_ok(rgb, w, h, f, format, d, packed, unpacked, gray);
+				check(name, ok, "decoded frame differs from reference");
+				pack_ctx_t ctx = {.src = rgb, .dst = packed, .width = w, .height = h, .factor = f,
+								  .format = format, .dither = d};
+				bench_run(name, run_pack, &ctx, rc_frame_payload_len(format, (uint16_t)(w / f), (uint16_t)(h / f)));
+			}
+
+	// Receiver side: packed payload -> GRAY8 / RGB888.
+	for (size_t fi = 0; fi < sizeof(formats) / sizeof(formats[0]); fi++)
+	{
+		const uint8_t format = formats[fi];
+		snprintf(name, sizeof(name), "pack/decode_%s", rc_frame_format_name(format));
+		if (!selected(name))
+			continue;
+		pack_ctx_t enc = {.src = rgb, .dst = packed, .width = w, .height = h, .factor = 1, .format = format,
+						  .dither = 1};
+		run_pack(&enc);
+		pack_ctx_t ctx = {.src = packed, .dst = unpacked, .width = w, .height = h, .format = format};
+		bench_run(name, (format == RC_FRAME_RGB332) ? run_rgb332_rgb888 : run_unpack_gray, &ctx,
+				  (size_t)w * h * ((format == RC_FRAME_RGB332) ? 3 : 1));
+	}
+
+	free(rgb);
+	free(packed);
+	free(unpacked);
+	free(gray);
+}
+
+// --- vision ---
+
+typedef struct
+{
+	const uint8_t *img;
+	vision_config_t cfg;
+	vision_result_t res;
+} vision_ctx_t;
+
+static void run_vision(void *p)
+{
+	vision_ctx_t *c = (vision_ctx_t *)p;
+	(void)vision_analyze(c->img, opt.width, opt.height, &c->cfg, &c->res);
+}
+
+// Dark line, 1/40 of the width wide, centered at line_x(y) = x_bottom + (y - h) * slope.
+static int line_center(int y, int w, int h)
+{
+	return (w * 5) / 8 - ((h - 1 - y) * w) / (4 * h);
+}
+
+static void bench_vision(void)
+{
+	const int w = opt.width, h = opt.height;
+	const int half = (w / 80 > 0) ? w / 80 : 1;
+	uint8_t *line = (uint8_t *)malloc((size_t)w * h);
+	uint8_t *blob = (uint8_t *)malloc((size_t)w * h);
+	uint32_t seed = 777;
+	for (int y = 0; y < h; y++)
+		for (int x = 0; x < w; x++)
+		{
+			seed = seed * 1103515245u + 12345u;
+			const int noise = (int)((seed >> 27) & 15) - 8;
+			const int c = line_center(y, w, h);
+			line[(size_t)y * w + x] = (uint8_t)(((x >= c - half && x <= c + half) ? 40 : 200) + noise);
+			const bool in_blob = x >= w / 4 && x < w / 4 + w / 8 && y >= h / 3 && y < h / 3 + h / 6;
+			blob[(size_t)y * w + x] = (uint8_t)((in_blob ? 230 : 100) + noise);
+		}
+
+	static const int steps[] = {1, 2, 4};
+	for (size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++)
+	{
+		const int step = steps[i];
+		char name[64];
+
+		snprintf(name, sizeof(name), "vision/line step%d", step);
+		if (selected(name))
+		{
+			vision_ctx_t ctx = {.img = line, .cfg = VISION_CONFIG_DEFAULT};
+			ctx.cfg.step = (uint8_t)step;
+			run_vision(&ctx);
+			bool ok = ctx.res.line_found;
+			// Each band's centroid must sit on the drawn line at the band's middle row (+- step + 1).
+			const int roi_y0 = (h * ctx.cfg.roi_top_pct) / 100;
+			for (int b = 0; b < VISION_BANDS && ok; b++)
+			{
+				const int mid_y = h - 1 - ((2 * b + 1) * (h - roi_y0)) / (2 * VISION_BANDS);
+				const int d = ctx.res.band_x[b] - line_center(mid_y, w, h);
+				ok = ctx.res.band_x[b] >= 0 && d <= step + 1 && d >= -(step + 1);
+			}
+			// The line leans left going away from the car.
+			ok = ok && ctx.res.line_offset > 0 && ctx.res.line_heading < 0;
+			check(name, ok, "line centroids off the drawn line");
+			bench_run(name, run_vision, &ctx, 0);
+		}
+
+		snprintf(name, sizeof(name), "vision/blob step%d", step);
+		if (selected(name))
+		{
+			vision_ctx_t ctx = {.img = blob, .cfg = VISION_CONFIG_DEFAULT};
+			ctx.cfg.step = (uint8_t)step;
+			ctx.cfg.dark_target = false;
+			run_vision(&ctx);
+			const vision_result_t *r = &ctx.res;
+			const int x0 = w / 4, x1 = w / 4 + w / 8 - 1, y0 = h / 3, y1 = h / 3 + h / 6 - 1;
+			const bool ok = r->blob_found && r->blob_x0 >= x0 && r->blob_x0 < x0 + step && r->blob_x1 <= x1 &&
+							r->blob_x1 > x1 - step && r->blob_y0 >= y0 && r->blob_y0 < y0 + step && r->blob_y1 <= y1 &&
+							r->blob_y1 > y1 - step;
+			check(name, ok, "blob bounding box doesn't match the drawn marker");
+			bench_run(name, run_vision, &ctx, 0);
+		}
+	}
+
+	free(line);
+	free(blob);
+}
+
+// --- abbreviated JPEG ---
+
+static const uint8_t STD_LUMA_Q[64] = {
+	16, 11, 10, 16, 24,  40,  51,  61,  12, 12, 14, 19, 26,  58,  60,  55,  14, 13, 16, 24, 40,  57,
+	69, 56, 14, 17, 22,  29,  51,  87,  80, 62, 18, 22, 37,  56,  68,  109, 103, 77, 24, 35, 55,  64,
+	81, 104, 113, 92, 49, 64, 78,  87,  103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99,
+};
+static const uint8_t STD_CHROMA_Q[8] = {17, 18, 24, 47, 99, 99, 99, 99}; // first row; the rest is 99
+// Code length counts of the four standard Huffman tables (DC/AC luma, DC/AC chroma).
+static const uint8_t STD_DHT_BITS[4][16] = {
+	{0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0},
+	{0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d},
+	{0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0},
+	{0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77},
+};
+static const uint8_t STD_DHT_CLASS[4] = {0x00, 0x10, 0x01, 0x11};
+
+static uint8_t *put_marker(uint8_t *p, uint8_t marker, size_t seg_len)
+{
+	*p++ = 0xFF;
+	*p++ = marker;
+	*p++ = (uint8_t)(seg_len >> 8);
+	*p++ = (uint8_t)seg_len;
+	return p;
+}
+
+// A baseline JPEG laid out like the camera's: SOI, APP0, DQT, SOF0 (YUV422), DHT, SOS, then
+// `scan_len` bytes of random entropy-coded data (0xFF stuffed) and EOI. The tables have the
+// standard sizes (T.81 Annex K) but the Huffman values and the scan are filler: the header is
+// realistic, the picture doesn't decode. `buf` needs 700 + 2 * scan_len bytes.
+static size_t make_jpeg(uint8_t *buf, int w, int h, int quality, size_t scan_len, uint32_t seed)
+{
+	const int scale = (quality < 50) ? 5000 / quality : 200 - 2 * quality;
+	uint8_t *p = buf;
+	*p++ = 0xFF;
+	*p++ = 0xD8;
+	p = put_marker(p, 0xE0, 16);
+	memcpy(p, "JFIF\0\x01\x01\0\0\x01\0\x01\0\0", 14);
+	p += 14;
+
+	p = put_marker(p, 0xDB, 2 + 2 * 65);
+	for (int t = 0; t < 2; t++)
+	{
+		*p++ = (uint8_t)t;
+		for (int i = 0; i < 64; i++)
+		{
+			const int base = t ? (i < 8 ? STD_CHROMA_Q[i] : 99) : STD_LUMA_Q[i];
+			const int q = (base * scale + 50) / 100;
+			*p++ = (uint8_t)(q < 1 ? 1 : q > 255 ? 255 : q);
+		}
+	}
+
+	p = put_marker(p, 0xC0, 17);
+	*p++ = 8;
+	*p++ = (uint8_t)(h >> 8);
+	*p++ = (uint8_t)h;
+	*p++ = (uint8_t)(w >> 8);
+	*p++ = (uint8_t)w;
+	*p++ = 3;
+	const uint8_t comps[9] = {1, 0x21, 0, 2, 0x11, 1, 3, 0x11, 1};
+	memcpy(p, comps, sizeof(comps));
+	p += sizeof(comps);
+
+	size_t dht_len = 2;
+	for (int t = 0; t < 4; t++)
+	{
+		dht_len += 17;
+		for (int i = 0; i < 16; i++)
+			dht_len += STD_DHT_BITS[t][i];
+	}
+	p = put_marker(p, 0xC4, dht_len);
+	for (int t = 0; t < 4; t++)
+	{
+		*p++ = STD_DHT_CLASS[t];
+		int n = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			*p++ = STD_DHT_BITS[t][i];
+			n += STD_DHT_BITS[t][i];
+		}
+		for (int i = 0; i < n; i++)
+			*p++ = (uint8_t)i;
+	}
+
+	p = put_marker(p, 0xDA, 12);
+	const uint8_t sos[10] = {3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0};
+	memcpy(p, sos, sizeof(sos));
+	p += sizeof(sos);
+
+	for (size_t i = 0; i < scan_len; i++)
+	{
+		seed = seed * 1103515245u + 12345u;
+		const uint8_t b = (uint8_t)(seed >> 23);
+		*p++ = b;
+		if (b == 0xFF)
+			*p++ = 0x00;
+	}
+	*p++ = 0xFF;
+	*p++ = 0xD9;
+	return (size_t)(p - buf);
+}
+
+typedef struct
+{
+	const uint8_t *jpeg;
+	size_t len;
+	rc_jpeg_tables_t *tables;
+	uint8_t ref[RC_FRAME_JREF_LEN];
+	rc_frame_t frame;
+	uint8_t *out;
+	size_t out_cap;
+} jpeg_ctx_t;
+
+// Sender side per frame: compare/refresh the tables, write the JREF.
+static void run_jpeg_split(void *p)
+{
+	jpeg_ctx_t *c = (jpeg_ctx_t *)p;
+	const size_t off = rc_jpeg_tables_update(c->tables, c->jpeg, c->len);
+	(void)rc_jref_write(c->ref, sizeof(c->ref), c->tables->id, (uint32_t)(c->len - off));
+}
+
+// Receiver side per frame: put the JPEG back together for the decoder.
+static void run_jpeg_rebuild(void *p)
+{
+	jpeg_ctx_t *c = (jpeg_ctx_t *)p;
+	(void)rc_frame_jpeg_rebuild(&c->frame, c->out, c->out_cap);
+}
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+	FILE *fp = fopen(path, "rb");
+	if (!fp)
+		return NULL;
+	fseek(fp, 0, SEEK_END);
+	const long n = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	uint8_t *buf = (n > 0) ? (uint8_t *)malloc((size_t)n) : NULL;
+	if (buf && fread(buf, 1, (size_t)n, fp) != (size_t)n)
+	{
+		free(buf);
+		buf = NULL;
+	}
+	fclose(fp);
+	*len = buf ? (size_t)n : 0;
+	return buf;
+}
+
+static void print_saving(const char *what, size_t full, size_t hdr_len)
+{
+	const size_t abbrev = full - hdr_len + RC_FRAME_JREF_LEN;
+	printf("%-36s %7zu B full %7zu B abbreviated, %4zu B (%.1f%%) saved, %5.1f kbit/s at 25 fps\n", what, full,
+		   abbrev, full - abbrev, 100.0 * (double)(full - abbrev) / (double)full,
+		   (double)(full - abbrev) * 8.0 * 25.0 / 1000.0);
+}
+
+static void bench_jpeg(void)
+{
+	const char *name = "jpeg/abbrev";
+	if (!selected(name))
+		return;
+
+	const int w = opt.width, h = opt.height;
+	// Scan data of 1 bit per pixel, about what the sensor produces at its default quality.
+	const size_t scan_len = (size_t)w * h / 8;
+	uint8_t *jpeg = (uint8_t *)malloc(700 + 2 * scan_len);
+	uint8_t *other = (uint8_t *)malloc(700 + 2 * scan_len);
+	size_t len = make_jpeg(jpeg, w, h, 80, scan_len, 1);
+	if (opt.jpeg_file)
+	{
+		free(jpeg);
+		jpeg = read_file(opt.jpeg_file, &len);
+		if (!jpeg)
+		{
+			check(name, false, "can't read --jpeg file");
+			free(other);
+			return;
+		}
+	}
+	const size_t other_len = make_jpeg(other, w, h, 60, scan_len, 2);
+
+	// Sender: split, unchanged tables keep their id, a quality change makes new ones.
+	static rc_jpeg_tables_t tables;
+	memset(&tables, 0, sizeof(tables));
+	const size_t hdr_len = rc_jpeg_header_len(jpeg, len);
+	bool ok = hdr_len > 0 && rc_jpeg_tables_update(&tables, jpeg, len) == hdr_len && tables.id == 1;
+	ok = ok && rc_jpeg_tables_update(&tables, jpeg, len) == hdr_len && tables.id == 1 && tables.changes == 0;
+	uint8_t jtab_a[RC_FRAME_JTAB_HDR_LEN + RC_JPEG_TABLES_MAX];
+	const size_t jtab_a_len = tables.len;
+	memcpy(jtab_a, tables.msg, tables.len);
+	const size_t other_hdr = rc_jpeg_tables_update(&tables, other, other_len);
+	ok = ok && other_hdr > 0 && tables.id == 2 && tables.changes == 1;
+	ok = ok && rc_jpeg_header_len(jpeg, hdr_len) == 0 && rc_jpeg_header_len(jpeg + 2, len - 2) == 0;
+	check(name, ok, "header split / table change detection");
+
+	// Receiver: tables, reference, an interleaved ack, scan data -> the original bytes.
+	rc_frame_rx_t *rx = (rc_frame_rx_t *)calloc(1, sizeof(rc_frame_rx_t));
+	uint8_t *out = (uint8_t *)malloc(len + other_len);
+	uint8_t ref[RC_FRAME_JREF_LEN];
+	const uint8_t ack[5] = {0xC5, 0x24, 1, 0, 0};
+	rc_frame_t f;
+	ok = rx && out;
+	ok = ok && rc_frame_rx_feed(rx, jtab_a, jtab_a_len, &f) == RC_FRAME_RX_NONE && rx->tables_id == 1;
+	(void)rc_jref_write(ref, sizeof(ref), 1, (uint32_t)(len - hdr_len));
+	ok = ok && rc_frame_rx_feed(rx, ref, sizeof(ref), &f) == RC_FRAME_RX_NONE;
+	ok = ok && rc_frame_rx_feed(rx, ack, sizeof(ack), &f) == RC_FRAME_RX_NONE;
+	ok = ok && rc_frame_rx_feed(rx, jpeg + hdr_len, len - hdr_len, &f) == RC_FRAME_RX_JPEG && f.prefix_len == hdr_len;
+	ok = ok && rc_frame_jpeg_rebuild(&f, out, len) == len && memcmp(out, jpeg, len) == 0;
+	ok = ok && rc_frame_jpeg_rebuild(&f, out, len - 1) == 0;
+	// Scan data for tables the client doesn't have is dropped, whole JPEGs still pass.
+	(void)rc_jref_write(ref, sizeof(ref), 2, (uint32_t)(other_len - other_hdr));
+	ok = ok && rc_frame_rx_feed(rx, ref, sizeof(ref), &f) == RC_FRAME_RX_NONE;
+	ok = ok && rc_frame_rx_feed(rx, other + other_hdr, other_len - other_hdr, &f) == RC_FRAME_RX_ERROR &&
+		 rx->missing_tables == 1;
+	ok = ok && rc_frame_rx_feed(rx, other, other_len, &f) == RC_FRAME_RX_JPEG && f.prefix == NULL;
+	ok = ok && rc_frame_rx_feed(rx, tables.msg, tables.len, &f) == RC_FRAME_RX_NONE && rx->tables_id == 2;
+	ok = ok && rc_frame_rx_feed(rx, ref, sizeof(ref), &f) == RC_FRAME_RX_NONE;
+	ok = ok && rc_frame_rx_feed(rx, other + other_hdr, other_len - other_hdr, &f) == RC_FRAME_RX_JPEG;
+	ok = ok && rc_frame_jpeg_rebuild(&f, out, other_len) == other_len && memcmp(out, other, other_len) == 0;
+	check(name, ok, "JTAB/JREF receive and byte-exact rebuild");
+
+	if (ok)
+	{
+		jpeg_ctx_t ctx = {.jpeg = jpeg, .len = len, .tables = &tables, .out = out, .out_cap = len};
+		(void)rc_jpeg_tables_update(&tables, jpeg, len);
+		ctx.frame.prefix = jpeg;
+		ctx.frame.prefix_len = hdr_len;
+		ctx.frame.data = jpeg + hdr_len;
+		ctx.frame.len = len - hdr_len;
+		bench_run("jpeg/abbrev split (sender)", run_jpeg_split, &ctx, len - hdr_len + RC_FRAME_JREF_LEN);
+		bench_run("jpeg/abbrev rebuild (receiver)", run_jpeg_rebuild, &ctx, len);
+
+		char what[64];
+		if (opt.jpeg_file)
+		{
+			print_saving(opt.jpeg_file, len, hdr_len);
+		}
+		else
+		{
+			static const int sizes[3][2] = {{160, 120}, {320, 240}, {640, 480}};
+			for (int i = 0; i < 3; i++)
+			{
+				const int sw = sizes[i][0], sh = sizes[i][1];
+				uint8_t *buf = (uint8_t *)malloc(700 + 2 * (size_t)sw * sh / 8);
+				if (!buf)
+					break;
+				const size_t n = make_jpeg(buf, sw, sh, 80, (size_t)sw * sh / 8, 3);
+				snprintf(what, sizeof(what), "jpeg/abbrev %dx%d", sw, sh);
+				print_saving(what, n, rc_jpeg_header_len(buf, n));
+				free(buf);
+			}
+		}
+		printf("%-36s %7zu B once per connection and table change\n", "jpeg/abbrev JTAB", jtab_a_len);
+	}
+	free(rx);
+	free(out);
+	free(other);
+	free(jpeg);
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+			"usage: %s [--size WxH] [--min-ms N] [--filter SUBSTR] [--jpeg FILE]\n"
+			"  --size WxH      frame size (default 320x240)\n"
+			"  --min-ms N      minimum run time per benchmark (default 300)\n"
+			"  --filter S      only run benchmarks whose name contains S\n"
+			"  --jpeg FILE     measure abbreviated JPEG on this frame instead of a synthetic one\n",
+			argv0);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option longopts[] = {
+		{"size", required_argument, NULL, 's'},
+		{"min-ms", required_argument, NULL, 'm'},
+		{"filter", required_argument, NULL, 'f'},
+		{"jpeg", required_argument, NULL, 'j'},
+		{"help", no_argument, NULL, '?'},
+		{NULL, 0, NULL, 0},
+	};
+	int ch;
+	while ((ch = getopt_long(argc, argv, "", longopts, NULL)) != -1)
+	{
+		switch (ch)
+		{
+		case 's':
+			if (sscanf(optarg, "%dx%d", &opt.width, &opt.height) != 2)
+				opt.width = 0;
+			break;
+		case 'm': opt.min_ms = atoi(optarg); break;
+		case 'f': opt.filter = optarg; break;
+		case 'j': opt.jpeg_file = optarg; break;
+		default: usage(argv[0]); return 2;
+		}
+	}
+	// Multiples of 4 keep every factor exact.
+	if (opt.width <= 0 || opt.height <= 0 || opt.width % 4 || opt.height % 4)
+	{
+		usage(argv[0]);
+		return 2;
+	}
+
+	printf("rc_bench: %dx%d frames\n", opt.width, opt.height);
+	bench_downscale();
+	bench_decode();
+	bench_pack();
+	bench_vision();
+	bench_jpeg();
+
+	if (failures)
+	{
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,372 @@
+// Linux harness for the camera supervisor (main/cam_supervisor.c): a simulated sensor with injected
+// faults runs through the camera task's grab / re-init loop on a virtual clock.
+//
+//   rc_camsim run [--fps N] [--duration S] [--boot-fail N] [--hang-at S] [--hang-inits N]
+//                 [--null-pct PCT] [--slow-pct PCT] [--seed N]
+//   rc_camsim selftest
+//
+// The sensor delivers a frame per grab in --fps pacing. Faults:
+// - --boot-fail N: the first N inits fail (sensor not answering on SCCB yet)
+// - --hang-at S: at S seconds the sensor hangs; every fb_get blocks for the driver's 4 s timeout and
+//   returns nothing until the camera is re-initialized. The first --hang-inits re-inits after the
+//   hang fail as well
+// - --null-pct / --slow-pct: random single grabs that return nothing / take 600 ms
+//
+// The report shows frames delivered, the longest gap between frames, stalls, init attempts and
+// recovery times. Before the supervisor, a hang left the car blind until a power cycle and a camera
+// missing at boot stopped the camera task for good.
+
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cam_supervisor.h"
+#include "rc_config.h"
+#include "selftest.h"
+
+#define FB_GET_TIMEOUT_US 4000000 // esp32-camera's fb_get wait
+#define INIT_US 350000            // esp_camera_init with SCCB probe and buffer allocation
+#define SLOW_GET_US 600000
+
+typedef struct
+{
+	int fps;
+	int duration_s;
+	int boot_fail;
+	double hang_at_s;
+	int hang_inits;
+	int null_pct;
+	int slow_pct;
+	uint32_t seed;
+} options_t;
+
+static options_t opt = {
+	.fps = STREAM_FPS,
+	.duration_s = 60,
+	.boot_fail = 0,
+	.hang_at_s = -1.0,
+	.hang_inits = 0,
+	.null_pct = 0,
+	.slow_pct = 0,
+	.seed = 1,
+};
+
+static uint32_t rng_state;
+
+static uint32_t rng(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+static cam_sup_config_t default_config(void)
+{
+	const cam_sup_config_t cfg = {
+		.slow_us = CAM_SLOW_GET_MS * 1000u,
+		.stall_grabs = CAM_STALL_GRABS,
+		.stall_us = CAM_STALL_MS * 1000u,
+		.backoff_min_us = CAM_REINIT_BACKOFF_MIN_MS * 1000u,
+		.backoff_max_us = CAM_REINIT_BACKOFF_MAX_MS * 1000u,
+	};
+	return cfg;
+}
+
+typedef struct
+{
+	int64_t t;
+	bool driver_up;
+	bool hung;
+	bool hang_done;
+	int inits_to_fail;
+	uint32_t frames;
+	int64_t last_frame_us;
+	int64_t max_gap_us;
+	int64_t max_gap_at_us;
+} sensor_t;
+
+// One init attempt; returns whether it worked and advances the clock.
+static bool sensor_init(sensor_t *s)
+{
+	s->t += INIT_US;
+	if (s->inits_to_fail > 0)
+	{
+		s->inits_to_fail--;
+		s->driver_up = false;
+		return false;
+	}
+	s->driver_up = true;
+	s->hung = false;
+	return true;
+}
+
+// One fb_get; returns whether a frame came back, `get_us` is the time spent.
+static bool sensor_grab(sensor_t *s, uint32_t frame_us, uint32_t *get_us)
+{
+	if (!s->hang_done && opt.hang_at_s >= 0 && s->t >= (int64_t)(opt.hang_at_s * 1e6))
+	{
+		s->hang_done = true;
+		s->hung = true;
+		s->inits_to_fail = opt.hang_inits;
+	}
+	const uint32_t r = rng() % 100;
+	bool ok = true;
+	if (!s->driver_up || s->hung)
+	{
+		*get_us = FB_GET_TIMEOUT_US;
+		ok = false;
+	}
+	else if ((int)r < opt.null_pct)
+	{
+		*get_us = frame_us;
+		ok = false;
+	}
+	else if ((int)r < opt.null_pct + opt.slow_pct)
+	{
+		*get_us = SLOW_GET_US;
+	}
+	else
+	{
+		*get_us = 2000 + rng() % 8000; // a frame is usually ready
+	}
+	s->t += *get_us;
+	if (ok)
+	{
+		s->frames++;
+		const int64_t gap = s->t - s->last_frame_us;
+		if (gap > s->max_gap_us)
+		{
+			s->max_gap_us = gap;
+			s->max_gap_at_us = s->last_frame_us;
+		}
+		s->last_frame_us = s->t;
+	}
+	return ok;
+}
+
+// The camera task's loop (main.c camera_stream_task) with frames always wanted.
+static void sim_run(cam_supervisor_t *sup, sensor_t *s, int64_t until_us, bool verbose)
+{
+	const uint32_t frame_us = 1000000u / (uint32_t)opt.fps;
+	while (s->t < until_us)
+	{
+		uint32_t wait_us = 0;
+		const cam_sup_action_t action = cam_supervisor_next(sup, s->t, &wait_us);
+		if (action == CAM_SUP_REINIT)
+		{
+			const bool ok = sensor_init(s);
+			cam_supervisor_init_result(sup, ok, s->t);
+			if (verbose)
+				printf("%8.3f s  init %s (attempt %u, backoff %u ms)\n", s->t / 1e6, ok ? "ok" : "failed",
+					   (unsigned)sup->stats.inits, (unsigned)(sup->backoff_us / 1000));
+			continue;
+		}
+		if (action == CAM_SUP_WAIT)
+		{
+			s->t += wait_us;
+			continue;
+		}
+
+		uint32_t get_us = 0;
+		const bool ok = sensor_grab(s, frame_us, &get_us);
+		if (cam_supervisor_grab(sup, ok, get_us, s->t) && verbose)
+			printf("%8.3f s  stall %u (%s)\n", s->t / 1e6, (unsigned)sup->stats.stalls, ok ? "slow" : "no frames");
+		s->t += frame_us;
+	}
+}
+
+static int cmd_run(void)
+{
+	rng_state = opt.seed ? opt.seed : 1;
+	const cam_sup_config_t cfg = default_config();
+	cam_supervisor_t sup;
+	cam_supervisor_init(&sup, &cfg, 0);
+	sensor_t s = {.inits_to_fail = opt.boot_fail};
+	const int64_t until_us = (int64_t)opt.duration_s * 1000000;
+	sim_run(&sup, &s, until_us, true);
+	const int64_t tail_gap = s.t - s.last_frame_us;
+	if (tail_gap > s.max_gap_us)
+	{
+		s.max_gap_us = tail_gap;
+		s.max_gap_at_us = s.last_frame_us;
+	}
+
+	char json[512];
+	(void)cam_supervisor_json(json, sizeof(json), &sup, s.t);
+	printf("frames %u in %d s, longest gap %.2f s (from %.2f s)\n", (unsigned)s.frames, opt.duration_s,
+		   s.max_gap_us / 1e6, s.max_gap_at_us / 1e6);
+	printf("%s\n", json);
+	return 0;
+}
+
+// --- selftest ---
+
+static int cmd_selftest(void)
+{
+	const cam_sup_config_t cfg = default_config();
+	const int64_t min_us = cfg.backoff_min_us;
+	cam_supervisor_t sup;
+	uint32_t wait_us = 0;
+
+	// Boot: failures back off 1x, 2x, 4x the minimum; nothing gives up.
+	cam_supervisor_init(&sup, &cfg, 0);
+	int64_t t = 0;
+	expect(cam_supervisor_next(&sup, t, NULL) == CAM_SUP_REINIT, "boot init right away");
+	for (int i = 0; i < 3; i++)
+	{
+		cam_supervisor_init_result(&sup, false, t);
+		expect(cam_supervisor_next(&sup, t, &wait_us) == CAM_SUP_WAIT && wait_us == (uint32_t)(min_us << i),
+			   "boot backoff doubles");
+		t += wait_us;
+		expect(cam_supervisor_next(&sup, t, NULL) == CAM_SUP_REINIT, "retry when due");
+	}
+	cam_supervisor_init_result(&sup, true, t);
+	expect(cam_supervisor_next(&sup, t, NULL) == CAM_SUP_GRAB && sup.state == CAM_SUP_STARTING, "boot init ok");
+	t += 40000;
+	expect(!cam_supervisor_grab(&sup, true, 20000, t), "first frame");
+	expect(sup.state == CAM_SUP_RUNNING && sup.stats.recoveries == 0 && sup.backoff_us == cfg.backoff_min_us,
+		   "running, boot not counted as recovery, backoff reset");
+
+	// Transient misses and slow frames below the thresholds are not a stall.
+	for (int i = 0; i < 200; i++)
+	{
+		t += 40000;
+		const bool miss = (i % 10) < 2;
+		expect(!cam_supervisor_grab(&sup, !miss, miss ? 40000 : (i % 10 == 5 ? 700000 : 20000), t),
+			   "no stall on transients");
+	}
+	expect(sup.stats.stalls == 0 && sup.stats.failed_grabs == 40 && sup.stats.slow_grabs == 20, "transient counts");
+	expect(sup.stats.get_us_max == 700000, "fb_get max");
+
+	// Stall by count: CAM_STALL_GRABS quick NULLs in a row.
+	bool stalled = false;
+	for (uint32_t i = 0; i < cfg.stall_grabs; i++)
+	{
+		t += 40000;
+		stalled = cam_supervisor_grab(&sup, false, 40000, t);
+		expect(stalled == (i + 1 == cfg.stall_grabs), "stall after N bad grabs");
+	}
+	expect(sup.stats.stalls == 1 && sup.state == CAM_SUP_RECOVERING, "recovering");
+	expect(cam_supervisor_next(&sup, t, &wait_us) == CAM_SUP_WAIT && wait_us == (uint32_t)min_us, "first re-init delay");
+	t += wait_us;
+	cam_supervisor_init_result(&sup, true, t);
+	t += 30000;
+	cam_supervisor_grab(&sup, true, 30000, t);
+	const int64_t first_bad = t - 30000 - wait_us - (int64_t)cfg.stall_grabs * 40000;
+	expect(sup.stats.recoveries == 1 && sup.stats.recovery_ms_last == (uint32_t)((t - first_bad) / 1000),
+		   "recovery time from first bad grab");
+
+	// Stall by time: slow frames that never add up to the count.
+	t += 40000;
+	const int64_t slow_start = t;
+	int n = 0;
+	do
+	{
+		t += 800000;
+		n++;
+	} while (!cam_supervisor_grab(&sup, true, 800000, t));
+	expect(n < (int)cfg.stall_grabs && t - (slow_start) >= (int64_t)cfg.stall_us, "stall by time");
+
+	// Re-init works but the sensor stays hung: the recovery keeps its start, backoff grows, and a
+	// failing init backs off further; a single hung fb_get is a stall on its own.
+	const int64_t down_since = sup.down_since_us;
+	uint32_t prev_wait = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		expect(cam_supervisor_next(&sup, t, &wait_us) == CAM_SUP_WAIT && wait_us > prev_wait, "backoff grows");
+		prev_wait = wait_us;
+		t += wait_us;
+		cam_supervisor_init_result(&sup, i != 1, t);
+		if (i != 1)
+		{
+			t += 4000000;
+			expect(cam_supervisor_grab(&sup, false, 4000000, t), "hung fb_get stalls at once");
+		}
+	}
+	expect(sup.down_since_us == down_since && sup.state == CAM_SUP_RECOVERING, "recovery start kept");
+	for (int i = 0; i < 20; i++)
+		cam_supervisor_init_result(&sup, false, t);
+	expect(sup.backoff_us == cfg.backoff_max_us, "backoff capped");
+	t = sup.next_init_us;
+	cam_supervisor_init_result(&sup, true, t);
+	t += 20000;
+	cam_supervisor_grab(&sup, true, 20000, t);
+	expect(sup.stats.recoveries == 2 && sup.stats.recovery_ms_max == (uint32_t)((t - down_since) / 1000),
+		   "long recovery");
+
+	// A failed settings re-init while running starts a recovery too.
+	cam_supervisor_init_result(&sup, false, t);
+	expect(sup.state == CAM_SUP_RECOVERING && cam_supervisor_next(&sup, t, NULL) == CAM_SUP_WAIT,
+		   "settings re-init failure");
+
+	// Whole loop: boot failures plus a sensor hang mid-session come back without a reboot.
+	opt.boot_fail = 2;
+	opt.hang_at_s = 10.0;
+	opt.hang_inits = 2;
+	opt.null_pct = 3;
+	opt.slow_pct = 1;
+	rng_state = 7;
+	cam_supervisor_init(&sup, &cfg, 0);
+	sensor_t s = {.inits_to_fail = opt.boot_fail};
+	sim_run(&sup, &s, 30000000, false);
+	expect(sup.stats.recoveries == 1 && sup.state == CAM_SUP_RUNNING, "sim: recovered");
+	expect(sup.stats.init_failures == 4, "sim: init failures");
+	expect(s.last_frame_us > 29000000 && s.max_gap_us < 15000000, "sim: frames after the hang");
+
+	char json[512];
+	expect(cam_supervisor_json(json, sizeof(json), &sup, s.t) > 0, "json");
+	expect(cam_supervisor_json(json, 32, &sup, s.t) == 0, "short buffer");
+
+	return selftest_done();
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+			"usage: %s run [--fps N] [--duration S] [--boot-fail N] [--hang-at S] [--hang-inits N]\n"
+			"              [--null-pct PCT] [--slow-pct PCT] [--seed N]\n"
+			"       %s selftest\n",
+			argv0, argv0);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option longopts[] = {
+		{"fps", required_argument, NULL, 'f'},        {"duration", required_argument, NULL, 'd'},
+		{"boot-fail", required_argument, NULL, 'b'},  {"hang-at", required_argument, NULL, 'h'},
+		{"hang-inits", required_argument, NULL, 'i'}, {"null-pct", required_argument, NULL, 'n'},
+		{"slow-pct", required_argument, NULL, 's'},   {"seed", required_argument, NULL, 'S'},
+		{"help", no_argument, NULL, '?'},             {NULL, 0, NULL, 0},
+	};
+	int ch;
+	while ((ch = getopt_long(argc, argv, "", longopts, NULL)) != -1)
+	{
+		switch (ch)
+		{
+		case 'f': opt.fps = atoi(optarg); break;
+		case 'd': opt.duration_s = atoi(optarg); break;
+		case 'b': opt.boot_fail = atoi(optarg); break;
+		case 'h': opt.hang_at_s = atof(optarg); break;
+		case 'i': opt.hang_inits = atoi(optarg); break;
+		case 'n': opt.null_pct = atoi(optarg); break;
+		case 's': opt.slow_pct = atoi(optarg); break;
+		case 'S': opt.seed = (uint32_t)strtoul(optarg, NULL, 10); break;
+		default: usage(argv[0]); return 2;
+		}
+	}
+
+	const int nargs = argc - optind;
+	if (nargs == 1 && strcmp(argv[optind], "selftest") == 0)
+		return cmd_selftest();
+	if (nargs != 1 || strcmp(argv[optind], "run") != 0 || opt.fps <= 0 || opt.fps > 1000 || opt.duration_s <= 0 ||
+		opt.boot_fail < 0 || opt.hang_inits < 0 || opt.null_pct < 0 || opt.slow_pct < 0 ||
+		opt.null_pct + opt.slow_pct > 100)
+	{
+		usage(argv[0]);
+		return 2;
+	}
+	return cmd_run();
+}
@@ -0,0 +1,689 @@
+// Host emulator of the car's WebSocket endpoint (port 8888, path "/").
+//
+// Streams synthetic RAWH frames at a fixed rate to every connected client and handles control
+// messages with the firmware's protocol code (main/rc_proto.c): HELLO/HELLO_ACK, sequencing,
+// ACK_REQ acks. Lets rc_loadgen and other tools run without hardware.
+//
+// Outbound traffic goes through the firmware's egress scheduler (main/egress.c) with one sender
+// thread, like egress_task: acks and telemetry are written between video fragments, and clients whose
+// sockets are full are skipped (a slow reader loses frames, nobody else waits for it). --no-egress
+// switches back to the old synchronous broadcast (every write in the caller, a 600 KB frame holds
+// up every ack behind it) for comparison.
+//
+// Plain GETs get the firmware's embedded web UI (main/web_assets.h), so the browser driving page can
+// be tried at http://localhost:8888/ without a car.
+
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "egress.h"
+#include "img_scale.h"
+#include "rc_frame.h"
+#include "rc_proto.h"
+#include "web_assets.h"
+#include "ws_lite.h"
+
+#define MAX_CLIENTS 32
+
+typedef struct
+{
+	uint16_t port;
+	int fps;
+	int width;
+	int height;
+	int raw_format; // rc_frame_format_t
+	int max_clients;
+	int send_timeout_ms;
+	bool egress;
+	uint32_t fragment_bytes;
+	int stall_ms;
+	uint32_t video_bps; // 0 = unlimited
+	uint32_t telemetry_bps;
+	uint32_t link_bps; // emulated radio, 0 = loopback speed
+	bool quiet;
+} options_t;
+
+typedef struct
+{
+	bool used;
+	ws_conn_t conn;
+	rc_proto_session_t sess;
+	pthread_t reader;
+} client_t;
+
+static options_t opt = {
+	.port = 8888,
+	.fps = 25,
+	.width = 320,
+	.height = 240,
+	.raw_format = RC_FRAME_GRAY8,
+	.max_clients = 8,
+	.send_timeout_ms = 5000,
+	.egress = true,
+	.fragment_bytes = 4096,
+	.stall_ms = 40,
+	.video_bps = 0,
+	.telemetry_bps = 16384,
+	.quiet = false,
+};
+
+static const uint32_t DEVICE_CAPS = RC_CAP_CONTROL_V2 | RC_CAP_CONTROL_ACK | RC_CAP_TELEMETRY_TEXT |
+									RC_CAP_CONTROL_ONLY | RC_CAP_VIDEO_CHUNKED;
+
+static client_t clients[MAX_CLIENTS];
+static pthread_mutex_t clients_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile sig_atomic_t stop_requested = 0;
+
+static pthread_mutex_t control_lock = PTHREAD_MUTEX_INITIALIZER;
+static rc_control_t control_state;
+static uint32_t control_applied, control_stale, control_malformed;
+static uint64_t frames_sent, bytes_sent, send_failures;
+
+// --link-bps: every write waits for its turn on one shared link, like frames queued in the car's
+// TCP/Wi-Fi stack. Without it loopback is too fast for head-of-line blocking to show.
+static pthread_mutex_t link_lock = PTHREAD_MUTEX_INITIALIZER;
+static int64_t link_busy_until;
+
+// Egress: producers queue under egress_lock, sender_thread does every write (with --egress).
+static egress_t egress;
+static uint8_t *egress_scratch;
+static pthread_mutex_t egress_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t egress_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t egress_video_done = PTHREAD_COND_INITIALIZER;
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	stop_requested = 1;
+}
+
+static void drop_client_locked(client_t *cl)
+{
+	ws_shutdown(&cl->conn);
+}
+
+static void link_pace(size_t len)
+{
+	if (opt.link_bps == 0)
+		return;
+	pthread_mutex_lock(&link_lock);
+	const int64_t now = ws_now_us();
+	if (link_busy_until < now)
+		link_busy_until = now;
+	link_busy_until += (int64_t)len * 1000000 / opt.link_bps;
+	const int64_t until = link_busy_until;
+	pthread_mutex_unlock(&link_lock);
+	ws_sleep_us(until - ws_now_us());
+}
+
+static int client_slot(const client_t *cl)
+{
+	return (int)(cl - clients);
+}
+
+static void cond_wait_us(pthread_cond_t *cond, pthread_mutex_t *lock, int64_t us)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	const int64_t ns = (int64_t)ts.tv_nsec + us * 1000;
+	ts.tv_sec += (time_t)(ns / 1000000000);
+	ts.tv_nsec = (long)(ns % 1000000000);
+	(void)pthread_cond_timedwait(cond, lock, &ts);
+}
+
+static void egress_queue(uint32_t mask, egress_class_t cls, uint8_t opcode, const void *data, size_t len)
+{
+	pthread_mutex_lock(&egress_lock);
+	if (egress_push(&egress, mask, cls, opcode, data, len, ws_now_us()) > 0)
+		pthread_cond_signal(&egress_wake);
+	pthread_mutex_unlock(&egress_lock);
+}
+
+// Control replies: queued ahead of video with the scheduler, written directly without it.
+static void send_reply(client_t *cl, const uint8_t *data, size_t len)
+{
+	if (opt.egress)
+		egress_queue(1u << client_slot(cl), EGRESS_CONTROL, EGRESS_WS_BINARY, data, len);
+	else
+	{
+		link_pace(len);
+		(void)ws_send(&cl->conn, WS_OP_BINARY, data, len);
+	}
+}
+
+static void handle_binary(client_t *cl, const uint8_t *data, size_t len)
+{
+	rc_msg_t msg;
+	if (rc_proto_parse(data, len, &msg) != RC_PARSE_OK)
+	{
+		__atomic_fetch_add(&control_malformed, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	uint8_t reply[RC_PROTO_HELLO_ACK_LEN];
+	if (msg.type == RC_MSG_HELLO)
+	{
+		cl->sess.caps = msg.hello.caps & DEVICE_CAPS;
+		if (opt.egress)
+		{
+			pthread_mutex_lock(&egress_lock);
+			egress_client_set_chunked(&egress, client_slot(cl), (cl->sess.caps & RC_CAP_VIDEO_CHUNKED) != 0);
+			pthread_mutex_unlock(&egress_lock);
+		}
+		send_reply(cl, reply, rc_proto_write_hello_ack(reply, sizeof(reply), cl->sess.caps));
+		return;
+	}
+	if (msg.type != RC_MSG_CONTROL)
+	{
+		__atomic_fetch_add(&control_malformed, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	const rc_control_t *ctrl = &msg.control;
+	const bool fresh = (ctrl->flags & RC_CTRL_FLAG_LEGACY) || rc_proto_session_accept(&cl->sess, ctrl->seq, ws_now_us());
+	if (fresh)
+	{
+		pthread_mutex_lock(&control_lock);
+		control_state = *ctrl;
+		pthread_mutex_unlock(&control_lock);
+		__atomic_fetch_add(&control_applied, 1, __ATOMIC_RELAXED);
+	}
+	else
+	{
+		__atomic_fetch_add(&control_stale, 1, __ATOMIC_RELAXED);
+	}
+	if (ctrl->flags & RC_CTRL_FLAG_ACK_REQ)
+		send_reply(cl, reply,
+				   rc_proto_write_ack(reply, sizeof(reply), ctrl->seq, fresh ? RC_ACK_APPLIED : RC_ACK_STALE));
+}
+
+static void *reader_thread(void *arg)
+{
+	client_t *cl = (client_t *)arg;
+	ws_set_max_msg(&cl->conn, 128);
+	while (!stop_requested)
+	{
+		ws_msg_t msg;
+		const int r = ws_recv(&cl->conn, &msg, 200);
+		if (r < 0)
+			break;
+		if (r == 0)
+			continue;
+		if (msg.opcode == WS_OP_BINARY)
+			handle_binary(cl, msg.data, msg.len);
+		else if (!opt.quiet)
+			printf("[WS Text] %.*s\n", (int)msg.len, (const char *)msg.data);
+	}
+
+	pthread_mutex_lock(&clients_lock);
+	ws_close(&cl->conn);
+	cl->used = false;
+	if (opt.egress)
+	{
+		// Before the slot can be reused (lock order: clients_lock, then egress_lock).
+		pthread_mutex_lock(&egress_lock);
+		if (egress_client_close(&egress, client_slot(cl)))
+			pthread_cond_broadcast(&egress_video_done);
+		pthread_mutex_unlock(&egress_lock);
+	}
+	pthread_mutex_unlock(&clients_lock);
+	if (!opt.quiet)
+		printf("client disconnected\n");
+	return NULL;
+}
+
+static void broadcast(uint8_t opcode, const void *data, size_t len)
+{
+	pthread_mutex_lock(&clients_lock);
+	for (int i = 0; i < MAX_CLIENTS; i++)
+	{
+		client_t *cl = &clients[i];
+		if (!cl->used)
+			continue;
+		// Like the firmware's subscriber registry: CONTROL_ONLY clients get telemetry but no video.
+		if (opcode == WS_OP_BINARY && (cl->sess.caps & RC_CAP_CONTROL_ONLY))
+			continue;
+		link_pace(len);
+		if (ws_send(&cl->conn, opcode, data, len) != 0)
+		{
+			send_failures++;
+			drop_client_locked(cl);
+			continue;
+		}
+		bytes_sent += len;
+	}
+	pthread_mutex_unlock(&clients_lock);
+}
+
+static uint32_t video_mask(void)
+{
+	uint32_t mask = 0;
+	pthread_mutex_lock(&clients_lock);
+	for (int i = 0; i < EGRESS_MAX_CLIENTS; i++)
+		if (clients[i].used && !(clients[i].sess.caps & RC_CAP_CONTROL_ONLY))
+			mask |= 1u << i;
+	pthread_mutex_unlock(&clients_lock);
+	return mask;
+}
+
+static uint32_t all_mask(void)
+{
+	uint32_t mask = 0;
+	pthread_mutex_lock(&clients_lock);
+	for (int i = 0; i < EGRESS_MAX_CLIENTS; i++)
+		if (clients[i].used)
+			mask |= 1u << i;
+	pthread_mutex_unlock(&clients_lock);
+	return mask;
+}
+
+// Slots whose sockets can take data now, like egress_writable() in the firmware.
+static uint32_t writable_mask(void)
+{
+	struct pollfd fds[MAX_CLIENTS];
+	int slots[MAX_CLIENTS];
+	nfds_t n = 0;
+	pthread_mutex_lock(&clients_lock);
+	for (int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if (!clients[i].used)
+			continue;
+		fds[n] = (struct pollfd){.fd = clients[i].conn.fd, .events = POLLOUT};
+		slots[n++] = i;
+	}
+	uint32_t mask = 0;
+	if (n > 0 && poll(fds, n, 0) >= 0)
+	{
+		for (nfds_t k = 0; k < n; k++)
+			if (fds[k].revents & (POLLOUT | POLLERR | POLLHUP)) // errors show up in the send
+				mask |= 1u << slots[k];
+	}
+	pthread_mutex_unlock(&clients_lock);
+	return mask;
+}
+
+// The firmware's egress_task: one WS frame at a time, as handed out by the scheduler.
+static void *sender_thread(void *arg)
+{
+	(void)arg;
+	pthread_mutex_lock(&egress_lock);
+	while (!stop_requested)
+	{
+		// Lock order: clients_lock, then egress_lock.
+		pthread_mutex_unlock(&egress_lock);
+		const uint32_t writable = writable_mask();
+		pthread_mutex_lock(&egress_lock);
+		if (egress_set_writable(&egress, writable, ws_now_us()))
+			pthread_cond_broadcast(&egress_video_done);
+
+		egress_tx_t tx;
+		int64_t wait_us = 0;
+		const egress_next_t next = egress_next(&egress, ws_now_us(), &tx, &wait_us);
+		if (next != EGRESS_SEND)
+		{
+			cond_wait_us(&egress_wake, &egress_lock, (next == EGRESS_WAIT && wait_us < 200000) ? wait_us : 200000);
+			continue;
+		}
+		pthread_mutex_unlock(&egress_lock);
+
+		link_pace(tx.len);
+		pthread_mutex_lock(&clients_lock);
+		client_t *cl = &clients[tx.slot];
+		// The slot may have been closed and reopened since egress_next().
+		pthread_mutex_lock(&egress_lock);
+		const bool current = (tx.gen == egress.clients[tx.slot].gen);
+		pthread_mutex_unlock(&egress_lock);
+		const bool ok = current && cl->used && ws_send_frame(&cl->conn, tx.opcode, tx.final, tx.data, tx.len) == 0;
+		if (ok)
+		{
+			bytes_sent += tx.len;
+		}
+		else if (current && cl->used)
+		{
+			send_failures++;
+			drop_client_locked(cl);
+		}
+		pthread_mutex_unlock(&clients_lock);
+
+		pthread_mutex_lock(&egress_lock);
+		if (egress_done(&egress, &tx, ok, ws_now_us()))
+			pthread_cond_broadcast(&egress_video_done);
+	}
+	pthread_mutex_unlock(&egress_lock);
+	return NULL;
+}
+
+// Submits the frame and waits until every subscriber got it or dropped out (the buffers are reused).
+static void egress_video_sync(const uint8_t *hdr, size_t hdr_len, const uint8_t *data, size_t len)
+{
+	const uint32_t mask = video_mask();
+	pthread_mutex_lock(&egress_lock);
+	if (egress_video_submit(&egress, mask, hdr, hdr_len, data, len, ws_now_us()))
+	{
+		pthread_cond_signal(&egress_wake);
+		while (egress_video_busy(&egress) && !stop_requested)
+			cond_wait_us(&egress_video_done, &egress_lock, 200000);
+	}
+	pthread_mutex_unlock(&egress_lock);
+}
+
+static bool have_clients(void)
+{
+	pthread_mutex_lock(&clients_lock);
+	bool any = false;
+	for (int i = 0; i < MAX_CLIENTS && !any; i++)
+		any = clients[i].used;
+	pthread_mutex_unlock(&clients_lock);
+	return any;
+}
+
+// GRAY8 frames are rendered directly, everything else as RGB565 first; packed formats are then
+// converted with the firmware's kernels (dithered, like CAM_STREAM_MODE_PACKED by default).
+static void render_frame(uint8_t *buf, uint8_t *rgb565, uint32_t frame_no)
+{
+	const int w = opt.width;
+	const int h = opt.height;
+	const bool packed = opt.raw_format != RC_FRAME_GRAY8 && opt.raw_format != RC_FRAME_RGB565;
+	uint8_t *out = packed ? rgb565 : buf;
+	for (int y = 0; y < h; y++)
+	{
+		for (int x = 0; x < w; x++)
+		{
+			const uint8_t v = (uint8_t)(((x + (int)frame_no * 4) ^ y) & 0xFF);
+			if (opt.raw_format == RC_FRAME_GRAY8)
+			{
+				buf[y * w + x] = v;
+			}
+			else
+			{
+				const uint16_t pix = (uint16_t)(((v >> 3) << 11) | (((255 - v) >> 2) << 5) | ((y & 0xFF) >> 3));
+				out[2 * (y * w + x)] = (uint8_t)(pix >> 8); // MSB first like the camera
+				out[2 * (y * w + x) + 1] = (uint8_t)pix;
+			}
+		}
+	}
+	if (opt.raw_format == RC_FRAME_RGB332)
+		(void)img_scale_rgb565_to_rgb332(rgb565, w, h, 1, 1, buf);
+	else if (packed)
+		(void)img_scale_rgb565_to_gray_packed(rgb565, w, h, 1, (int)rc_frame_bits((uint8_t)opt.raw_format), 1, buf);
+}
+
+static void *frame_thread(void *arg)
+{
+	(void)arg;
+	const size_t payload_len = rc_frame_payload_len((uint8_t)opt.raw_format, (uint16_t)opt.width, (uint16_t)opt.height);
+	uint8_t *payload = (uint8_t *)malloc(payload_len);
+	uint8_t *rgb565 = (uint8_t *)malloc((size_t)opt.width * (size_t)opt.height * 2);
+	if (!payload || !rgb565)
+	{
+		free(payload);
+		free(rgb565);
+		return NULL;
+	}
+
+	const int64_t period = 1000000LL / opt.fps;
+	int64_t next = ws_now_us();
+	uint32_t frame_no = 0;
+	while (!stop_requested)
+	{
+		ws_sleep_us(next - ws_now_us());
+		next += period;
+		if (next < ws_now_us())
+			next = ws_now_us() + period;
+		if (!have_clients())
+			continue;
+
+		render_frame(payload, rgb565, frame_no++);
+		uint8_t header[RC_FRAME_RAWH_LEN];
+		(void)rc_rawh_write(header, sizeof(header), (uint8_t)opt.raw_format, (uint16_t)opt.width,
+							(uint16_t)opt.height, (uint32_t)payload_len);
+		if (opt.egress)
+		{
+			egress_video_sync(header, sizeof(header), payload, payload_len);
+		}
+		else
+		{
+			broadcast(WS_OP_BINARY, header, sizeof(header));
+			broadcast(WS_OP_BINARY, payload, payload_len);
+		}
+		frames_sent++;
+	}
+	free(payload);
+	free(rgb565);
+	return NULL;
+}
+
+static void *telemetry_thread(void *arg)
+{
+	(void)arg;
+	while (!stop_requested)
+	{
+		ws_sleep_us(1000000);
+		pthread_mutex_lock(&control_lock);
+		const rc_control_t ctrl = control_state;
+		pthread_mutex_unlock(&control_lock);
+
+		char json[256];
+		const int n = snprintf(json, sizeof(json),
+							   "{\"type\":\"control\",\"seq\":%u,\"flags\":%u,\"throttle\":%d,\"steer\":%d,"
+							   "\"applied\":%u,\"stale\":%u,\"malformed\":%u}",
+							   (unsigned)ctrl.seq, (unsigned)ctrl.flags, (int)ctrl.throttle, (int)ctrl.steer,
+							   control_applied, control_stale, control_malformed);
+		if (opt.egress)
+			egress_queue(all_mask(), EGRESS_TELEMETRY, EGRESS_WS_TEXT, json, (size_t)n);
+		else
+			broadcast(WS_OP_TEXT, json, (size_t)n);
+		if (opt.quiet)
+			continue;
+		printf("frames=%llu bytes=%llu send_fail=%llu applied=%u stale=%u\n", (unsigned long long)frames_sent,
+			   (unsigned long long)bytes_sent, (unsigned long long)send_failures, control_applied, control_stale);
+		if (opt.egress)
+		{
+			char stats[768];
+			pthread_mutex_lock(&egress_lock);
+			const size_t len = egress_json(stats, sizeof(stats), &egress);
+			pthread_mutex_unlock(&egress_lock);
+			printf("egress %.*s\n", (int)len, stats);
+		}
+	}
+	return NULL;
+}
+
+// Same responses as web_send_asset() in the firmware.
+static void serve_http(int fd, const char *method, const char *path, const char *head, void *ctx)
+{
+	(void)ctx;
+	const web_asset_t *asset = (strcmp(method, "GET") == 0) ? web_asset_find(path) : NULL;
+	if (!asset)
+	{
+		(void)ws_http_reply(fd, "404 Not Found", "", NULL, 0);
+		return;
+	}
+	char inm[96];
+	char headers[256];
+	const bool cached = ws_http_header(head, "If-None-Match", inm, sizeof(inm)) && web_etag_match(inm, asset->etag);
+	int n = snprintf(headers, sizeof(headers), "ETag: %s\r\nCache-Control: %s\r\n", asset->etag,
+					 asset->cache_control);
+	if (!cached)
+		n += snprintf(headers + n, sizeof(headers) - (size_t)n, "Content-Type: %s\r\nContent-Encoding: gzip\r\n",
+					  asset->mime);
+	(void)ws_http_reply(fd, cached ? "304 Not Modified" : "200 OK", headers, asset->data, cached ? 0 : asset->len);
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+			"usage: %s [options]\n"
+			"  --port P             listen port (default 8888)\n"
+			"  --fps N              frame rate (default 25)\n"
+			"  --size WxH           frame size (default 320x240)\n"
+			"  --format FMT         RAWH payload format: gray8 (default), rgb565, gray4, gray2, rgb332\n"
+			"  --max-clients N      refuse connections beyond this (default 8)\n"
+			"  --send-timeout MS    drop a client whose send blocks this long (default 5000)\n"
+			"  --no-egress          synchronous broadcast instead of the egress scheduler\n"
+			"  --fragment N         video bytes per write with the scheduler (default 4096)\n"
+			"  --stall-ms MS        a client whose socket stays full this long skips frames (default 40)\n"
+			"  --video-bps N        video budget, bytes/s (default 0 = unlimited)\n"
+			"  --telemetry-bps N    telemetry budget, bytes/s (default 16384)\n"
+			"  --link-bps N         emulate a shared link of N bytes/s (default 0 = off)\n"
+			"  --quiet\n",
+			argv0);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option longopts[] = {
+		{"port", required_argument, NULL, 'p'},
+		{"fps", required_argument, NULL, 'f'},
+		{"size", required_argument, NULL, 's'},
+		{"format", required_argument, NULL, 'F'},
+		{"max-clients", required_argument, NULL, 'm'},
+		{"send-timeout", required_argument, NULL, 't'},
+		{"no-egress", no_argument, NULL, 'E'},
+		{"fragment", required_argument, NULL, 'g'},
+		{"stall-ms", required_argument, NULL, 'S'},
+		{"video-bps", required_argument, NULL, 'V'},
+		{"telemetry-bps", required_argument, NULL, 'T'},
+		{"link-bps", required_argument, NULL, 'L'},
+		{"quiet", no_argument, NULL, 'q'},
+		{"help", no_argument, NULL, '?'},
+		{NULL, 0, NULL, 0},
+	};
+	int ch;
+	while ((ch = getopt_long(argc, argv, "", longopts, NULL)) != -1)
+	{
+		switch (ch)
+		{
+		case 'p': opt.port = (uint16_t)atoi(optarg); break;
+		case 'f': opt.fps = atoi(optarg); break;
+		case 's':
+			if (sscanf(optarg, "%dx%d", &opt.width, &opt.height) != 2)
+				opt.width = 0;
+			break;
+		case 'F':
+			opt.raw_format = RC_FRAME_GRAY8;
+			for (uint8_t f = 0; f < RC_FRAME_FORMAT_COUNT; f++)
+				if (strcmp(optarg, rc_frame_format_name(f)) == 0)
+					opt.raw_format = f;
+			break;
+		case 'm': opt.max_clients = atoi(optarg); break;
+		case 't': opt.send_timeout_ms = atoi(optarg); break;
+		case 'E': opt.egress = false; break;
+		case 'g': opt.fragment_bytes = (uint32_t)strtoul(optarg, NULL, 10); break;
+		case 'S': opt.stall_ms = atoi(optarg); break;
+		case 'V': opt.video_bps = (uint32_t)strtoul(optarg, NULL, 10); break;
+		case 'T': opt.telemetry_bps = (uint32_t)strtoul(optarg, NULL, 10); break;
+		case 'L': opt.link_bps = (uint32_t)strtoul(optarg, NULL, 10); break;
+		case 'q': opt.quiet = true; break;
+		default: usage(argv[0]); return 2;
+		}
+	}
+	if (opt.fps <= 0 || opt.width <= 0 || opt.height <= 0 || opt.max_clients <= 0 || opt.max_clients > MAX_CLIENTS ||
+		(opt.egress && (opt.max_clients > EGRESS_MAX_CLIENTS || opt.fragment_bytes == 0)))
+	{
+		usage(argv[0]);
+		return 2;
+	}
+
+	// No SA_RESTART: SIGINT must interrupt the blocking accept().
+	struct sigaction sa = {.sa_handler = on_signal};
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	const int lfd = ws_server_listen(opt.port, 16);
+	if (lfd < 0)
+	{
+		perror("listen");
+		return 1;
+	}
+	printf("rc_hostsim: ws://0.0.0.0:%u/ %dx%d %s @%d fps, %s\n", (unsigned)opt.port, opt.width, opt.height,
+		   rc_frame_format_name((uint8_t)opt.raw_format), opt.fps, opt.egress ? "egress scheduler" : "sync broadcast");
+
+	pthread_t sender;
+	if (opt.egress)
+	{
+		const egress_config_t cfg = {
+			.budget =
+				{
+					[EGRESS_CONTROL] = {0, 0},
+					[EGRESS_TELEMETRY] = {opt.telemetry_bps, 8192},
+					[EGRESS_VIDEO] = {opt.video_bps, 65536},
+				},
+			.fragment_bytes = opt.fragment_bytes,
+			.queue_depth = 4,
+			.stall_us = (uint32_t)opt.stall_ms * 1000,
+		};
+		egress_scratch = (uint8_t *)malloc(opt.fragment_bytes + RC_FRAME_CHUNK_HDR_LEN);
+		if (!egress_scratch)
+			return 1;
+		egress_init(&egress, &cfg, egress_scratch, ws_now_us());
+		pthread_create(&sender, NULL, sender_thread, NULL);
+	}
+
+	pthread_t frames, telemetry;
+	pthread_create(&frames, NULL, frame_thread, NULL);
+	pthread_create(&telemetry, NULL, telemetry_thread, NULL);
+
+	while (!stop_requested)
+	{
+		ws_conn_t conn;
+		if (ws_server_accept(lfd, &conn, serve_http, NULL) != 0)
+			continue;
+
+		struct timeval tv = {.tv_sec = opt.send_timeout_ms / 1000, .tv_usec = (opt.send_timeout_ms % 1000) * 1000};
+		(void)setsockopt(conn.fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+		pthread_mutex_lock(&clients_lock);
+		int used = 0;
+		client_t *slot = NULL;
+		for (int i = 0; i < MAX_CLIENTS; i++)
+		{
+			if (clients[i].used)
+				used++;
+			else if (!slot)
+				slot = &clients[i];
+		}
+		if (!slot || used >= opt.max_clients)
+		{
+			pthread_mutex_unlock(&clients_lock);
+			ws_close(&conn);
+			continue;
+		}
+		memset(slot, 0, sizeof(*slot));
+		slot->conn = conn;
+		pthread_mutex_init(&slot->conn.send_lock, NULL);
+		slot->used = true;
+		if (opt.egress)
+		{
+			pthread_mutex_lock(&egress_lock);
+			if (egress_client_open(&egress, client_slot(slot), false))
+				pthread_cond_broadcast(&egress_video_done);
+			pthread_mutex_unlock(&egress_lock);
+		}
+		pthread_create(&slot->reader, NULL, reader_thread, slot);
+		pthread_detach(slot->reader);
+		pthread_mutex_unlock(&clients_lock);
+		if (!opt.quiet)
+			printf("client connected (%d/%d)\n", used + 1, opt.max_clients);
+	}
+
+	close(lfd);
+	pthread_join(frames, NULL);
+	pthread_join(telemetry, NULL);
+	if (opt.egress)
+	{
+		pthread_join(sender, NULL);
+		free(egress_scratch);
+	}
+	return 0;
+}
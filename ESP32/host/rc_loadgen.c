@@ -0,0 +1,632 @@
+// Multi-client load generator / soak tool for the RC car WebSocket endpoint.
+//
+// Opens N viewers (some of them deliberately slow readers) and M control senders against a car
+// or the host emulator (rc_hostsim), optionally forces periodic reconnect storms, and reports
+// aggregate throughput, per-client fps, control loss and control round-trip tail latency.
+
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rc_frame.h"
+#include "rc_proto.h"
+#include "ws_lite.h"
+
+typedef enum
+{
+	ROLE_VIEWER,
+	ROLE_SLOW_VIEWER,
+	ROLE_CONTROLLER,
+} role_t;
+
+static const char *role_names[] = {"viewer", "slow", "ctrl"};
+
+typedef struct
+{
+	const char *host;
+	uint16_t port;
+	const char *path;
+	int viewers;
+	int slow_viewers;
+	int controllers;
+	int ctrl_hz;
+	bool control_only; // controllers announce RC_CAP_CONTROL_ONLY (no video)
+	bool chunked;      // every client announces RC_CAP_VIDEO_CHUNKED
+	int slow_delay_ms;
+	int storm_every_s;
+	int duration_s;
+	int report_s;
+	int ack_timeout_ms;
+	const char *csv_path;
+} options_t;
+
+// Counters are written by the owning client thread and read by the reporter (relaxed atomics).
+typedef struct
+{
+	uint64_t bytes;
+	uint64_t frames;
+	uint64_t texts;
+	uint64_t connects;
+	uint64_t connect_fails;
+	uint64_t drops;
+	uint64_t ctrl_sent;
+	uint64_t ctrl_acked;
+	uint64_t ctrl_stale;
+	uint64_t ctrl_lost;     // no ack within --ack-timeout on a live connection
+	uint64_t ctrl_orphaned; // still in flight when the connection dropped or a storm closed it
+	int64_t max_gap_us; // longest gap between frames, reset by the reporter
+	int up;
+} client_stats_t;
+
+typedef struct
+{
+	int id;
+	role_t role;
+	pthread_t thread;
+	client_stats_t st;
+	uint64_t prev_frames; // reporter-only
+} client_t;
+
+#define LOAD(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define ADD(x, v) __atomic_fetch_add(&(x), (v), __ATOMIC_RELAXED)
+#define STORE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+
+// Control RTT histogram: 100 us buckets up to 10 s, last bucket is overflow.
+#define HIST_BUCKET_US 100
+#define HIST_BUCKETS 100001
+static uint64_t rtt_hist[HIST_BUCKETS];
+static int64_t rtt_max_us;
+
+static options_t opt = {
+	.host = "127.0.0.1",
+	.port = 8888,
+	.path = "/",
+	.viewers = 4,
+	.slow_viewers = 0,
+	.controllers = 1,
+	.ctrl_hz = 20,
+	.slow_delay_ms = 200,
+	.storm_every_s = 0,
+	.duration_s = 60,
+	.report_s = 5,
+	.ack_timeout_ms = 1000,
+	.csv_path = NULL,
+};
+
+static volatile sig_atomic_t stop_requested = 0;
+static uint32_t storm_gen = 0;
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	stop_requested = 1;
+}
+
+static void hist_add(int64_t us)
+{
+	size_t b = (us < 0) ? 0 : (size_t)(us / HIST_BUCKET_US);
+	if (b >= HIST_BUCKETS)
+		b = HIST_BUCKETS - 1;
+	ADD(rtt_hist[b], 1);
+	int64_t cur = LOAD(rtt_max_us);
+	while (us > cur && !__atomic_compare_exchange_n(&rtt_max_us, &cur, us, false, __ATOMIC_RELAXED,
+													__ATOMIC_RELAXED))
+	{
+	}
+}
+
+// Percentile in ms from the cumulative histogram, interpolated linearly within the bucket and
+// clamped to the largest sample (so p99.9 never exceeds max).
+static double hist_percentile(const uint64_t *hist, uint64_t total, double p, int64_t max_us)
+{
+	if (total == 0)
+		return 0.0;
+	const uint64_t target = (uint64_t)ceil(p * (double)total);
+	double us = (double)max_us;
+	uint64_t acc = 0;
+	for (size_t i = 0; i < HIST_BUCKETS; i++)
+	{
+		if (acc + hist[i] >= target)
+		{
+			us = ((double)i + (double)(target - acc) / (double)hist[i]) * HIST_BUCKET_US;
+			break;
+		}
+		acc += hist[i];
+	}
+	return ((us > (double)max_us) ? (double)max_us : us) / 1000.0;
+}
+
+typedef struct
+{
+	uint16_t seq;
+	bool outstanding;
+	int64_t sent_us;
+} pending_t;
+
+#define PENDING_SLOTS 1024
+// Reassembly buffer for --chunked (largest RAW frame: 640x480 RGB565 and then some).
+#define CHUNK_BUF_LEN (1024u * 1024u)
+
+typedef struct
+{
+	client_t *cl;
+	rc_frame_rx_t rx;
+	rc_chunk_rx_t chunks;
+	int64_t last_frame_us;
+	pending_t pending[PENDING_SLOTS];
+} session_t;
+
+static void note_frame(session_t *s, int64_t now)
+{
+	ADD(s->cl->st.frames, 1);
+	if (s->last_frame_us != 0)
+	{
+		const int64_t gap = now - s->last_frame_us;
+		if (gap > LOAD(s->cl->st.max_gap_us))
+			STORE(s->cl->st.max_gap_us, gap);
+	}
+	s->last_frame_us = now;
+}
+
+static void handle_ack(session_t *s, const rc_msg_t *m, int64_t now)
+{
+	pending_t *p = &s->pending[m->ack.seq % PENDING_SLOTS];
+	if (!p->outstanding || p->seq != m->ack.seq)
+		return; // late ack for a packet already counted as lost
+	p->outstanding = false;
+	ADD(s->cl->st.ctrl_acked, 1);
+	if (m->ack.status == RC_ACK_STALE)
+		ADD(s->cl->st.ctrl_stale, 1);
+	hist_add(now - p->sent_us);
+}
+
+static void handle_message(session_t *s, const ws_msg_t *msg, int64_t now)
+{
+	ADD(s->cl->st.bytes, msg->len);
+	if (msg->opcode == WS_OP_TEXT)
+	{
+		ADD(s->cl->st.texts, 1);
+		return;
+	}
+
+	const uint8_t *d = msg->data;
+	size_t len = msg->len;
+	if (opt.chunked)
+	{
+		const rc_chunk_result_t cr = rc_chunk_rx_feed(&s->chunks, msg->data, msg->len, &d, &len);
+		if (cr == RC_CHUNK_PARTIAL || cr == RC_CHUNK_ERROR)
+			return;
+		if (cr == RC_CHUNK_NONE)
+		{
+			d = msg->data;
+			len = msg->len;
+		}
+	}
+	rc_frame_t frame;
+	const rc_frame_rx_result_t fr = rc_frame_rx_feed(&s->rx, d, len, &frame);
+	if (fr == RC_FRAME_RX_JPEG || fr == RC_FRAME_RX_RAW)
+	{
+		note_frame(s, now);
+		return;
+	}
+	if (fr == RC_FRAME_RX_NONE && len >= 2 && d[0] == RC_PROTO_MAGIC)
+	{
+		rc_msg_t m;
+		if (rc_proto_parse(d, len, &m) == RC_PARSE_OK && m.type == RC_MSG_ACK)
+			handle_ack(s, &m, now);
+	}
+}
+
+static void expire_pending(session_t *s, int64_t now)
+{
+	const int64_t timeout_us = (int64_t)opt.ack_timeout_ms * 1000;
+	for (size_t i = 0; i < PENDING_SLOTS; i++)
+	{
+		pending_t *p = &s->pending[i];
+		if (p->outstanding && now - p->sent_us > timeout_us)
+		{
+			p->outstanding = false;
+			ADD(s->cl->st.ctrl_lost, 1);
+		}
+	}
+}
+
+static void send_control(ws_conn_t *c, session_t *s, uint16_t seq, int64_t now)
+{
+	// Slow sine sweep on both axes so the car side sees changing values.
+	const double phase = (double)now / 1e6;
+	rc_control_t ctrl = {
+		.seq = seq,
+		.flags = RC_CTRL_FLAG_ACK_REQ,
+		.throttle = (int16_t)(sin(phase) * RC_AXIS_MAX * 0.5),
+		.steer = (int16_t)(cos(phase * 0.7) * RC_AXIS_MAX),
+	};
+	uint8_t buf[RC_PROTO_CONTROL_LEN];
+	const size_t n = rc_proto_write_control(buf, sizeof(buf), &ctrl);
+
+	pending_t *p = &s->pending[seq % PENDING_SLOTS];
+	if (p->outstanding)
+		ADD(s->cl->st.ctrl_lost, 1);
+	p->seq = seq;
+	p->outstanding = true;
+	p->sent_us = now;
+	if (ws_send(c, WS_OP_BINARY, buf, n) == 0)
+		ADD(s->cl->st.ctrl_sent, 1);
+	else
+		p->outstanding = false;
+}
+
+// One connection lifetime. Returns when the connection drops, a storm is triggered or stop.
+static void run_session(client_t *cl, ws_conn_t *c, session_t *s)
+{
+	const uint32_t gen = LOAD(storm_gen);
+	const int64_t ctrl_period_us = (opt.ctrl_hz > 0) ? 1000000LL / opt.ctrl_hz : 0;
+	int64_t next_ctrl = ws_now_us();
+	uint16_t seq = (uint16_t)rand();
+
+	if (cl->role == ROLE_CONTROLLER || opt.chunked)
+	{
+		uint8_t hello[RC_PROTO_HELLO_LEN];
+		uint32_t caps = RC_CAP_TELEMETRY_TEXT | (opt.chunked ? RC_CAP_VIDEO_CHUNKED : 0);
+		if (cl->role == ROLE_CONTROLLER)
+			caps |= RC_CAP_CONTROL_V2 | RC_CAP_CONTROL_ACK | (opt.control_only ? RC_CAP_CONTROL_ONLY : 0);
+		const size_t n = rc_proto_write_hello(hello, sizeof(hello), caps);
+		(void)ws_send(c, WS_OP_BINARY, hello, n);
+	}
+
+	while (!stop_requested && LOAD(storm_gen) == gen)
+	{
+		int timeout_ms = 100;
+		int64_t now = ws_now_us();
+		if (cl->role == ROLE_CONTROLLER && ctrl_period_us > 0)
+		{
+			if (now >= next_ctrl)
+			{
+				send_control(c, s, seq++, now);
+				next_ctrl += ctrl_period_us;
+				if (next_ctrl < now)
+					next_ctrl = now + ctrl_period_us;
+				expire_pending(s, now);
+			}
+			timeout_ms = (int)((next_ctrl - now + 999) / 1000);
+		}
+
+		ws_msg_t msg;
+		const int r = ws_recv(c, &msg, timeout_ms);
+		if (r < 0)
+		{
+			ADD(cl->st.drops, 1);
+			return;
+		}
+		if (r == 0)
+			continue;
+		handle_message(s, &msg, ws_now_us());
+		if (cl->role == ROLE_SLOW_VIEWER && msg.opcode == WS_OP_BINARY)
+			ws_sleep_us((int64_t)opt.slow_delay_ms * 1000);
+	}
+}
+
+static void *client_thread(void *arg)
+{
+	client_t *cl = (client_t *)arg;
+	session_t *s = (session_t *)calloc(1, sizeof(session_t));
+	if (!s)
+		return NULL;
+	s->cl = cl;
+	if (opt.chunked)
+	{
+		s->chunks.cap = CHUNK_BUF_LEN;
+		s->chunks.buf = (uint8_t *)malloc(CHUNK_BUF_LEN);
+		if (!s->chunks.buf)
+		{
+			free(s);
+			return NULL;
+		}
+	}
+
+	while (!stop_requested)
+	{
+		ws_conn_t c;
+		if (ws_client_connect(&c, opt.host, opt.port, opt.path, 3000) != 0)
+		{
+			ADD(cl->st.connect_fails, 1);
+			ws_sleep_us(500000);
+			continue;
+		}
+		ADD(cl->st.connects, 1);
+		STORE(cl->st.up, 1);
+		memset(&s->rx, 0, sizeof(s->rx));
+		s->chunks.active = false;
+		s->last_frame_us = 0;
+
+		run_session(cl, &c, s);
+
+		STORE(cl->st.up, 0);
+		ws_close(&c);
+		// Anything still in flight can no longer be acked on a new connection. That is the connection
+		// going away (often our own storm), not the server dropping packets: counted apart from lost.
+		for (size_t i = 0; i < PENDING_SLOTS; i++)
+		{
+			if (s->pending[i].outstanding)
+			{
+				s->pending[i].outstanding = false;
+				ADD(cl->st.ctrl_orphaned, 1);
+			}
+		}
+	}
+	free(s->chunks.buf);
+	free(s);
+	return NULL;
+}
+
+typedef struct
+{
+	uint64_t bytes, frames, sent, acked, stale, lost, orphaned, connects, fails, drops;
+	int up;
+} totals_t;
+
+static totals_t sum_clients(client_t *clients, int n)
+{
+	totals_t t = {0};
+	for (int i = 0; i < n; i++)
+	{
+		client_stats_t *st = &clients[i].st;
+		t.bytes += LOAD(st->bytes);
+		t.frames += LOAD(st->frames);
+		t.sent += LOAD(st->ctrl_sent);
+		t.acked += LOAD(st->ctrl_acked);
+		t.stale += LOAD(st->ctrl_stale);
+		t.lost += LOAD(st->ctrl_lost);
+		t.orphaned += LOAD(st->ctrl_orphaned);
+		t.connects += LOAD(st->connects);
+		t.fails += LOAD(st->connect_fails);
+		t.drops += LOAD(st->drops);
+		t.up += LOAD(st->up);
+	}
+	return t;
+}
+
+static void rtt_snapshot(uint64_t *hist, uint64_t *total)
+{
+	*total = 0;
+	for (size_t i = 0; i < HIST_BUCKETS; i++)
+	{
+		hist[i] = LOAD(rtt_hist[i]);
+		*total += hist[i];
+	}
+}
+
+static void report(client_t *clients, int n, double elapsed_s, double interval_s, totals_t *prev,
+				   uint64_t *hist, FILE *csv)
+{
+	const totals_t t = sum_clients(clients, n);
+	const double mbps = (double)(t.bytes - prev->bytes) * 8.0 / 1e6 / interval_s;
+
+	double fps_min = 1e9, fps_max = 0.0, fps_sum = 0.0;
+	int64_t worst_gap = 0;
+	for (int i = 0; i < n; i++)
+	{
+		const uint64_t frames = LOAD(clients[i].st.frames);
+		const double fps = (double)(frames - clients[i].prev_frames) / interval_s;
+		clients[i].prev_frames = frames;
+		fps_sum += fps;
+		if (fps < fps_min)
+			fps_min = fps;
+		if (fps > fps_max)
+			fps_max = fps;
+		const int64_t gap = __atomic_exchange_n(&clients[i].st.max_gap_us, 0, __ATOMIC_RELAXED);
+		if (gap > worst_gap)
+			worst_gap = gap;
+	}
+
+	uint64_t rtt_total = 0;
+	rtt_snapshot(hist, &rtt_total);
+	const int64_t max_us = LOAD(rtt_max_us);
+	const double p50 = hist_percentile(hist, rtt_total, 0.50, max_us);
+	const double p99 = hist_percentile(hist, rtt_total, 0.99, max_us);
+	const double p999 = hist_percentile(hist, rtt_total, 0.999, max_us);
+	const double rtt_max = (double)max_us / 1000.0;
+	// Loss is measured on packets whose connection stayed up long enough to get an answer.
+	const uint64_t judged = t.sent - t.orphaned;
+	const double loss = (judged > 0) ? 100.0 * (double)t.lost / (double)judged : 0.0;
+
+	printf("[%7.0fs] up %d/%d | %7.2f Mbit/s | fps sum %6.1f min %5.1f avg %5.1f max %5.1f | gap max %6.0f ms"
+		   " | ctrl sent %llu lost %.3f%% orphaned %llu stale %llu | rtt p50 %.1f p99 %.1f p99.9 %.1f max %.1f ms"
+		   " | conn %llu fail %llu drop %llu\n",
+		   elapsed_s, t.up, n, mbps, fps_sum, (n > 0) ? fps_min : 0.0, (n > 0) ? fps_sum / n : 0.0, fps_max,
+		   (double)worst_gap / 1000.0, (unsigned long long)t.sent, loss, (unsigned long long)t.orphaned,
+		   (unsigned long long)t.stale, p50, p99,
+		   p999, rtt_max, (unsigned long long)t.connects, (unsigned long long)t.fails,
+		   (unsigned long long)t.drops);
+	fflush(stdout);
+
+	if (csv)
+	{
+		fprintf(csv, "%.0f,%d,%.3f,%.2f,%.2f,%.2f,%.1f,%llu,%llu,%llu,%.2f,%.2f,%.2f,%.2f,%llu,%llu,%llu,%llu\n",
+				elapsed_s, t.up, mbps, fps_sum, fps_min, fps_max, (double)worst_gap / 1000.0,
+				(unsigned long long)t.sent, (unsigned long long)t.lost, (unsigned long long)t.stale, p50, p99,
+				p999, rtt_max, (unsigned long long)t.connects, (unsigned long long)t.fails,
+				(unsigned long long)t.drops, (unsigned long long)t.orphaned);
+		fflush(csv);
+	}
+	*prev = t;
+}
+
+static void final_report(client_t *clients, int n, double elapsed_s)
+{
+	printf("\n%-4s %-6s %10s %8s %10s %8s %8s %8s %8s %6s %6s\n", "id", "role", "MB", "fps", "ctrl_sent", "lost",
+		   "orphaned", "stale", "conn", "fail", "drop");
+	for (int i = 0; i < n; i++)
+	{
+		const client_stats_t *st = &clients[i].st;
+		printf("%-4d %-6s %10.2f %8.2f %10llu %8llu %8llu %8llu %8llu %6llu %6llu\n", clients[i].id,
+			   role_names[clients[i].role], (double)LOAD(st->bytes) / 1e6,
+			   (elapsed_s > 0) ? (double)LOAD(st->frames) / elapsed_s : 0.0, (unsigned long long)LOAD(st->ctrl_sent),
+			   (unsigned long long)LOAD(st->ctrl_lost), (unsigned long long)LOAD(st->ctrl_orphaned),
+			   (unsigned long long)LOAD(st->ctrl_stale),
+			   (unsigned long long)LOAD(st->connects), (unsigned long long)LOAD(st->connect_fails),
+			   (unsigned long long)LOAD(st->drops));
+	}
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+			"usage: %s [options]\n"
+			"  --host H            car or rc_hostsim address (default 127.0.0.1)\n"
+			"  --port P            WS port (default 8888)\n"
+			"  --viewers N         video-only clients (default 4)\n"
+			"  --slow N            how many of the viewers read slowly (default 0)\n"
+			"  --slow-delay MS     pause after each binary message on slow viewers (default 200)\n"
+			"  --controllers N     control senders, also receive video (default 1)\n"
+			"  --ctrl-hz HZ        control packet rate per sender (default 20)\n"
+			"  --control-only      controllers opt out of video (HELLO cap CONTROL_ONLY)\n"
+			"  --chunked           all clients take video as chunk messages (HELLO cap VIDEO_CHUNKED)\n"
+			"  --ack-timeout MS    control packet counts as lost after this (default 1000)\n"
+			"  --storm S           every S seconds all clients drop and reconnect at once (default off)\n"
+			"  --duration S        0 = until Ctrl-C (default 60)\n"
+			"  --report S          report interval (default 5)\n"
+			"  --csv FILE          append interval reports as CSV\n",
+			argv0);
+}
+
+static int parse_args(int argc, char **argv)
+{
+	static const struct option longopts[] = {
+		{"host", required_argument, NULL, 'h'},
+		{"port", required_argument, NULL, 'p'},
+		{"viewers", required_argument, NULL, 'v'},
+		{"slow", required_argument, NULL, 's'},
+		{"slow-delay", required_argument, NULL, 'S'},
+		{"controllers", required_argument, NULL, 'c'},
+		{"ctrl-hz", required_argument, NULL, 'z'},
+		{"control-only", no_argument, NULL, 'C'},
+		{"chunked", no_argument, NULL, 'k'},
+		{"ack-timeout", required_argument, NULL, 'a'},
+		{"storm", required_argument, NULL, 'r'},
+		{"duration", required_argument, NULL, 'd'},
+		{"report", required_argument, NULL, 'i'},
+		{"csv", required_argument, NULL, 'o'},
+		{"help", no_argument, NULL, '?'},
+		{NULL, 0, NULL, 0},
+	};
+	int ch;
+	while ((ch = getopt_long(argc, argv, "", longopts, NULL)) != -1)
+	{
+		switch (ch)
+		{
+		case 'h': opt.host = optarg; break;
+		case 'p': opt.port = (uint16_t)atoi(optarg); break;
+		case 'v': opt.viewers = atoi(optarg); break;
+		case 's': opt.slow_viewers = atoi(optarg); break;
+		case 'S': opt.slow_delay_ms = atoi(optarg); break;
+		case 'c': opt.controllers = atoi(optarg); break;
+		case 'z': opt.ctrl_hz = atoi(optarg); break;
+		case 'C': opt.control_only = true; break;
+		case 'k': opt.chunked = true; break;
+		case 'a': opt.ack_timeout_ms = atoi(optarg); break;
+		case 'r': opt.storm_every_s = atoi(optarg); break;
+		case 'd': opt.duration_s = atoi(optarg); break;
+		case 'i': opt.report_s = atoi(optarg); break;
+		case 'o': opt.csv_path = optarg; break;
+		default: usage(argv[0]); return -1;
+		}
+	}
+	if (opt.viewers < 0 || opt.controllers < 0 || opt.viewers + opt.controllers == 0 || opt.report_s <= 0)
+	{
+		usage(argv[0]);
+		return -1;
+	}
+	if (opt.slow_viewers > opt.viewers)
+		opt.slow_viewers = opt.viewers;
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (parse_args(argc, argv) != 0)
+		return 2;
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	signal(SIGPIPE, SIG_IGN);
+	srand((unsigned)ws_now_us());
+
+	FILE *csv = NULL;
+	if (opt.csv_path)
+	{
+		csv = fopen(opt.csv_path, "a");
+		if (!csv)
+		{
+			perror(opt.csv_path);
+			return 1;
+		}
+		fprintf(csv, "t_s,up,mbps,fps_sum,fps_min,fps_max,gap_max_ms,ctrl_sent,ctrl_lost,ctrl_stale,"
+					 "rtt_p50_ms,rtt_p99_ms,rtt_p999_ms,rtt_max_ms,connects,connect_fails,drops,ctrl_orphaned\n");
+	}
+
+	const int n = opt.viewers + opt.controllers;
+	client_t *clients = (client_t *)calloc((size_t)n, sizeof(client_t));
+	uint64_t *hist = (uint64_t *)malloc(sizeof(uint64_t) * HIST_BUCKETS);
+	if (!clients || !hist)
+		return 1;
+
+	printf("rc_loadgen: %s:%u viewers=%d (slow=%d) controllers=%d @%d Hz storm=%ds duration=%ds\n", opt.host,
+		   (unsigned)opt.port, opt.viewers, opt.slow_viewers, opt.controllers, opt.ctrl_hz, opt.storm_every_s,
+		   opt.duration_s);
+
+	for (int i = 0; i < n; i++)
+	{
+		clients[i].id = i;
+		if (i < opt.controllers)
+			clients[i].role = ROLE_CONTROLLER;
+		else if (i - opt.controllers < opt.slow_viewers)
+			clients[i].role = ROLE_SLOW_VIEWER;
+		else
+			clients[i].role = ROLE_VIEWER;
+		pthread_create(&clients[i].thread, NULL, client_thread, &clients[i]);
+	}
+
+	const int64_t start = ws_now_us();
+	int64_t next_report = start + (int64_t)opt.report_s * 1000000LL;
+	int64_t next_storm = (opt.storm_every_s > 0) ? start + (int64_t)opt.storm_every_s * 1000000LL : INT64_MAX;
+	int64_t last_report = start;
+	totals_t prev = {0};
+	while (!stop_requested)
+	{
+		ws_sleep_us(50000);
+		const int64_t now = ws_now_us();
+		if (opt.duration_s > 0 && now - start >= (int64_t)opt.duration_s * 1000000LL)
+			break;
+		if (now >= next_storm)
+		{
+			ADD(storm_gen, 1);
+			next_storm += (int64_t)opt.storm_every_s * 1000000LL;
+		}
+		if (now >= next_report)
+		{
+			report(clients, n, (double)(now - start) / 1e6, (double)(now - last_report) / 1e6, &prev, hist, csv);
+			last_report = now;
+			next_report += (int64_t)opt.report_s * 1000000LL;
+		}
+	}
+
+	stop_requested = 1;
+	for (int i = 0; i < n; i++)
+		pthread_join(clients[i].thread, NULL);
+
+	const int64_t end = ws_now_us();
+	report(clients, n, (double)(end - start) / 1e6, (double)(end - last_report) / 1e6, &prev, hist, csv);
+	final_report(clients, n, (double)(end - start) / 1e6);
+
+	if (csv)
+		fclose(csv);
+	free(hist);
+	free(clients);
+	return 0;
+}
@@ -0,0 +1,460 @@
+// Drives the firmware's memory-budget tiers (main/mem_budget.c) against injected allocators with a
+// hard limit, standing in for the ESP32 DRAM and PSRAM heaps.
+//
+//   rc_memsim run [--dram-kb N] [--psram-kb N] [--clients N] [--ticks N] [--hog T:POOL:KB]... [--quiet]
+//   rc_memsim selftest
+//
+// One tick is one telemetry period: sample the heaps, apply the tier on a transition (re-allocate
+// camera frame buffers at the tier's size/count, drop WS clients beyond the cap), admit clients up to
+// the cap, then a transient JPEG-sized allocation. `--hog T:POOL:KB` allocates from POOL (dram|psram)
+// at tick T so that only KB stay free; KB = -1 releases the hogs in that pool. Thresholds and limits
+// are the firmware defaults from rc_config.h.
+
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem_budget.h"
+#include "rc_config.h"
+#include "selftest.h"
+
+// --- first-fit arena with a hard limit ---
+
+#define ARENA_ALIGN 16u
+#define ARENA_MIN_SPLIT 64u
+
+typedef struct
+{
+	uint32_t size; // including this header
+	uint32_t used;
+	uint8_t pad[ARENA_ALIGN - 8];
+} arena_block_t;
+
+typedef struct
+{
+	uint8_t *base;
+	size_t size;
+	size_t used; // including headers
+	size_t min_free;
+	uint32_t fails;
+} arena_t;
+
+static int arena_init(arena_t *a, size_t size)
+{
+	memset(a, 0, sizeof(*a));
+	size &= ~(size_t)(ARENA_ALIGN - 1);
+	if (size < 2 * sizeof(arena_block_t))
+		return 0; // absent pool
+	a->base = (uint8_t *)malloc(size);
+	if (!a->base)
+		return -1;
+	a->size = size;
+	arena_block_t *b = (arena_block_t *)a->base;
+	b->size = (uint32_t)size;
+	b->used = 0;
+	a->min_free = size;
+	return 0;
+}
+
+static void arena_deinit(arena_t *a)
+{
+	free(a->base);
+	memset(a, 0, sizeof(*a));
+}
+
+static arena_block_t *arena_next(const arena_t *a, arena_block_t *b)
+{
+	uint8_t *p = (uint8_t *)b + b->size;
+	return (p < a->base + a->size) ? (arena_block_t *)p : NULL;
+}
+
+static void *arena_alloc(arena_t *a, size_t len)
+{
+	const size_t need = sizeof(arena_block_t) + ((len + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1));
+	for (arena_block_t *b = a->base ? (arena_block_t *)a->base : NULL; b; b = arena_next(a, b))
+	{
+		if (b->used || b->size < need)
+			continue;
+		if (b->size - need >= ARENA_MIN_SPLIT)
+		{
+			arena_block_t *rest = (arena_block_t *)((uint8_t *)b + need);
+			rest->size = b->size - (uint32_t)need;
+			rest->used = 0;
+			b->size = (uint32_t)need;
+		}
+		b->used = 1;
+		a->used += b->size;
+		if (a->size - a->used < a->min_free)
+			a->min_free = a->size - a->used;
+		return b + 1;
+	}
+	a->fails++;
+	return NULL;
+}
+
+static void arena_free(arena_t *a, void *p)
+{
+	if (!p)
+		return;
+	arena_block_t *b = (arena_block_t *)p - 1;
+	b->used = 0;
+	a->used -= b->size;
+	// Coalesce every run of free blocks (the arena is small enough for a full pass).
+	for (arena_block_t *c = (arena_block_t *)a->base; c; c = arena_next(a, c))
+	{
+		arena_block_t *n;
+		while (!c->used && (n = arena_next(a, c)) && !n->used)
+			c->size += n->size;
+	}
+}
+
+static size_t arena_largest(const arena_t *a)
+{
+	size_t largest = 0;
+	for (arena_block_t *b = a->base ? (arena_block_t *)a->base : NULL; b; b = arena_next(a, b))
+	{
+		if (!b->used && b->size - sizeof(arena_block_t) > largest)
+			largest = b->size - sizeof(arena_block_t);
+	}
+	return largest;
+}
+
+static void arena_sample(const arena_t *a, mem_pool_sample_t *out)
+{
+	out->free = a->size - a->used;
+	out->largest = arena_largest(a);
+	out->min_free = a->min_free;
+}
+
+// --- simulated car ---
+
+#define SIM_MAX_FBS 8
+#define SIM_MAX_CLIENTS 32
+#define SIM_MAX_HOGS 16
+
+typedef struct
+{
+	int tick;
+	bool psram; // pool
+	int leave_kb; // -1 = release
+} hog_event_t;
+
+typedef struct
+{
+	size_t dram_kb;
+	size_t psram_kb;
+	int clients;
+	int ticks;
+	bool quiet;
+	hog_event_t hogs[SIM_MAX_HOGS];
+	int hog_count;
+} sim_options_t;
+
+typedef struct
+{
+	arena_t dram;
+	arena_t psram;
+	mem_budget_t mb;
+	void *fbs[SIM_MAX_FBS];
+	int fb_count;
+	void *clients[SIM_MAX_CLIENTS];
+	int client_count;
+	void *hogs[2][SIM_MAX_HOGS];
+	int hog_count[2];
+
+	// results
+	uint32_t fb_fails;
+	uint32_t client_fails;
+	uint32_t spike_fails;
+	uint32_t evicted;
+	int ticks_in[MEM_TIER_COUNT];
+	int max_clients_seen[MEM_TIER_COUNT];
+	mem_tier_t tier_at[1024]; // tier after tick t is tier_at[t - 1]
+} sim_t;
+
+#define MEM_FB_BYTES(w) ((size_t)(w) * ((w) * 3 / 4) * 2)
+#define SIM_LIMITS(width, fbs, clients, depth)                                                              \
+	{width, fbs, clients, depth, (size_t)(clients) * MEM_CLIENT_DRAM_KB * 1024, (fbs) * MEM_FB_BYTES(width)}
+
+static const mem_budget_config_t SIM_CONFIG = {
+	.dram_free = {0, MEM_REDUCED_DRAM_FREE_KB * 1024, MEM_SURVIVAL_DRAM_FREE_KB * 1024},
+	.dram_block = {0, MEM_REDUCED_DRAM_BLOCK_KB * 1024, MEM_SURVIVAL_DRAM_BLOCK_KB * 1024},
+	.psram_free = {0, MEM_REDUCED_PSRAM_FREE_KB * 1024, MEM_SURVIVAL_PSRAM_FREE_KB * 1024},
+	.psram_block = {0, MEM_REDUCED_PSRAM_BLOCK_KB * 1024, MEM_SURVIVAL_PSRAM_BLOCK_KB * 1024},
+	.recover_pct = MEM_RECOVER_PCT,
+	.recover_samples = MEM_RECOVER_SAMPLES,
+	.no_psram_tier = MEM_TIER_REDUCED,
+};
+
+static const mem_tier_limits_t SIM_LIMITS_TABLE[MEM_TIER_COUNT] = {
+	SIM_LIMITS(MEM_FULL_FRAME_WIDTH, MEM_FULL_FB_COUNT, RC_WS_MAX_CLIENTS, MEM_FULL_QUEUE_DEPTH),
+	SIM_LIMITS(MEM_REDUCED_FRAME_WIDTH, MEM_REDUCED_FB_COUNT, MEM_REDUCED_MAX_CLIENTS, MEM_REDUCED_QUEUE_DEPTH),
+	SIM_LIMITS(MEM_SURVIVAL_FRAME_WIDTH, MEM_SURVIVAL_FB_COUNT, MEM_SURVIVAL_MAX_CLIENTS, MEM_SURVIVAL_QUEUE_DEPTH),
+};
+
+static void sim_probe(void *ctx, mem_sample_t *out)
+{
+	const sim_t *s = (const sim_t *)ctx;
+	memset(out, 0, sizeof(*out));
+	arena_sample(&s->dram, &out->dram);
+	out->psram_present = s->psram.size > 0;
+	if (out->psram_present)
+		arena_sample(&s->psram, &out->psram);
+}
+
+// Frame buffers live in PSRAM when there is any (like CAMERA_FB_IN_PSRAM), otherwise in DRAM.
+static arena_t *frame_pool(sim_t *s)
+{
+	return s->psram.size ? &s->psram : &s->dram;
+}
+
+static void apply_fbs(sim_t *s)
+{
+	arena_t *pool = frame_pool(s);
+	for (int i = 0; i < s->fb_count; i++)
+		arena_free(pool, s->fbs[i]);
+	s->fb_count = 0;
+
+	const mem_tier_limits_t *lim = mem_budget_limits(&s->mb);
+	for (int i = 0; i < lim->fb_count && i < SIM_MAX_FBS; i++)
+	{
+		void *fb = arena_alloc(pool, MEM_FB_BYTES(lim->frame_width));
+		if (!fb)
+		{
+			s->fb_fails++;
+			break;
+		}
+		s->fbs[s->fb_count++] = fb;
+	}
+}
+
+static void apply_client_cap(sim_t *s)
+{
+	const int cap = mem_budget_limits(&s->mb)->max_clients;
+	while (s->client_count > cap)
+	{
+		arena_free(&s->dram, s->clients[--s->client_count]); // newest first, like the firmware
+		s->evicted++;
+	}
+}
+
+static void run_hogs(sim_t *s, const sim_options_t *o, int tick)
+{
+	for (int i = 0; i < o->hog_count; i++)
+	{
+		const hog_event_t *h = &o->hogs[i];
+		if (h->tick != tick)
+			continue;
+		arena_t *pool = h->psram ? &s->psram : &s->dram;
+		const int p = h->psram ? 1 : 0;
+		if (h->leave_kb < 0)
+		{
+			for (int j = 0; j < s->hog_count[p]; j++)
+				arena_free(pool, s->hogs[p][j]);
+			s->hog_count[p] = 0;
+			continue;
+		}
+		// Fill free blocks (largest first) until only `leave` bytes remain free.
+		const size_t leave = (size_t)h->leave_kb * 1024;
+		while (s->hog_count[p] < SIM_MAX_HOGS)
+		{
+			const size_t free_now = pool->size - pool->used;
+			const size_t largest = arena_largest(pool);
+			if (free_now <= leave + 2 * sizeof(arena_block_t) || largest == 0)
+				break;
+			size_t len = free_now - leave - 2 * sizeof(arena_block_t);
+			if (len > largest)
+				len = largest;
+			void *hog = arena_alloc(pool, len);
+			if (!hog)
+				break;
+			s->hogs[p][s->hog_count[p]++] = hog;
+		}
+	}
+}
+
+static int sim_run(sim_t *s, const sim_options_t *o)
+{
+	memset(s, 0, sizeof(*s));
+	if (arena_init(&s->dram, o->dram_kb * 1024) != 0 || arena_init(&s->psram, o->psram_kb * 1024) != 0)
+		return -1;
+
+	mem_budget_init(&s->mb, &SIM_CONFIG, SIM_LIMITS_TABLE, sim_probe, s);
+	apply_fbs(s);
+	if (!o->quiet)
+		printf("tick   0: start in %s\n", mem_tier_name(s->mb.tier));
+
+	const int ticks = o->ticks < 1024 ? o->ticks : 1024;
+	for (int t = 1; t <= ticks; t++)
+	{
+		run_hogs(s, o, t);
+
+		if (mem_budget_update(&s->mb))
+		{
+			apply_fbs(s);
+			apply_client_cap(s);
+			if (!o->quiet)
+			{
+				const mem_sample_t *m = &s->mb.last;
+				printf("tick %3d: %s -> %s (dram free %zu KB, psram free %zu KB largest %zu KB)\n", t,
+					   mem_tier_name(s->mb.prev_tier), mem_tier_name(s->mb.tier), m->dram.free / 1024,
+					   m->psram.free / 1024, m->psram.largest / 1024);
+			}
+		}
+
+		const mem_tier_limits_t *lim = mem_budget_limits(&s->mb);
+		while (s->client_count < o->clients && s->client_count < lim->max_clients && s->client_count < SIM_MAX_CLIENTS)
+		{
+			void *c = arena_alloc(&s->dram, MEM_CLIENT_DRAM_KB * 1024);
+			if (!c)
+			{
+				s->client_fails++;
+				break;
+			}
+			s->clients[s->client_count++] = c;
+		}
+
+		// Software JPEG output: about a quarter of the RGB565 frame, freed right after sending.
+		arena_t *pool = frame_pool(s);
+		void *spike = arena_alloc(pool, MEM_FB_BYTES(lim->frame_width) / 4);
+		if (!spike)
+			s->spike_fails++;
+		arena_free(pool, spike);
+
+		s->ticks_in[s->mb.tier]++;
+		if (s->client_count > s->max_clients_seen[s->mb.tier])
+			s->max_clients_seen[s->mb.tier] = s->client_count;
+		s->tier_at[t - 1] = s->mb.tier;
+	}
+
+	if (!o->quiet)
+	{
+		char json[512];
+		(void)mem_budget_json(json, sizeof(json), &s->mb);
+		printf("ticks full/reduced/survival: %d/%d/%d, transitions %u\n", s->ticks_in[MEM_TIER_FULL],
+			   s->ticks_in[MEM_TIER_REDUCED], s->ticks_in[MEM_TIER_SURVIVAL], (unsigned)s->mb.transitions);
+		printf("failures: fb %u, client %u, spike %u; clients evicted %u\n", (unsigned)s->fb_fails,
+			   (unsigned)s->client_fails, (unsigned)s->spike_fails, (unsigned)s->evicted);
+		printf("%s\n", json);
+	}
+	arena_deinit(&s->dram);
+	arena_deinit(&s->psram);
+	return 0;
+}
+
+// --- selftest ---
+
+#define TIER_AFTER(s, t) ((s).tier_at[(t) - 1])
+
+static int cmd_selftest(void)
+{
+	static sim_t s;
+
+	// Ample heap, 4 clients.
+	sim_options_t o = {.dram_kb = 160, .psram_kb = 4096, .clients = 4, .ticks = 40, .quiet = true};
+	expect(sim_run(&s, &o) == 0, "ample heap: run");
+	expect(s.ticks_in[MEM_TIER_FULL] == 40 && s.mb.transitions == 0, "stays full");
+	expect(s.fb_fails + s.client_fails + s.spike_fails == 0, "no allocation failures");
+	expect(s.max_clients_seen[MEM_TIER_FULL] == 4, "all clients admitted");
+
+	// PSRAM squeezed, then released.
+	o = (sim_options_t){.dram_kb = 160, .psram_kb = 4096, .clients = 5, .ticks = 80, .quiet = true};
+	o.hogs[o.hog_count++] = (hog_event_t){10, true, 300};
+	o.hogs[o.hog_count++] = (hog_event_t){20, true, 100};
+	o.hogs[o.hog_count++] = (hog_event_t){30, true, -1};
+	expect(sim_run(&s, &o) == 0, "PSRAM squeeze: run");
+	expect(TIER_AFTER(s, 10) == MEM_TIER_REDUCED, "reduced on the first sample under pressure");
+	expect(TIER_AFTER(s, 20) == MEM_TIER_SURVIVAL, "survival on the first sample under more pressure");
+	expect(s.max_clients_seen[MEM_TIER_SURVIVAL] <= MEM_SURVIVAL_MAX_CLIENTS, "client cap held in survival");
+	expect(s.evicted > 0, "clients beyond the cap dropped");
+	expect(s.fb_fails == 0, "frame buffers re-allocated at every tier");
+	expect(TIER_AFTER(s, 30 + MEM_RECOVER_SAMPLES - 2) == MEM_TIER_SURVIVAL, "no recovery before the hold time");
+	expect(TIER_AFTER(s, 30 + MEM_RECOVER_SAMPLES - 1) == MEM_TIER_REDUCED, "one tier up after the hold time");
+	expect(TIER_AFTER(s, 80) == MEM_TIER_FULL, "back to full after release");
+	expect(s.mb.transitions == 4, "exactly full>reduced>survival>reduced>full (no flapping)");
+
+	// Tight PSRAM (the full tier doesn't fit with margin).
+	o = (sim_options_t){.dram_kb = 160, .psram_kb = 1024, .clients = 2, .ticks = 60, .quiet = true};
+	o.hogs[o.hog_count++] = (hog_event_t){5, true, 400};
+	o.hogs[o.hog_count++] = (hog_event_t){15, true, -1};
+	expect(sim_run(&s, &o) == 0, "tight PSRAM: run");
+	expect(s.mb.transitions <= 2, "at most one drop and one recovery");
+	expect(s.fb_fails == 0 && s.spike_fails == 0, "no frame allocation failures");
+
+	// DRAM squeezed.
+	o = (sim_options_t){.dram_kb = 160, .psram_kb = 4096, .clients = 3, .ticks = 20, .quiet = true};
+	o.hogs[o.hog_count++] = (hog_event_t){5, false, 12};
+	expect(sim_run(&s, &o) == 0, "DRAM squeeze: run");
+	expect(TIER_AFTER(s, 5) == MEM_TIER_SURVIVAL, "survival below the DRAM threshold");
+	expect(s.max_clients_seen[MEM_TIER_SURVIVAL] <= MEM_SURVIVAL_MAX_CLIENTS, "client cap held");
+
+	// No PSRAM.
+	o = (sim_options_t){.dram_kb = 300, .psram_kb = 0, .clients = 2, .ticks = 20, .quiet = true};
+	expect(sim_run(&s, &o) == 0, "no PSRAM: run");
+	expect(s.ticks_in[MEM_TIER_FULL] == 0, "never full without PSRAM");
+	expect(s.fb_fails == 0, "frame buffer fits in DRAM");
+
+	return selftest_done();
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+			"usage: %s run [--dram-kb N] [--psram-kb N] [--clients N] [--ticks N] [--hog T:POOL:KB]... [--quiet]\n"
+			"       %s selftest\n",
+			argv0, argv0);
+}
+
+int main(int argc, char **argv)
+{
+	sim_options_t o = {.dram_kb = 160, .psram_kb = 4096, .clients = 4, .ticks = 60};
+	static const struct option longopts[] = {
+		{"dram-kb", required_argument, NULL, 'd'}, {"psram-kb", required_argument, NULL, 'p'},
+		{"clients", required_argument, NULL, 'c'}, {"ticks", required_argument, NULL, 't'},
+		{"hog", required_argument, NULL, 'g'},     {"quiet", no_argument, NULL, 'q'},
+		{"help", no_argument, NULL, 'h'},          {NULL, 0, NULL, 0},
+	};
+	int ch;
+	while ((ch = getopt_long(argc, argv, "", longopts, NULL)) != -1)
+	{
+		switch (ch)
+		{
+		case 'd': o.dram_kb = strtoul(optarg, NULL, 10); break;
+		case 'p': o.psram_kb = strtoul(optarg, NULL, 10); break;
+		case 'c': o.clients = atoi(optarg); break;
+		case 't': o.ticks = atoi(optarg); break;
+		case 'q': o.quiet = true; break;
+		case 'g':
+		{
+			char pool[8] = {0};
+			hog_event_t h;
+			if (o.hog_count >= SIM_MAX_HOGS || sscanf(optarg, "%d:%7[a-z]:%d", &h.tick, pool, &h.leave_kb) != 3 ||
+				(strcmp(pool, "dram") != 0 && strcmp(pool, "psram") != 0))
+			{
+				usage(argv[0]);
+				return 2;
+			}
+			h.psram = strcmp(pool, "psram") == 0;
+			o.hogs[o.hog_count++] = h;
+			break;
+		}
+		default: usage(argv[0]); return 2;
+		}
+	}
+
+	const int nargs = argc - optind;
+	const char *cmd = (nargs > 0) ? argv[optind] : "";
+	if (nargs == 1 && strcmp(cmd, "selftest") == 0)
+		return cmd_selftest();
+	if (nargs == 1 && strcmp(cmd, "run") == 0)
+	{
+		static sim_t s;
+		return sim_run(&s, &o) != 0;
+	}
+	usage(argv[0]);
+	return 2;
+}
@@ -0,0 +1,515 @@
+// Firmware upload tool for POST /api/ota, plus a selftest of the firmware's upload logic
+// (main/ota_stream.c) against a plain file standing in for the OTA partition.
+//
+//   rc_ota push IMAGE --host H [--port P] [--range-kb N] [--retries N]
+//   rc_ota sha256 IMAGE
+//   rc_ota selftest FILE [--size-kb N] [--partition-kb N] [--range-kb N]
+//
+// push sends the image in Content-Range pieces and, when a piece fails, asks GET /api/ota how far
+// the car got and resumes from there.
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "ota_stream.h"
+#include "selftest.h"
+#include "sha256.h"
+#include "ws_lite.h"
+
+typedef struct
+{
+	const char *host;
+	uint16_t port;
+	uint32_t range_kb;
+	int retries;
+	uint32_t size_kb;
+	uint32_t partition_kb;
+} options_t;
+
+static options_t opt = {
+	.host = NULL,
+	.port = 8888,
+	.range_kb = 256,
+	.retries = 5,
+	.size_kb = 1200,
+	.partition_kb = 1920,
+};
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+	FILE *fp = fopen(path, "rb");
+	if (!fp)
+		return NULL;
+	uint8_t *buf = NULL;
+	if (fseek(fp, 0, SEEK_END) == 0)
+	{
+		const long n = ftell(fp);
+		rewind(fp);
+		buf = (n > 0) ? (uint8_t *)malloc((size_t)n) : NULL;
+		if (buf && fread(buf, 1, (size_t)n, fp) != (size_t)n)
+		{
+			free(buf);
+			buf = NULL;
+		}
+		*len = (size_t)n;
+		if (n == 0)
+			errno = ENODATA;
+	}
+	fclose(fp);
+	return buf;
+}
+
+static void digest_of(const uint8_t *data, size_t len, uint8_t digest[32])
+{
+	sha256_t s;
+	sha256_start(&s);
+	sha256_update(&s, data, len);
+	sha256_finish(&s, digest);
+}
+
+// --- push ---
+
+static int tcp_connect(const char *host, uint16_t port)
+{
+	char port_str[8];
+	snprintf(port_str, sizeof(port_str), "%u", (unsigned)port);
+	struct addrinfo hints = {.ai_family = AF_INET, .ai_socktype = SOCK_STREAM};
+	struct addrinfo *res = NULL;
+	if (getaddrinfo(host, port_str, &hints, &res) != 0 || !res)
+		return -1;
+	const int fd = socket(res->ai_family, res->ai_socktype, 0);
+	if (fd >= 0)
+	{
+		struct timeval tv = {.tv_sec = 15};
+		(void)setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+		(void)setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		if (connect(fd, res->ai_addr, res->ai_addrlen) != 0)
+		{
+			close(fd);
+			freeaddrinfo(res);
+			return -1;
+		}
+	}
+	freeaddrinfo(res);
+	return fd;
+}
+
+static bool send_all(int fd, const void *data, size_t len)
+{
+	const uint8_t *p = (const uint8_t *)data;
+	while (len > 0)
+	{
+		const ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+		if (n <= 0)
+			return false;
+		p += n;
+		len -= (size_t)n;
+	}
+	return true;
+}
+
+// One request; returns the HTTP status (or -1) and the response body in `body`.
+static int http_request(const char *method, const char *extra_headers, const uint8_t *data, size_t len, char *body,
+						size_t body_cap)
+{
+	body[0] = '\0';
+	const int fd = tcp_connect(opt.host, opt.port);
+	if (fd < 0)
+		return -1;
+	char head[1024];
+	int n = snprintf(head, sizeof(head),
+					 "%s /api/ota HTTP/1.1\r\nHost: %s:%u\r\nContent-Length: %zu\r\n%sConnection: close\r\n\r\n",
+					 method, opt.host, (unsigned)opt.port, len, extra_headers ? extra_headers : "");
+	if (!send_all(fd, head, (size_t)n) || (len > 0 && !send_all(fd, data, len)))
+	{
+		close(fd);
+		return -1;
+	}
+
+	// The response is small: read it whole (the car may keep the socket open, so go by Content-Length).
+	size_t got = 0;
+	char resp[2048];
+	int status = -1;
+	size_t want = sizeof(resp) - 1;
+	while (got < want)
+	{
+		const ssize_t r = recv(fd, resp + got, want - got, 0);
+		if (r <= 0)
+			break;
+		got += (size_t)r;
+		resp[got] = '\0';
+		const char *end = strstr(resp, "\r\n\r\n");
+		if (end)
+		{
+			const char *cl = strcasestr(resp, "Content-Length:");
+			const size_t head_len = (size_t)(end + 4 - resp);
+			if (cl && cl < end)
+				want = head_len + strtoul(cl + 15, NULL, 10);
+			if (want > sizeof(resp) - 1)
+				want = sizeof(resp) - 1;
+		}
+	}
+	close(fd);
+	resp[got] = '\0';
+	if (sscanf(resp, "HTTP/1.%*d %d", &status) != 1)
+		return -1;
+	const char *b = strstr(resp, "\r\n\r\n");
+	snprintf(body, body_cap, "%s", b ? b + 4 : "");
+	return status;
+}
+
+static long json_number(const char *json, const char *key)
+{
+	char pat[48];
+	snprintf(pat, sizeof(pat), "\"%s\":", key);
+	const char *p = strstr(json, pat);
+	return p ? strtol(p + strlen(pat), NULL, 10) : -1;
+}
+
+static int cmd_push(const char *path)
+{
+	size_t len = 0;
+	uint8_t *img = read_file(path, &len);
+	if (!img || !opt.host)
+	{
+		fprintf(stderr, "%s: %s\n", path, img ? "--host is required" : strerror(errno));
+		free(img);
+		return 1;
+	}
+	uint8_t digest[32];
+	char hex[65];
+	digest_of(img, len, digest);
+	sha256_hex(digest, hex);
+	printf("%s: %zu bytes, sha256 %s\n", path, len, hex);
+
+	const size_t range = (size_t)opt.range_kb * 1024;
+	const int64_t start = ws_now_us();
+	size_t off = 0;
+	int failures = 0;
+	char body[1024];
+	while (true)
+	{
+		const size_t n = (len - off < range) ? len - off : range;
+		char hdr[256];
+		snprintf(hdr, sizeof(hdr), "Content-Type: application/octet-stream\r\nContent-Range: bytes %zu-%zu/%zu\r\n"
+				 "X-Image-SHA256: %s\r\n", off, off + n - 1, len, hex);
+		const int status = http_request("POST", hdr, img + off, n, body, sizeof(body));
+		if (status == 200 && strstr(body, "\"state\":\"done\""))
+		{
+			const double secs = (double)(ws_now_us() - start) / 1e6;
+			printf("\ndone in %.1f s (%.1f KiB/s), %d retries; the car reboots into the new image\n", secs,
+				   secs > 0 ? (double)len / 1024.0 / secs : 0.0, failures);
+			free(img);
+			return 0;
+		}
+		if (status == 200)
+		{
+			off += n;
+			printf("\r%zu / %zu", off, len);
+			fflush(stdout);
+			continue;
+		}
+
+		printf("\nrange %zu-%zu: %s %s\n", off, off + n - 1, status < 0 ? "connection failed" : "HTTP", body);
+		if (status == 400 || status == 413 || ++failures > opt.retries)
+			break;
+		ws_sleep_us(1000000);
+		// Resume wherever the car stands; anything else starts over.
+		if (http_request("GET", NULL, NULL, 0, body, sizeof(body)) == 200 && strstr(body, "\"state\":\"receiving\"") &&
+			json_number(body, "total") == (long)len)
+			off = (size_t)json_number(body, "received");
+		else
+			off = 0;
+		printf("resuming at %zu\n", off);
+	}
+	free(img);
+	return 1;
+}
+
+static int cmd_sha256(const char *path)
+{
+	size_t len = 0;
+	uint8_t *img = read_file(path, &len);
+	if (!img)
+	{
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return 1;
+	}
+	uint8_t digest[32];
+	char hex[65];
+	digest_of(img, len, digest);
+	sha256_hex(digest, hex);
+	printf("%s  %s\n", hex, path);
+	free(img);
+	return 0;
+}
+
+// --- selftest: file-backed partition ---
+
+#define SECTOR 4096
+
+typedef struct
+{
+	FILE *fp;
+	size_t size;
+	size_t written;
+	size_t erased; // sectors are erased on demand, like OTA_WITH_SEQUENTIAL_WRITES
+	bool open;
+	bool bootable;
+	uint32_t aborts;
+} file_part_t;
+
+static bool part_begin(void *ctx, size_t image_len)
+{
+	file_part_t *p = (file_part_t *)ctx;
+	if (image_len > p->size)
+		return false;
+	p->written = 0;
+	p->erased = 0;
+	p->open = true;
+	p->bootable = false;
+	return true;
+}
+
+static bool part_write(void *ctx, const uint8_t *data, size_t len)
+{
+	file_part_t *p = (file_part_t *)ctx;
+	if (!p->open || p->written + len > p->size)
+		return false;
+	static const uint8_t ff[SECTOR] = {[0 ... SECTOR - 1] = 0xFF};
+	while (p->erased < p->written + len)
+	{
+		if (fseek(p->fp, (long)p->erased, SEEK_SET) != 0 || fwrite(ff, 1, SECTOR, p->fp) != SECTOR)
+			return false;
+		p->erased += SECTOR;
+	}
+	if (fseek(p->fp, (long)p->written, SEEK_SET) != 0 || fwrite(data, 1, len, p->fp) != len)
+		return false;
+	p->written += len;
+	return true;
+}
+
+static bool part_finish(void *ctx)
+{
+	file_part_t *p = (file_part_t *)ctx;
+	uint8_t magic = 0;
+	p->open = false;
+	// esp_ota_end() checks the image; the magic byte is the part that applies to test data.
+	fflush(p->fp);
+	if (fseek(p->fp, 0, SEEK_SET) != 0 || fread(&magic, 1, 1, p->fp) != 1 || magic != 0xE9)
+		return false;
+	p->bootable = true;
+	return true;
+}
+
+static void part_abort(void *ctx)
+{
+	file_part_t *p = (file_part_t *)ctx;
+	p->open = false;
+	p->aborts++;
+}
+
+static void hash_start(void *ctx)
+{
+	sha256_start((sha256_t *)ctx);
+}
+
+static void hash_update(void *ctx, const uint8_t *data, size_t len)
+{
+	sha256_update((sha256_t *)ctx, data, len);
+}
+
+static void hash_finish(void *ctx, uint8_t digest[OTA_SHA256_LEN])
+{
+	sha256_finish((sha256_t *)ctx, digest);
+}
+
+static bool part_matches(file_part_t *p, const uint8_t *img, size_t len)
+{
+	uint8_t *buf = (uint8_t *)malloc(len);
+	fflush(p->fp);
+	const bool ok = buf && fseek(p->fp, 0, SEEK_SET) == 0 && fread(buf, 1, len, p->fp) == len &&
+					memcmp(buf, img, len) == 0;
+	free(buf);
+	return ok;
+}
+
+// Feeds [off, off + n) in transport-sized pieces (1..8 KB, like TCP reads). Stops after `cut` bytes
+// (simulated disconnect) when cut < n.
+static ota_err_t feed(ota_stream_t *o, const uint8_t *img, size_t off, size_t n, size_t cut, int64_t *t)
+{
+	size_t done = 0;
+	while (done < n && done < cut)
+	{
+		size_t piece = 1 + (size_t)(rand() % 8192);
+		if (piece > n - done)
+			piece = n - done;
+		if (piece > cut - done)
+			piece = cut - done;
+		const ota_err_t err = ota_stream_write(o, img + off + done, piece, *t += 1000);
+		if (err != OTA_OK)
+			return err;
+		done += piece;
+	}
+	return OTA_OK;
+}
+
+static int cmd_selftest(const char *path)
+{
+	file_part_t part = {.size = (size_t)opt.partition_kb * 1024};
+	part.fp = fopen(path, "w+b");
+	const size_t len = (size_t)opt.size_kb * 1024 + 123; // not sector aligned
+	uint8_t *img = (uint8_t *)malloc(len);
+	if (!part.fp || !img)
+	{
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return 1;
+	}
+	srand(1234);
+	for (size_t i = 0; i < len; i++)
+		img[i] = (uint8_t)rand();
+	img[0] = 0xE9;
+	uint8_t sha[32], other_sha[32];
+	digest_of(img, len, sha);
+	memcpy(other_sha, sha, sizeof(sha));
+	other_sha[5] ^= 1;
+
+	sha256_t hash_ctx;
+	const ota_sink_t sink = {&part, part_begin, part_write, part_finish, part_abort};
+	const ota_hash_t hash = {&hash_ctx, hash_start, hash_update, hash_finish};
+	ota_stream_t o;
+	ota_stream_init(&o, &sink, &hash, part.size);
+	int64_t t = 0;
+
+	size_t first, last, total;
+	printf("parsing\n");
+	expect(ota_parse_content_range("bytes 0-99/1000", &first, &last, &total) && first == 0 && last == 99 &&
+			   total == 1000,
+		   "Content-Range");
+	expect(!ota_parse_content_range("bytes 5-4/1000", &first, &last, &total) &&
+			   !ota_parse_content_range("bytes 0-1000/1000", &first, &last, &total) &&
+			   !ota_parse_content_range("bytes 0-9/*", &first, &last, &total),
+		   "bad Content-Range accepted");
+	char hex[65];
+	uint8_t parsed[32];
+	sha256_hex(sha, hex);
+	expect(ota_parse_sha256_hex(hex, parsed) && memcmp(parsed, sha, 32) == 0 && !ota_parse_sha256_hex("12", parsed),
+		   "SHA-256 hex");
+
+	printf("single upload (%zu bytes, random read sizes)\n", len);
+	expect(ota_stream_open(&o, 0, len, sha, t) == OTA_OK, "open");
+	expect(feed(&o, img, 0, len, len, &t) == OTA_OK, "write");
+	expect(ota_stream_close(&o) == OTA_OK && o.state == OTA_DONE && part.bootable, "verify + finish");
+	expect(part_matches(&part, img, len), "partition content");
+
+	const size_t range = (size_t)opt.range_kb * 1024;
+	printf("ranged upload (%zu KB ranges, disconnect + resume in every range)\n", range / 1024);
+	part.bootable = false;
+	for (size_t off = 0; off < len;)
+	{
+		const size_t n = (len - off < range) ? len - off : range;
+		expect(ota_stream_open(&o, off, len, sha, t) == OTA_OK, "open range");
+		// The connection drops part way; the client asks where to resume.
+		const size_t cut = n / 3;
+		expect(feed(&o, img, off, n, cut, &t) == OTA_OK && ota_stream_close(&o) == OTA_OK, "partial range");
+		expect(o.state == OTA_RECEIVING && o.received == off + cut, "state after disconnect");
+		if (o.received > 0)
+		{
+			expect(ota_stream_open(&o, o.received + 1, len, sha, t) == OTA_ERR_RANGE, "wrong resume offset accepted");
+			expect(ota_stream_open(&o, o.received, len, other_sha, t) == OTA_ERR_MISMATCH, "other image accepted");
+			expect(ota_stream_open(&o, o.received, len + 1, sha, t) == OTA_ERR_MISMATCH, "other size accepted");
+			expect(o.state == OTA_RECEIVING, "rejected resume dropped the upload");
+			expect(ota_stream_open(&o, o.received, len, sha, t) == OTA_OK, "resume");
+		}
+		const size_t resume = o.received;
+		expect(feed(&o, img, resume, off + n - resume, off + n - resume, &t) == OTA_OK, "resumed write");
+		expect(ota_stream_close(&o) == OTA_OK, "close range");
+		off += n;
+	}
+	expect(o.state == OTA_DONE && part.bootable && part_matches(&part, img, len), "ranged image");
+
+	printf("corrupted byte\n");
+	part.bootable = false;
+	const uint32_t aborts = part.aborts;
+	expect(ota_stream_open(&o, 0, len, sha, t) == OTA_OK, "open");
+	img[len / 2] ^= 0x40;
+	expect(feed(&o, img, 0, len, len, &t) == OTA_OK, "write");
+	img[len / 2] ^= 0x40;
+	expect(ota_stream_close(&o) == OTA_ERR_HASH && o.state == OTA_FAILED && !part.bootable &&
+			   part.aborts == aborts + 1,
+		   "corrupt image not rejected");
+
+	printf("limits\n");
+	expect(ota_stream_open(&o, 0, part.size + 1, sha, t) == OTA_ERR_SIZE, "oversized image accepted");
+	expect(ota_stream_open(&o, 0, 1000, sha, t) == OTA_OK && ota_stream_write(&o, img, 1001, t) == OTA_ERR_SIZE &&
+			   o.state == OTA_FAILED,
+		   "bytes beyond total accepted");
+	expect(ota_stream_open(&o, 10, len, sha, t) == OTA_ERR_RANGE, "resume without an upload accepted");
+	expect(ota_stream_open(&o, 0, len, sha, t) == OTA_OK && !ota_stream_expire(&o, t + 1000, 5000) &&
+			   ota_stream_expire(&o, t + 10000, 5000) && o.last_error == OTA_ERR_TIMEOUT,
+		   "idle upload not expired");
+
+	char json[256];
+	expect(ota_stream_json(json, sizeof(json), &o) > 0, "status json");
+	printf("  %s\n", json);
+
+	fclose(part.fp);
+	free(img);
+	return selftest_done();
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+			"usage: %s push IMAGE --host H [--port P] [--range-kb N] [--retries N]\n"
+			"       %s sha256 IMAGE\n"
+			"       %s selftest FILE [--size-kb N] [--partition-kb N] [--range-kb N]\n",
+			argv0, argv0, argv0);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option longopts[] = {
+		{"host", required_argument, NULL, 'h'},     {"port", required_argument, NULL, 'p'},
+		{"range-kb", required_argument, NULL, 'r'}, {"retries", required_argument, NULL, 'R'},
+		{"size-kb", required_argument, NULL, 's'},  {"partition-kb", required_argument, NULL, 'P'},
+		{"help", no_argument, NULL, '?'},           {NULL, 0, NULL, 0},
+	};
+	int ch;
+	while ((ch = getopt_long(argc, argv, "", longopts, NULL)) != -1)
+	{
+		switch (ch)
+		{
+		case 'h': opt.host = optarg; break;
+		case 'p': opt.port = (uint16_t)atoi(optarg); break;
+		case 'r': opt.range_kb = (uint32_t)strtoul(optarg, NULL, 10); break;
+		case 'R': opt.retries = atoi(optarg); break;
+		case 's': opt.size_kb = (uint32_t)strtoul(optarg, NULL, 10); break;
+		case 'P': opt.partition_kb = (uint32_t)strtoul(optarg, NULL, 10); break;
+		default: usage(argv[0]); return 2;
+		}
+	}
+	if (opt.range_kb == 0)
+	{
+		usage(argv[0]);
+		return 2;
+	}
+
+	const int nargs = argc - optind;
+	const char *cmd = (nargs > 0) ? argv[optind] : "";
+	if (nargs == 2 && strcmp(cmd, "push") == 0)
+		return cmd_push(argv[optind + 1]);
+	if (nargs == 2 && strcmp(cmd, "sha256") == 0)
+		return cmd_sha256(argv[optind + 1]);
+	if (nargs == 2 && strcmp(cmd, "selftest") == 0)
+		return cmd_selftest(argv[optind + 1]);
+	usage(argv[0]);
+	return 2;
+}
@@ -0,0 +1,379 @@
+// Reads recordings made by the firmware recorder (main/recorder.c) and exercises the writer on a
+// plain file standing in for the SD card.
+//
+//   rc_rec info FILE
+//   rc_rec list FILE [--from-ms T] [--count N]
+//   rc_rec extract FILE OUTDIR [--from-ms T] [--count N]     writes frame_<seq>.jpg / .rawh / .cam / .ctrl
+//   rc_rec selftest FILE [--size-mb N] [--frames N] [--fps N]
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "recorder.h"
+#include "selftest.h"
+#include "ws_lite.h"
+
+typedef struct
+{
+	int64_t from_ms;
+	uint32_t count;
+	uint32_t size_mb;
+	uint32_t frames;
+	uint32_t fps;
+} options_t;
+
+static options_t opt = {.from_ms = -1, .count = UINT32_MAX, .size_mb = 16, .frames = 2000, .fps = 500};
+
+static int open_reader(const char *path, rec_store_t *st, rec_reader_t *r)
+{
+	if (rec_store_file_open(st, path, 0, false) != 0)
+	{
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if (rec_reader_open(r, st) != 0)
+	{
+		fprintf(stderr, "%s: not a recording (bad header)\n", path);
+		rec_store_file_close(st);
+		return -1;
+	}
+	return 0;
+}
+
+static uint32_t first_selected(const rec_reader_t *r)
+{
+	if (opt.from_ms < 0)
+		return r->first_seq;
+	rec_entry_t e;
+	if (!rec_reader_entry(r, r->first_seq, &e))
+		return r->hdr.next_seq;
+	return rec_reader_seek_time(r, e.t_us + opt.from_ms * 1000);
+}
+
+static int cmd_info(const char *path)
+{
+	rec_store_t st;
+	rec_reader_t r;
+	if (open_reader(path, &st, &r) != 0)
+		return 1;
+
+	printf("file_id    %08" PRIx32 "\n", r.hdr.file_id);
+	printf("index      %" PRIu32 " entries @ %" PRIu64 "\n", r.hdr.index_cap, r.hdr.index_off);
+	printf("data ring  %" PRIu64 " bytes @ %" PRIu64 ", head %" PRIu64 " (wrapped %" PRIu64 "x)\n", r.hdr.data_size,
+		   r.hdr.data_off, r.hdr.head, r.hdr.head / r.hdr.data_size);
+	printf("frames     %" PRIu32 " readable (seq %" PRIu32 "..%" PRIu32 ")\n", rec_reader_count(&r), r.first_seq,
+		   r.hdr.next_seq ? r.hdr.next_seq - 1 : 0);
+
+	rec_entry_t a, b;
+	if (rec_reader_count(&r) > 0 && rec_reader_entry(&r, r.first_seq, &a) &&
+		rec_reader_entry(&r, r.hdr.next_seq - 1, &b))
+	{
+		const double span_s = (double)(b.t_us - a.t_us) / 1e6;
+		printf("span       %.1f s (%.1f fps, %.1f KB/s)\n", span_s,
+			   span_s > 0 ? (double)(rec_reader_count(&r) - 1) / span_s : 0.0,
+			   span_s > 0 ? (double)(b.pos - a.pos) / 1024.0 / span_s : 0.0);
+	}
+	rec_store_file_close(&st);
+	return 0;
+}
+
+static int cmd_list(const char *path)
+{
+	rec_store_t st;
+	rec_reader_t r;
+	if (open_reader(path, &st, &r) != 0)
+		return 1;
+
+	rec_entry_t first;
+	const int64_t t0 = rec_reader_entry(&r, r.first_seq, &first) ? first.t_us : 0;
+	uint32_t n = 0;
+	printf("%10s %12s %8s %4s %14s\n", "seq", "t_ms", "bytes", "fmt", "pos");
+	for (uint32_t seq = first_selected(&r); seq != r.hdr.next_seq && n < opt.count; seq++, n++)
+	{
+		rec_entry_t e;
+		if (!rec_reader_entry(&r, seq, &e))
+			continue;
+		printf("%10" PRIu32 " %12.1f %8" PRIu32 " %4s %14" PRIu64 "\n", seq, (double)(e.t_us - t0) / 1000.0, e.len,
+			   rec_fmt_name(e.flags), e.pos);
+	}
+	rec_store_file_close(&st);
+	return 0;
+}
+
+static int cmd_extract(const char *path, const char *outdir)
+{
+	rec_store_t st;
+	rec_reader_t r;
+	if (open_reader(path, &st, &r) != 0)
+		return 1;
+	(void)mkdir(outdir, 0755);
+
+	size_t cap = 256 * 1024;
+	uint8_t *buf = (uint8_t *)malloc(cap);
+	uint32_t n = 0, failed = 0;
+	for (uint32_t seq = first_selected(&r); seq != r.hdr.next_seq && n < opt.count && buf; seq++)
+	{
+		rec_entry_t e;
+		int len = rec_reader_read(&r, seq, buf, cap, &e);
+		if (len < 0 && rec_reader_entry(&r, seq, &e) && e.len > cap)
+		{
+			cap = e.len;
+			uint8_t *nb = (uint8_t *)realloc(buf, cap);
+			if (!nb)
+				break;
+			buf = nb;
+			len = rec_reader_read(&r, seq, buf, cap, &e);
+		}
+		if (len < 0)
+		{
+			failed++;
+			continue;
+		}
+
+		char name[512];
+		snprintf(name, sizeof(name), "%s/frame_%08" PRIu32 ".%s", outdir, seq,
+				 (e.flags & 0xFF) == REC_FMT_JPEG ? "jpg" : rec_fmt_name(e.flags));
+		FILE *f = fopen(name, "wb");
+		if (!f || fwrite(buf, 1, (size_t)len, f) != (size_t)len)
+			failed++;
+		else
+			n++;
+		if (f)
+			fclose(f);
+	}
+	free(buf);
+	rec_store_file_close(&st);
+	printf("extracted %" PRIu32 " frame(s) to %s, %" PRIu32 " failed\n", n, outdir, failed);
+	return failed ? 1 : 0;
+}
+
+// --- selftest: producer/consumer threads against a file, then read everything back ---
+
+static uint32_t test_len(uint32_t seq)
+{
+	return 1500u + (seq * 7919u) % 38000u;
+}
+
+static uint8_t test_byte(uint32_t seq, uint32_t i)
+{
+	return (uint8_t)(seq * 31u + i * 7u + (i >> 8));
+}
+
+typedef struct
+{
+	rec_writer_t *w;
+	atomic_bool stop;
+	uint32_t drains;
+	int errors;
+} drain_ctx_t;
+
+static void *drain_thread(void *arg)
+{
+	drain_ctx_t *c = (drain_ctx_t *)arg;
+	int64_t last_flush = ws_now_us();
+	while (!atomic_load(&c->stop))
+	{
+		const int64_t now = ws_now_us();
+		const bool flush = now - last_flush > 50000;
+		if (rec_writer_drain(c->w, flush) < 0)
+			c->errors++;
+		if (flush)
+			last_flush = now;
+		c->drains++;
+		ws_sleep_us(2000);
+	}
+	if (rec_writer_drain(c->w, true) < 0)
+		c->errors++;
+	return NULL;
+}
+
+// Pushes opt.frames frames at opt.fps; returns the number of frames accepted.
+static uint32_t produce(rec_writer_t *w, int64_t *t_us, uint8_t *buf)
+{
+	uint32_t accepted = 0;
+	const int64_t period = 1000000 / (opt.fps ? opt.fps : 1);
+	int64_t next = ws_now_us();
+	for (uint32_t i = 0; i < opt.frames; i++)
+	{
+		const uint32_t seq = w->prod_seq;
+		const uint32_t len = test_len(seq);
+		for (uint32_t k = 0; k < len; k++)
+			buf[k] = test_byte(seq, k);
+		*t_us += period;
+		if (rec_writer_push(w, buf, len, *t_us, REC_FMT_JPEG))
+			accepted++;
+		next += period;
+		const int64_t wait = next - ws_now_us();
+		if (wait > 0)
+			ws_sleep_us(wait);
+	}
+	return accepted;
+}
+
+static int run_writer(rec_store_t *st, uint32_t file_id, int64_t *t_us, uint32_t *first_seq, rec_stats_t *stats)
+{
+	static uint8_t staging[256 * 1024];
+	rec_writer_t w;
+	if (rec_writer_init(&w, st, staging, sizeof(staging), 1024, file_id) != 0)
+	{
+		fprintf(stderr, "writer init failed\n");
+		return -1;
+	}
+	*first_seq = w.prod_seq;
+
+	drain_ctx_t dc = {.w = &w};
+	atomic_init(&dc.stop, false);
+	pthread_t th;
+	pthread_create(&th, NULL, drain_thread, &dc);
+
+	uint8_t *buf = (uint8_t *)malloc(64 * 1024);
+	const int64_t start = ws_now_us();
+	const uint32_t accepted = produce(&w, t_us, buf);
+	atomic_store(&dc.stop, true);
+	pthread_join(th, NULL);
+	const double secs = (double)(ws_now_us() - start) / 1e6;
+	free(buf);
+
+	*stats = rec_writer_stats(&w);
+	printf("  pushed %" PRIu32 ", accepted %" PRIu32 ", dropped %" PRIu32 ", indexed %" PRIu32 "\n", opt.frames,
+		   accepted, stats->dropped, stats->indexed);
+	printf("  %" PRIu32 " drains, %" PRIu32 " batches, %.1f MB written (%.1f MB/s), staging peak %" PRIu32
+		   " KB, errors %d\n",
+		   dc.drains, stats->batches, (double)stats->bytes_written / 1e6, (double)stats->bytes_written / 1e6 / secs,
+		   stats->staging_peak / 1024, dc.errors + (int)stats->write_errors);
+	rec_writer_deinit(&w);
+	return (dc.errors || stats->write_errors || stats->indexed != accepted) ? -1 : 0;
+}
+
+static int verify(rec_store_t *st, uint32_t expect_next)
+{
+	rec_reader_t r;
+	if (rec_reader_open(&r, st) != 0)
+	{
+		printf("  header unreadable\n");
+		return -1;
+	}
+	if (r.hdr.next_seq != expect_next)
+	{
+		printf("  next_seq %" PRIu32 ", expected %" PRIu32 "\n", r.hdr.next_seq, expect_next);
+		return -1;
+	}
+
+	uint8_t *buf = (uint8_t *)malloc(64 * 1024);
+	uint32_t ok = 0, bad = 0;
+	int64_t prev_t = INT64_MIN;
+	for (uint32_t seq = r.first_seq; seq != r.hdr.next_seq; seq++)
+	{
+		rec_entry_t e;
+		const int len = rec_reader_read(&r, seq, buf, 64 * 1024, &e);
+		bool good = len == (int)test_len(seq) && e.t_us > prev_t;
+		for (int k = 0; good && k < len; k++)
+			good = buf[k] == test_byte(seq, (uint32_t)k);
+		prev_t = e.t_us;
+		good ? ok++ : bad++;
+	}
+
+	// Seeking: the found frame is the first at or after t.
+	uint32_t seek_bad = 0;
+	rec_entry_t a, b;
+	if (rec_reader_count(&r) > 1 && rec_reader_entry(&r, r.first_seq, &a) &&
+		rec_reader_entry(&r, r.hdr.next_seq - 1, &b))
+	{
+		for (int i = 0; i < 200; i++)
+		{
+			const int64_t t = a.t_us + (b.t_us - a.t_us) * i / 199;
+			const uint32_t seq = rec_reader_seek_time(&r, t);
+			rec_entry_t e, p;
+			if (!rec_reader_entry(&r, seq, &e) || e.t_us < t ||
+				(seq != r.first_seq && rec_reader_entry(&r, seq - 1, &p) && p.t_us >= t))
+				seek_bad++;
+		}
+	}
+	free(buf);
+
+	printf("  readable seq %" PRIu32 "..%" PRIu32 ": %" PRIu32 " ok, %" PRIu32 " bad, %" PRIu32 " bad seeks\n",
+		   r.first_seq, r.hdr.next_seq - 1, ok, bad, seek_bad);
+	return (bad || seek_bad || ok == 0) ? -1 : 0;
+}
+
+static int cmd_selftest(const char *path)
+{
+	rec_store_t st;
+	(void)remove(path);
+	if (rec_store_file_open(&st, path, (uint64_t)opt.size_mb << 20, true) != 0)
+	{
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return 1;
+	}
+
+	int64_t t_us = 0;
+	uint32_t first_seq;
+	rec_stats_t stats;
+
+	printf("session 1 (new file, %" PRIu32 " MB)\n", opt.size_mb);
+	expect(run_writer(&st, 0x1234u, &t_us, &first_seq, &stats) == 0, "session 1 written and indexed");
+	const uint32_t next1 = first_seq + stats.indexed;
+	expect(verify(&st, next1) == 0, "session 1 readable");
+
+	printf("session 2 (resume)\n");
+	expect(run_writer(&st, 0x5678u, &t_us, &first_seq, &stats) == 0, "session 2 written and indexed");
+	expect(first_seq == next1, "session 2 resumes the sequence");
+	expect(verify(&st, first_seq + stats.indexed) == 0, "session 2 readable");
+
+	rec_store_file_close(&st);
+	return selftest_done();
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+			"usage: %s info FILE\n"
+			"       %s list FILE [--from-ms T] [--count N]\n"
+			"       %s extract FILE OUTDIR [--from-ms T] [--count N]\n"
+			"       %s selftest FILE [--size-mb N] [--frames N] [--fps N]\n",
+			argv0, argv0, argv0, argv0);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option longopts[] = {
+		{"from-ms", required_argument, NULL, 't'}, {"count", required_argument, NULL, 'n'},
+		{"size-mb", required_argument, NULL, 's'}, {"frames", required_argument, NULL, 'f'},
+		{"fps", required_argument, NULL, 'r'},     {"help", no_argument, NULL, 'h'},
+		{NULL, 0, NULL, 0},
+	};
+	int ch;
+	while ((ch = getopt_long(argc, argv, "", longopts, NULL)) != -1)
+	{
+		switch (ch)
+		{
+		case 't': opt.from_ms = atoll(optarg); break;
+		case 'n': opt.count = (uint32_t)strtoul(optarg, NULL, 10); break;
+		case 's': opt.size_mb = (uint32_t)strtoul(optarg, NULL, 10); break;
+		case 'f': opt.frames = (uint32_t)strtoul(optarg, NULL, 10); break;
+		case 'r': opt.fps = (uint32_t)strtoul(optarg, NULL, 10); break;
+		default: usage(argv[0]); return 2;
+		}
+	}
+
+	const int nargs = argc - optind;
+	const char *cmd = (nargs > 0) ? argv[optind] : "";
+	if (nargs == 2 && strcmp(cmd, "info") == 0)
+		return cmd_info(argv[optind + 1]);
+	if (nargs == 2 && strcmp(cmd, "list") == 0)
+		return cmd_list(argv[optind + 1]);
+	if (nargs == 3 && strcmp(cmd, "extract") == 0)
+		return cmd_extract(argv[optind + 1], argv[optind + 2]);
+	if (nargs == 2 && strcmp(cmd, "selftest") == 0)
+		return cmd_selftest(argv[optind + 1]);
+	usage(argv[0]);
+	return 2;
+}
@@ -0,0 +1,417 @@
+// Reference video receiver for the RC car WebSocket endpoint (car or rc_hostsim).
+//
+// Decodes the stream with the same frame codec the firmware encodes with (main/rc_frame.c):
+// RAWH header + payload pairs and JPEG frames. RAW payloads are converted the way a display client
+// would (RGB565 byte swap, GRAY8 / unpacked GRAY4 / GRAY2 -> RGB565, RGB332 -> RGB565) and timed. Optionally writes frames to disk as
+// PGM/PPM/JPEG, and with --expect checks every frame's format and size (exit code 1 otherwise),
+// which makes it usable as an end-to-end format test. --chunked announces RC_CAP_VIDEO_CHUNKED and
+// reassembles the chunk messages first. --abbrev announces RC_CAP_VIDEO_JPEG_ABBREV and rebuilds
+// each JPEG from the stored tables and the scan data (checked and timed like a RAW decode).
+
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rc_frame.h"
+#include "rc_proto.h"
+#include "ws_lite.h"
+
+typedef struct
+{
+	const char *host;
+	uint16_t port;
+	const char *path;
+	int duration_s; // 0 = until interrupted or --frames reached
+	uint32_t max_frames;
+	const char *out_dir;
+	uint32_t save_every;
+	const char *expect; // jpeg or a RAW format name (rgb565, gray8, gray4, gray2, rgb332)
+	int expect_w;
+	int expect_h;
+	bool chunked;
+	bool abbrev;
+	bool quiet;
+} options_t;
+
+static options_t opt = {
+	.host = "127.0.0.1",
+	.port = 8888,
+	.path = "/",
+	.save_every = 1,
+};
+
+typedef struct
+{
+	uint32_t frames[RC_FRAME_FORMAT_COUNT + 1]; // RAW formats, then JPEG
+	uint64_t bytes;
+	uint64_t decode_us;
+	uint32_t decoded;
+	int64_t max_gap_us;
+	uint32_t mismatches;
+	uint32_t saved;
+	uint32_t abbreviated; // JPEG frames rebuilt from JTAB + scan data
+	uint64_t scan_bytes;  // their scan data (what came over the wire)
+	uint64_t jpeg_bytes;  // and the rebuilt JPEGs
+	uint32_t tables;      // table changes seen
+} stats_t;
+
+#define JPEG_SLOT RC_FRAME_FORMAT_COUNT
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	stop_requested = 1;
+}
+
+static bool format_is_gray(uint8_t format)
+{
+	return format == RC_FRAME_GRAY8 || format == RC_FRAME_GRAY4 || format == RC_FRAME_GRAY2;
+}
+
+// `pixels` holds the GRAY8 plane for gray formats (unpacked), RGB888 for color ones.
+static void save_frame(const rc_frame_t *f, bool jpeg, const uint8_t *pixels, uint32_t n)
+{
+	char path[512];
+	const char *ext = jpeg ? "jpg" : format_is_gray(f->hdr.format) ? "pgm" : "ppm";
+	snprintf(path, sizeof(path), "%s/frame_%06u.%s", opt.out_dir, (unsigned)n, ext);
+	FILE *fp = fopen(path, "wb");
+	if (!fp)
+	{
+		perror(path);
+		return;
+	}
+	if (jpeg)
+	{
+		if (f->prefix_len)
+			fwrite(f->prefix, 1, f->prefix_len, fp);
+		fwrite(f->data, 1, f->len, fp);
+	}
+	else if (format_is_gray(f->hdr.format))
+	{
+		fprintf(fp, "P5\n%u %u\n255\n", (unsigned)f->hdr.width, (unsigned)f->hdr.height);
+		fwrite(pixels, 1, (size_t)f->hdr.width * f->hdr.height, fp);
+	}
+	else
+	{
+		fprintf(fp, "P6\n%u %u\n255\n", (unsigned)f->hdr.width, (unsigned)f->hdr.height);
+		fwrite(pixels, 3, (size_t)f->hdr.width * f->hdr.height, fp);
+	}
+	fclose(fp);
+}
+
+static bool frame_matches(const rc_frame_t *f, bool jpeg)
+{
+	if (!opt.expect)
+		return true;
+	if (strcmp(opt.expect, "jpeg") == 0)
+		return jpeg;
+	if (jpeg || strcmp(opt.expect, rc_frame_format_name(f->hdr.format)) != 0)
+		return false;
+	return (opt.expect_w == 0 || f->hdr.width == opt.expect_w) && (opt.expect_h == 0 || f->hdr.height == opt.expect_h);
+}
+
+// Display-side conversion of a RAW payload into `disp` (little-endian RGB565), timed. Packed gray
+// formats are unpacked into `gray` first (left there for saving).
+static void decode_raw(const rc_frame_t *f, uint8_t *disp, uint8_t *gray, stats_t *st)
+{
+	const size_t pixels = (size_t)f->hdr.width * f->hdr.height;
+	const int64_t t0 = ws_now_us();
+	if (f->hdr.format == RC_FRAME_RGB565)
+		rc_px_swap16(disp, f->data, pixels);
+	else if (f->hdr.format == RC_FRAME_RGB332)
+		rc_px_rgb332_to_rgb565le(disp, f->data, pixels);
+	else if (f->hdr.format == RC_FRAME_GRAY8)
+		rc_px_gray8_to_rgb565le(disp, f->data, pixels);
+	else
+	{
+		(void)rc_px_unpack_gray8(gray, f->data, f->hdr.format, f->hdr.width, f->hdr.height);
+		rc_px_gray8_to_rgb565le(disp, gray, pixels);
+	}
+	st->decode_us += (uint64_t)(ws_now_us() - t0);
+	st->decoded++;
+}
+
+// Reassembles an abbreviated JPEG the way a client hands it to a decoder, timed. False if the result
+// isn't a complete JPEG (header that parses to exactly the tables, EOI at the end).
+static bool rebuild_jpeg(const rc_frame_t *f, uint8_t *buf, size_t cap, stats_t *st)
+{
+	const int64_t t0 = ws_now_us();
+	const size_t n = rc_frame_jpeg_rebuild(f, buf, cap);
+	const bool ok = n > 2 && rc_jpeg_header_len(buf, n) == f->prefix_len && buf[n - 2] == 0xFF && buf[n - 1] == 0xD9;
+	st->decode_us += (uint64_t)(ws_now_us() - t0);
+	st->decoded++;
+	st->abbreviated++;
+	st->scan_bytes += f->len;
+	st->jpeg_bytes += n;
+	return ok;
+}
+
+static bool known_format(const char *name)
+{
+	for (uint8_t f = 0; f < RC_FRAME_FORMAT_COUNT; f++)
+		if (strcmp(name, rc_frame_format_name(f)) == 0)
+			return true;
+	return false;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+			"usage: %s [options]\n"
+			"  --host H             car or rc_hostsim address (default 127.0.0.1)\n"
+			"  --port P             (default 8888)\n"
+			"  --path P             (default /)\n"
+			"  --duration S         stop after S seconds (default 0 = no limit)\n"
+			"  --frames N           stop after N frames\n"
+			"  --out DIR            write frames as PGM (gray) / PPM (rgb565, rgb332) / JPEG\n"
+			"  --every N            with --out, write every N-th frame (default 1)\n"
+			"  --expect FMT         fail (exit 1) on frames of another format\n"
+			"                       (jpeg, rgb565, gray8, gray4, gray2, rgb332)\n"
+			"  --size WxH           with --expect, also check the frame size\n"
+			"  --chunked            take video as chunk messages (HELLO cap VIDEO_CHUNKED)\n"
+			"  --abbrev             take abbreviated JPEG (HELLO cap VIDEO_JPEG_ABBREV)\n"
+			"  --quiet              no per-second lines\n",
+			argv0);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option longopts[] = {
+		{"host", required_argument, NULL, 'h'},
+		{"port", required_argument, NULL, 'p'},
+		{"path", required_argument, NULL, 'P'},
+		{"duration", required_argument, NULL, 'd'},
+		{"frames", required_argument, NULL, 'n'},
+		{"out", required_argument, NULL, 'o'},
+		{"every", required_argument, NULL, 'e'},
+		{"expect", required_argument, NULL, 'x'},
+		{"size", required_argument, NULL, 's'},
+		{"chunked", no_argument, NULL, 'k'},
+		{"abbrev", no_argument, NULL, 'a'},
+		{"quiet", no_argument, NULL, 'q'},
+		{"help", no_argument, NULL, '?'},
+		{NULL, 0, NULL, 0},
+	};
+	int ch;
+	while ((ch = getopt_long(argc, argv, "", longopts, NULL)) != -1)
+	{
+		switch (ch)
+		{
+		case 'h': opt.host = optarg; break;
+		case 'p': opt.port = (uint16_t)atoi(optarg); break;
+		case 'P': opt.path = optarg; break;
+		case 'd': opt.duration_s = atoi(optarg); break;
+		case 'n': opt.max_frames = (uint32_t)strtoul(optarg, NULL, 10); break;
+		case 'o': opt.out_dir = optarg; break;
+		case 'e': opt.save_every = (uint32_t)strtoul(optarg, NULL, 10); break;
+		case 'x': opt.expect = optarg; break;
+		case 's':
+			if (sscanf(optarg, "%dx%d", &opt.expect_w, &opt.expect_h) != 2)
+				opt.expect_w = -1;
+			break;
+		case 'k': opt.chunked = true; break;
+		case 'a': opt.abbrev = true; break;
+		case 'q': opt.quiet = true; break;
+		default: usage(argv[0]); return 2;
+		}
+	}
+	if (opt.save_every == 0 || opt.expect_w < 0 || opt.duration_s < 0 ||
+		(opt.expect && strcmp(opt.expect, "jpeg") != 0 && !known_format(opt.expect)))
+	{
+		usage(argv[0]);
+		return 2;
+	}
+
+	struct sigaction sa = {.sa_handler = on_signal};
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	ws_conn_t c;
+	if (ws_client_connect(&c, opt.host, opt.port, opt.path, 3000) != 0)
+	{
+		fprintf(stderr, "rc_recv: can't connect to ws://%s:%u%s\n", opt.host, (unsigned)opt.port, opt.path);
+		return 1;
+	}
+
+	rc_chunk_rx_t chunks;
+	memset(&chunks, 0, sizeof(chunks));
+	if (opt.chunked)
+	{
+		chunks.cap = 4u * 1024u * 1024u;
+		chunks.buf = (uint8_t *)malloc(chunks.cap);
+	}
+	if (opt.chunked || opt.abbrev)
+	{
+		const uint32_t caps = RC_CAP_TELEMETRY_TEXT | (opt.chunked ? RC_CAP_VIDEO_CHUNKED : 0) |
+							  (opt.abbrev ? RC_CAP_VIDEO_JPEG_ABBREV : 0);
+		uint8_t hello[RC_PROTO_HELLO_LEN];
+		const size_t n = rc_proto_write_hello(hello, sizeof(hello), caps);
+		if ((opt.chunked && !chunks.buf) || ws_send(&c, WS_OP_BINARY, hello, n) != 0)
+		{
+			fprintf(stderr, "rc_recv: can't start session\n");
+			ws_close(&c);
+			return 1;
+		}
+	}
+
+	rc_frame_rx_t rx;
+	memset(&rx, 0, sizeof(rx));
+	stats_t st;
+	memset(&st, 0, sizeof(st));
+	uint8_t *disp = NULL, *rgb888 = NULL;
+	size_t disp_cap = 0;
+	uint8_t *jpeg_buf = NULL;
+	size_t jpeg_cap = 0;
+	uint8_t tables_id = 0;
+
+	const int64_t start = ws_now_us();
+	int64_t last_frame = 0, next_report = start + 1000000;
+	uint32_t report_frames = 0;
+	bool failed = false;
+	while (!stop_requested)
+	{
+		const int64_t now = ws_now_us();
+		if (opt.duration_s > 0 && now - start >= (int64_t)opt.duration_s * 1000000)
+			break;
+		if (opt.max_frames && rx.frames >= opt.max_frames)
+			break;
+		if (!opt.quiet && now >= next_report)
+		{
+			printf("fps=%u frames=%u bad_headers=%u orphans=%u\n", (unsigned)report_frames, (unsigned)rx.frames,
+				   (unsigned)rx.bad_headers, (unsigned)rx.orphans);
+			report_frames = 0;
+			next_report += 1000000;
+		}
+
+		ws_msg_t msg;
+		const int r = ws_recv(&c, &msg, 200);
+		if (r < 0)
+		{
+			fprintf(stderr, "rc_recv: connection closed\n");
+			failed = opt.max_frames && rx.frames < opt.max_frames;
+			break;
+		}
+		if (r == 0 || msg.opcode != WS_OP_BINARY)
+			continue;
+
+		const uint8_t *data = msg.data;
+		size_t len = msg.len;
+		if (opt.chunked)
+		{
+			const rc_chunk_result_t cr = rc_chunk_rx_feed(&chunks, msg.data, msg.len, &data, &len);
+			if (cr == RC_CHUNK_PARTIAL || cr == RC_CHUNK_ERROR)
+				continue;
+			if (cr == RC_CHUNK_NONE)
+			{
+				data = msg.data;
+				len = msg.len;
+			}
+		}
+		rc_frame_t f;
+		const rc_frame_rx_result_t fr = rc_frame_rx_feed(&rx, data, len, &f);
+		if (fr != RC_FRAME_RX_JPEG && fr != RC_FRAME_RX_RAW)
+			continue;
+
+		const int64_t t = ws_now_us();
+		if (last_frame && t - last_frame > st.max_gap_us)
+			st.max_gap_us = t - last_frame;
+		last_frame = t;
+		report_frames++;
+		st.bytes += f.len;
+
+		const bool jpeg = (fr == RC_FRAME_RX_JPEG);
+		const bool save = opt.out_dir && (rx.frames - 1) % opt.save_every == 0;
+		st.frames[jpeg ? JPEG_SLOT : f.hdr.format]++;
+		if (!frame_matches(&f, jpeg))
+			st.mismatches++;
+		if (jpeg && f.prefix)
+		{
+			if (rx.tables_id != tables_id)
+			{
+				tables_id = rx.tables_id;
+				st.tables++;
+			}
+			if (f.prefix_len + f.len > jpeg_cap)
+			{
+				free(jpeg_buf);
+				jpeg_cap = 2 * (f.prefix_len + f.len);
+				jpeg_buf = (uint8_t *)malloc(jpeg_cap);
+				if (!jpeg_buf)
+				{
+					fprintf(stderr, "rc_recv: out of memory\n");
+					failed = true;
+					break;
+				}
+			}
+			if (!rebuild_jpeg(&f, jpeg_buf, jpeg_cap, &st))
+				st.mismatches++;
+		}
+		if (!jpeg)
+		{
+			const size_t pixels = (size_t)f.hdr.width * f.hdr.height;
+			if (pixels * 3 > disp_cap)
+			{
+				free(disp);
+				free(rgb888);
+				disp_cap = pixels * 3;
+				disp = (uint8_t *)malloc(pixels * 2);
+				rgb888 = (uint8_t *)malloc(disp_cap);
+				if (!disp || !rgb888)
+				{
+					fprintf(stderr, "rc_recv: out of memory\n");
+					failed = true;
+					break;
+				}
+			}
+			// rgb888 doubles as the unpacked gray plane.
+			decode_raw(&f, disp, rgb888, &st);
+			if (save && f.hdr.format == RC_FRAME_RGB565)
+				rc_px_rgb565be_to_rgb888(rgb888, f.data, pixels);
+			else if (save && f.hdr.format == RC_FRAME_RGB332)
+				rc_px_rgb332_to_rgb888(rgb888, f.data, pixels);
+		}
+		if (save)
+		{
+			save_frame(&f, jpeg, (!jpeg && f.hdr.format == RC_FRAME_GRAY8) ? f.data : rgb888, rx.frames - 1);
+			st.saved++;
+		}
+	}
+	ws_close(&c);
+
+	const double secs = (double)(ws_now_us() - start) / 1e6;
+	printf("frames=%u (rgb565=%u gray8=%u gray4=%u gray2=%u rgb332=%u jpeg=%u) in %.1f s, %.1f fps, %.1f KiB/s, "
+		   "max_gap=%lld ms\n",
+		   (unsigned)rx.frames, (unsigned)st.frames[RC_FRAME_RGB565], (unsigned)st.frames[RC_FRAME_GRAY8],
+		   (unsigned)st.frames[RC_FRAME_GRAY4], (unsigned)st.frames[RC_FRAME_GRAY2],
+		   (unsigned)st.frames[RC_FRAME_RGB332], (unsigned)st.frames[JPEG_SLOT], secs, secs > 0 ? rx.frames / secs : 0.0,
+		   secs > 0 ? (double)st.bytes / 1024.0 / secs : 0.0, (long long)(st.max_gap_us / 1000));
+	printf("decode: %.1f us/frame, bad_headers=%u orphans=%u, chunk_drops=%u, saved=%u\n",
+		   st.decoded ? (double)st.decode_us / st.decoded : 0.0, (unsigned)rx.bad_headers, (unsigned)rx.orphans,
+		   (unsigned)chunks.dropped, (unsigned)st.saved);
+	if (opt.abbrev)
+		printf("abbrev: %u of %u JPEG frames rebuilt, %u table sets, %u missing tables, scan data %.1f%% of JPEG "
+			   "bytes\n",
+			   (unsigned)st.abbreviated, (unsigned)st.frames[JPEG_SLOT], (unsigned)st.tables,
+			   (unsigned)rx.missing_tables, st.jpeg_bytes ? 100.0 * (double)st.scan_bytes / (double)st.jpeg_bytes : 0.0);
+	free(chunks.buf);
+	free(jpeg_buf);
+	free(disp);
+	free(rgb888);
+
+	if (opt.expect)
+	{
+		if (rx.frames == 0 || st.mismatches || rx.bad_headers || rx.missing_tables)
+		{
+			printf("FAIL expect %s: %u mismatching of %u frames, %u bad headers\n", opt.expect,
+				   (unsigned)st.mismatches, (unsigned)rx.frames, (unsigned)rx.bad_headers);
+			failed = true;
+		}
+	}
+	return failed ? 1 : 0;
+}
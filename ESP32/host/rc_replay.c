@@ -0,0 +1,1017 @@
+// Replays a session capture (main/session.h, firmware built with RECORDER_SESSION) through the host
+// build of the firmware pipeline and reports what each stage cost and what was sent.
+//
+//   rc_replay run SESSION [--realtime | --speed X] [--stream jpeg|rgb565|gray8] [--scale N] [--vision]
+//                         [--viewers N] [--link-bps B] [--video-bps B] [--json]
+//   rc_replay synth SESSION [--frames N] [--fps N] [--width W] [--height H]
+//   rc_replay selftest
+//
+// Each sensor frame goes through what camera_stream_task does with it in the chosen stream mode
+// (luma/scale kernels, vision, RAWH framing, the egress scheduler); each control message through
+// ws_handle_binary (rc_proto parsing, sequencing, acks). Scheduling runs on the capture's own clock,
+// so counts, bytes and egress latencies are the same on every run and machine and can be diffed
+// between builds; only the stage timings are measured on the host. Without --realtime / --speed the
+// session is fed as fast as possible.
+//
+// Not in the host build: software JPEG (raw frames in jpeg mode go out as RAWH RGB565, like the
+// firmware's fallback when fmt2jpg fails) and the radio: writes complete instantly unless --link-bps
+// emulates a link of that speed. --viewers adds video subscribers that are always connected, for
+// sessions captured with nobody watching.
+//
+// synth writes a session with moving-line RGB565 frames and 20 Hz control traffic (two clients, a
+// duplicate and a malformed packet); selftest replays one and checks the results are deterministic.
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "egress.h"
+#include "img_scale.h"
+#include "rc_config.h"
+#include "rc_frame.h"
+#include "rc_proto.h"
+#include "recorder.h"
+#include "selftest.h"
+#include "session.h"
+#include "vision.h"
+#include "ws_lite.h"
+
+typedef enum
+{
+	STREAM_JPEG = 0,
+	STREAM_RGB565,
+	STREAM_GRAY8,
+} stream_mode_t;
+
+static const char *const STREAM_NAMES[] = {"jpeg", "rgb565", "gray8"};
+
+typedef struct
+{
+	double speed; // 0 = as fast as possible
+	int stream;   // stream_mode_t
+	int scale;
+	bool vision;
+	int viewers;
+	uint32_t link_bps; // 0 = writes complete instantly
+	uint32_t video_bps;
+	bool json;
+	// synth
+	uint32_t frames;
+	uint32_t fps;
+	int width;
+	int height;
+} options_t;
+
+static options_t opt = {
+	.speed = 0.0,
+	.stream = STREAM_JPEG,
+	.scale = CAM_STREAM_SCALE,
+	.vision = false,
+	.viewers = 0,
+	.link_bps = 0,
+	.video_bps = EGRESS_VIDEO_RATE_BPS,
+	.json = false,
+	.frames = 250,
+	.fps = 25,
+	.width = 320,
+	.height = 240,
+};
+
+static const uint32_t DEVICE_CAPS = RC_CAP_CONTROL_V2 | RC_CAP_CONTROL_ACK | RC_CAP_TELEMETRY_TEXT |
+									RC_CAP_CONTROL_ONLY | RC_CAP_VIDEO_CHUNKED;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	stop_requested = 1;
+}
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// --- replay ---
+
+enum
+{
+	ST_READ,    // session file -> memory (host only)
+	ST_VISION,  // luma conversion for vision (non-gray modes) + vision_analyze
+	ST_SCALE,   // stream kernels: luma extraction / downscale
+	ST_SEND,    // RAWH header + egress_video_submit
+	ST_FRAME,   // everything above for one frame
+	ST_CONTROL, // parse + sequencing + ack for one message
+	ST_COUNT
+};
+
+static const char *const STAGE_NAMES[ST_COUNT] = {"read", "vision", "scale", "send", "frame", "control"};
+
+typedef struct
+{
+	uint32_t *ns;
+	size_t n;
+	size_t cap;
+} samples_t;
+
+// Everything that doesn't depend on the host's speed. Two replays of one session with the same
+// options produce identical reports.
+typedef struct
+{
+	uint32_t entries;
+	uint32_t missing; // index entries overwritten or unreadable
+	uint32_t other;   // JPEG/RAWH entries of a normal recording
+	int64_t span_us;
+
+	uint32_t frames;
+	uint32_t frames_bad;
+	uint32_t by_pixfmt[SESSION_PIX_GRAY8 + 1];
+	uint64_t sensor_bytes;
+	int64_t sensor_lag_max_us; // sensor timestamp -> camera task
+
+	uint32_t sent;           // submitted to egress
+	uint32_t skipped;        // previous frame still being sent
+	uint32_t no_viewer;      // nobody subscribed to video
+	uint32_t not_streamable; // pixel format the stream mode can't send
+	uint32_t sw_jpeg;        // raw frames a jpeg-mode car would have encoded in software
+
+	uint32_t vision_frames;
+	uint32_t vision_lines;
+	int64_t vision_steer_sum;
+
+	uint32_t opens;
+	uint32_t ctrl_msgs;
+	uint32_t no_slot;
+	uint32_t hellos;
+	uint32_t applied;
+	uint32_t stale;
+	uint32_t malformed;
+} replay_report_t;
+
+typedef struct
+{
+	bool open;
+	bool viewer; // not CONTROL_ONLY
+	rc_proto_session_t sess;
+} replay_slot_t;
+
+typedef struct
+{
+	rec_store_t store;
+	rec_reader_t r;
+	egress_t eg;
+	uint8_t *eg_scratch;
+	replay_slot_t slots[EGRESS_MAX_CLIENTS];
+	uint32_t viewer_mask; // --viewers
+
+	int64_t sched_us;     // scheduler clock (capture time)
+	int64_t link_free_us; // --link-bps: when the current write is done
+
+	// Frames are read into frame[0] unless it may still be referenced by egress; then into frame[1],
+	// which is never submitted.
+	uint8_t *frame[2];
+	size_t frame_cap[2];
+	uint8_t *msg;
+	size_t msg_cap;
+	uint8_t *out; // scaled / converted stream frame
+	size_t out_cap;
+	uint8_t *gray; // vision luma, or stream output that won't be sent
+	size_t gray_cap;
+	uint8_t rawh[RC_FRAME_RAWH_LEN];
+
+	replay_report_t rep;
+	samples_t st[ST_COUNT];
+} replay_t;
+
+static bool reserve(uint8_t **buf, size_t *cap, size_t len)
+{
+	if (len <= *cap)
+		return true;
+	uint8_t *nb = (uint8_t *)realloc(*buf, len);
+	if (!nb)
+		return false;
+	*buf = nb;
+	*cap = len;
+	return true;
+}
+
+static void sample_add(replay_t *rp, int stage, int64_t t0_ns)
+{
+	samples_t *s = &rp->st[stage];
+	if (s->n == s->cap)
+	{
+		const size_t cap = s->cap ? s->cap * 2 : 1024;
+		uint32_t *nb = (uint32_t *)realloc(s->ns, cap * sizeof(uint32_t));
+		if (!nb)
+			return;
+		s->ns = nb;
+		s->cap = cap;
+	}
+	const int64_t d = now_ns() - t0_ns;
+	s->ns[s->n++] = (d > UINT32_MAX) ? UINT32_MAX : (uint32_t)d;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	const uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+// Percentile in us; sorts the samples.
+static double sample_pct(samples_t *s, double p)
+{
+	if (s->n == 0)
+		return 0.0;
+	qsort(s->ns, s->n, sizeof(uint32_t), cmp_u32);
+	size_t i = (size_t)(p * (double)(s->n - 1) + 0.5);
+	return (double)s->ns[i] / 1000.0;
+}
+
+static uint32_t video_mask(const replay_t *rp)
+{
+	uint32_t mask = rp->viewer_mask;
+	for (int i = 0; i < EGRESS_MAX_CLIENTS; i++)
+		if (rp->slots[i].open && rp->slots[i].viewer)
+			mask |= 1u << i;
+	return mask;
+}
+
+// The firmware's egress_task on the capture clock: writes everything the scheduler hands out up to
+// capture time `t`, each taking len / link_bps.
+static void drain_until(replay_t *rp, int64_t t)
+{
+	while (true)
+	{
+		const int64_t now = (rp->link_free_us > rp->sched_us) ? rp->link_free_us : rp->sched_us;
+		if (now > t)
+			return;
+		egress_tx_t tx;
+		int64_t wait_us = 0;
+		const egress_next_t next = egress_next(&rp->eg, now, &tx, &wait_us);
+		if (next == EGRESS_IDLE)
+		{
+			rp->sched_us = t;
+			return;
+		}
+		if (next == EGRESS_WAIT)
+		{
+			rp->sched_us = now + ((wait_us > 0) ? wait_us : 1);
+			if (rp->sched_us > t)
+			{
+				rp->sched_us = t;
+				return;
+			}
+			continue;
+		}
+		rp->sched_us = now;
+		rp->link_free_us = now + (opt.link_bps ? (int64_t)tx.len * 1000000 / opt.link_bps : 0);
+		(void)egress_done(&rp->eg, &tx, true, rp->link_free_us);
+	}
+}
+
+static void replay_control(replay_t *rp, const rec_entry_t *e, const uint8_t *data, size_t len)
+{
+	const int slot = session_control_slot(e->flags);
+	if (slot >= EGRESS_MAX_CLIENTS)
+	{
+		rp->rep.no_slot++;
+		return;
+	}
+	replay_slot_t *s = &rp->slots[slot];
+	const bool open = session_control_event(e->flags) == SESSION_CTRL_OPEN;
+	if (open || !s->open)
+	{
+		// A new client on the slot, or one already connected when the capture started.
+		(void)egress_client_close(&rp->eg, slot);
+		(void)egress_client_open(&rp->eg, slot, false);
+		memset(s, 0, sizeof(*s));
+		s->open = true;
+		s->viewer = true;
+		if (open)
+		{
+			rp->rep.opens++;
+			return;
+		}
+	}
+	rp->rep.ctrl_msgs++;
+
+	const int64_t t0 = now_ns();
+	rc_msg_t msg;
+	uint8_t reply[RC_PROTO_HELLO_ACK_LEN];
+	size_t reply_len = 0;
+	if (rc_proto_parse(data, len, &msg) != RC_PARSE_OK)
+	{
+		rp->rep.malformed++;
+	}
+	else if (msg.type == RC_MSG_HELLO)
+	{
+		rp->rep.hellos++;
+		s->sess.caps = msg.hello.caps & DEVICE_CAPS;
+		s->viewer = !(s->sess.caps & RC_CAP_CONTROL_ONLY);
+		egress_client_set_chunked(&rp->eg, slot, (s->sess.caps & RC_CAP_VIDEO_CHUNKED) != 0);
+		reply_len = rc_proto_write_hello_ack(reply, sizeof(reply), s->sess.caps);
+	}
+	else if (msg.type == RC_MSG_CONTROL)
+	{
+		const rc_control_t *ctrl = &msg.control;
+		const bool fresh = (ctrl->flags & RC_CTRL_FLAG_LEGACY) || rc_proto_session_accept(&s->sess, ctrl->seq, e->t_us);
+		fresh ? rp->rep.applied++ : rp->rep.stale++;
+		if (ctrl->flags & RC_CTRL_FLAG_ACK_REQ)
+			reply_len =
+				rc_proto_write_ack(reply, sizeof(reply), ctrl->seq, fresh ? RC_ACK_APPLIED : RC_ACK_STALE);
+	}
+	else
+	{
+		rp->rep.malformed++;
+	}
+	if (reply_len > 0)
+		(void)egress_push(&rp->eg, 1u << slot, EGRESS_CONTROL, EGRESS_WS_BINARY, reply, reply_len, e->t_us);
+	sample_add(rp, ST_CONTROL, t0);
+}
+
+static void replay_vision(replay_t *rp, const uint8_t *gray, int w, int h)
+{
+	static const vision_config_t cfg = VISION_CONFIG_DEFAULT;
+	vision_result_t res;
+	if (!vision_analyze(gray, w, h, &cfg, &res))
+		return;
+	rp->rep.vision_frames++;
+	if (res.line_found)
+	{
+		rp->rep.vision_lines++;
+		rp->rep.vision_steer_sum += vision_steer(&res, VISION_STEER_GAIN_PCT);
+	}
+}
+
+static void submit(replay_t *rp, uint32_t mask, uint8_t raw_format, int w, int h, const uint8_t *data, size_t len,
+				   int64_t t_us)
+{
+	const int64_t t0 = now_ns();
+	size_t hdr_len = 0;
+	if (raw_format != 0xFF)
+		hdr_len = rc_rawh_write(rp->rawh, sizeof(rp->rawh), raw_format, (uint16_t)w, (uint16_t)h, (uint32_t)len);
+	if (egress_video_submit(&rp->eg, mask, hdr_len ? rp->rawh : NULL, hdr_len, data, len, t_us))
+		rp->rep.sent++;
+	sample_add(rp, ST_SEND, t0);
+}
+
+// camera_stream_task for one frame, in the stream mode given by opt.stream.
+static void replay_frame(replay_t *rp, const rec_entry_t *e, const uint8_t *payload, size_t len)
+{
+	replay_report_t *rep = &rp->rep;
+	session_camera_t cam;
+	if (!session_camera_parse(payload, len, &cam))
+	{
+		rep->frames_bad++;
+		return;
+	}
+	const int64_t t_frame = now_ns();
+	const uint8_t *fb = payload + SESSION_CAMERA_HDR_LEN;
+	const size_t fb_len = len - SESSION_CAMERA_HDR_LEN;
+	rep->frames++;
+	rep->by_pixfmt[cam.pixformat]++;
+	rep->sensor_bytes += fb_len;
+	if (e->t_us - cam.sensor_us > rep->sensor_lag_max_us)
+		rep->sensor_lag_max_us = e->t_us - cam.sensor_us;
+
+	const uint32_t mask = video_mask(rp);
+	const bool send = mask != 0 && !egress_video_busy(&rp->eg);
+	const size_t bpp = session_pixfmt_bpp(cam.pixformat);
+	const int rows = bpp ? (int)((fb_len / (cam.width * bpp) < cam.height) ? fb_len / (cam.width * bpp) : cam.height)
+						 : cam.height;
+	const int scale = opt.scale;
+	bool streamable = true;
+
+	if (opt.stream == STREAM_GRAY8)
+	{
+		streamable = bpp != 0;
+		const int out_w = img_scale_dim(cam.width, scale);
+		const int out_h = img_scale_dim(rows, scale);
+		const size_t out_len = (size_t)out_w * out_h;
+		if (streamable && out_len > 0)
+		{
+			const uint8_t *gray = fb;
+			if (cam.pixformat != SESSION_PIX_GRAY8 || scale != 1)
+			{
+				uint8_t **dst = send ? &rp->out : &rp->gray;
+				if (!reserve(dst, send ? &rp->out_cap : &rp->gray_cap, out_len))
+					return;
+				const int64_t t0 = now_ns();
+				if (cam.pixformat == SESSION_PIX_GRAY8)
+					(void)img_scale_gray8(fb, cam.width, rows, scale, *dst);
+				else if (cam.pixformat == SESSION_PIX_YUV422)
+					(void)img_scale_yuv422_to_gray8(fb, cam.width, rows, scale, *dst);
+				else
+					(void)img_scale_rgb565_to_gray8(fb, cam.width, rows, scale, *dst);
+				sample_add(rp, ST_SCALE, t0);
+				gray = *dst;
+			}
+			if (opt.vision)
+			{
+				const int64_t t0 = now_ns();
+				replay_vision(rp, gray, out_w, out_h);
+				sample_add(rp, ST_VISION, t0);
+			}
+			if (send)
+				submit(rp, mask, RC_FRAME_GRAY8, out_w, out_h, gray, out_len, e->t_us);
+		}
+	}
+	else
+	{
+		if (opt.vision && cam.pixformat == SESSION_PIX_RGB565)
+		{
+			const int w = img_scale_dim(cam.width, VISION_RGB565_SCALE);
+			const int h = img_scale_dim(rows, VISION_RGB565_SCALE);
+			if ((size_t)w * h > 0 && reserve(&rp->gray, &rp->gray_cap, (size_t)w * h))
+			{
+				const int64_t t0 = now_ns();
+				(void)img_scale_rgb565_to_gray8(fb, cam.width, rows, VISION_RGB565_SCALE, rp->gray);
+				replay_vision(rp, rp->gray, w, h);
+				sample_add(rp, ST_VISION, t0);
+			}
+		}
+		if (cam.pixformat == SESSION_PIX_JPEG)
+		{
+			// Sensor JPEG goes out as captured in every non-gray mode.
+			if (send)
+				submit(rp, mask, 0xFF, 0, 0, fb, fb_len, e->t_us);
+		}
+		else if (cam.pixformat == SESSION_PIX_RGB565)
+		{
+			if (opt.stream == STREAM_JPEG)
+				rep->sw_jpeg++;
+			const int out_w = img_scale_dim(cam.width, scale);
+			const int out_h = img_scale_dim(rows, scale);
+			const size_t out_len = (size_t)out_w * out_h * 2;
+			if (send && out_len > 0)
+			{
+				const uint8_t *src = fb;
+				if (scale != 1)
+				{
+					if (!reserve(&rp->out, &rp->out_cap, out_len))
+						return;
+					const int64_t t0 = now_ns();
+					(void)img_scale_rgb565(fb, cam.width, rows, scale, rp->out);
+					sample_add(rp, ST_SCALE, t0);
+					src = rp->out;
+				}
+				submit(rp, mask, RC_FRAME_RGB565, out_w, out_h, src, out_len, e->t_us);
+			}
+		}
+		else
+		{
+			streamable = false;
+		}
+	}
+
+	if (!streamable)
+		rep->not_streamable++;
+	else if (mask == 0)
+		rep->no_viewer++;
+	else if (!send)
+		rep->skipped++;
+	sample_add(rp, ST_FRAME, t_frame);
+}
+
+static void replay_free(replay_t *rp)
+{
+	free(rp->eg_scratch);
+	free(rp->frame[0]);
+	free(rp->frame[1]);
+	free(rp->msg);
+	free(rp->out);
+	free(rp->gray);
+	for (int i = 0; i < ST_COUNT; i++)
+		free(rp->st[i].ns);
+	rec_store_file_close(&rp->store);
+}
+
+// Replays `path` into `rp` (which the caller frees with replay_free). Returns 0 on success.
+static int replay_run(const char *path, replay_t *rp, double *wall_s)
+{
+	memset(rp, 0, sizeof(*rp));
+	if (rec_store_file_open(&rp->store, path, 0, false) != 0)
+	{
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if (rec_reader_open(&rp->r, &rp->store) != 0)
+	{
+		fprintf(stderr, "%s: not a recording (bad header)\n", path);
+		return -1;
+	}
+	rec_entry_t first;
+	if (rec_reader_count(&rp->r) == 0 || !rec_reader_entry(&rp->r, rp->r.first_seq, &first))
+	{
+		fprintf(stderr, "%s: empty session\n", path);
+		return -1;
+	}
+
+	egress_config_t cfg = {
+		.budget =
+			{
+				[EGRESS_CONTROL] = {EGRESS_CONTROL_RATE_BPS, EGRESS_CONTROL_BURST},
+				[EGRESS_TELEMETRY] = {EGRESS_TELEMETRY_RATE_BPS, EGRESS_TELEMETRY_BURST},
+				[EGRESS_VIDEO] = {opt.video_bps, EGRESS_VIDEO_BURST},
+			},
+		.fragment_bytes = EGRESS_FRAGMENT_BYTES,
+		.queue_depth = EGRESS_QUEUE_MAX,
+	};
+	rp->eg_scratch = (uint8_t *)malloc(cfg.fragment_bytes + RC_FRAME_CHUNK_HDR_LEN);
+	if (!rp->eg_scratch)
+		return -1;
+	egress_init(&rp->eg, &cfg, rp->eg_scratch, first.t_us);
+	for (int i = 0; i < opt.viewers && i < EGRESS_MAX_CLIENTS; i++)
+	{
+		const int slot = EGRESS_MAX_CLIENTS - 1 - i;
+		(void)egress_client_open(&rp->eg, slot, false);
+		rp->viewer_mask |= 1u << slot;
+	}
+	rp->sched_us = first.t_us;
+	rp->link_free_us = first.t_us;
+
+	const int64_t wall0 = ws_now_us();
+	int64_t last_t = first.t_us;
+	for (uint32_t seq = rp->r.first_seq; seq != rp->r.hdr.next_seq && !stop_requested; seq++)
+	{
+		rec_entry_t e;
+		if (!rec_reader_entry(&rp->r, seq, &e))
+		{
+			rp->rep.missing++;
+			continue;
+		}
+		if (opt.speed > 0)
+			ws_sleep_us(wall0 + (int64_t)((double)(e.t_us - first.t_us) / opt.speed) - ws_now_us());
+		drain_until(rp, e.t_us);
+		last_t = e.t_us;
+		rp->rep.entries++;
+
+		const uint32_t kind = e.flags & 0xFF;
+		if (kind != REC_FMT_CAMERA && kind != REC_FMT_CONTROL)
+		{
+			rp->rep.other++;
+			continue;
+		}
+		const int b = egress_video_busy(&rp->eg) ? 1 : 0;
+		uint8_t **buf = (kind == REC_FMT_CAMERA) ? &rp->frame[b] : &rp->msg;
+		size_t *cap = (kind == REC_FMT_CAMERA) ? &rp->frame_cap[b] : &rp->msg_cap;
+		if (!reserve(buf, cap, e.len))
+			return -1;
+		const int64_t t0 = now_ns();
+		const int len = rec_reader_read(&rp->r, seq, *buf, *cap, &e);
+		if (len < 0)
+		{
+			rp->rep.missing++;
+			continue;
+		}
+		sample_add(rp, ST_READ, t0);
+		if (kind == REC_FMT_CAMERA)
+			replay_frame(rp, &e, *buf, (size_t)len);
+		else
+			replay_control(rp, &e, *buf, (size_t)len);
+	}
+	// Let queued writes finish (bounded, in case a budget never lets them out).
+	drain_until(rp, last_t + 60 * 1000000LL);
+	rp->rep.span_us = last_t - first.t_us;
+	*wall_s = (double)(ws_now_us() - wall0) / 1e6;
+	return 0;
+}
+
+static void print_report(replay_t *rp, const char *path, double wall_s)
+{
+	const replay_report_t *r = &rp->rep;
+	const double span_s = (double)r->span_us / 1e6;
+	printf("session    %s: %" PRIu32 " entries over %.1f s (%" PRIu32 " unreadable, %" PRIu32 " not session)\n",
+		   path, r->entries, span_s, r->missing, r->other);
+	printf("frames     %" PRIu32 " (", r->frames);
+	for (int f = 0; f <= SESSION_PIX_GRAY8; f++)
+		printf("%s%s %" PRIu32, f ? ", " : "", session_pixfmt_name((uint8_t)f), r->by_pixfmt[f]);
+	printf("), %" PRIu32 " bad, %.1f MB sensor data, %.1f fps, sensor->task lag max %.1f ms\n", r->frames_bad,
+		   (double)r->sensor_bytes / 1e6, span_s > 0 ? (double)(r->frames - 1) / span_s : 0.0,
+		   (double)r->sensor_lag_max_us / 1000.0);
+	printf("control    %" PRIu32 " opens, %" PRIu32 " msgs: %" PRIu32 " hello, %" PRIu32 " applied, %" PRIu32
+		   " stale, %" PRIu32 " malformed, %" PRIu32 " without a slot\n",
+		   r->opens, r->ctrl_msgs, r->hellos, r->applied, r->stale, r->malformed, r->no_slot);
+	printf("stream     %s x%d: %" PRIu32 " sent, %" PRIu32 " skipped (link busy), %" PRIu32 " no viewer, %" PRIu32
+		   " not streamable",
+		   STREAM_NAMES[opt.stream], opt.scale, r->sent, r->skipped, r->no_viewer, r->not_streamable);
+	if (r->sw_jpeg)
+		printf(", %" PRIu32 " sent as RGB565 instead of software JPEG", r->sw_jpeg);
+	printf("\n");
+	if (opt.vision)
+		printf("vision     %" PRIu32 " frames, line found in %" PRIu32 ", steer sum %" PRId64 "\n", r->vision_frames,
+			   r->vision_lines, r->vision_steer_sum);
+	for (int c = 0; c < EGRESS_CLASS_COUNT; c++)
+	{
+		const egress_class_stats_t *s = &rp->eg.stats[c];
+		printf("egress     %-9s %8" PRIu64 " msgs %12" PRIu64 " B  dropped %-5" PRIu32 " lat avg %.1f max %.1f ms\n",
+			   egress_class_name((egress_class_t)c), s->msgs, s->bytes, s->dropped, (double)s->lat_avg_us / 1000.0,
+			   (double)s->lat_max_us / 1000.0);
+	}
+	printf("%-10s %8s %9s %9s %9s   (us, host)\n", "stage", "n", "p50", "p99", "max");
+	for (int i = 0; i < ST_COUNT; i++)
+	{
+		samples_t *s = &rp->st[i];
+		if (s->n == 0)
+			continue;
+		printf("%-10s %8zu %9.1f %9.1f %9.1f\n", STAGE_NAMES[i], s->n, sample_pct(s, 0.50), sample_pct(s, 0.99),
+			   sample_pct(s, 1.0));
+	}
+	printf("replay     %.2f s wall, %.1fx real time\n", wall_s, wall_s > 0 ? span_s / wall_s : 0.0);
+}
+
+static void print_json(replay_t *rp, double wall_s)
+{
+	const replay_report_t *r = &rp->rep;
+	char eg[1024];
+	if (egress_json(eg, sizeof(eg), &rp->eg) == 0)
+		snprintf(eg, sizeof(eg), "null");
+	printf("{\"entries\":%" PRIu32 ",\"missing\":%" PRIu32 ",\"span_ms\":%.1f,\"frames\":%" PRIu32
+		   ",\"frames_bad\":%" PRIu32 ",\"sensor_bytes\":%" PRIu64 ",\"stream\":\"%s\",\"scale\":%d,\"sent\":%" PRIu32
+		   ",\"skipped\":%" PRIu32 ",\"no_viewer\":%" PRIu32 ",\"not_streamable\":%" PRIu32 ",\"sw_jpeg\":%" PRIu32
+		   ",\"vision\":{\"frames\":%" PRIu32 ",\"lines\":%" PRIu32 ",\"steer_sum\":%" PRId64 "}"
+		   ",\"control\":{\"opens\":%" PRIu32 ",\"msgs\":%" PRIu32 ",\"hello\":%" PRIu32 ",\"applied\":%" PRIu32
+		   ",\"stale\":%" PRIu32 ",\"malformed\":%" PRIu32 "},\"egress\":%s,\"timing_us\":{",
+		   r->entries, r->missing, (double)r->span_us / 1000.0, r->frames, r->frames_bad, r->sensor_bytes,
+		   STREAM_NAMES[opt.stream], opt.scale, r->sent, r->skipped, r->no_viewer, r->not_streamable, r->sw_jpeg,
+		   r->vision_frames, r->vision_lines, r->vision_steer_sum, r->opens, r->ctrl_msgs, r->hellos, r->applied,
+		   r->stale, r->malformed, eg);
+	bool first = true;
+	for (int i = 0; i < ST_COUNT; i++)
+	{
+		samples_t *s = &rp->st[i];
+		if (s->n == 0)
+			continue;
+		printf("%s\"%s\":{\"n\":%zu,\"p50\":%.1f,\"p99\":%.1f,\"max\":%.1f}", first ? "" : ",", STAGE_NAMES[i], s->n,
+			   sample_pct(s, 0.50), sample_pct(s, 0.99), sample_pct(s, 1.0));
+		first = false;
+	}
+	printf("},\"wall_s\":%.3f}\n", wall_s);
+}
+
+static int cmd_run(const char *path)
+{
+	static replay_t rp;
+	double wall_s = 0.0;
+	const int rc = replay_run(path, &rp, &wall_s);
+	if (rc == 0)
+	{
+		if (opt.json)
+			print_json(&rp, wall_s);
+		else
+			print_report(&rp, path, wall_s);
+	}
+	replay_free(&rp);
+	return rc == 0 ? 0 : 1;
+}
+
+// --- synth ---
+
+typedef struct
+{
+	uint32_t frames;
+	uint32_t opens;
+	uint32_t hellos;
+	uint32_t controls; // CONTROL messages, including the duplicate
+	uint32_t acks;     // ACK_REQ among them
+	uint32_t stale;
+	uint32_t malformed;
+} synth_counts_t;
+
+// RGB565 (big-endian, like the sensor): light floor, dark vertical tape that drifts sideways.
+static void synth_frame(uint8_t *buf, int w, int h, uint32_t k)
+{
+	const int line_x = w / 4 + (int)(k * 3 % (uint32_t)(w / 2));
+	for (int y = 0; y < h; y++)
+	{
+		for (int x = 0; x < w; x++)
+		{
+			const bool tape = x >= line_x && x < line_x + w / 32 + 2;
+			const uint8_t v = tape ? (uint8_t)(20 + (x ^ y) % 16) : (uint8_t)(200 + (x + y + (int)k) % 40);
+			const uint16_t pix = (uint16_t)(((v >> 3) << 11) | ((v >> 2) << 5) | (v >> 3));
+			buf[2 * (y * w + x)] = (uint8_t)(pix >> 8);
+			buf[2 * (y * w + x) + 1] = (uint8_t)pix;
+		}
+	}
+}
+
+static bool synth_push(rec_writer_t *w, const uint8_t *head, size_t head_len, const uint8_t *data, size_t len,
+					   int64_t t_us, uint32_t flags)
+{
+	if (!rec_writer_push2(w, head, (uint32_t)head_len, data, (uint32_t)len, t_us, flags))
+		return false;
+	return rec_writer_drain(w, false) >= 0;
+}
+
+// Frames at opt.fps; slot 0 opens, says HELLO and drives at 20 Hz (every 10th control asks for an
+// ack, one is sent twice, one garbage message); slot 1 joins halfway as a control-only client.
+static int synth_write(const char *path, synth_counts_t *n)
+{
+	memset(n, 0, sizeof(*n));
+	const int w = opt.width, h = opt.height;
+	const size_t frame_len = (size_t)w * h * 2;
+	uint32_t staging_size = 64 * 1024;
+	while (staging_size < 2 * (frame_len + SESSION_CAMERA_HDR_LEN + REC_FRAME_HDR_SIZE + 4))
+		staging_size *= 2;
+	const int64_t period = 1000000 / (opt.fps ? opt.fps : 1);
+	const uint32_t ctrl_count = (uint32_t)((int64_t)opt.frames * period / 50000) + 1;
+	const uint32_t entries = opt.frames + ctrl_count + 8;
+	const uint64_t size = (uint64_t)opt.frames * (frame_len + 64) + (uint64_t)ctrl_count * 64 +
+						  (uint64_t)entries * REC_INDEX_ENTRY_SIZE + 4ull * staging_size + (1u << 20);
+
+	(void)unlink(path); // a new session, not appended to an old one
+	rec_store_t st;
+	if (rec_store_file_open(&st, path, size, true) != 0)
+	{
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	uint8_t *staging = (uint8_t *)malloc(staging_size);
+	uint8_t *frame = (uint8_t *)malloc(frame_len);
+	rec_writer_t wr;
+	if (!staging || !frame || rec_writer_init(&wr, &st, staging, staging_size, entries, (uint32_t)ws_now_us()) != 0)
+	{
+		fprintf(stderr, "%s: can't set up the writer\n", path);
+		free(staging);
+		free(frame);
+		rec_store_file_close(&st);
+		return -1;
+	}
+
+	bool ok = true;
+	const int64_t t0 = 10 * 1000000LL; // esp_timer-like: ten seconds after boot
+	const uint8_t fd0[4] = {54, 0, 0, 0}, fd1[4] = {55, 0, 0, 0};
+	uint8_t msg[32];
+	ok = ok && synth_push(&wr, NULL, 0, fd0, sizeof(fd0), t0 - 2000, session_control_flags(0, SESSION_CTRL_OPEN));
+	ok = ok && synth_push(&wr, NULL, 0, msg,
+						  rc_proto_write_hello(msg, sizeof(msg),
+											   RC_CAP_CONTROL_V2 | RC_CAP_CONTROL_ACK | RC_CAP_VIDEO_CHUNKED),
+						  t0 - 1000, session_control_flags(0, SESSION_CTRL_MSG));
+	n->opens++;
+	n->hellos++;
+
+	uint32_t k = 0, j = 0;
+	uint16_t seq = 0;
+	while (ok && k < opt.frames)
+	{
+		const int64_t t_frame = t0 + (int64_t)k * period;
+		const int64_t t_ctrl = t0 + 3000 + (int64_t)j * 50000;
+		if (j < ctrl_count && t_ctrl < t_frame)
+		{
+			if (j == ctrl_count / 2)
+			{
+				ok = ok && synth_push(&wr, NULL, 0, fd1, sizeof(fd1), t_ctrl - 500,
+									  session_control_flags(1, SESSION_CTRL_OPEN));
+				ok = ok && synth_push(&wr, NULL, 0, msg,
+									  rc_proto_write_hello(msg, sizeof(msg), RC_CAP_CONTROL_V2 | RC_CAP_CONTROL_ONLY),
+									  t_ctrl - 400, session_control_flags(1, SESSION_CTRL_MSG));
+				n->opens++;
+				n->hellos++;
+			}
+			size_t len;
+			if (j == 13)
+			{
+				static const uint8_t garbage[3] = {0xDE, 0xAD, 0x01};
+				memcpy(msg, garbage, sizeof(garbage));
+				len = sizeof(garbage);
+				n->malformed++;
+			}
+			else
+			{
+				if (j != 7)
+					seq++; // j == 7 repeats the previous sequence number
+				else
+					n->stale++;
+				rc_control_t ctrl = {.seq = seq,
+									 .flags = (seq % 10 == 0) ? RC_CTRL_FLAG_ACK_REQ : 0,
+									 .throttle = (int16_t)(8000 + (int)(j % 50) * 100),
+									 .steer = (int16_t)((int)(j % 40) * 500 - 10000)};
+				if (ctrl.flags & RC_CTRL_FLAG_ACK_REQ)
+					n->acks++;
+				len = rc_proto_write_control(msg, sizeof(msg), &ctrl);
+				n->controls++;
+			}
+			ok = synth_push(&wr, NULL, 0, msg, len, t_ctrl, session_control_flags(0, SESSION_CTRL_MSG));
+			j++;
+			continue;
+		}
+
+		synth_frame(frame, w, h, k);
+		uint8_t hdr[SESSION_CAMERA_HDR_LEN];
+		const session_camera_t cam = {.pixformat = SESSION_PIX_RGB565,
+									  .width = (uint16_t)w,
+									  .height = (uint16_t)h,
+									  .sensor_us = t_frame - 4000 - (int64_t)(k % 5) * 1000};
+		ok = synth_push(&wr, hdr, session_camera_write(hdr, sizeof(hdr), &cam), frame, frame_len, t_frame,
+						REC_FMT_CAMERA);
+		n->frames++;
+		k++;
+	}
+	ok = ok && rec_writer_drain(&wr, true) >= 0 && rec_writer_stats(&wr).dropped == 0;
+	rec_writer_deinit(&wr);
+	rec_store_file_close(&st);
+	free(staging);
+	free(frame);
+	if (!ok)
+		fprintf(stderr, "%s: write failed\n", path);
+	return ok ? 0 : -1;
+}
+
+static int cmd_synth(const char *path)
+{
+	synth_counts_t n;
+	if (opt.width < 32 || opt.height < 8 || opt.frames == 0 || synth_write(path, &n) != 0)
+		return 1;
+	printf("%s: %" PRIu32 " frames %dx%d rgb565 at %" PRIu32 " fps, %" PRIu32 " control messages\n", path, n.frames,
+		   opt.width, opt.height, opt.fps, n.hellos + n.controls + n.malformed);
+	return 0;
+}
+
+// --- selftest ---
+
+// A slot reopened while the old client's close waits for its tx (a browser reload mid-frame): the
+// frame is released once, by the reopen; the old tx's egress_done() reports nothing.
+static void selftest_egress_reopen(void)
+{
+	static uint8_t scratch[EGRESS_FRAGMENT_BYTES + RC_FRAME_CHUNK_HDR_LEN];
+	static uint8_t frame[3 * EGRESS_FRAGMENT_BYTES];
+	static egress_t eg;
+	const egress_config_t cfg = {
+		.fragment_bytes = EGRESS_FRAGMENT_BYTES,
+		.queue_depth = EGRESS_QUEUE_MAX,
+	};
+	egress_init(&eg, &cfg, scratch, 0);
+	(void)egress_client_open(&eg, 0, false);
+	expect(egress_video_submit(&eg, 1u, NULL, 0, frame, sizeof(frame), 0), "reopen: submit");
+	egress_tx_t tx;
+	expect(egress_next(&eg, 0, &tx, NULL) == EGRESS_SEND && tx.slot == 0 && tx.cls == EGRESS_VIDEO,
+		   "reopen: frame in flight");
+	int released = 0;
+	const bool on_close = egress_client_close(&eg, 0);
+	released += on_close;
+	expect(!on_close && egress_video_busy(&eg), "reopen: close waits for the tx");
+	released += egress_client_open(&eg, 0, false);
+	released += egress_done(&eg, &tx, true, 1000);
+	expect(released == 1 && !egress_video_busy(&eg), "reopen: frame released exactly once");
+	expect(egress_video_submit(&eg, 1u, NULL, 0, frame, sizeof(frame), 2000), "reopen: next frame goes out");
+}
+
+static int cmd_selftest(void)
+{
+	char path[] = "/tmp/rc_replay_XXXXXX";
+	const int fd = mkstemp(path);
+	if (fd < 0)
+	{
+		perror("mkstemp");
+		return 1;
+	}
+	close(fd);
+
+	opt.width = 160;
+	opt.height = 120;
+	opt.frames = 60;
+	opt.fps = 25;
+	synth_counts_t n;
+	expect(synth_write(path, &n) == 0, "synth");
+
+	static replay_t a, b;
+	double wall_s = 0.0;
+
+	// GRAY8 x1 with vision, one extra viewer, instant link: every frame goes out.
+	opt.stream = STREAM_GRAY8;
+	opt.scale = 1;
+	opt.vision = true;
+	opt.viewers = 1;
+	expect(replay_run(path, &a, &wall_s) == 0, "replay");
+	const replay_report_t *r = &a.rep;
+	expect(r->frames == n.frames && r->frames_bad == 0 && r->missing == 0, "every frame replayed");
+	expect(r->entries == n.frames + n.opens + n.hellos + n.controls + n.malformed, "entry count");
+	expect(r->opens == n.opens && r->hellos == n.hellos, "opens and hellos");
+	expect(r->applied == n.controls - n.stale && r->stale == n.stale, "sequencing");
+	expect(r->malformed == n.malformed, "malformed");
+	expect(r->sent == n.frames && r->skipped == 0, "all frames sent");
+	expect(r->vision_frames == n.frames && r->vision_lines == n.frames, "vision finds the tape");
+	expect(a.eg.stats[EGRESS_CONTROL].msgs == n.hellos + n.acks, "hello acks and acks");
+	// Two viewers (slot 0 and the extra one); slot 1 is control-only. Slot 0 negotiated chunked video,
+	// which carries a few more header bytes than the plain RAWH frames of the extra viewer.
+	const uint64_t plain = (uint64_t)n.frames * (RC_FRAME_RAWH_LEN + 160 * 120);
+	expect(a.eg.stats[EGRESS_VIDEO].bytes > 2 * plain && a.eg.stats[EGRESS_VIDEO].bytes < 2 * plain + plain / 10,
+		   "video bytes");
+	expect(a.st[ST_FRAME].n == n.frames && a.st[ST_CONTROL].n == n.hellos + n.controls + n.malformed, "timing samples");
+	char json_a[1024], json_b[1024];
+	egress_json(json_a, sizeof(json_a), &a.eg);
+
+	// Same session, same options: identical results.
+	expect(replay_run(path, &b, &wall_s) == 0, "second replay");
+	egress_json(json_b, sizeof(json_b), &b.eg);
+	expect(memcmp(&a.rep, &b.rep, sizeof(a.rep)) == 0 && strcmp(json_a, json_b) == 0, "deterministic");
+	replay_free(&a);
+	replay_free(&b);
+
+	// A link slower than the stream: frames are skipped, acks still get through.
+	opt.link_bps = 300000;
+	expect(replay_run(path, &a, &wall_s) == 0, "slow link replay");
+	expect(a.rep.skipped > 0 && a.rep.sent + a.rep.skipped == n.frames, "slow link skips frames");
+	expect(a.eg.stats[EGRESS_CONTROL].msgs == n.hellos + n.acks, "acks on a slow link");
+	expect(a.eg.stats[EGRESS_CONTROL].lat_max_us < 50000, "acks ahead of video");
+	replay_free(&a);
+	opt.link_bps = 0;
+
+	// JPEG mode: raw frames fall back to RAWH RGB565, downscaled.
+	opt.stream = STREAM_JPEG;
+	opt.scale = 2;
+	opt.viewers = 0;
+	expect(replay_run(path, &a, &wall_s) == 0, "jpeg replay");
+	expect(a.rep.sw_jpeg == n.frames && a.rep.sent == n.frames, "jpeg mode fallback");
+	expect(a.rep.vision_frames == n.frames, "vision on RGB565 frames");
+	replay_free(&a);
+
+	// Real-time pacing at 4x: takes about a quarter of the session span.
+	opt.speed = 4.0;
+	expect(replay_run(path, &a, &wall_s) == 0, "paced replay");
+	const double want_s = (double)a.rep.span_us / 1e6 / opt.speed;
+	expect(wall_s > want_s * 0.95 && wall_s < want_s + 0.5, "pacing");
+	replay_free(&a);
+
+	unlink(path);
+	selftest_egress_reopen();
+	return selftest_done();
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+			"usage: %s run SESSION [--realtime | --speed X] [--stream jpeg|rgb565|gray8] [--scale N] [--vision]\n"
+			"                      [--viewers N] [--link-bps B] [--video-bps B] [--json]\n"
+			"       %s synth SESSION [--frames N] [--fps N] [--width W] [--height H]\n"
+			"       %s selftest\n",
+			argv0, argv0, argv0);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option longopts[] = {
+		{"realtime", no_argument, NULL, 'r'},       {"speed", required_argument, NULL, 'x'},
+		{"stream", required_argument, NULL, 's'},   {"scale", required_argument, NULL, 'k'},
+		{"vision", no_argument, NULL, 'v'},         {"viewers", required_argument, NULL, 'n'},
+		{"link-bps", required_argument, NULL, 'l'}, {"video-bps", required_argument, NULL, 'b'},
+		{"json", no_argument, NULL, 'j'},           {"frames", required_argument, NULL, 'f'},
+		{"fps", required_argument, NULL, 'F'},      {"width", required_argument, NULL, 'W'},
+		{"height", required_argument, NULL, 'H'},   {"help", no_argument, NULL, '?'},
+		{NULL, 0, NULL, 0},
+	};
+	int ch;
+	while ((ch = getopt_long(argc, argv, "", longopts, NULL)) != -1)
+	{
+		switch (ch)
+		{
+		case 'r': opt.speed = 1.0; break;
+		case 'x': opt.speed = atof(optarg); break;
+		case 's':
+			opt.stream = -1;
+			for (int i = 0; i < (int)(sizeof(STREAM_NAMES) / sizeof(STREAM_NAMES[0])); i++)
+				if (strcmp(optarg, STREAM_NAMES[i]) == 0)
+					opt.stream = i;
+			break;
+		case 'k': opt.scale = atoi(optarg); break;
+		case 'v': opt.vision = true; break;
+		case 'n': opt.viewers = atoi(optarg); break;
+		case 'l': opt.link_bps = (uint32_t)strtoul(optarg, NULL, 10); break;
+		case 'b': opt.video_bps = (uint32_t)strtoul(optarg, NULL, 10); break;
+		case 'j': opt.json = true; break;
+		case 'f': opt.frames = (uint32_t)strtoul(optarg, NULL, 10); break;
+		case 'F': opt.fps = (uint32_t)strtoul(optarg, NULL, 10); break;
+		case 'W': opt.width = atoi(optarg); break;
+		case 'H': opt.height = atoi(optarg); break;
+		default: usage(argv[0]); return 2;
+		}
+	}
+
+	const int nargs = argc - optind;
+	if (nargs == 1 && strcmp(argv[optind], "selftest") == 0)
+		return cmd_selftest();
+	if (nargs != 2 || opt.stream < 0 || !img_scale_factor_valid(opt.scale) || opt.speed < 0 || opt.viewers < 0)
+	{
+		usage(argv[0]);
+		return 2;
+	}
+	struct sigaction sa = {.sa_handler = on_signal};
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	if (strcmp(argv[optind], "run") == 0)
+		return cmd_run(argv[optind + 1]);
+	if (strcmp(argv[optind], "synth") == 0)
+		return cmd_synth(argv[optind + 1]);
+	usage(argv[0]);
+	return 2;
+}
@@ -0,0 +1,282 @@
+// top for the car: polls GET /api/tasks (main/task_prof.c) and prints per-core load and per-task
+// CPU and stack headroom.
+//
+//   rc_top --host H [--port P] [--interval S] [--count N]
+//   rc_top selftest
+//
+// selftest feeds the profiler synthetic snapshots of a two-core system (known loads, a counter that
+// wraps, tasks that end and start, a task table overflow) and checks what it reports.
+
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rc_config.h"
+#include "selftest.h"
+#include "task_prof.h"
+#include "ws_lite.h"
+
+typedef struct
+{
+	const char *host;
+	uint16_t port;
+	int interval_s;
+	int count;
+} options_t;
+
+static options_t opt = {
+	.host = NULL,
+	.port = 8888,
+	.interval_s = 2,
+	.count = 0,
+};
+
+static volatile int stop_requested = 0;
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	stop_requested = 1;
+}
+
+static double json_num(const char *obj, const char *key)
+{
+	char pat[32];
+	snprintf(pat, sizeof(pat), "\"%s\":", key);
+	const char *p = strstr(obj, pat);
+	return p ? strtod(p + strlen(pat), NULL) : -1.0;
+}
+
+static void json_str(const char *obj, const char *key, char *out, size_t cap)
+{
+	char pat[32];
+	snprintf(pat, sizeof(pat), "\"%s\":\"", key);
+	const char *p = strstr(obj, pat);
+	size_t n = 0;
+	if (p)
+	{
+		p += strlen(pat);
+		while (p[n] && p[n] != '"' && n + 1 < cap)
+		{
+			out[n] = p[n];
+			n++;
+		}
+	}
+	out[n] = '\0';
+}
+
+// Prints one /api/tasks document. Returns the number of tasks listed.
+static int print_report(const char *json)
+{
+	printf("period %.0f ms, window %.0f ms", json_num(json, "period_ms"), json_num(json, "window_ms"));
+	const char *cores = strstr(json, "\"cores\":[");
+	const char *tasks = strstr(json, "\"tasks\":[");
+	for (const char *c = cores ? strstr(cores, "{\"core\":") : NULL; c && (!tasks || c < tasks);
+		 c = strstr(c + 1, "{\"core\":"))
+		printf(" | core %.0f %5.1f%% (window %5.1f%%)", json_num(c, "core"), json_num(c, "load"),
+			   json_num(c, "load_window"));
+	if (json_num(json, "overflow") > 0)
+		printf(" | %.0f tasks not tracked", json_num(json, "overflow"));
+	printf("\n%-16s %4s %4s %7s %7s %10s\n", "task", "core", "prio", "cpu%", "win%", "stack_free");
+
+	int n = 0;
+	for (const char *t = tasks ? strstr(tasks, "{\"name\":") : NULL; t; t = strstr(t + 1, "{\"name\":"))
+	{
+		char name[TASK_PROF_NAME_LEN + 1];
+		json_str(t, "name", name, sizeof(name));
+		const double core = json_num(t, "core");
+		const double stack = json_num(t, "stack_free");
+		char core_str[8];
+		if (core < 0)
+			snprintf(core_str, sizeof(core_str), "-");
+		else
+			snprintf(core_str, sizeof(core_str), "%.0f", core);
+		printf("%-16s %4s %4.0f %7.1f %7.1f %10.0f%s\n", name, core_str, json_num(t, "prio"), json_num(t, "cpu"),
+			   json_num(t, "cpu_window"), stack, (stack < TASK_PROF_STACK_WARN_BYTES) ? "  <- low" : "");
+		n++;
+	}
+	return n;
+}
+
+static int cmd_watch(void)
+{
+	char *body = (char *)malloc(16384);
+	if (!body)
+		return 1;
+	for (int i = 0; !stop_requested && (opt.count == 0 || i < opt.count); i++)
+	{
+		if (i > 0)
+			ws_sleep_us((int64_t)opt.interval_s * 1000000);
+		const int status = ws_http_get(opt.host, opt.port, "/api/tasks", body, 16384, 3000);
+		if (status != 200)
+		{
+			printf("GET /api/tasks: %s %s\n", (status < 0) ? "connection failed" : "HTTP", body);
+			continue;
+		}
+		printf("\n");
+		print_report(body);
+		fflush(stdout);
+	}
+	free(body);
+	return 0;
+}
+
+// --- selftest ---
+
+static bool near(float v, float want)
+{
+	return v > want - 0.5f && v < want + 0.5f;
+}
+
+static float load_of(const task_prof_t *p, const char *name, bool window)
+{
+	task_prof_load_t loads[TASK_PROF_MAX_TASKS];
+	const size_t n = task_prof_loads(p, loads, TASK_PROF_MAX_TASKS);
+	for (size_t i = 0; i < n; i++)
+	{
+		if (strcmp(loads[i].task->name, name) == 0)
+			return window ? loads[i].cpu_window : loads[i].cpu;
+	}
+	return -2.0f;
+}
+
+static int cmd_selftest(void)
+{
+	enum
+	{
+		IDLE0,
+		IDLE1,
+		CAMERA,
+		HTTPD,
+		WIFI,
+		BURST,
+		SHORT,
+		TASKS
+	};
+	// name, core, idle, load % per period (BURST: 10% for 5 periods, then 60%)
+	task_prof_sample_t s[TASKS] = {
+		{1, "IDLE0", 0, 0, true, 0, 4000},       {2, "IDLE1", 1, 0, true, 0, 4000},
+		{3, "camera_task", 1, 5, false, 0, 2000}, {4, "httpd", TASK_PROF_NO_CORE, 5, false, 0, 1800},
+		{5, "wifi", 0, 23, false, 0, 2500},       {6, "burst", 0, 2, false, 0xFFFFF000u, 900},
+		{7, "short", 1, 1, false, 0, 300},
+	};
+	static task_prof_t prof;
+	task_prof_init(&prof, TASK_PROF_STACK_WARN_BYTES);
+	const int64_t period = 1000000;
+	int64_t now = 5000000;
+
+	// The first snapshot warns about "short" (300 bytes free); later ones don't repeat it.
+	expect(task_prof_add(&prof, now, s, TASKS) == 1, "one low-stack warning");
+	expect(task_prof_core_load(&prof, 0, false) < 0, "load before two snapshots");
+	for (int i = 1; i <= 15; i++)
+	{
+		now += period;
+		// core 1: camera 40%, short 5% until it ends after snapshot 8, httpd 10% (no affinity, on core 1 here)
+		s[CAMERA].runtime += 400000;
+		s[HTTPD].runtime += 100000;
+		s[SHORT].runtime += 50000;
+		s[IDLE1].runtime += (i <= 8) ? 450000 : 500000;
+		// core 0: wifi 20%, burst 10% then 60%
+		const uint32_t burst = (i <= 5) ? 100000 : 600000;
+		s[WIFI].runtime += 200000;
+		s[BURST].runtime += burst;
+		s[IDLE0].runtime += 1000000 - 200000 - burst;
+		const size_t count = (i <= 8) ? TASKS : TASKS - 1;
+		expect(task_prof_add(&prof, now, s, count) == 0, "repeated low-stack warning");
+		if (i == 3)
+		{
+			expect(near(load_of(&prof, "camera_task", false), 40.0f), "camera load");
+			expect(near(task_prof_core_load(&prof, 0, false), 30.0f), "core 0 load");
+			expect(near(task_prof_core_load(&prof, 1, false), 55.0f), "core 1 load");
+			expect(near(load_of(&prof, "burst", false), 10.0f), "load across a counter wrap");
+		}
+	}
+	expect(load_of(&prof, "short", false) == -2.0f, "ended task still listed");
+	expect(near(load_of(&prof, "burst", false), 60.0f), "burst load, last period");
+	expect(near(load_of(&prof, "burst", true), 60.0f), "burst load, window after the burst");
+	// Window: 3 periods at 55%, 7 at 50%.
+	expect(near(task_prof_core_load(&prof, 1, true), 51.5f), "core 1 window load");
+
+	// A task that appears mid-window is measured from its first snapshot (core 1: late takes 25%).
+	task_prof_sample_t all[TASKS];
+	memcpy(all, s, sizeof(s));
+	all[SHORT] = (task_prof_sample_t){8, "late", 1, 4, false, 777, 3000};
+	for (int i = 0; i < 2; i++)
+	{
+		now += period;
+		all[CAMERA].runtime += 400000;
+		all[HTTPD].runtime += 100000;
+		all[IDLE1].runtime += (i == 0) ? 500000 : 250000;
+		all[SHORT].runtime += (i == 0) ? 0 : 250000;
+		all[WIFI].runtime += 200000;
+		all[BURST].runtime += 600000;
+		all[IDLE0].runtime += 200000;
+		task_prof_add(&prof, now, all, TASKS);
+		if (i == 0)
+			expect(load_of(&prof, "late", true) < 0, "new task has no load yet");
+	}
+	expect(near(load_of(&prof, "late", true), 25.0f), "new task window load");
+
+	task_prof_load_t loads[TASK_PROF_MAX_TASKS];
+	const size_t n = task_prof_loads(&prof, loads, TASK_PROF_MAX_TASKS);
+	expect(n == TASKS && strcmp(loads[0].task->name, "burst") == 0, "busiest first");
+
+	static char json[8192];
+	expect(task_prof_json(json, sizeof(json), &prof) > 0, "json");
+	expect(print_report(json) == TASKS, "json lists every task");
+	expect(task_prof_json(json, 64, &prof) == 0, "short buffer");
+
+	// More tasks than the table holds.
+	task_prof_sample_t many[TASK_PROF_MAX_TASKS + 4];
+	for (size_t i = 0; i < TASK_PROF_MAX_TASKS + 4; i++)
+		many[i] = (task_prof_sample_t){100 + i, "many", 0, 1, false, 0, 1000};
+	task_prof_add(&prof, now + period, many, TASK_PROF_MAX_TASKS + 4);
+	expect(prof.overflow == 4, "overflow count");
+
+	return selftest_done();
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+			"usage: %s --host H [--port P] [--interval S] [--count N]\n"
+			"       %s selftest\n",
+			argv0, argv0);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option longopts[] = {
+		{"host", required_argument, NULL, 'h'},  {"port", required_argument, NULL, 'p'},
+		{"interval", required_argument, NULL, 'i'}, {"count", required_argument, NULL, 'c'},
+		{"help", no_argument, NULL, '?'},        {NULL, 0, NULL, 0},
+	};
+	int ch;
+	while ((ch = getopt_long(argc, argv, "", longopts, NULL)) != -1)
+	{
+		switch (ch)
+		{
+		case 'h': opt.host = optarg; break;
+		case 'p': opt.port = (uint16_t)atoi(optarg); break;
+		case 'i': opt.interval_s = atoi(optarg); break;
+		case 'c': opt.count = atoi(optarg); break;
+		default: usage(argv[0]); return 2;
+		}
+	}
+
+	const int nargs = argc - optind;
+	if (nargs == 1 && strcmp(argv[optind], "selftest") == 0)
+		return cmd_selftest();
+	if (nargs != 0 || !opt.host || opt.interval_s <= 0)
+	{
+		usage(argv[0]);
+		return 2;
+	}
+	struct sigaction sa = {.sa_handler = on_signal};
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	return cmd_watch();
+}
@@ -0,0 +1,525 @@
+// Linux harness for the STA link recovery (main/wifi_recovery.c): simulated Wi-Fi driver events on a
+// virtual clock, fed to the state machine the way wifi_event_handler / wifi_recovery_task do.
+//
+//   rc_wifisim run [--drop-at S] [--drop-ms MS] [--roam] [--silent-pct PCT] [--boot-fail]
+//                  [--duration S] [--seed N]
+//   rc_wifisim selftest
+//
+// The access point is on channel 1 and disappears at --drop-at for --drop-ms (with --roam it comes
+// back on channel 6, so pinned reconnects can't find it). The car notices a vanished AP after a
+// beacon loss timeout. A pinned connect takes 150 ms to fail or associate, a full scan 1.5 s, DHCP
+// another 300 ms; --silent-pct of the attempts never report back (the recovery's attempt timeout
+// handles those). --boot-fail starts with the AP gone, so the boot connect gives up.
+//
+// The report is the event timeline, how long the link was down (motors zeroed, video idle), and the
+// recovery stats as /api/link returns them. The selftest also covers the setup portal's credential
+// test (main/prov_test.c), driven the way prov_timer and wifi_recovery_task drive it.
+
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "prov_test.h"
+#include "rc_config.h"
+#include "selftest.h"
+#include "wifi_recovery.h"
+
+#define STEP_US 10000
+#define BEACON_LOSS_US 3000000
+#define PINNED_US 150000
+#define SCAN_US 1500000
+#define DHCP_US 300000
+#define REASON_BEACON_TIMEOUT 200
+#define REASON_NO_AP_FOUND 201
+
+typedef struct
+{
+	double drop_at_s;
+	int drop_ms;
+	bool roam;
+	int silent_pct;
+	bool boot_fail;
+	int duration_s;
+	uint32_t seed;
+} options_t;
+
+static options_t opt = {
+	.drop_at_s = 10.0,
+	.drop_ms = 2000,
+	.roam = false,
+	.silent_pct = 0,
+	.boot_fail = false,
+	.duration_s = 60,
+	.seed = 1,
+};
+
+static uint32_t rng_state;
+
+static uint32_t rng(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+static wifi_rec_config_t default_config(void)
+{
+	const wifi_rec_config_t cfg = {
+		.boot_attempts = WIFI_STA_MAX_RETRY + 1,
+		.fast_attempts = WIFI_FAST_RECONNECT_TRIES,
+		.attempt_timeout_us = WIFI_RECONNECT_TIMEOUT_MS * 1000u,
+		.backoff_min_us = WIFI_RECONNECT_BACKOFF_MIN_MS * 1000u,
+		.backoff_max_us = WIFI_RECONNECT_BACKOFF_MAX_MS * 1000u,
+		.softap_after_us = WIFI_FALLBACK_AP_AFTER_MS * 1000u,
+		.softap_retry_us = WIFI_FALLBACK_STA_RETRY_MS * 1000u,
+	};
+	return cfg;
+}
+
+static const uint8_t AP_BSSID[6] = {0x02, 0x11, 0x22, 0x33, 0x44, 0x55};
+
+typedef struct
+{
+	int64_t t;
+	wifi_rec_t rec;
+	bool verbose;
+	int ap_stations;     // stations on the fallback AP (blocks taking it down)
+	// driver
+	bool associated;
+	int64_t lost_at_us;  // AP vanished while associated
+	int64_t fail_at_us;  // pending attempt: disconnect event
+	int64_t assoc_at_us; // pending attempt: STA_CONNECTED
+	int64_t ip_at_us;    // pending attempt: GOT_IP
+	uint8_t assoc_channel;
+	// what the rest of the car saw
+	bool link_up;
+	uint32_t down_edges;
+	int64_t down_since_us;
+	int64_t down_total_us;
+	uint32_t softap_starts;
+	uint32_t softap_stops;
+	uint32_t boot_failed;
+} sim_t;
+
+static bool ap_present(int64_t t)
+{
+	if (opt.boot_fail)
+		return t >= (int64_t)(opt.drop_at_s * 1e6);
+	const int64_t from = (int64_t)(opt.drop_at_s * 1e6);
+	return t < from || t >= from + (int64_t)opt.drop_ms * 1000;
+}
+
+static uint8_t ap_channel(int64_t t)
+{
+	return (opt.roam && t >= (int64_t)(opt.drop_at_s * 1e6)) ? 6 : 1;
+}
+
+static void note(const sim_t *s, const char *what)
+{
+	if (s->verbose)
+		printf("%8.3f s  %-16s %s\n", s->t / 1e6, wifi_rec_state_name(s->rec.state), what);
+}
+
+static void clear_attempt(sim_t *s)
+{
+	s->fail_at_us = s->assoc_at_us = s->ip_at_us = -1;
+}
+
+// esp_wifi_connect(): schedules the events the driver would post.
+static void start_connect(sim_t *s, bool pinned)
+{
+	clear_attempt(s);
+	if ((int)(rng() % 100) < opt.silent_pct)
+		return;
+	const int64_t done = s->t + (pinned ? PINNED_US : SCAN_US);
+	const bool found = ap_present(done) && (!pinned || ap_channel(done) == s->rec.channel);
+	if (!found)
+	{
+		s->fail_at_us = done;
+		return;
+	}
+	s->assoc_at_us = done;
+	s->assoc_channel = ap_channel(done);
+	s->ip_at_us = done + DHCP_US;
+}
+
+static void link_edge(sim_t *s)
+{
+	if (s->rec.link_up == s->link_up)
+		return;
+	s->link_up = s->rec.link_up;
+	if (!s->link_up)
+	{
+		s->down_edges++;
+		s->down_since_us = s->t;
+		note(s, "link down: motors zeroed, video idle");
+	}
+	else
+	{
+		s->down_total_us += s->t - s->down_since_us;
+		note(s, "link up");
+	}
+}
+
+// Driver events due at s->t, as wifi_event_handler would see them.
+static void deliver_events(sim_t *s)
+{
+	if (s->associated && !ap_present(s->t) && s->lost_at_us < 0)
+		s->lost_at_us = s->t;
+	if (s->associated && s->lost_at_us >= 0 && s->t >= s->lost_at_us + BEACON_LOSS_US)
+	{
+		s->associated = false;
+		s->lost_at_us = -1;
+		wifi_rec_disconnected(&s->rec, REASON_BEACON_TIMEOUT, s->t);
+		note(s, "disconnected (beacon timeout)");
+	}
+	if (s->fail_at_us >= 0 && s->t >= s->fail_at_us)
+	{
+		s->fail_at_us = -1;
+		wifi_rec_disconnected(&s->rec, REASON_NO_AP_FOUND, s->t);
+		note(s, "connect failed (no AP found)");
+	}
+	if (s->assoc_at_us >= 0 && s->t >= s->assoc_at_us)
+	{
+		s->assoc_at_us = -1;
+		s->associated = true;
+		s->lost_at_us = -1;
+		wifi_rec_connected(&s->rec, s->assoc_channel, AP_BSSID);
+		note(s, "associated");
+	}
+	if (s->ip_at_us >= 0 && s->t >= s->ip_at_us)
+	{
+		s->ip_at_us = -1;
+		wifi_rec_got_ip(&s->rec, s->t);
+		note(s, "got IP");
+	}
+}
+
+// One wifi_recovery_task iteration: actions until there is nothing to do.
+static void run_actions(sim_t *s)
+{
+	for (;;)
+	{
+		link_edge(s);
+		const wifi_rec_action_t action = wifi_rec_poll(&s->rec, s->t, NULL);
+		link_edge(s);
+		switch (action)
+		{
+		case WIFI_REC_NONE:
+			return;
+		case WIFI_REC_CONNECT_FAST:
+			note(s, "connect (pinned channel/BSSID)");
+			start_connect(s, true);
+			break;
+		case WIFI_REC_CONNECT_SCAN:
+			note(s, "connect (full scan)");
+			start_connect(s, false);
+			break;
+		case WIFI_REC_START_SOFTAP:
+			clear_attempt(s); // the mode switch aborts it
+			s->softap_starts++;
+			note(s, "fallback AP up");
+			break;
+		case WIFI_REC_STOP_SOFTAP:
+			if (s->ap_stations == 0)
+			{
+				s->softap_stops++;
+				note(s, "fallback AP down");
+			}
+			wifi_rec_softap_stopped(&s->rec, s->ap_stations == 0, s->t);
+			break;
+		case WIFI_REC_BOOT_FAILED:
+			s->boot_failed++;
+			note(s, "boot connect gave up: provisioning");
+			break;
+		}
+	}
+}
+
+static void sim_init(sim_t *s, bool verbose)
+{
+	memset(s, 0, sizeof(*s));
+	const wifi_rec_config_t cfg = default_config();
+	wifi_rec_init(&s->rec, &cfg);
+	s->verbose = verbose;
+	s->link_up = true;
+	s->lost_at_us = -1;
+	clear_attempt(s);
+	// app_main: the boot connect.
+	wifi_rec_begin(&s->rec, 0);
+	start_connect(s, false);
+	note(s, "connect (boot)");
+}
+
+static void sim_until(sim_t *s, int64_t until_us)
+{
+	while (s->t < until_us)
+	{
+		s->t += STEP_US;
+		deliver_events(s);
+		run_actions(s);
+	}
+}
+
+static void sim_finish(sim_t *s)
+{
+	if (!s->link_up)
+	{
+		s->down_total_us += s->t - s->down_since_us;
+		s->down_since_us = s->t;
+	}
+}
+
+static int cmd_run(void)
+{
+	rng_state = opt.seed ? opt.seed : 1;
+	sim_t s;
+	sim_init(&s, true);
+	sim_until(&s, (int64_t)opt.duration_s * 1000000);
+	sim_finish(&s);
+
+	char json[512];
+	(void)wifi_rec_json(json, sizeof(json), &s.rec, s.t);
+	printf("link down %.2f s in %u outages (motors zeroed, video idle), fallback AP %u up / %u down\n",
+		   s.down_total_us / 1e6, (unsigned)s.down_edges, (unsigned)s.softap_starts, (unsigned)s.softap_stops);
+	printf("%s\n", json);
+	return 0;
+}
+
+// --- selftest ---
+
+static void scenario(double drop_at_s, int drop_ms, bool roam, int silent_pct, bool boot_fail)
+{
+	opt.drop_at_s = drop_at_s;
+	opt.drop_ms = drop_ms;
+	opt.roam = roam;
+	opt.silent_pct = silent_pct;
+	opt.boot_fail = boot_fail;
+	rng_state = 3;
+}
+
+// wifi_recovery_task wakes on every STA event, prov_timer only marks steps due: a wake-up without
+// the timer must not touch the test.
+static void selftest_provisioning(void)
+{
+	const prov_test_config_t cfg = {
+		.attempts_max = PROVISION_TEST_ATTEMPTS,
+		.timeout_us = PROVISION_TEST_TIMEOUT_MS * 1000u,
+		.retry_delay_us = 500000,
+		.switch_delay_us = PROVISION_SWITCH_DELAY_MS * 1000u,
+	};
+	prov_test_t t;
+	prov_test_init(&t, &cfg);
+	int64_t arm_us = 0;
+
+	// One transient disconnect: one retry, the test still runs.
+	prov_test_start(&t, 0);
+	expect(prov_test_disconnected(&t, REASON_BEACON_TIMEOUT, PROV_FAIL_OTHER), "disconnect schedules a retry");
+	expect(prov_test_next(&t, 200000, &arm_us) == PROV_ACT_NONE && t.step == PROV_STEP_RETRY && t.attempts == 1,
+		   "task wake-up leaves the retry pending");
+	prov_test_timer_fired(&t);
+	expect(prov_test_next(&t, 700000, &arm_us) == PROV_ACT_CONNECT && t.attempts == 2 &&
+			   t.state == PROV_TEST_CONNECTING && arm_us == (int64_t)cfg.timeout_us - 700000,
+		   "one retry, not a timeout");
+	expect(prov_test_next(&t, 800000, &arm_us) == PROV_ACT_NONE && t.state == PROV_TEST_CONNECTING,
+		   "nothing until the timer fires again");
+
+	// The retry connects: save, then switch after the delay.
+	expect(prov_test_got_ip(&t), "got IP ends the test");
+	expect(prov_test_next(&t, 900000, NULL) == PROV_ACT_NONE, "commit waits for the timer");
+	prov_test_timer_fired(&t);
+	expect(prov_test_next(&t, 900000, NULL) == PROV_ACT_SAVE && t.state == PROV_TEST_OK, "commit");
+	expect(prov_test_saved(&t, true, 900000) && t.switch_us == 900000 + (int64_t)cfg.switch_delay_us, "saved");
+	expect(!prov_test_disconnected(&t, REASON_BEACON_TIMEOUT, PROV_FAIL_OTHER) && t.state == PROV_TEST_OK,
+		   "disconnect after the commit ignored");
+	prov_test_timer_fired(&t);
+	expect(prov_test_next(&t, t.switch_us, NULL) == PROV_ACT_SWITCH, "switch to STA");
+
+	// Every connect fails: attempts_max connects, then connect_failed.
+	prov_test_start(&t, 0);
+	for (uint32_t i = 1; i < cfg.attempts_max; i++)
+	{
+		expect(prov_test_disconnected(&t, REASON_BEACON_TIMEOUT, PROV_FAIL_OTHER), "retry");
+		prov_test_timer_fired(&t);
+		expect(prov_test_next(&t, i * 1000000, NULL) == PROV_ACT_CONNECT && t.attempts == i + 1, "retry connect");
+	}
+	expect(!prov_test_disconnected(&t, REASON_NO_AP_FOUND, PROV_FAIL_NOT_FOUND) && t.state == PROV_TEST_FAILED &&
+			   strcmp(t.error, "not_found") == 0,
+		   "attempts exhausted");
+
+	// A wrong password fails at once.
+	prov_test_start(&t, 0);
+	expect(!prov_test_disconnected(&t, 15, PROV_FAIL_AUTH) && t.state == PROV_TEST_FAILED &&
+			   strcmp(t.error, "wrong_password") == 0 && t.attempts == 1,
+		   "wrong password, no retry");
+
+	// No result by the deadline; a retry due past the deadline gives up too.
+	prov_test_start(&t, 0);
+	prov_test_timer_fired(&t);
+	expect(prov_test_next(&t, cfg.timeout_us, NULL) == PROV_ACT_GIVE_UP && strcmp(t.error, "timeout") == 0,
+		   "timeout");
+	prov_test_start(&t, 0);
+	expect(prov_test_disconnected(&t, REASON_BEACON_TIMEOUT, PROV_FAIL_OTHER), "late retry scheduled");
+	prov_test_timer_fired(&t);
+	expect(prov_test_next(&t, cfg.timeout_us, NULL) == PROV_ACT_GIVE_UP && t.attempts == 1, "late retry gives up");
+}
+
+static int cmd_selftest(void)
+{
+	const wifi_rec_config_t cfg = default_config();
+	sim_t s;
+
+	// Boot without the AP: boot_attempts connects, then provisioning; the link counts as up (AP mode).
+	scenario(1000.0, 0, false, 0, true);
+	sim_init(&s, false);
+	sim_until(&s, 20000000);
+	expect(s.boot_failed == 1 && s.rec.state == WIFI_REC_IDLE, "boot gives up");
+	expect(s.rec.stats.attempts == cfg.boot_attempts && s.down_edges == 0, "boot attempts, no outage");
+
+	// Short dropout: back on the pinned channel/BSSID.
+	scenario(10.0, 2000, false, 0, false);
+	sim_init(&s, false);
+	sim_until(&s, 5000000);
+	expect(s.rec.state == WIFI_REC_CONNECTED && s.rec.channel == 1 && s.rec.stats.outages == 0, "boot connect");
+	sim_until(&s, 30000000);
+	sim_finish(&s);
+	expect(s.rec.stats.outages == 1 && s.rec.stats.fast_recoveries == 1 && s.rec.stats.scan_recoveries == 0,
+		   "fast recovery");
+	expect(s.down_edges == 1 && s.link_up && s.rec.stats.outage_ms_last < 1000 &&
+			   s.down_total_us / 1000 == (int64_t)s.rec.stats.outage_ms_last,
+		   "outage measured (AP back before the beacon timeout)");
+	expect(s.softap_starts == 0, "no fallback AP");
+
+	// The AP moves to another channel: pinned connects fail, a scan finds it.
+	scenario(10.0, 5000, true, 0, false);
+	sim_init(&s, false);
+	sim_until(&s, 40000000);
+	expect(s.rec.stats.scan_recoveries == 1 && s.rec.stats.fast_recoveries == 0 && s.rec.channel == 6,
+		   "scan recovery on the new channel");
+	expect(s.rec.stats.attempts >= 1 + cfg.fast_attempts + 1, "pinned attempts first");
+
+	// Long outage: fallback AP at softap_after_us, the STA keeps trying, the AP goes away with the STA back.
+	scenario(10.0, 60000, false, 0, false);
+	sim_init(&s, false);
+	const int64_t lost = 10000000 + BEACON_LOSS_US;
+	sim_until(&s, lost + cfg.softap_after_us - STEP_US);
+	expect(s.softap_starts == 0 && !s.link_up, "no fallback before softap_after");
+	sim_until(&s, lost + cfg.softap_after_us + 2 * STEP_US);
+	expect(s.softap_starts == 1 && s.link_up && s.rec.softap, "fallback AP up, link usable");
+	const uint32_t attempts = s.rec.stats.attempts;
+	s.ap_stations = 1; // someone drives over the fallback AP
+	sim_until(&s, 75000000);
+	expect(s.rec.stats.attempts > attempts && s.rec.state == WIFI_REC_CONNECTED, "STA retried and back");
+	expect(s.rec.softap && s.softap_stops == 0, "fallback AP kept while in use");
+	s.ap_stations = 0;
+	sim_until(&s, 75000000 + cfg.softap_retry_us + STEP_US);
+	expect(!s.rec.softap && s.softap_stops == 1, "fallback AP taken down");
+	expect(s.down_edges == 1 && s.rec.stats.softap_fallbacks == 1, "one outage");
+
+	// Backoff doubles up to the cap; an attempt that never reports back times out.
+	wifi_rec_t r;
+	wifi_rec_config_t no_ap = cfg;
+	no_ap.softap_after_us = 0;
+	wifi_rec_init(&r, &no_ap);
+	wifi_rec_begin(&r, 0);
+	wifi_rec_connected(&r, 1, AP_BSSID);
+	wifi_rec_got_ip(&r, 0);
+	int64_t t = 1000000;
+	wifi_rec_disconnected(&r, REASON_BEACON_TIMEOUT, t);
+	expect(!r.link_up, "link down on drop");
+	uint32_t wait_us = 0;
+	for (uint32_t i = 0; i < cfg.fast_attempts; i++)
+	{
+		expect(wifi_rec_poll(&r, t, &wait_us) == WIFI_REC_CONNECT_FAST && wait_us == cfg.attempt_timeout_us,
+			   "pinned connect, waits for its result");
+		wifi_rec_disconnected(&r, REASON_NO_AP_FOUND, t);
+	}
+	uint32_t expect_gap = cfg.backoff_min_us;
+	for (int i = 0; i < 8; i++)
+	{
+		expect(wifi_rec_poll(&r, t, &wait_us) == WIFI_REC_NONE && wait_us == expect_gap, "backoff gap");
+		t += wait_us;
+		expect(wifi_rec_poll(&r, t, NULL) == WIFI_REC_CONNECT_SCAN, "scan connect when due");
+		if (i == 3)
+		{
+			t += cfg.attempt_timeout_us;
+			expect(wifi_rec_poll(&r, t, NULL) == WIFI_REC_NONE && r.stats.attempt_timeouts == 1, "timeout");
+		}
+		else
+		{
+			wifi_rec_disconnected(&r, REASON_NO_AP_FOUND, t);
+		}
+		expect_gap = (expect_gap * 2 > cfg.backoff_max_us) ? cfg.backoff_max_us : expect_gap * 2;
+	}
+	expect(r.backoff_us == cfg.backoff_max_us && r.state == WIFI_REC_BACKOFF && r.stats.softap_fallbacks == 0,
+		   "capped, no fallback when disabled");
+
+	// Provisioning / AP mode: STA events are not ours.
+	wifi_rec_idle(&r);
+	wifi_rec_disconnected(&r, REASON_NO_AP_FOUND, t);
+	wifi_rec_got_ip(&r, t);
+	expect(r.state == WIFI_REC_IDLE && wifi_rec_poll(&r, t, &wait_us) == WIFI_REC_NONE && wait_us == UINT32_MAX,
+		   "idle ignores events");
+
+	// Silent attempts on a flaky link still recover through timeouts.
+	scenario(10.0, 3000, false, 40, false);
+	sim_init(&s, false);
+	sim_until(&s, 90000000);
+	expect(s.rec.state == WIFI_REC_CONNECTED && s.rec.stats.attempt_timeouts > 0 && s.link_up, "flaky recovery");
+
+	char json[512];
+	expect(wifi_rec_json(json, sizeof(json), &s.rec, s.t) > 0, "json");
+	expect(wifi_rec_json(json, 32, &s.rec, s.t) == 0, "short buffer");
+
+	selftest_provisioning();
+	return selftest_done();
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+			"usage: %s run [--drop-at S] [--drop-ms MS] [--roam] [--silent-pct PCT] [--boot-fail]\n"
+			"              [--duration S] [--seed N]\n"
+			"       %s selftest\n",
+			argv0, argv0);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option longopts[] = {
+		{"drop-at", required_argument, NULL, 'a'},    {"drop-ms", required_argument, NULL, 'm'},
+		{"roam", no_argument, NULL, 'r'},             {"silent-pct", required_argument, NULL, 's'},
+		{"boot-fail", no_argument, NULL, 'b'},        {"duration", required_argument, NULL, 'd'},
+		{"seed", required_argument, NULL, 'S'},       {"help", no_argument, NULL, '?'},
+		{NULL, 0, NULL, 0},
+	};
+	int ch;
+	while ((ch = getopt_long(argc, argv, "", longopts, NULL)) != -1)
+	{
+		switch (ch)
+		{
+		case 'a': opt.drop_at_s = atof(optarg); break;
+		case 'm': opt.drop_ms = atoi(optarg); break;
+		case 'r': opt.roam = true; break;
+		case 's': opt.silent_pct = atoi(optarg); break;
+		case 'b': opt.boot_fail = true; break;
+		case 'd': opt.duration_s = atoi(optarg); break;
+		case 'S': opt.seed = (uint32_t)strtoul(optarg, NULL, 10); break;
+		default: usage(argv[0]); return 2;
+		}
+	}
+
+	const int nargs = argc - optind;
+	if (nargs == 1 && strcmp(argv[optind], "selftest") == 0)
+		return cmd_selftest();
+	if (nargs != 1 || strcmp(argv[optind], "run") != 0 || opt.duration_s <= 0 || opt.drop_ms < 0 ||
+		opt.silent_pct < 0 || opt.silent_pct > 100)
+	{
+		usage(argv[0]);
+		return 2;
+	}
+	return cmd_run();
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+// Assertion helpers for the host tools' `selftest` subcommands. Each tool is a single translation
+// unit, so the failure count lives here as a file-static.
+
+#include <stdbool.h>
+#include <stdio.h>
+
+static int selftest_fails;
+
+static inline void expect(bool ok, const char *what)
+{
+	if (!ok)
+	{
+		printf("FAIL: %s\n", what);
+		selftest_fails++;
+	}
+}
+
+// Prints the verdict and returns the process exit code.
+static inline int selftest_done(void)
+{
+	printf(selftest_fails ? "selftest FAILED\n" : "selftest ok\n");
+	return selftest_fails ? 1 : 0;
+}
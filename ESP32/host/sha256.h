@@ -0,0 +1,20 @@
+#pragma once
+
+// SHA-256 (FIPS 180-4) for the host tools; the firmware uses mbedtls (hardware accelerated).
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+	uint32_t h[8];
+	uint64_t bytes;
+	uint8_t block[64];
+	size_t fill;
+} sha256_t;
+
+void sha256_start(sha256_t *s);
+void sha256_update(sha256_t *s, const void *data, size_t len);
+void sha256_finish(sha256_t *s, uint8_t digest[32]);
+// Lowercase hex into `out` (65 bytes).
+void sha256_hex(const uint8_t digest[32], char out[65]);
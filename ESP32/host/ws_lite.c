@@ -0,0 +1,624 @@
+#define _GNU_SOURCE
+#include "ws_lite.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WS_DEFAULT_MAX_MSG (4u * 1024u * 1024u)
+
+int64_t ws_now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+void ws_sleep_us(int64_t us)
+{
+	if (us <= 0)
+		return;
+	struct timespec ts = {.tv_sec = us / 1000000LL, .tv_nsec = (us % 1000000LL) * 1000};
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+	{
+	}
+}
+
+// --- SHA-1 + base64, only for Sec-WebSocket-Accept ---
+
+static uint32_t rol32(uint32_t v, int n)
+{
+	return (v << n) | (v >> (32 - n));
+}
+
+static void sha1(const uint8_t *msg, size_t len, uint8_t out[20])
+{
+	uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+	const size_t total = ((len + 8) / 64 + 1) * 64;
+	uint8_t block[64];
+	for (size_t off = 0; off < total; off += 64)
+	{
+		for (size_t i = 0; i < 64; i++)
+		{
+			const size_t p = off + i;
+			if (p < len)
+				block[i] = msg[p];
+			else if (p == len)
+				block[i] = 0x80;
+			else if (p >= total - 8)
+				block[i] = (uint8_t)(((uint64_t)len * 8) >> (8 * (total - 1 - p)));
+			else
+				block[i] = 0;
+		}
+
+		uint32_t w[80];
+		for (int i = 0; i < 16; i++)
+			w[i] = ((uint32_t)block[4 * i] << 24) | ((uint32_t)block[4 * i + 1] << 16) |
+				   ((uint32_t)block[4 * i + 2] << 8) | block[4 * i + 3];
+		for (int i = 16; i < 80; i++)
+			w[i] = rol32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+		uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+		for (int i = 0; i < 80; i++)
+		{
+			uint32_t f, k;
+			if (i < 20)
+			{
+				f = (b & c) | (~b & d);
+				k = 0x5A827999;
+			}
+			else if (i < 40)
+			{
+				f = b ^ c ^ d;
+				k = 0x6ED9EBA1;
+			}
+			else if (i < 60)
+			{
+				f = (b & c) | (b & d) | (c & d);
+				k = 0x8F1BBCDC;
+			}
+			else
+			{
+				f = b ^ c ^ d;
+				k = 0xCA62C1D6;
+			}
+			const uint32_t t = rol32(a, 5) + f + e + k + w[i];
+			e = d;
+			d = c;
+			c = rol32(b, 30);
+			b = a;
+			a = t;
+		}
+		h[0] += a;
+		h[1] += b;
+		h[2] += c;
+		h[3] += d;
+		h[4] += e;
+	}
+	for (int i = 0; i < 5; i++)
+	{
+		out[4 * i] = (uint8_t)(h[i] >> 24);
+		out[4 * i + 1] = (uint8_t)(h[i] >> 16);
+		out[4 * i + 2] = (uint8_t)(h[i] >> 8);
+		out[4 * i + 3] = (uint8_t)h[i];
+	}
+}
+
+static void base64(const uint8_t *in, size_t len, char *out)
+{
+	static const char tbl[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	size_t o = 0;
+	for (size_t i = 0; i < len; i += 3)
+	{
+		const uint32_t v = ((uint32_t)in[i] << 16) | ((i + 1 < len) ? (uint32_t)in[i + 1] << 8 : 0) |
+						   ((i + 2 < len) ? in[i + 2] : 0);
+		out[o++] = tbl[(v >> 18) & 63];
+		out[o++] = tbl[(v >> 12) & 63];
+		out[o++] = (i + 1 < len) ? tbl[(v >> 6) & 63] : '=';
+		out[o++] = (i + 2 < len) ? tbl[v & 63] : '=';
+	}
+	out[o] = '\0';
+}
+
+static void accept_key(const char *key, char out[29])
+{
+	char buf[128];
+	snprintf(buf, sizeof(buf), "%s" WS_GUID, key);
+	uint8_t digest[20];
+	sha1((const uint8_t *)buf, strlen(buf), digest);
+	base64(digest, sizeof(digest), out);
+}
+
+// --- socket helpers ---
+
+static int write_all(int fd, const void *data, size_t len)
+{
+	const uint8_t *p = (const uint8_t *)data;
+	while (len > 0)
+	{
+		const ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += n;
+		len -= (size_t)n;
+	}
+	return 0;
+}
+
+// Reads exactly `len` bytes. `deadline_us` < 0 means no deadline. Returns 1, 0 (timeout) or -1.
+static int read_all(int fd, void *data, size_t len, int64_t deadline_us)
+{
+	uint8_t *p = (uint8_t *)data;
+	while (len > 0)
+	{
+		int timeout = -1;
+		if (deadline_us >= 0)
+		{
+			const int64_t left = deadline_us - ws_now_us();
+			if (left <= 0)
+				return 0;
+			timeout = (int)((left + 999) / 1000);
+		}
+		struct pollfd pfd = {.fd = fd, .events = POLLIN};
+		const int pr = poll(&pfd, 1, timeout);
+		if (pr < 0 && errno == EINTR)
+			continue;
+		if (pr < 0)
+			return -1;
+		if (pr == 0)
+			return 0;
+		const ssize_t n = recv(fd, p, len, 0);
+		if (n == 0)
+			return -1;
+		if (n < 0)
+		{
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			return -1;
+		}
+		p += n;
+		len -= (size_t)n;
+	}
+	return 1;
+}
+
+// Reads an HTTP header block (up to CRLFCRLF) into buf. Returns length or -1.
+static int read_http_head(int fd, char *buf, size_t cap, int timeout_ms)
+{
+	const int64_t deadline = ws_now_us() + (int64_t)timeout_ms * 1000;
+	size_t len = 0;
+	while (len + 1 < cap)
+	{
+		if (read_all(fd, buf + len, 1, deadline) != 1)
+			return -1;
+		len++;
+		if (len >= 4 && memcmp(buf + len - 4, "\r\n\r\n", 4) == 0)
+		{
+			buf[len] = '\0';
+			return (int)len;
+		}
+	}
+	return -1;
+}
+
+static bool header_value(const char *head, const char *name, char *out, size_t cap)
+{
+	const size_t name_len = strlen(name);
+	for (const char *line = strstr(head, "\r\n"); line && line[2]; line = strstr(line + 2, "\r\n"))
+	{
+		const char *p = line + 2;
+		if (strncasecmp(p, name, name_len) == 0 && p[name_len] == ':')
+		{
+			p += name_len + 1;
+			while (*p == ' ')
+				p++;
+			size_t n = 0;
+			while (p[n] && p[n] != '\r' && n + 1 < cap)
+			{
+				out[n] = p[n];
+				n++;
+			}
+			out[n] = '\0';
+			return true;
+		}
+	}
+	return false;
+}
+
+static void conn_init(ws_conn_t *c, int fd, bool is_client)
+{
+	memset(c, 0, sizeof(*c));
+	c->fd = fd;
+	c->is_client = is_client;
+	c->max_msg = WS_DEFAULT_MAX_MSG;
+	pthread_mutex_init(&c->send_lock, NULL);
+	const int one = 1;
+	(void)setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+static int tcp_connect(const char *host, uint16_t port, int timeout_ms)
+{
+	char port_str[8];
+	snprintf(port_str, sizeof(port_str), "%u", (unsigned)port);
+	struct addrinfo hints = {.ai_family = AF_INET, .ai_socktype = SOCK_STREAM};
+	struct addrinfo *res = NULL;
+	if (getaddrinfo(host, port_str, &hints, &res) != 0 || !res)
+		return -1;
+
+	const int fd = socket(res->ai_family, res->ai_socktype, 0);
+	if (fd < 0)
+	{
+		freeaddrinfo(res);
+		return -1;
+	}
+	struct timeval tv = {.tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000};
+	(void)setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+	const int rc = connect(fd, res->ai_addr, res->ai_addrlen);
+	freeaddrinfo(res);
+	if (rc != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int ws_client_connect(ws_conn_t *c, const char *host, uint16_t port, const char *path, int timeout_ms)
+{
+	const int fd = tcp_connect(host, port, timeout_ms);
+	if (fd < 0)
+		return -1;
+
+	uint8_t nonce[16];
+	for (size_t i = 0; i < sizeof(nonce); i++)
+		nonce[i] = (uint8_t)rand();
+	char key[32];
+	base64(nonce, sizeof(nonce), key);
+
+	char req[512];
+	const int n = snprintf(req, sizeof(req),
+						   "GET %s HTTP/1.1\r\nHost: %s:%u\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+						   "Sec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n\r\n",
+						   path ? path : "/", host, (unsigned)port, key);
+	char head[1024];
+	char accept[64];
+	char expected[29];
+	accept_key(key, expected);
+	if (write_all(fd, req, (size_t)n) != 0 || read_http_head(fd, head, sizeof(head), timeout_ms) < 0 ||
+		strncmp(head, "HTTP/1.1 101", 12) != 0 || !header_value(head, "Sec-WebSocket-Accept", accept, sizeof(accept)) ||
+		strcmp(accept, expected) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	conn_init(c, fd, true);
+	return 0;
+}
+
+int ws_http_get(const char *host, uint16_t port, const char *path, char *body, size_t cap, int timeout_ms)
+{
+	body[0] = '\0';
+	const int fd = tcp_connect(host, port, timeout_ms);
+	if (fd < 0)
+		return -1;
+	char req[512];
+	const int n = snprintf(req, sizeof(req), "GET %s HTTP/1.1\r\nHost: %s:%u\r\nConnection: close\r\n\r\n", path, host,
+						   (unsigned)port);
+	char head[2048];
+	int status = -1;
+	if (write_all(fd, req, (size_t)n) != 0 || read_http_head(fd, head, sizeof(head), timeout_ms) < 0 ||
+		sscanf(head, "HTTP/1.%*d %d", &status) != 1)
+	{
+		close(fd);
+		return -1;
+	}
+
+	// Content-Length if given (the car keeps connections open), otherwise until the server closes.
+	char value[32];
+	const int64_t deadline = ws_now_us() + (int64_t)timeout_ms * 1000;
+	size_t len = 0;
+	if (header_value(head, "Content-Length", value, sizeof(value)))
+	{
+		len = (size_t)strtoul(value, NULL, 10);
+		if (len > cap - 1)
+			len = cap - 1;
+		if (len > 0 && read_all(fd, body, len, deadline) != 1)
+			len = 0;
+	}
+	else
+	{
+		ssize_t r;
+		while (len < cap - 1 && (r = recv(fd, body + len, cap - 1 - len, 0)) > 0)
+			len += (size_t)r;
+	}
+	body[len] = '\0';
+	close(fd);
+	return status;
+}
+
+int ws_server_listen(uint16_t port, int backlog)
+{
+	const int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+	const int one = 1;
+	(void)setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = INADDR_ANY};
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, backlog) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+bool ws_http_header(const char *head, const char *name, char *out, size_t cap)
+{
+	return header_value(head, name, out, cap);
+}
+
+int ws_http_reply(int fd, const char *status, const char *headers, const void *body, size_t len)
+{
+	char head[1024];
+	const int n = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Length: %zu\r\nConnection: close\r\n%s\r\n",
+						   status, len, headers);
+	if (n < 0 || (size_t)n >= sizeof(head) || write_all(fd, head, (size_t)n) != 0)
+		return -1;
+	return (len > 0) ? write_all(fd, body, len) : 0;
+}
+
+int ws_server_accept(int listen_fd, ws_conn_t *c, ws_http_fn_t http_fn, void *ctx)
+{
+	const int fd = accept(listen_fd, NULL, NULL);
+	if (fd < 0)
+		return -1;
+
+	char head[2048];
+	if (read_http_head(fd, head, sizeof(head), 5000) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	char key[64];
+	if (!header_value(head, "Sec-WebSocket-Key", key, sizeof(key)))
+	{
+		char method[8] = {0};
+		char path[256] = {0};
+		(void)sscanf(head, "%7s %255s", method, path);
+		if (http_fn)
+			http_fn(fd, method, path, head, ctx);
+		else
+			(void)ws_http_reply(fd, "404 Not Found", "", NULL, 0);
+		close(fd);
+		return -1;
+	}
+
+	char accept[29];
+	accept_key(key, accept);
+	char resp[256];
+	const int n = snprintf(resp, sizeof(resp),
+						   "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+						   "Sec-WebSocket-Accept: %s\r\n\r\n",
+						   accept);
+	if (write_all(fd, resp, (size_t)n) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	conn_init(c, fd, false);
+	return 0;
+}
+
+void ws_set_max_msg(ws_conn_t *c, size_t max_msg)
+{
+	c->max_msg = max_msg;
+}
+
+static int send_frame_locked(ws_conn_t *c, uint8_t opcode, bool fin, const void *data, size_t len)
+{
+	uint8_t hdr[14];
+	size_t hl = 0;
+	hdr[hl++] = (uint8_t)((fin ? 0x80 : 0x00) | opcode);
+	const uint8_t mask_bit = c->is_client ? 0x80 : 0x00;
+	if (len < 126)
+	{
+		hdr[hl++] = (uint8_t)(mask_bit | len);
+	}
+	else if (len <= 0xFFFF)
+	{
+		hdr[hl++] = (uint8_t)(mask_bit | 126);
+		hdr[hl++] = (uint8_t)(len >> 8);
+		hdr[hl++] = (uint8_t)len;
+	}
+	else
+	{
+		hdr[hl++] = (uint8_t)(mask_bit | 127);
+		for (int i = 7; i >= 0; i--)
+			hdr[hl++] = (uint8_t)((uint64_t)len >> (8 * i));
+	}
+
+	if (!c->is_client)
+	{
+		if (write_all(c->fd, hdr, hl) != 0)
+			return -1;
+		return (len > 0) ? write_all(c->fd, data, len) : 0;
+	}
+
+	uint8_t mask[4];
+	for (int i = 0; i < 4; i++)
+		mask[i] = (uint8_t)rand();
+	memcpy(hdr + hl, mask, 4);
+	hl += 4;
+	if (write_all(c->fd, hdr, hl) != 0)
+		return -1;
+
+	const uint8_t *src = (const uint8_t *)data;
+	uint8_t chunk[1024];
+	for (size_t off = 0; off < len; off += sizeof(chunk))
+	{
+		const size_t n = (len - off < sizeof(chunk)) ? len - off : sizeof(chunk);
+		for (size_t i = 0; i < n; i++)
+			chunk[i] = src[off + i] ^ mask[(off + i) & 3];
+		if (write_all(c->fd, chunk, n) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+int ws_send(ws_conn_t *c, uint8_t opcode, const void *data, size_t len)
+{
+	if (!c || c->fd < 0)
+		return -1;
+	pthread_mutex_lock(&c->send_lock);
+	const int rc = send_frame_locked(c, opcode, true, data, len);
+	pthread_mutex_unlock(&c->send_lock);
+	return rc;
+}
+
+int ws_send_frame(ws_conn_t *c, uint8_t opcode, bool fin, const void *data, size_t len)
+{
+	if (!c || c->fd < 0)
+		return -1;
+	pthread_mutex_lock(&c->send_lock);
+	const int rc = send_frame_locked(c, opcode, fin, data, len);
+	pthread_mutex_unlock(&c->send_lock);
+	return rc;
+}
+
+static int reserve(ws_conn_t *c, size_t need)
+{
+	if (need <= c->rx_cap)
+		return 0;
+	size_t cap = c->rx_cap ? c->rx_cap : 4096;
+	while (cap < need)
+		cap *= 2;
+	uint8_t *p = (uint8_t *)realloc(c->rx_buf, cap);
+	if (!p)
+		return -1;
+	c->rx_buf = p;
+	c->rx_cap = cap;
+	return 0;
+}
+
+int ws_recv(ws_conn_t *c, ws_msg_t *msg, int timeout_ms)
+{
+	if (!c || c->fd < 0)
+		return -1;
+
+	// The timeout applies to the start of each frame; once a frame started, wait for the rest. A
+	// fragmented message that times out between frames is resumed by the next call.
+	const int64_t deadline = (timeout_ms >= 0) ? ws_now_us() + (int64_t)timeout_ms * 1000 : -1;
+	while (true)
+	{
+		uint8_t h[2];
+		const int r = read_all(c->fd, h, 2, deadline);
+		if (r <= 0)
+			return r;
+
+		const bool fin = (h[0] & 0x80) != 0;
+		const uint8_t opcode = h[0] & 0x0F;
+		const bool masked = (h[1] & 0x80) != 0;
+		uint64_t len = h[1] & 0x7F;
+		if (len == 126)
+		{
+			uint8_t e[2];
+			if (read_all(c->fd, e, 2, -1) != 1)
+				return -1;
+			len = ((uint64_t)e[0] << 8) | e[1];
+		}
+		else if (len == 127)
+		{
+			uint8_t e[8];
+			if (read_all(c->fd, e, 8, -1) != 1)
+				return -1;
+			len = 0;
+			for (int i = 0; i < 8; i++)
+				len = (len << 8) | e[i];
+		}
+		uint8_t mask[4] = {0};
+		if (masked && read_all(c->fd, mask, 4, -1) != 1)
+			return -1;
+
+		if (opcode >= WS_OP_CLOSE)
+		{
+			uint8_t ctl[125];
+			if (len > sizeof(ctl) || read_all(c->fd, ctl, (size_t)len, -1) != 1)
+				return -1;
+			for (size_t i = 0; i < len; i++)
+				ctl[i] ^= mask[i & 3];
+			if (opcode == WS_OP_CLOSE)
+			{
+				(void)ws_send(c, WS_OP_CLOSE, ctl, (len >= 2) ? 2 : 0);
+				return -1;
+			}
+			if (opcode == WS_OP_PING)
+				(void)ws_send(c, WS_OP_PONG, ctl, (size_t)len);
+			continue;
+		}
+
+		if (opcode != WS_OP_CONT)
+		{
+			c->rx_opcode = opcode;
+			c->rx_len = 0;
+		}
+		const size_t total = c->rx_len;
+		if (total + len > c->max_msg || reserve(c, (size_t)(total + len)) != 0)
+			return -1;
+		if (len > 0 && read_all(c->fd, c->rx_buf + total, (size_t)len, -1) != 1)
+			return -1;
+		if (masked)
+			for (size_t i = 0; i < len; i++)
+				c->rx_buf[total + i] ^= mask[i & 3];
+		c->rx_len = total + (size_t)len;
+
+		if (fin)
+		{
+			msg->opcode = c->rx_opcode;
+			msg->data = c->rx_buf;
+			msg->len = c->rx_len;
+			c->rx_opcode = 0;
+			c->rx_len = 0;
+			return 1;
+		}
+	}
+}
+
+void ws_shutdown(ws_conn_t *c)
+{
+	if (c && c->fd >= 0)
+		(void)shutdown(c->fd, SHUT_RDWR);
+}
+
+void ws_close(ws_conn_t *c)
+{
+	if (!c)
+		return;
+	if (c->fd >= 0)
+	{
+		const uint8_t code[2] = {0x03, 0xE8}; // 1000 normal closure
+		(void)ws_send(c, WS_OP_CLOSE, code, sizeof(code));
+		close(c->fd);
+		c->fd = -1;
+	}
+	free(c->rx_buf);
+	c->rx_buf = NULL;
+	c->rx_cap = 0;
+	pthread_mutex_destroy(&c->send_lock);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+// Minimal blocking RFC 6455 WebSocket endpoint for the Linux host tools (client and server side).
+// No TLS, no extensions. One ws_conn_t must not be read from two threads at once; sends are
+// serialized internally so a reader thread and a broadcaster may share a connection.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define WS_OP_CONT 0x0
+#define WS_OP_TEXT 0x1
+#define WS_OP_BINARY 0x2
+#define WS_OP_CLOSE 0x8
+#define WS_OP_PING 0x9
+#define WS_OP_PONG 0xA
+
+typedef struct
+{
+	int fd;
+	bool is_client; // clients mask outgoing frames
+	pthread_mutex_t send_lock;
+	uint8_t *rx_buf;
+	size_t rx_cap;
+	size_t max_msg;
+	size_t rx_len;     // fragments of a message received so far
+	uint8_t rx_opcode; // its opcode, 0 = no message in progress
+} ws_conn_t;
+
+typedef struct
+{
+	uint8_t opcode; // TEXT or BINARY (control frames are handled internally)
+	const uint8_t *data; // valid until the next ws_recv on the same connection
+	size_t len;
+} ws_msg_t;
+
+// Connects and performs the upgrade handshake (Sec-WebSocket-Accept is verified). Returns 0 or -1.
+int ws_client_connect(ws_conn_t *c, const char *host, uint16_t port, const char *path, int timeout_ms);
+
+// Plain HTTP GET. Returns the status code (body copied into `body`, NUL-terminated, truncated to
+// `cap`) or -1.
+int ws_http_get(const char *host, uint16_t port, const char *path, char *body, size_t cap, int timeout_ms);
+
+// Listening socket on 0.0.0.0:port, or -1.
+int ws_server_listen(uint16_t port, int backlog);
+// Accepts one connection and completes the upgrade handshake. Returns 0 or -1.
+// Plain HTTP requests that are not upgrades are passed to `http_fn` (may be NULL -> 404) with the
+// request head; the connection is closed afterwards.
+typedef void (*ws_http_fn_t)(int fd, const char *method, const char *path, const char *head, void *ctx);
+int ws_server_accept(int listen_fd, ws_conn_t *c, ws_http_fn_t http_fn, void *ctx);
+// Copies a header's value out of a request head. Returns false if it is absent.
+bool ws_http_header(const char *head, const char *name, char *out, size_t cap);
+// Writes a complete response ("Connection: close"). `headers` is "" or "Name: value\r\n" lines.
+int ws_http_reply(int fd, const char *status, const char *headers, const void *body, size_t len);
+
+// Limits the largest message ws_recv will assemble (default 4 MiB).
+void ws_set_max_msg(ws_conn_t *c, size_t max_msg);
+
+int ws_send(ws_conn_t *c, uint8_t opcode, const void *data, size_t len);
+// One frame of a fragmented message: the first carries the opcode, the rest WS_OP_CONT; `fin` on the last.
+int ws_send_frame(ws_conn_t *c, uint8_t opcode, bool fin, const void *data, size_t len);
+
+// Waits up to timeout_ms (-1 = forever) for one complete data message.
+// Returns 1 on message, 0 on timeout, -1 on close/error.
+int ws_recv(ws_conn_t *c, ws_msg_t *msg, int timeout_ms);
+
+// Wakes up a thread blocked in ws_recv on this connection (it returns -1). Safe from any thread.
+void ws_shutdown(ws_conn_t *c);
+
+void ws_close(ws_conn_t *c);
+
+// Small helpers shared by the tools.
+int64_t ws_now_us(void);
+void ws_sleep_us(int64_t us);
@@ -0,0 +1,326 @@
+#include "actuator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A tick that comes this late only covers this much time (a stalled timer must not turn into one huge step).
+#define ACT_MAX_DT_US 100000
+
+static int32_t clamp_axis(int64_t v)
+{
+	if (v > RC_AXIS_MAX)
+		return RC_AXIS_MAX;
+	if (v < RC_AXIS_MIN)
+		return RC_AXIS_MIN;
+	return (int32_t)v;
+}
+
+// Bit-by-bit integer square root: 32 iterations, no division.
+static uint32_t isqrt64(uint64_t v)
+{
+	uint64_t res = 0;
+	uint64_t bit = 1ull << 62;
+	while (bit > v)
+		bit >>= 2;
+	while (bit)
+	{
+		if (v >= res + bit)
+		{
+			v -= res + bit;
+			res = (res >> 1) + bit;
+		}
+		else
+		{
+			res >>= 1;
+		}
+		bit >>= 2;
+	}
+	return (uint32_t)res;
+}
+
+static int32_t axis_out(const act_axis_t *x)
+{
+	return (x->out_q8 >= 0) ? (x->out_q8 + 128) >> 8 : -((-x->out_q8 + 128) >> 8);
+}
+
+// Reference at `now`: the segment from -> to over one interval, then the trend for at most
+// extrapolate_us, then hold. Also returns its slope (units/s) and where it will come to rest.
+static int32_t axis_ref(const actuator_t *a, const act_axis_t *x, int64_t now_us, int32_t *slope, int32_t *end)
+{
+	const int64_t dt = now_us - x->t0_us;
+	const int64_t iv = a->interval_us;
+	const int64_t delta = (int64_t)x->to - x->from;
+	if (end)
+		*end = clamp_axis(x->to + (int64_t)x->trend * a->cfg.extrapolate_us / iv);
+	if (dt <= 0)
+	{
+		if (slope)
+			*slope = 0;
+		return x->from;
+	}
+	if (dt < iv)
+	{
+		if (slope)
+			*slope = (int32_t)(delta * 1000000 / iv);
+		return clamp_axis(x->from + delta * dt / iv);
+	}
+	int64_t ext = dt - iv;
+	if (ext >= a->cfg.extrapolate_us)
+		ext = a->cfg.extrapolate_us;
+	if (slope)
+		*slope = (ext == a->cfg.extrapolate_us) ? 0 : (int32_t)((int64_t)x->trend * 1000000 / iv);
+	return clamp_axis(x->to + (int64_t)x->trend * ext / iv);
+}
+
+// Highest speed (units/s) from which the output can still stop within `dist_q8` when the rate drops
+// by dv per tick: the discrete form of sqrt(2 * accel * distance). With s the per-tick decrement of
+// the step, the steps k*s + r, (k-1)*s + r, ..., r cover s*k*(k+1)/2 + r*(k+1).
+static int64_t stop_speed(uint32_t dist_q8, int64_t dv, uint32_t dt_us)
+{
+	int64_t s = dv * dt_us * 256 / 1000000;
+	if (s < 1)
+		s = 1;
+	const int64_t d = dist_q8;
+	int64_t k = ((int64_t)isqrt64(1 + (uint64_t)(8 * d / s)) - 1) / 2;
+	if (s * (k + 1) * (k + 2) / 2 <= d)
+		k++;
+	const int64_t r = (d - s * k * (k + 1) / 2) / (k + 1);
+	return (k * s + r) * 1000000 / 256 / dt_us;
+}
+
+// Moves the output toward the reference for dt_us within the slew and acceleration limits. It
+// follows the reference's slope and closes the remaining distance no faster than it could still stop
+// on it, and never faster than it could stop where the reference comes to rest, so a step or the
+// end of a ramp is approached without overshoot.
+static void axis_step(act_axis_t *x, int32_t ref, int32_t slope, int32_t end, uint32_t dt_us, uint32_t slew,
+					  uint32_t accel)
+{
+	const int32_t ref_q8 = ref * 256;
+	const int32_t err_q8 = ref_q8 - x->out_q8;
+	if (dt_us == 0 || (err_q8 == 0 && x->rate == 0 && slope == 0))
+		return;
+
+	// Largest rate change this tick.
+	int64_t dv = (int64_t)accel * dt_us / 1000000;
+	if (accel && dv < 1)
+		dv = 1;
+	const uint32_t dist = (uint32_t)((err_q8 < 0) ? -err_q8 : err_q8);
+	// Landing exactly on the reference this tick.
+	int64_t close = (int64_t)dist * 1000000 / 256 / dt_us;
+	if (accel)
+	{
+		const int64_t v_stop = stop_speed(dist, dv, dt_us);
+		if (close > v_stop)
+			close = v_stop;
+	}
+	if (close == 0 && slope == 0 && (!accel || (x->rate <= dv && x->rate >= -dv)))
+	{
+		// Less than one tick's resolution away and slow enough to stop.
+		x->out_q8 = ref_q8;
+		x->rate = 0;
+		return;
+	}
+	int64_t want = slope + ((err_q8 > 0) ? close : -close);
+	if (accel)
+	{
+		const int32_t end_err = end * 256 - x->out_q8;
+		const int64_t v_end = stop_speed((uint32_t)(end_err < 0 ? -end_err : end_err), dv, dt_us);
+		if (end_err >= 0 && want > v_end)
+			want = v_end;
+		else if (end_err <= 0 && want < -v_end)
+			want = -v_end;
+	}
+	if (slew && want > slew)
+		want = slew;
+	else if (slew && want < -(int64_t)slew)
+		want = -(int64_t)slew;
+
+	int64_t rate = want;
+	if (accel)
+	{
+		if (want > x->rate + dv)
+			rate = x->rate + dv;
+		else if (want < x->rate - dv)
+			rate = x->rate - dv;
+	}
+
+	int64_t out = x->out_q8 + rate * dt_us * 256 / 1000000;
+	// Land on a reference that is standing still if both the shortened last step and the stop after it
+	// are within the acceleration limit. Otherwise (the reference stopped short of where it was
+	// heading) go past and come back.
+	const int64_t land = (int64_t)err_q8 * 1000000 / 256 / dt_us;
+	const bool can_stop = !accel || (llabs(land) <= dv && llabs(land - x->rate) <= dv);
+	if (slope == 0 && can_stop && ((err_q8 > 0 && out >= ref_q8) || (err_q8 < 0 && out <= ref_q8) || err_q8 == 0))
+	{
+		out = ref_q8;
+		rate = 0;
+	}
+	if (out > (int64_t)RC_AXIS_MAX * 256)
+		out = (int64_t)RC_AXIS_MAX * 256;
+	else if (out < (int64_t)RC_AXIS_MIN * 256)
+		out = (int64_t)RC_AXIS_MIN * 256;
+	x->out_q8 = (int32_t)out;
+	x->rate = (int32_t)rate;
+}
+
+static void axis_segment(const actuator_t *a, act_axis_t *x, int32_t sp, int64_t now_us, bool jump)
+{
+	const int32_t from = jump ? sp : axis_ref(a, x, now_us, NULL, NULL);
+	// Only a move that continues the previous one is a trend worth extrapolating; a lone step
+	// (legacy STEER, a tap on a key) is not.
+	const int32_t prev = x->to - x->from;
+	const int32_t next = sp - from;
+	if (jump || (prev > 0) != (next > 0) || prev == 0 || next == 0)
+		x->trend = 0;
+	else
+		x->trend = (abs(next) < abs(prev)) ? next : prev;
+	x->from = from;
+	x->to = sp;
+	x->t0_us = now_us;
+}
+
+void actuator_init(actuator_t *a, const act_config_t *cfg, int64_t now_us)
+{
+	memset(a, 0, sizeof(*a));
+	a->cfg = *cfg;
+	if (a->cfg.period_us == 0)
+		a->cfg.period_us = 5000;
+	if (a->cfg.interval_us < a->cfg.period_us)
+		a->cfg.interval_us = a->cfg.period_us;
+	a->throttle.lim = cfg->throttle;
+	a->steer.lim = cfg->steer;
+	a->interval_us = a->cfg.interval_us;
+	a->brake = true;
+	a->last_tick_us = now_us;
+	a->throttle.t0_us = now_us;
+	a->steer.t0_us = now_us;
+	a->stats.interval_us = a->interval_us;
+}
+
+void actuator_setpoint(actuator_t *a, const rc_control_t *ctrl, int64_t now_us)
+{
+	if (a->have_packet && !a->failsafe)
+	{
+		int64_t dt = now_us - a->last_rx_us;
+		if (dt > (int64_t)a->interval_us + a->cfg.extrapolate_us)
+			a->stats.late_packets++;
+		// A pause or a burst says nothing about the sender's rate.
+		const int64_t max_iv = 4 * (int64_t)a->cfg.interval_us;
+		if (dt > max_iv)
+			dt = max_iv;
+		if (dt < a->cfg.period_us)
+			dt = a->cfg.period_us;
+		a->interval_us = (uint32_t)((int64_t)a->interval_us + (dt - (int64_t)a->interval_us) / 8);
+	}
+	a->have_packet = true;
+	a->failsafe = false;
+	a->last_rx_us = now_us;
+	a->stats.packets++;
+	a->stats.interval_us = a->interval_us;
+
+	a->brake = (ctrl->flags & RC_CTRL_FLAG_BRAKE) != 0;
+	// Braking doesn't wait for interpolation.
+	axis_segment(a, &a->throttle, a->brake ? 0 : ctrl->throttle, now_us, a->brake);
+	axis_segment(a, &a->steer, ctrl->steer, now_us, false);
+}
+
+void actuator_override(actuator_t *a, const rc_control_t *ctrl, int64_t now_us)
+{
+	if (!a->have_packet || a->failsafe)
+		return;
+	const bool brake = (ctrl->flags & RC_CTRL_FLAG_BRAKE) != 0;
+	if (brake != a->brake)
+	{
+		a->brake = brake;
+		axis_segment(a, &a->throttle, brake ? 0 : ctrl->throttle, now_us, brake);
+	}
+	axis_segment(a, &a->steer, ctrl->steer, now_us, false);
+}
+
+void actuator_stop(actuator_t *a, int64_t now_us)
+{
+	act_axis_t *axes[2] = {&a->throttle, &a->steer};
+	for (int i = 0; i < 2; i++)
+	{
+		axis_segment(a, axes[i], 0, now_us, true);
+		axes[i]->out_q8 = 0;
+		axes[i]->rate = 0;
+	}
+	a->brake = true;
+	a->have_packet = false;
+	a->failsafe = false;
+}
+
+act_output_t actuator_tick(actuator_t *a, int64_t now_us)
+{
+	int64_t dt = now_us - a->last_tick_us;
+	if (dt < 0)
+		dt = 0;
+	if (dt > ACT_MAX_DT_US)
+		dt = ACT_MAX_DT_US;
+	a->last_tick_us = now_us;
+	a->stats.ticks++;
+
+	if (a->have_packet && !a->failsafe)
+	{
+		const int64_t since = now_us - a->last_rx_us;
+		if (since > a->cfg.timeout_us)
+		{
+			// Sender gone: same as a brake packet with both axes at 0.
+			a->failsafe = true;
+			a->brake = true;
+			a->stats.failsafes++;
+			axis_segment(a, &a->throttle, 0, now_us, true);
+			axis_segment(a, &a->steer, 0, now_us, true);
+		}
+		else if (since > (int64_t)a->interval_us + a->cfg.extrapolate_us)
+		{
+			a->stats.held++;
+		}
+		else if (since > a->interval_us)
+		{
+			a->stats.extrapolated++;
+		}
+	}
+
+	int32_t slope, end;
+	const int32_t t_ref = axis_ref(a, &a->throttle, now_us, &slope, &end);
+	if (a->brake && a->cfg.brake_slew == 0)
+	{
+		a->throttle.out_q8 = 0;
+		a->throttle.rate = 0;
+	}
+	else if (a->brake)
+	{
+		axis_step(&a->throttle, t_ref, slope, end, (uint32_t)dt, a->cfg.brake_slew, 0);
+	}
+	else
+	{
+		axis_step(&a->throttle, t_ref, slope, end, (uint32_t)dt, a->throttle.lim.slew, a->throttle.lim.accel);
+	}
+	const int32_t s_ref = axis_ref(a, &a->steer, now_us, &slope, &end);
+	axis_step(&a->steer, s_ref, slope, end, (uint32_t)dt, a->steer.lim.slew, a->steer.lim.accel);
+
+	const act_output_t out = {
+		.throttle = (int16_t)axis_out(&a->throttle),
+		.steer = (int16_t)axis_out(&a->steer),
+		.brake = a->brake,
+	};
+	return out;
+}
+
+size_t actuator_json(char *buf, size_t len, const actuator_t *a)
+{
+	const act_stats_t *s = &a->stats;
+	const int n = snprintf(buf, len,
+						   "{\"out_throttle\":%d,\"out_steer\":%d,\"brake\":%s,\"failsafe\":%s,\"rate_hz\":%u,"
+						   "\"interval_ms\":%.1f,\"ticks\":%u,\"packets\":%u,\"late\":%u,\"extrapolated\":%u,"
+						   "\"held\":%u,\"failsafes\":%u}",
+						   (int)axis_out(&a->throttle), (int)axis_out(&a->steer), a->brake ? "true" : "false",
+						   a->failsafe ? "true" : "false", (unsigned)(1000000 / a->cfg.period_us),
+						   (double)s->interval_us / 1000.0, (unsigned)s->ticks, (unsigned)s->packets,
+						   (unsigned)s->late_packets, (unsigned)s->extrapolated, (unsigned)s->held,
+						   (unsigned)s->failsafes);
+	return (n > 0 && (size_t)n < len) ? (size_t)n : 0;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+// Fixed-rate actuation. Portable C (also built on the Linux host).
+//
+// Control setpoints arrive at ~20 Hz with network jitter (and legacy STEER comes in 0..10 steps).
+// actuator_tick() runs at a fixed rate (ACT_RATE_HZ) and turns them into smooth axis outputs:
+// - Interpolation: after each packet the reference moves linearly from the previous setpoint to the
+//   new one over one packet interval (EWMA of the measured interval), arriving when the next
+//   packet is due. This trades one interval of latency for the steps disappearing.
+// - Extrapolation: if the next packet is late, the reference keeps moving for at most
+//   extrapolate_us, then holds. It only continues a trend two packets agree on (the smaller of the
+//   two moves); a lone step is held, not extrapolated. After timeout_us without a packet both axes go to 0 with the brake
+//   flag set (failsafe), exactly as if a brake packet had arrived.
+// - Limits per axis: slew (units/s) and acceleration (units/s^2). The output follows the reference's
+//   slope and plans its deceleration so it doesn't overshoot where the reference comes to rest. BRAKE skips interpolation and the acceleration
+//   limit on throttle and uses brake_slew instead.
+//
+// Integer math only (int64 for intermediate products); each tick is a fixed amount of work plus four
+// bounded integer square roots, no loops over history.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rc_proto.h"
+
+typedef struct
+{
+	uint32_t slew;  // max output change, axis units per second (0 = unlimited)
+	uint32_t accel; // max change of that rate, units per second^2 (0 = unlimited)
+} act_limits_t;
+
+typedef struct
+{
+	uint32_t period_us;      // tick period
+	act_limits_t throttle;
+	act_limits_t steer;
+	uint32_t brake_slew;     // throttle units per second while braking (0 = immediate)
+	uint32_t interval_us;    // initial packet interval estimate
+	uint32_t extrapolate_us; // how far past the expected packet the trend is continued
+	uint32_t timeout_us;     // no packet for this long: failsafe
+} act_config_t;
+
+typedef struct
+{
+	act_limits_t lim;
+	int32_t from;    // reference segment: from -> to over interval starting at t0
+	int32_t to;
+	int32_t trend;   // per-interval move continued past `to` while the next packet is late
+	int64_t t0_us;
+	int32_t out_q8;  // output, axis units * 256
+	int32_t rate;    // output rate, units per second
+} act_axis_t;
+
+typedef struct
+{
+	uint32_t ticks;
+	uint32_t packets;
+	uint32_t extrapolated; // ticks past the expected packet time that continued the trend
+	uint32_t held;         // ticks past the extrapolation window
+	uint32_t failsafes;    // timeouts that forced the brake
+	uint32_t late_packets; // arrived after interval + extrapolate_us
+	uint32_t interval_us;  // current packet interval estimate
+} act_stats_t;
+
+typedef struct
+{
+	int16_t throttle;
+	int16_t steer;
+	bool brake;
+} act_output_t;
+
+typedef struct
+{
+	act_config_t cfg;
+	act_axis_t throttle;
+	act_axis_t steer;
+	bool brake;
+	bool failsafe;
+	bool have_packet;
+	int64_t last_rx_us;
+	int64_t last_tick_us;
+	uint32_t interval_us; // EWMA 1/8
+	act_stats_t stats;
+} actuator_t;
+
+void actuator_init(actuator_t *a, const act_config_t *cfg, int64_t now_us);
+
+// A control packet was applied (arrival time `now_us`). Cheap; may run on another task than the
+// tick if the caller serializes the two.
+void actuator_setpoint(actuator_t *a, const rc_control_t *ctrl, int64_t now_us);
+
+// A setpoint that isn't an operator packet (vision steering): retargets steer, and throttle only if
+// the brake flag changes. The interval estimate and the timeout stay keyed to the last
+// actuator_setpoint(), so the failsafe still fires when the operator goes quiet. Ignored before
+// the first packet and during failsafe.
+void actuator_override(actuator_t *a, const rc_control_t *ctrl, int64_t now_us);
+
+// Advances the outputs to `now_us`. Call every cfg.period_us; a late tick just covers a longer dt.
+act_output_t actuator_tick(actuator_t *a, int64_t now_us);
+
+// Outputs back to 0 at once, brake on (link lost, shutdown).
+void actuator_stop(actuator_t *a, int64_t now_us);
+
+// {"out_throttle":..,"out_steer":..,"brake":..,"interval_ms":..,...}. Returns bytes written, 0 if it didn't fit.
+size_t actuator_json(char *buf, size_t len, const actuator_t *a);
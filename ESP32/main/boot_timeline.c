@@ -0,0 +1,92 @@
+#include "boot_timeline.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "boot";
+
+static const char *const milestone_names[BOOT_MS_COUNT] = {
+	[BOOT_MS_APP_MAIN] = "app_main",
+	[BOOT_MS_NETIF_READY] = "netif_ready",
+	[BOOT_MS_NVS_READY] = "nvs_ready",
+	[BOOT_MS_CREDS_LOADED] = "creds_loaded",
+	[BOOT_MS_HTTPD_READY] = "httpd_ready",
+	[BOOT_MS_WIFI_STARTED] = "wifi_started",
+	[BOOT_MS_STA_GOT_IP] = "sta_got_ip",
+	[BOOT_MS_AP_STARTED] = "ap_started",
+	[BOOT_MS_CAMERA_READY] = "camera_ready",
+	[BOOT_MS_CAMERA_FAILED] = "camera_failed",
+	[BOOT_MS_FIRST_FRAME] = "first_frame",
+	[BOOT_MS_DRIVABLE] = "drivable",
+};
+
+// 0 = not reached. esp_timer starts well before app_main, so a real stamp is never 0.
+static int64_t milestone_us[BOOT_MS_COUNT];
+static portMUX_TYPE timeline_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void boot_timeline_mark(boot_milestone_t ms)
+{
+	if ((unsigned)ms >= BOOT_MS_COUNT)
+		return;
+
+	const int64_t now = esp_timer_get_time();
+	bool first = false;
+	bool drivable = false;
+
+	portENTER_CRITICAL(&timeline_lock);
+	if (milestone_us[ms] == 0)
+	{
+		milestone_us[ms] = now;
+		first = true;
+	}
+	if (milestone_us[BOOT_MS_DRIVABLE] == 0 && milestone_us[BOOT_MS_HTTPD_READY] != 0 &&
+		(milestone_us[BOOT_MS_STA_GOT_IP] != 0 || milestone_us[BOOT_MS_AP_STARTED] != 0))
+	{
+		milestone_us[BOOT_MS_DRIVABLE] = now;
+		drivable = true;
+	}
+	portEXIT_CRITICAL(&timeline_lock);
+
+	if (first)
+		ESP_LOGI(TAG, "%-13s +%lld ms", milestone_names[ms], (long long)(now / 1000));
+	if (drivable)
+		ESP_LOGI(TAG, "Drivable after %lld ms", (long long)(now / 1000));
+}
+
+int64_t boot_timeline_get_us(boot_milestone_t ms)
+{
+	if ((unsigned)ms >= BOOT_MS_COUNT)
+		return -1;
+	portENTER_CRITICAL(&timeline_lock);
+	const int64_t us = milestone_us[ms];
+	portEXIT_CRITICAL(&timeline_lock);
+	return (us != 0) ? us : -1;
+}
+
+size_t boot_timeline_to_json(char *buf, size_t len)
+{
+	if (!buf || len == 0)
+		return 0;
+
+	size_t off = 0;
+	off += snprintf(buf + off, len - off, "{\"now_us\":%lld,\"milestones\":{",
+					(long long)esp_timer_get_time());
+	for (int i = 0; i < BOOT_MS_COUNT && off < len; i++)
+	{
+		const int64_t us = boot_timeline_get_us((boot_milestone_t)i);
+		const char *comma = (i == 0) ? "" : ",";
+		if (us < 0)
+			off += snprintf(buf + off, len - off, "%s\"%s\":null", comma, milestone_names[i]);
+		else
+			off += snprintf(buf + off, len - off, "%s\"%s\":%lld", comma, milestone_names[i],
+							(long long)us);
+	}
+	if (off < len)
+		off += snprintf(buf + off, len - off, "}}");
+	return (off < len) ? off : len - 1;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Boot milestones, roughly in the order they are reached. Each one is stamped once (first call
+// wins) with esp_timer time, i.e. microseconds since the chip came out of reset.
+typedef enum
+{
+	BOOT_MS_APP_MAIN = 0,
+	BOOT_MS_NETIF_READY,
+	BOOT_MS_NVS_READY,
+	BOOT_MS_CREDS_LOADED,
+	BOOT_MS_HTTPD_READY,
+	BOOT_MS_WIFI_STARTED,
+	BOOT_MS_STA_GOT_IP,
+	BOOT_MS_AP_STARTED,
+	BOOT_MS_CAMERA_READY,
+	BOOT_MS_CAMERA_FAILED,
+	BOOT_MS_FIRST_FRAME,
+	// Derived: WS server is up and a link (STA IP or SoftAP) exists, so the car accepts control.
+	BOOT_MS_DRIVABLE,
+	BOOT_MS_COUNT,
+} boot_milestone_t;
+
+void boot_timeline_mark(boot_milestone_t ms);
+
+// Returns the timestamp in microseconds, or -1 if the milestone was not reached (yet).
+int64_t boot_timeline_get_us(boot_milestone_t ms);
+
+// Writes the timeline as a JSON object. Returns the number of chars written (excluding NUL).
+size_t boot_timeline_to_json(char *buf, size_t len);
@@ -0,0 +1,142 @@
+#include "cam_supervisor.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static uint32_t ms_since(int64_t since_us, int64_t now_us)
+{
+	const int64_t ms = (now_us - since_us) / 1000;
+	return (ms < 0) ? 0 : (ms > UINT32_MAX) ? UINT32_MAX : (uint32_t)ms;
+}
+
+// The driver is down (stall or failed init): schedule the next attempt and grow the backoff.
+static void schedule_reinit(cam_supervisor_t *s, int64_t now_us)
+{
+	s->driver_up = false;
+	s->bad_streak = 0;
+	s->next_init_us = now_us + s->backoff_us;
+	const uint64_t next = (uint64_t)s->backoff_us * 2;
+	s->backoff_us = (next > s->cfg.backoff_max_us) ? s->cfg.backoff_max_us : (uint32_t)next;
+	if (s->backoff_us == 0)
+		s->backoff_us = s->cfg.backoff_min_us;
+}
+
+void cam_supervisor_init(cam_supervisor_t *s, const cam_sup_config_t *cfg, int64_t now_us)
+{
+	memset(s, 0, sizeof(*s));
+	s->cfg = *cfg;
+	if (s->cfg.stall_grabs == 0)
+		s->cfg.stall_grabs = 1;
+	if (s->cfg.backoff_max_us < s->cfg.backoff_min_us)
+		s->cfg.backoff_max_us = s->cfg.backoff_min_us;
+	s->state = CAM_SUP_STARTING;
+	s->backoff_us = s->cfg.backoff_min_us;
+	s->next_init_us = now_us;
+	s->down_since_us = now_us;
+}
+
+cam_sup_action_t cam_supervisor_next(const cam_supervisor_t *s, int64_t now_us, uint32_t *wait_us)
+{
+	if (s->driver_up)
+		return CAM_SUP_GRAB;
+	if (now_us >= s->next_init_us)
+		return CAM_SUP_REINIT;
+	if (wait_us)
+		*wait_us = (uint32_t)(s->next_init_us - now_us);
+	return CAM_SUP_WAIT;
+}
+
+void cam_supervisor_init_result(cam_supervisor_t *s, bool ok, int64_t now_us)
+{
+	s->stats.inits++;
+	if (ok)
+	{
+		s->driver_up = true;
+		s->bad_streak = 0;
+		return;
+	}
+	s->stats.init_failures++;
+	if (s->state == CAM_SUP_RUNNING)
+	{
+		s->state = CAM_SUP_RECOVERING;
+		s->down_since_us = now_us;
+	}
+	schedule_reinit(s, now_us);
+}
+
+bool cam_supervisor_grab(cam_supervisor_t *s, bool ok, uint32_t get_us, int64_t now_us)
+{
+	cam_sup_stats_t *st = &s->stats;
+	st->grabs++;
+	if (!ok)
+		st->failed_grabs++;
+	else if (get_us > s->cfg.slow_us)
+		st->slow_grabs++;
+	if (ok)
+	{
+		st->get_us_avg = (st->get_us_avg == 0) ? get_us : st->get_us_avg - st->get_us_avg / 8 + get_us / 8;
+		if (get_us > st->get_us_max)
+			st->get_us_max = get_us;
+	}
+
+	if (ok && get_us <= s->cfg.slow_us)
+	{
+		s->bad_streak = 0;
+		if (s->state == CAM_SUP_RECOVERING)
+		{
+			const uint32_t ms = ms_since(s->down_since_us, now_us);
+			st->recoveries++;
+			st->recovery_ms_last = ms;
+			if (ms > st->recovery_ms_max)
+				st->recovery_ms_max = ms;
+		}
+		s->state = CAM_SUP_RUNNING;
+		s->backoff_us = s->cfg.backoff_min_us;
+		return false;
+	}
+
+	if (s->bad_streak++ == 0)
+		s->bad_since_us = now_us - get_us;
+	if (s->bad_streak < s->cfg.stall_grabs && now_us - s->bad_since_us < (int64_t)s->cfg.stall_us)
+		return false;
+
+	// A driver that was re-initialized but never delivered keeps its recovery start (and its
+	// backoff keeps growing); a stall of a running camera starts a new recovery.
+	st->stalls++;
+	if (s->state == CAM_SUP_RUNNING)
+	{
+		s->state = CAM_SUP_RECOVERING;
+		s->down_since_us = s->bad_since_us;
+	}
+	schedule_reinit(s, now_us);
+	return true;
+}
+
+const char *cam_sup_state_name(cam_sup_state_t state)
+{
+	switch (state)
+	{
+	case CAM_SUP_STARTING: return "starting";
+	case CAM_SUP_RUNNING: return "running";
+	case CAM_SUP_RECOVERING: return "recovering";
+	}
+	return "unknown";
+}
+
+size_t cam_supervisor_json(char *buf, size_t len, const cam_supervisor_t *s, int64_t now_us)
+{
+	const cam_sup_stats_t *st = &s->stats;
+	const uint32_t down_ms = (s->state == CAM_SUP_RUNNING) ? 0 : ms_since(s->down_since_us, now_us);
+	const int n = snprintf(buf, len,
+						   "{\"state\":\"%s\",\"driver_up\":%s,\"down_ms\":%u,\"grabs\":%u,\"failed\":%u,"
+						   "\"slow\":%u,\"get_ms_avg\":%.1f,\"get_ms_max\":%.1f,\"stalls\":%u,\"inits\":%u,"
+						   "\"init_failures\":%u,\"recoveries\":%u,\"recovery_ms_last\":%u,\"recovery_ms_max\":%u,"
+						   "\"backoff_ms\":%u}",
+						   cam_sup_state_name(s->state), s->driver_up ? "true" : "false", (unsigned)down_ms,
+						   (unsigned)st->grabs, (unsigned)st->failed_grabs, (unsigned)st->slow_grabs,
+						   (double)st->get_us_avg / 1000.0, (double)st->get_us_max / 1000.0, (unsigned)st->stalls,
+						   (unsigned)st->inits, (unsigned)st->init_failures, (unsigned)st->recoveries,
+						   (unsigned)st->recovery_ms_last, (unsigned)st->recovery_ms_max,
+						   (unsigned)(s->backoff_us / 1000));
+	return (n > 0 && (size_t)n < len) ? (size_t)n : 0;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+// Camera supervisor. Portable C (also built on the Linux host).
+//
+// Decides when the camera task grabs frames and when it tears the driver down and initializes it
+// again; the task does the actual esp_camera_* calls and reports back:
+// - every grab with its esp_camera_fb_get() time and whether a frame came back. A grab that fails or
+//   takes longer than slow_us is bad; stall_grabs bad grabs in a row, or bad grabs for stall_us
+//   (one hung fb_get that times out after seconds is enough), is a stall
+// - after a stall or a failed init the driver is re-initialized after a backoff delay that starts at
+//   backoff_min_us and doubles per failed attempt up to backoff_max_us. An init that succeeds but
+//   still doesn't deliver frames counts as failed; the first good frame resets the backoff and ends
+//   the recovery (recovery time = first bad grab -> first good frame)
+// - it never gives up: a camera that fails at boot keeps being retried at backoff_max_us
+//
+// Not thread-safe; main.c serializes access with a spinlock (all calls are O(1)).
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+	uint32_t slow_us;        // fb_get slower than this counts as a bad grab
+	uint32_t stall_grabs;    // bad grabs in a row that make a stall
+	uint32_t stall_us;       // or bad grabs for this long
+	uint32_t backoff_min_us; // delay before the first re-init after a stall
+	uint32_t backoff_max_us;
+} cam_sup_config_t;
+
+typedef enum
+{
+	CAM_SUP_STARTING = 0, // no frame yet since boot
+	CAM_SUP_RUNNING,
+	CAM_SUP_RECOVERING, // stall or failed re-init, waiting for a frame again
+} cam_sup_state_t;
+
+// What the camera task should do next.
+typedef enum
+{
+	CAM_SUP_GRAB = 0, // driver is up: grab frames (if anyone wants them)
+	CAM_SUP_REINIT,   // deinit (if needed) and init the driver, then report cam_supervisor_init_result()
+	CAM_SUP_WAIT,     // driver is down, next attempt later
+} cam_sup_action_t;
+
+typedef struct
+{
+	uint32_t grabs;
+	uint32_t failed_grabs; // fb_get returned NULL
+	uint32_t slow_grabs;
+	uint32_t get_us_avg;   // EWMA 1/8 of fb_get time (successful grabs)
+	uint32_t get_us_max;
+	uint32_t stalls;
+	uint32_t inits;        // init attempts, boot included
+	uint32_t init_failures;
+	uint32_t recoveries;
+	uint32_t recovery_ms_last;
+	uint32_t recovery_ms_max;
+} cam_sup_stats_t;
+
+typedef struct
+{
+	cam_sup_config_t cfg;
+	cam_sup_state_t state;
+	bool driver_up;        // esp_camera_init succeeded and no stall since
+	uint32_t bad_streak;
+	int64_t bad_since_us;  // start of the first bad grab of the streak
+	int64_t down_since_us; // recovery start
+	int64_t next_init_us;
+	uint32_t backoff_us;   // delay after the next failure
+	cam_sup_stats_t stats;
+} cam_supervisor_t;
+
+void cam_supervisor_init(cam_supervisor_t *s, const cam_sup_config_t *cfg, int64_t now_us);
+
+// Next step for the camera task. For CAM_SUP_WAIT, `wait_us` (optional) gets the time until the next
+// init attempt.
+cam_sup_action_t cam_supervisor_next(const cam_supervisor_t *s, int64_t now_us, uint32_t *wait_us);
+
+// Result of an init attempt (or of a settings re-init the task did on its own; a failure there
+// starts a recovery like a stall does).
+void cam_supervisor_init_result(cam_supervisor_t *s, bool ok, int64_t now_us);
+
+// A grab finished at `now_us` after `get_us` in fb_get; `ok` = a frame came back. Returns true if it
+// completed a stall: the driver is considered down and cam_supervisor_next() schedules a re-init.
+bool cam_supervisor_grab(cam_supervisor_t *s, bool ok, uint32_t get_us, int64_t now_us);
+
+const char *cam_sup_state_name(cam_sup_state_t state);
+
+// {"state":..,"grabs":..,"stalls":..,"recovery_ms_last":..,...}. Returns bytes written, 0 if it didn't fit.
+size_t cam_supervisor_json(char *buf, size_t len, const cam_supervisor_t *s, int64_t now_us);
@@ -0,0 +1,614 @@
+#include "egress.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const egress_class_t PRIORITY[EGRESS_CLASS_COUNT] = {EGRESS_CONTROL, EGRESS_TELEMETRY, EGRESS_VIDEO};
+
+static void note_latency(egress_class_stats_t *st, int64_t lat_us)
+{
+	const uint32_t lat = (lat_us > 0) ? (uint32_t)lat_us : 0;
+	st->lat_avg_us = (st->msgs <= 1) ? lat : st->lat_avg_us - st->lat_avg_us / 8 + lat / 8;
+	if (lat > st->lat_max_us)
+		st->lat_max_us = lat;
+}
+
+static void unref_msg(egress_t *eg, int idx)
+{
+	egress_msg_t *m = &eg->pool[idx];
+	if (m->refs > 0)
+		m->refs--;
+}
+
+static int alloc_msg(egress_t *eg, egress_class_t cls)
+{
+	int found = -1;
+	int free_count = 0;
+	for (int i = 0; i < EGRESS_POOL_SIZE; i++)
+	{
+		if (eg->pool[i].refs == 0)
+		{
+			if (found < 0)
+				found = i;
+			free_count++;
+		}
+	}
+	if (cls != EGRESS_CONTROL && free_count <= EGRESS_POOL_CONTROL_RESERVE)
+		return -1;
+	return found;
+}
+
+static int queue_at(const egress_queue_t *q, int pos)
+{
+	return q->q[(q->head + pos) % EGRESS_QUEUE_MAX];
+}
+
+static void queue_remove_at(egress_t *eg, egress_queue_t *q, int pos)
+{
+	unref_msg(eg, queue_at(q, pos));
+	for (int i = pos; i > 0; i--)
+		q->q[(q->head + i) % EGRESS_QUEUE_MAX] = q->q[(q->head + i - 1) % EGRESS_QUEUE_MAX];
+	q->head = (uint8_t)((q->head + 1) % EGRESS_QUEUE_MAX);
+	q->count--;
+}
+
+static bool video_unref(egress_t *eg)
+{
+	if (eg->video_refs == 0 || --eg->video_refs > 0)
+		return false;
+	eg->video_hdr = NULL;
+	eg->video_data = NULL;
+	eg->video_hdr_len = 0;
+	eg->video_len = 0;
+	memset(&eg->video_abbrev, 0, sizeof(eg->video_abbrev));
+	return true;
+}
+
+// Drops everything the client holds. Returns true if that released the video frame.
+static bool clear_client(egress_t *eg, egress_client_t *c)
+{
+	for (int cls = 0; cls < EGRESS_VIDEO; cls++)
+	{
+		egress_queue_t *q = &c->queue[cls];
+		while (q->count)
+			queue_remove_at(eg, q, 0);
+		q->head = 0;
+	}
+	bool released = false;
+	if (c->video)
+	{
+		c->video = false;
+		released = video_unref(eg);
+	}
+	c->open = false;
+	c->close_pending = false;
+	c->blocked = false;
+	c->inflight = false;
+	c->inflight_pool = -1;
+	c->gen++;
+	return released;
+}
+
+void egress_init(egress_t *eg, const egress_config_t *cfg, uint8_t *scratch, int64_t now_us)
+{
+	memset(eg, 0, sizeof(*eg));
+	eg->cfg = *cfg;
+	eg->scratch = scratch;
+	eg->writable = UINT32_MAX;
+	egress_set_queue_depth(eg, cfg->queue_depth);
+	for (int cls = 0; cls < EGRESS_CLASS_COUNT; cls++)
+	{
+		egress_set_budget(eg, (egress_class_t)cls, cfg->budget[cls]);
+		eg->refill_us[cls] = now_us;
+	}
+	for (int i = 0; i < EGRESS_MAX_CLIENTS; i++)
+		eg->clients[i].inflight_pool = -1;
+}
+
+void egress_set_queue_depth(egress_t *eg, uint8_t depth)
+{
+	if (depth < 1)
+		depth = 1;
+	if (depth > EGRESS_QUEUE_MAX)
+		depth = EGRESS_QUEUE_MAX;
+	eg->cfg.queue_depth = depth;
+}
+
+void egress_set_budget(egress_t *eg, egress_class_t cls, egress_budget_t budget)
+{
+	eg->cfg.budget[cls] = budget;
+	eg->tokens[cls] = budget.burst;
+}
+
+bool egress_client_open(egress_t *eg, int slot, bool chunked)
+{
+	egress_client_t *c = &eg->clients[slot];
+	const bool released = (c->open || c->close_pending) && clear_client(eg, c);
+	c->open = true;
+	c->chunked = chunked;
+	c->want_chunked = chunked;
+	c->abbrev = false;
+	c->tables_id = 0;
+	c->chunk_seq = 0;
+	return released;
+}
+
+void egress_client_set_chunked(egress_t *eg, int slot, bool chunked)
+{
+	egress_client_t *c = &eg->clients[slot];
+	c->want_chunked = chunked;
+	if (!c->video)
+		c->chunked = chunked;
+}
+
+void egress_client_set_abbrev(egress_t *eg, int slot, bool abbrev)
+{
+	egress_client_t *c = &eg->clients[slot];
+	c->abbrev = abbrev;
+	c->tables_id = 0;
+}
+
+bool egress_client_close(egress_t *eg, int slot)
+{
+	egress_client_t *c = &eg->clients[slot];
+	if (!c->open)
+		return false;
+	if (c->inflight)
+	{
+		// The sender is still writing from this client's buffers; egress_done() cleans up.
+		c->open = false;
+		c->close_pending = true;
+		return false;
+	}
+	return clear_client(eg, c);
+}
+
+static uint32_t open_mask(const egress_t *eg, uint32_t mask)
+{
+	uint32_t out = 0;
+	for (int i = 0; i < EGRESS_MAX_CLIENTS; i++)
+		if ((mask & (1u << i)) && eg->clients[i].open)
+			out |= 1u << i;
+	return out;
+}
+
+size_t egress_push(egress_t *eg, uint32_t mask, egress_class_t cls, uint8_t opcode, const void *data, size_t len,
+				   int64_t now_us)
+{
+	mask = open_mask(eg, mask);
+	if (!mask || cls == EGRESS_VIDEO)
+		return 0;
+	const int idx = (len > 0 && len <= EGRESS_MSG_MAX) ? alloc_msg(eg, cls) : -1;
+	if (idx < 0)
+	{
+		eg->stats[cls].dropped += (uint32_t)__builtin_popcount(mask);
+		return 0;
+	}
+
+	egress_msg_t *m = &eg->pool[idx];
+	memcpy(m->data, data, len);
+	m->len = (uint16_t)len;
+	m->opcode = opcode;
+	m->cls = (uint8_t)cls;
+	m->queued_us = now_us;
+	m->refs = 0;
+
+	// Acks always get the whole queue: a client in the middle of a video message can owe several.
+	const uint8_t depth = (cls == EGRESS_CONTROL) ? EGRESS_QUEUE_MAX : eg->cfg.queue_depth;
+	size_t n = 0;
+	for (int i = 0; i < EGRESS_MAX_CLIENTS; i++)
+	{
+		if (!(mask & (1u << i)))
+			continue;
+		egress_client_t *c = &eg->clients[i];
+		egress_queue_t *q = &c->queue[cls];
+		if (q->count >= depth)
+		{
+			// Drop the oldest message that isn't being written right now.
+			const int pos = (c->inflight && c->inflight_pool == queue_at(q, 0)) ? 1 : 0;
+			if (pos < q->count)
+			{
+				queue_remove_at(eg, q, pos);
+				eg->stats[cls].dropped++;
+			}
+			if (q->count >= EGRESS_QUEUE_MAX)
+			{
+				eg->stats[cls].dropped++;
+				continue;
+			}
+		}
+		q->q[(q->head + q->count) % EGRESS_QUEUE_MAX] = (int8_t)idx;
+		q->count++;
+		m->refs++;
+		n++;
+	}
+	return n;
+}
+
+static bool video_submit(egress_t *eg, uint32_t mask, const uint8_t *hdr, size_t hdr_len, const uint8_t *data,
+						 size_t len, const egress_jpeg_abbrev_t *abbrev, int64_t now_us)
+{
+	if (eg->video_refs > 0 || !data || len == 0)
+		return false;
+	mask = open_mask(eg, mask);
+	if (!mask)
+		return false;
+
+	eg->video_hdr = hdr;
+	eg->video_hdr_len = hdr ? hdr_len : 0;
+	eg->video_data = data;
+	eg->video_len = len;
+	eg->video_queued_us = now_us;
+	const bool can_abbrev = abbrev && abbrev->tables && abbrev->ref && abbrev->scan_off > 0 && abbrev->scan_off < len;
+	if (can_abbrev)
+		eg->video_abbrev = *abbrev;
+	else
+		memset(&eg->video_abbrev, 0, sizeof(eg->video_abbrev));
+	for (int i = 0; i < EGRESS_MAX_CLIENTS; i++)
+	{
+		if (!(mask & (1u << i)))
+			continue;
+		egress_client_t *c = &eg->clients[i];
+		c->video = true;
+		c->video_abbrev = can_abbrev && c->abbrev;
+		if (c->video_abbrev)
+			c->video_part = (c->tables_id != abbrev->id) ? EGRESS_PART_TABLES : EGRESS_PART_HEADER;
+		else
+			c->video_part = (eg->video_hdr_len > 0) ? EGRESS_PART_HEADER : EGRESS_PART_DATA;
+		c->video_base = c->video_abbrev ? abbrev->scan_off : 0;
+		c->video_off = 0;
+		c->chunked = c->want_chunked;
+		eg->video_refs++;
+	}
+	return true;
+}
+
+bool egress_video_submit(egress_t *eg, uint32_t mask, const uint8_t *hdr, size_t hdr_len, const uint8_t *data,
+						 size_t len, int64_t now_us)
+{
+	return video_submit(eg, mask, hdr, hdr_len, data, len, NULL, now_us);
+}
+
+bool egress_video_submit_jpeg(egress_t *eg, uint32_t mask, const uint8_t *jpeg, size_t len,
+							  const egress_jpeg_abbrev_t *abbrev, int64_t now_us)
+{
+	return video_submit(eg, mask, NULL, 0, jpeg, len, abbrev, now_us);
+}
+
+// A non-chunked client in the middle of a fragmented video message can't take other data frames.
+static bool mid_message(const egress_client_t *c)
+{
+	return c->video && !c->chunked && c->video_off > 0;
+}
+
+static bool stalled(const egress_t *eg, const egress_client_t *c, int64_t now_us)
+{
+	return eg->cfg.stall_us && c->blocked && now_us - c->blocked_since_us >= (int64_t)eg->cfg.stall_us;
+}
+
+bool egress_set_writable(egress_t *eg, uint32_t writable, int64_t now_us)
+{
+	eg->writable = writable;
+	bool released = false;
+	for (int i = 0; i < EGRESS_MAX_CLIENTS; i++)
+	{
+		egress_client_t *c = &eg->clients[i];
+		if (!c->open || c->inflight)
+			continue;
+		if (writable & (1u << i))
+		{
+			c->blocked = false;
+			continue;
+		}
+		if (!c->blocked)
+		{
+			c->blocked = true;
+			c->blocked_since_us = now_us;
+		}
+		// Between messages the rest of the frame can be skipped; the client picks up a later one.
+		if (c->video && !mid_message(c) && stalled(eg, c, now_us))
+		{
+			c->video = false;
+			c->video_off = 0;
+			eg->stats[EGRESS_VIDEO].dropped++;
+			released |= video_unref(eg);
+		}
+	}
+	return released;
+}
+
+static bool client_has_work(const egress_client_t *c, egress_class_t cls)
+{
+	if (!c->open || c->inflight)
+		return false;
+	if (cls == EGRESS_VIDEO)
+		return c->video;
+	return c->queue[cls].count > 0 && !mid_message(c);
+}
+
+// Work that can go out now: the socket takes data, or it's the rest of a video message that
+// can't be skipped and has waited stall_us already.
+static bool client_ready(const egress_t *eg, int slot, egress_class_t cls, int64_t now_us)
+{
+	const egress_client_t *c = &eg->clients[slot];
+	if (!client_has_work(c, cls))
+		return false;
+	return (eg->writable & (1u << slot)) || (cls == EGRESS_VIDEO && mid_message(c) && stalled(eg, c, now_us));
+}
+
+// Picks the client to serve in `cls`: round-robin, except that a non-chunked client whose acks are
+// held up behind its current video message gets that message finished first.
+static int pick_client(const egress_t *eg, egress_class_t cls, int64_t now_us)
+{
+	if (cls == EGRESS_VIDEO)
+	{
+		for (int i = 0; i < EGRESS_MAX_CLIENTS; i++)
+		{
+			const egress_client_t *c = &eg->clients[i];
+			if (client_ready(eg, i, cls, now_us) && mid_message(c) && c->queue[EGRESS_CONTROL].count > 0)
+				return i;
+		}
+	}
+	for (int n = 0; n < EGRESS_MAX_CLIENTS; n++)
+	{
+		const int i = (eg->rr[cls] + n) % EGRESS_MAX_CLIENTS;
+		if (client_ready(eg, i, cls, now_us))
+			return i;
+	}
+	return -1;
+}
+
+static bool blocked_work(const egress_t *eg)
+{
+	for (int i = 0; i < EGRESS_MAX_CLIENTS; i++)
+		for (int cls = 0; cls < EGRESS_CLASS_COUNT; cls++)
+			if (client_has_work(&eg->clients[i], (egress_class_t)cls))
+				return true;
+	return false;
+}
+
+static void refill(egress_t *eg, int64_t now_us)
+{
+	for (int cls = 0; cls < EGRESS_CLASS_COUNT; cls++)
+	{
+		const egress_budget_t *b = &eg->cfg.budget[cls];
+		if (b->rate_bps == 0)
+			continue;
+		// Only the time that produced whole bytes is consumed, so frequent calls don't lose tokens.
+		const int64_t add = (int64_t)b->rate_bps * (now_us - eg->refill_us[cls]) / 1000000;
+		if (add <= 0)
+			continue;
+		eg->tokens[cls] += add;
+		eg->refill_us[cls] += add * 1000000 / b->rate_bps;
+		if (eg->tokens[cls] >= (int64_t)b->burst)
+		{
+			eg->tokens[cls] = b->burst;
+			eg->refill_us[cls] = now_us;
+		}
+	}
+}
+
+static void build_video_tx(egress_t *eg, egress_client_t *c, egress_tx_t *tx)
+{
+	tx->opcode = EGRESS_WS_BINARY;
+	tx->fragmented = false;
+	tx->final = true;
+	if (c->video_part == EGRESS_PART_TABLES)
+	{
+		tx->data = eg->video_abbrev.tables;
+		tx->len = eg->video_abbrev.tables_len;
+		tx->msg_len = tx->len;
+		return;
+	}
+	if (c->video_part == EGRESS_PART_HEADER)
+	{
+		tx->data = c->video_abbrev ? eg->video_abbrev.ref : eg->video_hdr;
+		tx->len = c->video_abbrev ? eg->video_abbrev.ref_len : eg->video_hdr_len;
+		tx->msg_len = tx->len;
+		return;
+	}
+
+	const uint8_t *data = eg->video_data + c->video_base;
+	const size_t total = eg->video_len - c->video_base;
+	const size_t frag = eg->cfg.fragment_bytes ? eg->cfg.fragment_bytes : total;
+	const size_t left = total - c->video_off;
+	const size_t n = (left < frag) ? left : frag;
+	const bool last = (n == left);
+	if (c->chunked)
+	{
+		if (c->video_off == 0)
+			c->chunk_seq++;
+		(void)rc_chunk_write_header(eg->scratch, RC_FRAME_CHUNK_HDR_LEN, c->chunk_seq, (uint32_t)c->video_off, last);
+		memcpy(eg->scratch + RC_FRAME_CHUNK_HDR_LEN, data + c->video_off, n);
+		tx->data = eg->scratch;
+		tx->len = n + RC_FRAME_CHUNK_HDR_LEN;
+		tx->msg_len = tx->len;
+		return;
+	}
+
+	tx->data = data + c->video_off;
+	tx->len = n;
+	if (c->video_off == 0 && last)
+	{
+		tx->msg_len = n;
+		return;
+	}
+	tx->fragmented = true;
+	tx->opcode = (c->video_off == 0) ? EGRESS_WS_BINARY : EGRESS_WS_CONTINUE;
+	tx->final = last;
+	tx->msg_len = last ? total : 0;
+}
+
+egress_next_t egress_next(egress_t *eg, int64_t now_us, egress_tx_t *tx, int64_t *wait_us)
+{
+	refill(eg, now_us);
+	int64_t wait = -1;
+	for (int p = 0; p < EGRESS_CLASS_COUNT; p++)
+	{
+		const egress_class_t cls = PRIORITY[p];
+		const int slot = pick_client(eg, cls, now_us);
+		if (slot < 0)
+			continue;
+
+		const egress_budget_t *b = &eg->cfg.budget[cls];
+		if (b->rate_bps && eg->tokens[cls] <= 0)
+		{
+			// Over budget: lower classes may still use theirs.
+			const int64_t w = (1 - eg->tokens[cls]) * 1000000 / b->rate_bps + 1;
+			if (wait < 0 || w < wait)
+				wait = w;
+			continue;
+		}
+
+		egress_client_t *c = &eg->clients[slot];
+		memset(tx, 0, sizeof(*tx));
+		tx->slot = slot;
+		tx->cls = cls;
+		tx->gen = c->gen;
+		tx->pool = -1;
+		if (cls == EGRESS_VIDEO)
+		{
+			build_video_tx(eg, c, tx);
+		}
+		else
+		{
+			const int idx = queue_at(&c->queue[cls], 0);
+			const egress_msg_t *m = &eg->pool[idx];
+			tx->pool = (int8_t)idx;
+			tx->opcode = m->opcode;
+			tx->final = true;
+			tx->data = m->data;
+			tx->len = m->len;
+			tx->msg_len = m->len;
+			c->inflight_pool = (int8_t)idx;
+		}
+		if (b->rate_bps)
+			eg->tokens[cls] -= (int64_t)tx->len;
+		c->inflight = true;
+		eg->rr[cls] = (slot + 1) % EGRESS_MAX_CLIENTS;
+		return EGRESS_SEND;
+	}
+
+	if (blocked_work(eg) && (wait < 0 || wait > EGRESS_POLL_US))
+		wait = EGRESS_POLL_US;
+	if (wait < 0)
+		return EGRESS_IDLE;
+	if (wait_us)
+		*wait_us = wait;
+	return EGRESS_WAIT;
+}
+
+bool egress_done(egress_t *eg, const egress_tx_t *tx, bool ok, int64_t now_us)
+{
+	egress_client_t *c = &eg->clients[tx->slot];
+	if (tx->gen != c->gen)
+		return false; // slot was reopened; the old client's state is gone
+	c->inflight = false;
+	c->inflight_pool = -1;
+	if (c->close_pending)
+		return clear_client(eg, c);
+
+	egress_class_stats_t *st = &eg->stats[tx->cls];
+	if (ok)
+	{
+		st->bytes += tx->len;
+		if (tx->final)
+			st->msgs++;
+	}
+	else
+	{
+		st->failed++;
+	}
+
+	if (tx->cls != EGRESS_VIDEO)
+	{
+		egress_queue_t *q = &c->queue[tx->cls];
+		if (ok)
+			note_latency(st, now_us - eg->pool[tx->pool].queued_us);
+		if (q->count && queue_at(q, 0) == tx->pool)
+			queue_remove_at(eg, q, 0);
+		return false;
+	}
+
+	if (!c->video)
+		return false;
+	if (!ok)
+	{
+		// The connection is most likely gone; skip the rest of the frame for this client.
+		c->video = false;
+		return video_unref(eg);
+	}
+	if (c->video_part == EGRESS_PART_TABLES)
+	{
+		c->tables_id = eg->video_abbrev.id;
+		c->video_part = EGRESS_PART_HEADER;
+		eg->abbrev.tables++;
+		eg->abbrev.saved_bytes -= (int64_t)tx->len;
+		return false;
+	}
+	if (c->video_part == EGRESS_PART_HEADER)
+	{
+		c->video_part = EGRESS_PART_DATA;
+		c->video_off = 0;
+		return false;
+	}
+	c->video_off += c->chunked ? tx->len - RC_FRAME_CHUNK_HDR_LEN : tx->len;
+	if (c->video_off < eg->video_len - c->video_base)
+		return false;
+	if (c->video_abbrev)
+	{
+		eg->abbrev.frames++;
+		eg->abbrev.saved_bytes += (int64_t)eg->video_abbrev.scan_off - (int64_t)eg->video_abbrev.ref_len;
+	}
+	c->video = false;
+	c->video_off = 0;
+	note_latency(st, now_us - eg->video_queued_us);
+	return video_unref(eg);
+}
+
+const char *egress_class_name(egress_class_t cls)
+{
+	switch (cls)
+	{
+	case EGRESS_CONTROL:
+		return "control";
+	case EGRESS_TELEMETRY:
+		return "telemetry";
+	case EGRESS_VIDEO:
+		return "video";
+	default:
+		return "?";
+	}
+}
+
+size_t egress_json(char *buf, size_t len, const egress_t *eg)
+{
+	int free_msgs = 0;
+	for (int i = 0; i < EGRESS_POOL_SIZE; i++)
+		free_msgs += eg->pool[i].refs == 0;
+
+	int n = snprintf(buf, len, "{\"fragment_bytes\":%u,\"queue_depth\":%u,\"pool_free\":%d",
+					 (unsigned)eg->cfg.fragment_bytes, (unsigned)eg->cfg.queue_depth, free_msgs);
+	if (n < 0 || (size_t)n >= len)
+		return 0;
+	size_t off = (size_t)n;
+	for (int cls = 0; cls < EGRESS_CLASS_COUNT; cls++)
+	{
+		const egress_class_stats_t *st = &eg->stats[cls];
+		n = snprintf(buf + off, len - off,
+					 ",\"%s\":{\"rate_bps\":%lu,\"msgs\":%llu,\"bytes\":%llu,\"dropped\":%lu,\"failed\":%lu,"
+					 "\"lat_avg_us\":%lu,\"lat_max_us\":%lu}",
+					 egress_class_name((egress_class_t)cls), (unsigned long)eg->cfg.budget[cls].rate_bps,
+					 (unsigned long long)st->msgs, (unsigned long long)st->bytes, (unsigned long)st->dropped,
+					 (unsigned long)st->failed, (unsigned long)st->lat_avg_us, (unsigned long)st->lat_max_us);
+		if (n < 0 || (size_t)n >= len - off)
+			return 0;
+		off += (size_t)n;
+	}
+	n = snprintf(buf + off, len - off, ",\"jpeg_abbrev\":{\"frames\":%llu,\"tables\":%lu,\"saved_bytes\":%lld}}",
+				 (unsigned long long)eg->abbrev.frames, (unsigned long)eg->abbrev.tables,
+				 (long long)eg->abbrev.saved_bytes);
+	if (n < 0 || (size_t)n >= len - off)
+		return 0;
+	return off + (size_t)n;
+}
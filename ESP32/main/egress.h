@@ -0,0 +1,250 @@
+#pragma once
+
+// WebSocket egress scheduler. Portable C (also built on the Linux host); not thread-safe, callers
+// serialize access and do the actual socket writes outside their lock.
+//
+// Outbound traffic is split into priority classes:
+// - control:   HELLO_ACK / ACK (a few bytes, latency-critical)
+// - telemetry: JSON text frames
+// - video:     one frame at a time (optional RAWH header message + payload message), shared by all
+//              subscribers and referenced, not copied. Clients with RC_CAP_VIDEO_JPEG_ABBREV get
+//              JPEG frames as JTAB (only when their tables are stale) + JREF + scan data instead
+// Small messages are copied into a shared pool and queued per client. Video is sent in fragments of
+// `fragment_bytes`, so one sender serves every client's queue between fragments instead of being
+// stuck in a 100 KB write. For clients with RC_CAP_VIDEO_CHUNKED each fragment is a complete
+// message with a chunk header (rc_frame.h) and control/telemetry can go out between the chunks of a
+// frame; other clients get WS continuation frames, so their small messages wait for the end of the
+// current video message (RFC 6455 doesn't allow data frames inside a fragmented message).
+//
+// egress_next() picks the highest class that has both work and budget (token bucket per class,
+// deficit allowed so a fragment larger than the burst still goes out) and rotates between clients
+// within a class.
+//
+// The caller reports which sockets can take data (egress_set_writable) before each egress_next(), so
+// writes never wait on a slow reader: blocked clients are skipped and everyone else, acks first,
+// keeps flowing. A client blocked for `stall_us` gives up the current video frame at the next
+// message boundary (the frame goes back to the camera, the client gets a later one). Only a
+// non-chunked client in the middle of a video message can't be skipped; past `stall_us` it is handed
+// its next fragment anyway and the caller's send timeout decides.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rc_frame.h"
+
+#ifndef EGRESS_MAX_CLIENTS
+#define EGRESS_MAX_CLIENTS 8
+#endif
+// Pool of small messages shared by all clients; a broadcast takes one entry.
+#ifndef EGRESS_POOL_SIZE
+#define EGRESS_POOL_SIZE 16
+#endif
+#ifndef EGRESS_MSG_MAX
+#define EGRESS_MSG_MAX 512
+#endif
+// Per-client queue capacity per small class (the runtime depth limit is at most this).
+#define EGRESS_QUEUE_MAX 8
+// Pool entries telemetry can't take, so acks still get through when telemetry backs up.
+#define EGRESS_POOL_CONTROL_RESERVE 2
+// While work waits only on blocked sockets, egress_next() asks to be called again after this long.
+#define EGRESS_POLL_US 5000
+
+typedef enum
+{
+	EGRESS_CONTROL = 0,
+	EGRESS_TELEMETRY,
+	EGRESS_VIDEO,
+	EGRESS_CLASS_COUNT,
+} egress_class_t;
+
+// WS opcodes of the frames egress_next() asks the caller to send.
+#define EGRESS_WS_CONTINUE 0x0
+#define EGRESS_WS_TEXT 0x1
+#define EGRESS_WS_BINARY 0x2
+
+typedef struct
+{
+	uint32_t rate_bps; // bytes per second, 0 = unlimited
+	uint32_t burst;    // bucket size, bytes
+} egress_budget_t;
+
+typedef struct
+{
+	egress_budget_t budget[EGRESS_CLASS_COUNT];
+	uint32_t fragment_bytes; // video bytes per send
+	uint8_t queue_depth;     // telemetry per client, 1..EGRESS_QUEUE_MAX; the oldest message is dropped
+	uint32_t stall_us;       // blocked this long: the client skips the current video frame (0 = never)
+} egress_config_t;
+
+typedef struct
+{
+	uint64_t msgs;
+	uint64_t bytes;
+	uint32_t dropped;    // queue full / pool exhausted; video: frames skipped by a blocked client
+	uint32_t failed;     // send errors
+	uint32_t lat_avg_us; // enqueue -> sent (video: submit -> last byte), EWMA 1/8
+	uint32_t lat_max_us;
+} egress_class_stats_t;
+
+// One frame the caller asks egress_next() to write.
+typedef struct
+{
+	int slot;
+	egress_class_t cls;
+	uint8_t opcode;  // EGRESS_WS_*
+	bool fragmented; // part of a WS message split into continuation frames
+	bool final;      // FIN bit; with !fragmented always true
+	const uint8_t *data;
+	size_t len;
+	size_t msg_len; // whole message (chunk) length on the final frame, for stats
+	// internal
+	uint32_t gen;
+	int8_t pool;
+} egress_tx_t;
+
+typedef struct
+{
+	uint8_t data[EGRESS_MSG_MAX];
+	uint16_t len;
+	uint8_t opcode;
+	uint8_t cls;
+	uint8_t refs;
+	int64_t queued_us;
+} egress_msg_t;
+
+typedef struct
+{
+	int8_t q[EGRESS_QUEUE_MAX]; // pool indices
+	uint8_t head;
+	uint8_t count;
+} egress_queue_t;
+
+// Messages of one video frame for one client, in sending order.
+typedef enum
+{
+	EGRESS_PART_TABLES = 0, // JTAB, abbreviated JPEG only
+	EGRESS_PART_HEADER,     // RAWH or JREF
+	EGRESS_PART_DATA,       // payload / JPEG / scan data
+} egress_part_t;
+
+// Abbreviated form of the JPEG passed to egress_video_submit_jpeg() (rc_frame.h). The buffers
+// follow the same lifetime rule as the frame.
+typedef struct
+{
+	const uint8_t *tables; // JTAB message
+	size_t tables_len;
+	uint8_t id;            // table id in `tables` and `ref`
+	const uint8_t *ref;    // JREF message
+	size_t ref_len;
+	size_t scan_off;       // scan data = JPEG from this offset
+} egress_jpeg_abbrev_t;
+
+typedef struct
+{
+	uint64_t frames;     // frames sent abbreviated
+	uint32_t tables;     // JTAB messages sent
+	int64_t saved_bytes; // header bytes not sent, minus JREF and JTAB overhead
+} egress_abbrev_stats_t;
+
+typedef struct
+{
+	bool open;
+	bool chunked;      // current frame is sent as chunk messages
+	bool want_chunked; // RC_CAP_VIDEO_CHUNKED negotiated; applies from the next frame
+	bool abbrev;       // RC_CAP_VIDEO_JPEG_ABBREV negotiated
+	uint8_t tables_id; // last JTAB this client got, 0 = none
+	bool inflight;     // a tx for this client is being written
+	int8_t inflight_pool;
+	bool close_pending;
+	bool blocked; // socket not writable at the last egress_set_writable()
+	int64_t blocked_since_us;
+	uint32_t gen;
+	egress_queue_t queue[EGRESS_VIDEO]; // control, telemetry
+	// Video state for the current frame.
+	bool video;
+	bool video_abbrev;  // current frame goes out abbreviated
+	uint8_t video_part; // egress_part_t
+	size_t video_base;  // first payload byte for this client (scan offset when abbreviated)
+	size_t video_off;   // bytes of the current part already sent
+	uint16_t chunk_seq;
+} egress_client_t;
+
+typedef struct
+{
+	egress_config_t cfg;
+	uint8_t *scratch; // fragment_bytes + RC_FRAME_CHUNK_HDR_LEN, for chunk headers
+	egress_msg_t pool[EGRESS_POOL_SIZE];
+	egress_client_t clients[EGRESS_MAX_CLIENTS];
+	int rr[EGRESS_CLASS_COUNT]; // round-robin cursor per class
+	uint32_t writable;          // last egress_set_writable() mask
+
+	int64_t tokens[EGRESS_CLASS_COUNT];
+	int64_t refill_us[EGRESS_CLASS_COUNT];
+
+	// Current video frame.
+	const uint8_t *video_hdr;
+	size_t video_hdr_len;
+	const uint8_t *video_data;
+	size_t video_len;
+	uint32_t video_refs; // clients still sending it
+	int64_t video_queued_us;
+	egress_jpeg_abbrev_t video_abbrev; // tables == NULL: not an abbreviable JPEG
+
+	egress_class_stats_t stats[EGRESS_CLASS_COUNT];
+	egress_abbrev_stats_t abbrev;
+} egress_t;
+
+typedef enum
+{
+	EGRESS_IDLE = 0, // nothing queued
+	EGRESS_SEND,     // write `tx`, then call egress_done()
+	EGRESS_WAIT,     // work queued but over budget; call again after *wait_us
+} egress_next_t;
+
+// `scratch` must hold cfg->fragment_bytes + RC_FRAME_CHUNK_HDR_LEN bytes and outlive the scheduler.
+void egress_init(egress_t *eg, const egress_config_t *cfg, uint8_t *scratch, int64_t now_us);
+void egress_set_queue_depth(egress_t *eg, uint8_t depth);
+void egress_set_budget(egress_t *eg, egress_class_t cls, egress_budget_t budget);
+
+// A client still on the slot (or its close waiting for egress_done()) is dropped first; the old
+// tx's egress_done() then reports nothing. Returns true if that released the current video frame.
+bool egress_client_open(egress_t *eg, int slot, bool chunked);
+void egress_client_set_chunked(egress_t *eg, int slot, bool chunked);
+// Abbreviated JPEG on/off; the client gets the tables again with its next JPEG frame.
+void egress_client_set_abbrev(egress_t *eg, int slot, bool abbrev);
+// Drops everything queued for the slot; if a tx for it is in flight, egress_done() does that instead.
+// Returns true if this released the current video frame.
+bool egress_client_close(egress_t *eg, int slot);
+
+// Queues a small message for every slot in `mask`. Returns the number of clients it was queued for.
+size_t egress_push(egress_t *eg, uint32_t mask, egress_class_t cls, uint8_t opcode, const void *data, size_t len,
+				   int64_t now_us);
+
+// Starts sending a video frame to every slot in `mask`: the optional `hdr` message, then `data`.
+// Both buffers must stay valid until egress_video_busy() is false. Returns false if the previous
+// frame is still being sent (nothing changes) or no slot in `mask` is open.
+bool egress_video_submit(egress_t *eg, uint32_t mask, const uint8_t *hdr, size_t hdr_len, const uint8_t *data,
+						 size_t len, int64_t now_us);
+// The same for a JPEG frame: clients with abbreviated JPEG get `abbrev` (if not NULL), the others
+// the whole JPEG.
+bool egress_video_submit_jpeg(egress_t *eg, uint32_t mask, const uint8_t *jpeg, size_t len,
+							  const egress_jpeg_abbrev_t *abbrev, int64_t now_us);
+static inline bool egress_video_busy(const egress_t *eg)
+{
+	return eg->video_refs > 0;
+}
+
+// Slots whose sockets can take a frame without blocking right now (e.g. select() with a zero
+// timeout); call before each egress_next(). All slots count as writable until the first call.
+// Returns true if a client skipping its frame released the current video frame.
+bool egress_set_writable(egress_t *eg, uint32_t writable, int64_t now_us);
+
+// One tx at a time: every EGRESS_SEND must be followed by egress_done() before the next call.
+egress_next_t egress_next(egress_t *eg, int64_t now_us, egress_tx_t *tx, int64_t *wait_us);
+// Reports the result of writing `tx`. Returns true if this completed (released) the current video frame.
+bool egress_done(egress_t *eg, const egress_tx_t *tx, bool ok, int64_t now_us);
+
+const char *egress_class_name(egress_class_t cls);
+// {"control":{...},"telemetry":{...},"video":{...},"jpeg_abbrev":{...}}. Returns bytes written.
+size_t egress_json(char *buf, size_t len, const egress_t *eg);
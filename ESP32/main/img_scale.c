@@ -0,0 +1,329 @@
+#include "img_scale.h"
+
+// RGB565 channel sums are accumulated in one 32-bit word ("SWAR"): R and B keep their positions in
+// the low half, G is moved up by 16 bits. With at most 16 pixels per block the fields cannot
+// collide: B sum <= 496 (bits 0..8), R sum <= 496 (bits 11..19), G sum <= 1008 (bits 21..30).
+static inline uint32_t spread565(const uint8_t *p)
+{
+	const uint32_t v = ((uint32_t)p[0] << 8) | p[1];
+	return (v & 0xF81Fu) | ((v & 0x07E0u) << 16);
+}
+
+#define ACC_R(acc) (((acc) >> 11) & 0x3FFu)
+#define ACC_G(acc) (((acc) >> 21) & 0x3FFu)
+#define ACC_B(acc) ((acc) & 0x1FFu)
+
+// Luma from 5/6/5-bit channel sums. Equivalent to
+//   y = (77 * r8 + 150 * g8 + 29 * b8) >> 8   with r8 ~ r5 * 33/4, g8 ~ g6 * 65/16, b8 ~ b5 * 33/4
+// folded into one set of constants with 12 fractional bits.
+#define LUMA_KR 10164u
+#define LUMA_KG 9750u
+#define LUMA_KB 3828u
+
+static inline uint8_t luma_from_acc(uint32_t acc, unsigned shift)
+{
+	const uint32_t y = (LUMA_KR * ACC_R(acc) + LUMA_KG * ACC_G(acc) + LUMA_KB * ACC_B(acc) +
+						(1u << (11 + shift))) >>
+					   (12 + shift);
+	return (uint8_t)((y > 255) ? 255 : y);
+}
+
+static inline uint32_t block_acc565(const uint8_t *src, size_t stride, int factor)
+{
+	uint32_t acc = 0;
+	switch (factor)
+	{
+	case 1:
+		acc = spread565(src);
+		break;
+	case 2:
+		acc = spread565(src) + spread565(src + 2) + spread565(src + stride) + spread565(src + stride + 2);
+		break;
+	default:
+		for (int dy = 0; dy < 4; dy++)
+		{
+			const uint8_t *r = src + (size_t)dy * stride;
+			acc += spread565(r) + spread565(r + 2) + spread565(r + 4) + spread565(r + 6);
+		}
+		break;
+	}
+	return acc;
+}
+
+static inline unsigned factor_shift(int factor)
+{
+	return (factor == 4) ? 4u : (factor == 2) ? 2u : 0u;
+}
+
+void img_scale_row_rgb565(const uint8_t *src, size_t stride, int src_w, int factor, uint8_t *dst)
+{
+	const int out_w = img_scale_dim(src_w, factor);
+	const unsigned shift = factor_shift(factor);
+	const uint32_t round = (shift > 0) ? (1u << (shift - 1)) : 0u;
+	const size_t step = (size_t)factor * 2;
+
+	for (int x = 0; x < out_w; x++, src += step, dst += 2)
+	{
+		const uint32_t acc = block_acc565(src, stride, factor);
+		const uint32_t r = (ACC_R(acc) + round) >> shift;
+		const uint32_t g = (ACC_G(acc) + round) >> shift;
+		const uint32_t b = (ACC_B(acc) + round) >> shift;
+		const uint32_t pix = ((r > 31 ? 31 : r) << 11) | ((g > 63 ? 63 : g) << 5) | (b > 31 ? 31 : b);
+		dst[0] = (uint8_t)(pix >> 8);
+		dst[1] = (uint8_t)pix;
+	}
+}
+
+void img_scale_row_rgb565_to_gray8(const uint8_t *src, size_t stride, int src_w, int factor, uint8_t *dst)
+{
+	const int out_w = img_scale_dim(src_w, factor);
+	const unsigned shift = factor_shift(factor);
+	const size_t step = (size_t)factor * 2;
+
+	for (int x = 0; x < out_w; x++, src += step)
+		dst[x] = luma_from_acc(block_acc565(src, stride, factor), shift);
+}
+
+void img_scale_row_gray8(const uint8_t *src, size_t stride, int src_w, int factor, uint8_t *dst)
+{
+	const int out_w = img_scale_dim(src_w, factor);
+	switch (factor)
+	{
+	case 1:
+		for (int x = 0; x < out_w; x++)
+			dst[x] = src[x];
+		break;
+	case 2:
+		for (int x = 0; x < out_w; x++, src += 2)
+		{
+			const uint32_t s = (uint32_t)src[0] + src[1] + src[stride] + src[stride + 1];
+			dst[x] = (uint8_t)((s + 2) >> 2);
+		}
+		break;
+	default:
+		for (int x = 0; x < out_w; x++, src += 4)
+		{
+			uint32_t s = 0;
+			for (int dy = 0; dy < 4; dy++)
+			{
+				const uint8_t *r = src + (size_t)dy * stride;
+				s += (uint32_t)r[0] + r[1] + r[2] + r[3];
+			}
+			dst[x] = (uint8_t)((s + 8) >> 4);
+		}
+		break;
+	}
+}
+
+void img_scale_row_yuv422_to_gray8(const uint8_t *src, size_t stride, int src_w, int factor, uint8_t *dst)
+{
+	const int out_w = img_scale_dim(src_w, factor);
+	switch (factor)
+	{
+	case 1:
+	{
+		int x = 0;
+		for (; x + 1 < out_w; x += 2, src += 4)
+		{
+			dst[x] = src[0];
+			dst[x + 1] = src[2];
+		}
+		if (x < out_w)
+			dst[x] = src[0];
+		break;
+	}
+	case 2:
+		for (int x = 0; x < out_w; x++, src += 4)
+		{
+			const uint32_t s = (uint32_t)src[0] + src[2] + src[stride] + src[stride + 2];
+			dst[x] = (uint8_t)((s + 2) >> 2);
+		}
+		break;
+	default:
+		for (int x = 0; x < out_w; x++, src += 8)
+		{
+			uint32_t s = 0;
+			for (int dy = 0; dy < 4; dy++)
+			{
+				const uint8_t *r = src + (size_t)dy * stride;
+				s += (uint32_t)r[0] + r[2] + r[4] + r[6];
+			}
+			dst[x] = (uint8_t)((s + 8) >> 4);
+		}
+		break;
+	}
+}
+
+// Ordered dither thresholds: the 4x4 Bayer matrix m scaled to 16 * m + 8 (mean 128). Without
+// dithering every pixel uses 128, i.e. rounds to the nearest level.
+static const uint8_t DITHER_BAYER4[4][4] = {
+	{8, 136, 40, 168},
+	{200, 72, 232, 104},
+	{56, 184, 24, 152},
+	{248, 120, 216, 88},
+};
+static const uint8_t DITHER_NONE[4] = {128, 128, 128, 128};
+
+static inline const uint8_t *dither_row(int dither_y)
+{
+	return (dither_y >= 0) ? DITHER_BAYER4[dither_y & 3] : DITHER_NONE;
+}
+
+// 8-bit value -> 0..max with threshold t (0..255): (v * max + t) / 256. Levels map back to
+// v = q * 255 / max, so with t = 128 this is rounding to the nearest level.
+static inline uint32_t quantize(uint32_t v, uint32_t max, uint32_t t)
+{
+	return (v * max + t) >> 8;
+}
+
+// RRRGGGBB from a block sum; the channels are first scaled to 0..255 (x 255/31, 255/63).
+static inline uint32_t rgb332_from_acc(uint32_t acc, unsigned shift, uint32_t t)
+{
+	const uint32_t round = 128u << shift;
+	const uint32_t r8 = (ACC_R(acc) * 2106u + round) >> (8 + shift);
+	const uint32_t g8 = (ACC_G(acc) * 1036u + round) >> (8 + shift);
+	const uint32_t b8 = (ACC_B(acc) * 2106u + round) >> (8 + shift);
+	return (quantize(r8, 7, t) << 5) | (quantize(g8, 7, t) << 2) | quantize(b8, 3, t);
+}
+
+static inline void wr_be32(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t)(v >> 24);
+	p[1] = (uint8_t)(v >> 16);
+	p[2] = (uint8_t)(v >> 8);
+	p[3] = (uint8_t)v;
+}
+
+// Stores the first `n` pixels of a partial word (`n` * `bits` bits collected in the low end),
+// MSB-first and zero-padded to a whole byte.
+static inline void store_tail(uint8_t *dst, uint32_t word, int n, unsigned bits)
+{
+	word <<= 32 - (unsigned)n * bits;
+	const size_t bytes = ((size_t)n * bits + 7) / 8;
+	for (size_t i = 0; i < bytes; i++)
+		dst[i] = (uint8_t)(word >> (24 - 8 * i));
+}
+
+// `bits` is a constant at both call sites, so the inner loop unrolls into shifts and ORs. A word
+// holds 8 or 16 pixels, a multiple of the dither period, so the threshold index is the lane.
+static inline void gray_pack_row(const uint8_t *src, size_t stride, int src_w, int factor, unsigned bits,
+								 const uint8_t *thr, uint8_t *dst)
+{
+	const int out_w = img_scale_dim(src_w, factor);
+	const unsigned shift = factor_shift(factor);
+	const size_t step = (size_t)factor * 2;
+	const uint32_t max = (1u << bits) - 1;
+	const int lanes = (int)(32 / bits);
+
+	int x = 0;
+	for (; x + lanes <= out_w; x += lanes, dst += 4)
+	{
+		uint32_t word = 0;
+		for (int i = 0; i < lanes; i++, src += step)
+			word = (word << bits) | quantize(luma_from_acc(block_acc565(src, stride, factor), shift), max, thr[i & 3]);
+		wr_be32(dst, word);
+	}
+	if (x < out_w)
+	{
+		uint32_t word = 0;
+		int n = 0;
+		for (; x < out_w; x++, n++, src += step)
+			word = (word << bits) | quantize(luma_from_acc(block_acc565(src, stride, factor), shift), max, thr[x & 3]);
+		store_tail(dst, word, n, bits);
+	}
+}
+
+void img_scale_row_rgb565_to_gray_packed(const uint8_t *src, size_t stride, int src_w, int factor, int bits,
+										 int dither_y, uint8_t *dst)
+{
+	if (bits == 4)
+		gray_pack_row(src, stride, src_w, factor, 4, dither_row(dither_y), dst);
+	else
+		gray_pack_row(src, stride, src_w, factor, 2, dither_row(dither_y), dst);
+}
+
+void img_scale_row_rgb565_to_rgb332(const uint8_t *src, size_t stride, int src_w, int factor, int dither_y,
+									uint8_t *dst)
+{
+	const int out_w = img_scale_dim(src_w, factor);
+	const unsigned shift = factor_shift(factor);
+	const size_t step = (size_t)factor * 2;
+	const uint8_t *thr = dither_row(dither_y);
+
+	int x = 0;
+	for (; x + 4 <= out_w; x += 4, dst += 4)
+	{
+		uint32_t word = 0;
+		for (int i = 0; i < 4; i++, src += step)
+			word = (word << 8) | rgb332_from_acc(block_acc565(src, stride, factor), shift, thr[i]);
+		wr_be32(dst, word);
+	}
+	for (; x < out_w; x++, src += step)
+		*dst++ = (uint8_t)rgb332_from_acc(block_acc565(src, stride, factor), shift, thr[x & 3]);
+}
+
+typedef void (*row_fn_t)(const uint8_t *, size_t, int, int, uint8_t *);
+
+static size_t scale_frame(row_fn_t fn, const uint8_t *src, int w, int h, int factor, size_t src_bpp,
+						  size_t dst_bpp, uint8_t *dst)
+{
+	if (!src || !dst || w <= 0 || h <= 0 || !img_scale_factor_valid(factor))
+		return 0;
+
+	const size_t stride = (size_t)w * src_bpp;
+	const int out_w = img_scale_dim(w, factor);
+	const int out_h = img_scale_dim(h, factor);
+	const size_t out_row = (size_t)out_w * dst_bpp;
+	for (int y = 0; y < out_h; y++)
+		fn(src + (size_t)y * factor * stride, stride, w, factor, dst + (size_t)y * out_row);
+	return out_row * (size_t)out_h;
+}
+
+size_t img_scale_rgb565(const uint8_t *src, int w, int h, int factor, uint8_t *dst)
+{
+	return scale_frame(img_scale_row_rgb565, src, w, h, factor, 2, 2, dst);
+}
+
+size_t img_scale_rgb565_to_gray8(const uint8_t *src, int w, int h, int factor, uint8_t *dst)
+{
+	return scale_frame(img_scale_row_rgb565_to_gray8, src, w, h, factor, 2, 1, dst);
+}
+
+size_t img_scale_gray8(const uint8_t *src, int w, int h, int factor, uint8_t *dst)
+{
+	return scale_frame(img_scale_row_gray8, src, w, h, factor, 1, 1, dst);
+}
+
+size_t img_scale_yuv422_to_gray8(const uint8_t *src, int w, int h, int factor, uint8_t *dst)
+{
+	return scale_frame(img_scale_row_yuv422_to_gray8, src, w, h, factor, 2, 1, dst);
+}
+
+size_t img_scale_rgb565_to_gray_packed(const uint8_t *src, int w, int h, int factor, int bits, int dither,
+									   uint8_t *dst)
+{
+	if (!src || !dst || w <= 0 || h <= 0 || !img_scale_factor_valid(factor) || (bits != 4 && bits != 2))
+		return 0;
+
+	const size_t stride = (size_t)w * 2;
+	const int out_h = img_scale_dim(h, factor);
+	const size_t out_row = img_packed_row_bytes(img_scale_dim(w, factor), bits);
+	for (int y = 0; y < out_h; y++)
+		img_scale_row_rgb565_to_gray_packed(src + (size_t)y * factor * stride, stride, w, factor, bits,
+											dither ? y : -1, dst + (size_t)y * out_row);
+	return out_row * (size_t)out_h;
+}
+
+size_t img_scale_rgb565_to_rgb332(const uint8_t *src, int w, int h, int factor, int dither, uint8_t *dst)
+{
+	if (!src || !dst || w <= 0 || h <= 0 || !img_scale_factor_valid(factor))
+		return 0;
+
+	const size_t stride = (size_t)w * 2;
+	const int out_h = img_scale_dim(h, factor);
+	const size_t out_row = (size_t)img_scale_dim(w, factor);
+	for (int y = 0; y < out_h; y++)
+		img_scale_row_rgb565_to_rgb332(src + (size_t)y * factor * stride, stride, w, factor, dither ? y : -1,
+									   dst + (size_t)y * out_row);
+	return out_row * (size_t)out_h;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+// Integer box-filter downscaling for camera frames. Portable C (also built on the Linux host).
+//
+// RGB565 buffers are MSB-first, as produced by the ESP32 camera driver, and stay MSB-first on
+// output. YUV422 buffers are YUYV (Y0 U Y1 V), as the driver delivers them; only the luma bytes are
+// read, so they reduce to GRAY8 with a strided copy. Kernels are row-streamed: each call consumes `factor` source rows and produces one
+// destination row, so no full-resolution intermediate buffer is ever needed.
+// Supported factors: 1, 2, 4. Trailing rows/columns that don't fill a block are dropped.
+//
+// Packed output (RAWH GRAY4 / GRAY2 / RGB332, layout in rc_frame.h) is produced by the same pass
+// that converts and downscales: each output pixel is quantized as soon as its block is averaged and
+// shifted into a 32-bit word, which is stored once full. Quantization rounds to the nearest level,
+// or with `dither` uses a 4x4 ordered (Bayer) threshold, which keeps gradients readable at 2 bits
+// per pixel and costs one table lookup.
+
+#include <stddef.h>
+#include <stdint.h>
+
+static inline int img_scale_dim(int src, int factor)
+{
+	return (factor > 0) ? src / factor : 0;
+}
+
+static inline int img_scale_factor_valid(int factor)
+{
+	return factor == 1 || factor == 2 || factor == 4;
+}
+
+// Bytes per packed row of `w` pixels (`bits` per pixel, rows padded to whole bytes).
+static inline size_t img_packed_row_bytes(int w, int bits)
+{
+	return ((size_t)w * (size_t)bits + 7) / 8;
+}
+
+// Row kernels: `src` points at the first of `factor` source rows, `stride` bytes apart.
+// `src_w` is the source width in pixels.
+void img_scale_row_rgb565(const uint8_t *src, size_t stride, int src_w, int factor, uint8_t *dst);
+void img_scale_row_rgb565_to_gray8(const uint8_t *src, size_t stride, int src_w, int factor, uint8_t *dst);
+void img_scale_row_gray8(const uint8_t *src, size_t stride, int src_w, int factor, uint8_t *dst);
+void img_scale_row_yuv422_to_gray8(const uint8_t *src, size_t stride, int src_w, int factor, uint8_t *dst);
+// `bits` is 4 or 2. `dither_y` is the output row number (selects the dither matrix row), or -1 for
+// plain rounding.
+void img_scale_row_rgb565_to_gray_packed(const uint8_t *src, size_t stride, int src_w, int factor, int bits,
+										 int dither_y, uint8_t *dst);
+void img_scale_row_rgb565_to_rgb332(const uint8_t *src, size_t stride, int src_w, int factor, int dither_y,
+									uint8_t *dst);
+
+// Whole-frame wrappers. Return the number of bytes written to `dst`, 0 on bad arguments.
+size_t img_scale_rgb565(const uint8_t *src, int w, int h, int factor, uint8_t *dst);
+size_t img_scale_rgb565_to_gray8(const uint8_t *src, int w, int h, int factor, uint8_t *dst);
+size_t img_scale_gray8(const uint8_t *src, int w, int h, int factor, uint8_t *dst);
+size_t img_scale_yuv422_to_gray8(const uint8_t *src, int w, int h, int factor, uint8_t *dst);
+size_t img_scale_rgb565_to_gray_packed(const uint8_t *src, int w, int h, int factor, int bits, int dither,
+									   uint8_t *dst);
+size_t img_scale_rgb565_to_rgb332(const uint8_t *src, int w, int h, int factor, int dither, uint8_t *dst);
@@ -1,34 +1,234 @@
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 
+#include "esp_app_desc.h"
 #include "esp_camera.h"
+#include "driver/ledc.h"
 #include "esp_event.h"
+#include "esp_heap_caps.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
 #include "esp_mac.h"
 #include "esp_netif.h"
+#include "esp_ota_ops.h"
+#include "esp_random.h"
 #include "esp_system.h"
 #include "esp_timer.h"
+#include "esp_vfs_fat.h"
 #include "esp_wifi.h"
+#include "lwip/sockets.h"
 #include "mdns.h"
 #include "nvs.h"
 #include "nvs_flash.h"
 
 #include "img_converters.h"
-
+#include "mbedtls/sha256.h"
+
+#include "actuator.h"
+#include "boot_timeline.h"
+#include "cam_supervisor.h"
+#include "egress.h"
+#include "img_scale.h"
+#include "mem_budget.h"
+#include "ota_stream.h"
+#include "prov_test.h"
 #include "rc_config.h"
+#include "rc_frame.h"
+#include "rc_proto.h"
+#include "recorder.h"
+#include "session.h"
+#include "task_prof.h"
+#include "vision.h"
+#include "web_assets.h"
+#include "wifi_link.h"
+#include "wifi_recovery.h"
+#include "ws_clients.h"
 
 static const char *TAG = MDNS_INSTANCE;
 
 static httpd_handle_t httpServer = NULL;
 static httpd_handle_t provisionServer = NULL;
-static uint8_t controlState[RC_CONTROL_LEN] = {0};
 
-static volatile bool camera_ok = false;
+// Latest applied control input. Written by the httpd task, read by telemetry (and actuation).
+static rc_control_t control_state = {0};
+static portMUX_TYPE control_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile uint32_t control_applied = 0;
+static volatile uint32_t control_stale = 0;
+static volatile uint32_t control_malformed = 0;
+// Bumped with every control_set()/control_reset() (arrival time alongside), so the actuation loop
+// hands each input to the actuator exactly once.
+static uint32_t control_gen = 0;
+static int64_t control_rx_us = 0;
+// Socket of the client whose input is in control_state (-1 = none), so its close stops the car.
+static int control_owner_fd = -1;
+
+// Actuation loop (esp_timer at ACT_RATE_HZ). The timer callback owns `actuator`; telemetry copies it.
+static actuator_t actuator;
+static portMUX_TYPE act_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Vision stage. Results are written by the camera task, read by telemetry and control_get().
+static volatile uint8_t vision_mode = VISION_MODE;
+static volatile int vision_gain_pct = VISION_STEER_GAIN_PCT;
+static vision_config_t vision_cfg = VISION_CONFIG_DEFAULT;
+static vision_result_t vision_last = {0};
+static int64_t vision_last_us = 0;      // when vision_last was produced
+static int64_t vision_line_seen_us = 0; // last frame in which a line was found
+static int16_t vision_steer_cmd = 0;    // steering from that frame
+static uint32_t vision_frames = 0;
+static uint32_t vision_cost_us = 0; // analysis time of the last frame
+static portMUX_TYPE vision_lock = portMUX_INITIALIZER_UNLOCKED;
+// Luma buffer for stream modes that don't produce GRAY8 themselves. Camera task only.
+static uint8_t *vision_gray = NULL;
+static size_t vision_gray_cap = 0;
+
+// Recorder: the camera task pushes encoded frames, recorder_task writes them to the SD card.
+static rec_store_t rec_store;
+static rec_writer_t rec_writer;
+static volatile bool recorder_ready = false;
+#if RECORDER_SESSION
+// Session capture has two producers (camera task, httpd) for the single-producer writer.
+static SemaphoreHandle_t session_lock = NULL;
+#endif
+
+static const uint32_t RC_DEVICE_CAPS = RC_CAP_CONTROL_V2 | RC_CAP_CONTROL_ACK | RC_CAP_TELEMETRY_TEXT |
+									   RC_CAP_CONTROL_ONLY | RC_CAP_VIDEO_CHUNKED |
+									   (JPEG_ABBREV_ENABLE ? RC_CAP_VIDEO_JPEG_ABBREV : 0);
+
+// WS egress: producers (httpd handlers, telemetry, camera) queue under egress_lock, egress_task does
+// every write. The camera task waits on egress_video_done until its frame buffer is released.
+_Static_assert(RC_WS_MAX_CLIENTS <= EGRESS_MAX_CLIENTS, "egress slots mirror ws_clients slots");
+static egress_t egress;
+static SemaphoreHandle_t egress_lock = NULL;
+static SemaphoreHandle_t egress_video_done = NULL;
+static TaskHandle_t egress_task_handle = NULL;
+static uint8_t egress_scratch[EGRESS_FRAGMENT_BYTES + RC_FRAME_CHUNK_HDR_LEN];
+static const egress_config_t EGRESS_CONFIG = {
+	.budget =
+		{
+			[EGRESS_CONTROL] = {EGRESS_CONTROL_RATE_BPS, EGRESS_CONTROL_BURST},
+			[EGRESS_TELEMETRY] = {EGRESS_TELEMETRY_RATE_BPS, EGRESS_TELEMETRY_BURST},
+			[EGRESS_VIDEO] = {EGRESS_VIDEO_RATE_BPS, EGRESS_VIDEO_BURST},
+		},
+	.fragment_bytes = EGRESS_FRAGMENT_BYTES,
+	.queue_depth = MEM_FULL_QUEUE_DEPTH,
+	.stall_us = EGRESS_STALL_MS * 1000,
+};
+
+#if OTA_ENABLE
+// OTA: the POST handler checks the headers and hands the request over (httpd async handler) to
+// ota_task, which streams the body into the inactive partition. `ota` is guarded by ota_lock.
+typedef struct
+{
+	httpd_req_t *req;
+	size_t offset;
+	size_t total;
+	uint8_t sha256[OTA_SHA256_LEN];
+} ota_job_t;
+static ota_stream_t ota;
+static SemaphoreHandle_t ota_lock = NULL;
+static QueueHandle_t ota_jobs = NULL;
+static bool ota_busy = false; // ota_lock; a request is queued or running (or the reboot is pending)
+static esp_ota_handle_t ota_handle = 0;
+static const esp_partition_t *ota_partition = NULL;
+static mbedtls_sha256_context ota_sha;
+// Set while this image still has to prove itself (first boot after an update).
+static volatile bool ota_pending_verify = false;
+static esp_timer_handle_t ota_verify_timer = NULL;
+#endif
+
+#if TASK_PROF_ENABLE && configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+#define TASK_PROF_ACTIVE 1
+// Filled from an esp_timer callback, read by GET /api/tasks; both under task_prof_lock.
+typedef struct
+{
+	task_prof_t prof;
+	TaskStatus_t status[TASK_PROF_MAX_TASKS];
+	task_prof_sample_t samples[TASK_PROF_MAX_TASKS];
+} task_prof_state_t;
+static task_prof_state_t *task_prof_state = NULL;
+static SemaphoreHandle_t task_prof_lock = NULL;
+#else
+#define TASK_PROF_ACTIVE 0
+#endif
+
+// Stall detection and re-init backoff. Driven by the camera task, read by camera_telemetry_json;
+// both under cam_sup_lock.
+static cam_supervisor_t cam_sup;
+static portMUX_TYPE cam_sup_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Why the camera task should produce frames. It blocks on these bits while none is set.
+static EventGroupHandle_t camera_demand_group = NULL;
+static const EventBits_t CAM_DEMAND_VIDEO = BIT0;    // WS video subscribers (kept by ws_clients)
+static const EventBits_t CAM_DEMAND_VISION = BIT1;   // vision steering needs frames
+static const EventBits_t CAM_DEMAND_RECORDER = BIT2; // recorder is writing
+static const EventBits_t CAM_DEMAND_REINIT = BIT3;   // latency mode or memory tier change pending
+static const EventBits_t CAM_DEMAND_LINK = BIT4;     // network link up (not a demand: gates VIDEO)
+
+// Grab policy: requested (API) vs. what the driver was initialized with (camera task only).
+static volatile uint8_t cam_latency_mode = CAM_LATENCY_MODE;
+static uint8_t cam_latency_active = CAM_LATENCY_MODE;
+static size_t cam_fb_count_active = 0;
+static uint16_t cam_frame_width_active = 0;
+static uint8_t cam_tier_active = MEM_TIER_FULL;
+static pixformat_t cam_pixformat_active = PIXFORMAT_JPEG; // what the sensor was configured for
+static volatile uint32_t cam_max_age_ms = CAM_FRAME_MAX_AGE_MS;
+
+// Frame age (capture timestamp -> grabbed by the camera task), accumulated per telemetry period.
+typedef struct
+{
+	uint32_t frames;
+	uint32_t discarded;
+	uint64_t age_sum_us;
+	uint32_t age_max_us;
+} frame_age_stats_t;
+static frame_age_stats_t frame_age_window = {0};
+static frame_age_stats_t frame_age_report = {0}; // last complete period
+static uint32_t frame_discarded_total = 0;
+static portMUX_TYPE frame_age_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Memory budget. Sampled by telemetry_task (the only writer of mem_budget); `mem_tier` is what the camera
+// task and the WS registry size themselves by. The last JSON report is cached for /api/mem.
+static const mem_budget_config_t MEM_BUDGET_CONFIG = {
+	.dram_free = {0, MEM_REDUCED_DRAM_FREE_KB * 1024, MEM_SURVIVAL_DRAM_FREE_KB * 1024},
+	.dram_block = {0, MEM_REDUCED_DRAM_BLOCK_KB * 1024, MEM_SURVIVAL_DRAM_BLOCK_KB * 1024},
+	.psram_free = {0, MEM_REDUCED_PSRAM_FREE_KB * 1024, MEM_SURVIVAL_PSRAM_FREE_KB * 1024},
+	.psram_block = {0, MEM_REDUCED_PSRAM_BLOCK_KB * 1024, MEM_SURVIVAL_PSRAM_BLOCK_KB * 1024},
+	.recover_pct = MEM_RECOVER_PCT,
+	.recover_samples = MEM_RECOVER_SAMPLES,
+	.no_psram_tier = MEM_TIER_REDUCED,
+};
+// Cost estimates: 4:3 RGB565 frame buffers (the worst case) and per-client DRAM.
+#define MEM_FB_BYTES(w) ((size_t)(w) * ((w) * 3 / 4) * 2)
+#define MEM_TIER_LIMITS_ENTRY(width, fbs, clients, depth)                                                   \
+	{width, fbs, clients, depth, (size_t)(clients) * MEM_CLIENT_DRAM_KB * 1024, (fbs) * MEM_FB_BYTES(width)}
+static const mem_tier_limits_t MEM_TIER_LIMITS[MEM_TIER_COUNT] = {
+	MEM_TIER_LIMITS_ENTRY(MEM_FULL_FRAME_WIDTH, MEM_FULL_FB_COUNT, RC_WS_MAX_CLIENTS, MEM_FULL_QUEUE_DEPTH),
+	MEM_TIER_LIMITS_ENTRY(MEM_REDUCED_FRAME_WIDTH, MEM_REDUCED_FB_COUNT, MEM_REDUCED_MAX_CLIENTS,
+						  MEM_REDUCED_QUEUE_DEPTH),
+	MEM_TIER_LIMITS_ENTRY(MEM_SURVIVAL_FRAME_WIDTH, MEM_SURVIVAL_FB_COUNT, MEM_SURVIVAL_MAX_CLIENTS,
+						  MEM_SURVIVAL_QUEUE_DEPTH),
+};
+static mem_budget_t mem_budget;
+static volatile uint8_t mem_tier = MEM_TIER_FULL;
+static char mem_json_cache[512] = "{}";
+static portMUX_TYPE mem_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Stream downscale factor (1, 2 or 4), changed at runtime via /api/stream.
+static volatile uint8_t stream_scale = CAM_STREAM_SCALE;
+// CAM_STREAM_MODE_PACKED output (rc_frame_format_t) and dithering, changed at runtime via /api/stream.
+static volatile uint8_t stream_packed_format = CAM_STREAM_PACKED_FORMAT;
+static volatile bool stream_dither = CAM_STREAM_DITHER;
+// Scratch buffer for scaled/converted frames. Only touched by the camera task; grows, never shrinks.
+static uint8_t *stream_scratch = NULL;
+static size_t stream_scratch_cap = 0;
+static bool netif_stack_initialized = false;
 static bool wifi_handlers_registered = false;
 static bool wifi_stack_initialized = false;
 static esp_netif_t *wifi_netif_sta = NULL;
@@ -37,14 +237,299 @@ static esp_netif_t *wifi_netif_ap = NULL;
 static EventGroupHandle_t wifi_event_group = NULL;
 static const EventBits_t WIFI_CONNECTED_BIT = BIT0;
 static const EventBits_t WIFI_FAIL_BIT = BIT1;
-static int sta_retry_count = 0;
+
+// STA link recovery (see wifi_recovery.h): fed by wifi_event_handler, driven by wifi_recovery_task;
+// both under wifi_rec_lock.
+static const wifi_rec_config_t WIFI_REC_CONFIG = {
+	.boot_attempts = WIFI_STA_MAX_RETRY + 1,
+	.fast_attempts = WIFI_FAST_RECONNECT_TRIES,
+	.attempt_timeout_us = WIFI_RECONNECT_TIMEOUT_MS * 1000u,
+	.backoff_min_us = WIFI_RECONNECT_BACKOFF_MIN_MS * 1000u,
+	.backoff_max_us = WIFI_RECONNECT_BACKOFF_MAX_MS * 1000u,
+	.softap_after_us = WIFI_FALLBACK_AP_AFTER_MS * 1000u,
+	.softap_retry_us = WIFI_FALLBACK_STA_RETRY_MS * 1000u,
+};
+static wifi_rec_t wifi_rec;
+static portMUX_TYPE wifi_rec_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t wifi_rec_task_handle = NULL;
+
+// Boot dependencies between the tasks started from app_main.
+static EventGroupHandle_t boot_event_group = NULL;
+static const EventBits_t BOOT_NETIF_READY_BIT = BIT0;
+static const EventBits_t BOOT_HTTPD_READY_BIT = BIT1;
 
 static esp_timer_handle_t restart_timer = NULL;
+// mDNS is started and advertised from both the Wi-Fi/IP event handler and app_main; mdns_lock
+// serializes the start and the flags below.
+static SemaphoreHandle_t mdns_lock = NULL;
 static bool mdns_started = false;
 static bool mdns_service_added_esp_rc = false;
 static bool mdns_service_added_rcws = false;
 static bool mdns_service_added_http = false;
 
+static void control_set(const rc_control_t *ctrl, int fd)
+{
+	const int64_t now_us = esp_timer_get_time();
+	portENTER_CRITICAL(&control_lock);
+	control_state = *ctrl;
+	control_gen++;
+	control_rx_us = now_us;
+	control_owner_fd = fd;
+	portEXIT_CRITICAL(&control_lock);
+	control_applied++;
+}
+
+// In steer mode the vision stage owns steering; the operator keeps throttle and brake.
+static void vision_apply_to_control(rc_control_t *ctrl)
+{
+	if (vision_mode != VISION_MODE_STEER)
+		return;
+
+	const int64_t now_us = esp_timer_get_time();
+	portENTER_CRITICAL(&vision_lock);
+	const int64_t seen_us = vision_line_seen_us;
+	const int16_t steer = vision_steer_cmd;
+	portEXIT_CRITICAL(&vision_lock);
+
+	if (seen_us == 0 || now_us - seen_us > (int64_t)VISION_LOST_BRAKE_MS * 1000)
+	{
+		ctrl->steer = 0;
+		ctrl->throttle = 0;
+		ctrl->flags |= RC_CTRL_FLAG_BRAKE;
+		return;
+	}
+	ctrl->steer = steer;
+}
+
+// Effective control: the last operator input with the vision override applied.
+static rc_control_t control_get(void)
+{
+	portENTER_CRITICAL(&control_lock);
+	rc_control_t ctrl = control_state;
+	portEXIT_CRITICAL(&control_lock);
+	vision_apply_to_control(&ctrl);
+	return ctrl;
+}
+
+static void control_reset(void)
+{
+	const rc_control_t zero = {.flags = RC_CTRL_FLAG_BRAKE};
+	const int64_t now_us = esp_timer_get_time();
+	portENTER_CRITICAL(&control_lock);
+	control_state = zero;
+	control_gen++;
+	control_rx_us = now_us;
+	control_owner_fd = -1;
+	portEXIT_CRITICAL(&control_lock);
+}
+
+// The controlling client went away: stop now rather than waiting for the actuator timeout.
+static void control_release(int fd)
+{
+	portENTER_CRITICAL(&control_lock);
+	const bool owner = (fd == control_owner_fd);
+	portEXIT_CRITICAL(&control_lock);
+	if (owner)
+		control_reset();
+}
+
+#define MOTOR_PWM_BITS 10
+#define STEER_SERVO_BITS 16
+#define STEER_SERVO_PERIOD_US 20000
+
+static void motor_outputs_init(void)
+{
+#if MOTOR_PIN_FWD >= 0 && MOTOR_PIN_REV >= 0
+	const ledc_timer_config_t motor_timer = {
+		.speed_mode = LEDC_LOW_SPEED_MODE,
+		.duty_resolution = (ledc_timer_bit_t)MOTOR_PWM_BITS,
+		.timer_num = LEDC_TIMER_1,
+		.freq_hz = MOTOR_PWM_HZ,
+		.clk_cfg = LEDC_AUTO_CLK,
+	};
+	ESP_ERROR_CHECK(ledc_timer_config(&motor_timer));
+	const int motor_pins[2] = {MOTOR_PIN_FWD, MOTOR_PIN_REV};
+	for (int i = 0; i < 2; i++)
+	{
+		const ledc_channel_config_t ch = {
+			.gpio_num = motor_pins[i],
+			.speed_mode = LEDC_LOW_SPEED_MODE,
+			.channel = (ledc_channel_t)(LEDC_CHANNEL_1 + i),
+			.intr_type = LEDC_INTR_DISABLE,
+			.timer_sel = LEDC_TIMER_1,
+			.duty = 0,
+			.hpoint = 0,
+		};
+		ESP_ERROR_CHECK(ledc_channel_config(&ch));
+	}
+#endif
+#if STEER_SERVO_PIN >= 0
+	const ledc_timer_config_t servo_timer = {
+		.speed_mode = LEDC_LOW_SPEED_MODE,
+		.duty_resolution = (ledc_timer_bit_t)STEER_SERVO_BITS,
+		.timer_num = LEDC_TIMER_2,
+		.freq_hz = 1000000 / STEER_SERVO_PERIOD_US,
+		.clk_cfg = LEDC_AUTO_CLK,
+	};
+	ESP_ERROR_CHECK(ledc_timer_config(&servo_timer));
+	const ledc_channel_config_t servo = {
+		.gpio_num = STEER_SERVO_PIN,
+		.speed_mode = LEDC_LOW_SPEED_MODE,
+		.channel = LEDC_CHANNEL_3,
+		.intr_type = LEDC_INTR_DISABLE,
+		.timer_sel = LEDC_TIMER_2,
+		.duty = 0,
+		.hpoint = 0,
+	};
+	ESP_ERROR_CHECK(ledc_channel_config(&servo));
+#endif
+}
+
+static void motor_outputs_apply(const act_output_t *out)
+{
+#if MOTOR_PIN_FWD >= 0 && MOTOR_PIN_REV >= 0
+	const uint32_t full = (1u << MOTOR_PWM_BITS) - 1;
+	const int32_t t = out->throttle;
+	uint32_t fwd = (t > 0) ? (uint32_t)t * full / RC_AXIS_MAX : 0;
+	uint32_t rev = (t < 0) ? (uint32_t)(-t) * full / RC_AXIS_MAX : 0;
+	if (out->brake && t == 0)
+		fwd = rev = full; // both inputs high: the bridge shorts the motor (brake)
+	ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_1, fwd);
+	ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_1);
+	ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_2, rev);
+	ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_2);
+#endif
+#if STEER_SERVO_PIN >= 0
+	const int32_t mid_us = (STEER_SERVO_MIN_US + STEER_SERVO_MAX_US) / 2;
+	const int32_t pulse_us = mid_us + (int32_t)out->steer * (STEER_SERVO_MAX_US - STEER_SERVO_MIN_US) / 2 / RC_AXIS_MAX;
+	ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_3,
+				  (uint32_t)pulse_us * (1u << STEER_SERVO_BITS) / STEER_SERVO_PERIOD_US);
+	ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_3);
+#endif
+	(void)out;
+}
+
+// Runs at ACT_RATE_HZ on the esp_timer task: a fixed amount of integer work, no blocking.
+static void actuation_tick(void *arg)
+{
+	(void)arg;
+	static uint32_t seen_gen = 0;
+	static uint32_t seen_vision = 0;
+	const int64_t now_us = esp_timer_get_time();
+
+	portENTER_CRITICAL(&control_lock);
+	const uint32_t gen = control_gen;
+	const int64_t rx_us = control_rx_us;
+	portEXIT_CRITICAL(&control_lock);
+	// In steer mode every vision frame is a new steering setpoint as well, but not an operator packet:
+	// the actuator timeout stays keyed to control_rx_us.
+	uint32_t vision_gen = seen_vision;
+	if (vision_mode == VISION_MODE_STEER)
+	{
+		portENTER_CRITICAL(&vision_lock);
+		vision_gen = vision_frames;
+		portEXIT_CRITICAL(&vision_lock);
+	}
+	const bool control_fresh = gen != seen_gen;
+	const bool fresh = control_fresh || vision_gen != seen_vision;
+	rc_control_t ctrl;
+	if (fresh)
+	{
+		ctrl = control_get();
+		seen_gen = gen;
+		seen_vision = vision_gen;
+	}
+
+	portENTER_CRITICAL(&act_lock);
+	if (control_fresh)
+		actuator_setpoint(&actuator, &ctrl, rx_us);
+	else if (fresh)
+		actuator_override(&actuator, &ctrl, now_us);
+	const act_output_t out = actuator_tick(&actuator, now_us);
+	portEXIT_CRITICAL(&act_lock);
+	motor_outputs_apply(&out);
+}
+
+static void actuation_start(void)
+{
+	static const act_config_t cfg = {
+		.period_us = 1000000 / ACT_RATE_HZ,
+		.throttle = {ACT_THROTTLE_SLEW, ACT_THROTTLE_ACCEL},
+		.steer = {ACT_STEER_SLEW, ACT_STEER_ACCEL},
+		.brake_slew = ACT_BRAKE_SLEW,
+		.interval_us = ACT_INTERVAL_MS * 1000,
+		.extrapolate_us = ACT_EXTRAPOLATE_MS * 1000,
+		.timeout_us = ACT_TIMEOUT_MS * 1000,
+	};
+	actuator_init(&actuator, &cfg, esp_timer_get_time());
+	motor_outputs_init();
+
+	esp_timer_handle_t timer = NULL;
+	const esp_timer_create_args_t args = {
+		.callback = actuation_tick,
+		.dispatch_method = ESP_TIMER_TASK,
+		.name = "actuation",
+		.skip_unhandled_events = true,
+	};
+	ESP_ERROR_CHECK(esp_timer_create(&args, &timer));
+	ESP_ERROR_CHECK(esp_timer_start_periodic(timer, cfg.period_us));
+	ESP_LOGI(TAG, "Actuation at %d Hz (motor %d/%d, servo %d)", ACT_RATE_HZ, MOTOR_PIN_FWD, MOTOR_PIN_REV,
+			 STEER_SERVO_PIN);
+}
+
+static uint8_t *stream_scratch_get(size_t len)
+{
+	if (len <= stream_scratch_cap)
+		return stream_scratch;
+
+	uint8_t *buf = (uint8_t *)realloc(stream_scratch, len);
+	if (!buf)
+		return NULL;
+	stream_scratch = buf;
+	stream_scratch_cap = len;
+	return buf;
+}
+
+static const char *cam_latency_name(uint8_t mode)
+{
+	return (mode == CAM_LATENCY_LOW) ? "low" : "smooth";
+}
+
+// Closes the current frame-age period and formats it.
+static size_t camera_telemetry_json(char *buf, size_t len, bool roll_window)
+{
+	portENTER_CRITICAL(&frame_age_lock);
+	if (roll_window)
+	{
+		frame_age_report = frame_age_window;
+		memset(&frame_age_window, 0, sizeof(frame_age_window));
+	}
+	const frame_age_stats_t st = frame_age_report;
+	const uint32_t discarded_total = frame_discarded_total;
+	portEXIT_CRITICAL(&frame_age_lock);
+
+	const int64_t now_us = esp_timer_get_time();
+	portENTER_CRITICAL(&cam_sup_lock);
+	const cam_supervisor_t sup = cam_sup;
+	portEXIT_CRITICAL(&cam_sup_lock);
+	char sup_json[384];
+	if (cam_supervisor_json(sup_json, sizeof(sup_json), &sup, now_us) == 0)
+		snprintf(sup_json, sizeof(sup_json), "null");
+
+	const uint32_t avg_us = st.frames ? (uint32_t)(st.age_sum_us / st.frames) : 0;
+	const int n = snprintf(buf, len,
+						   "{\"type\":\"camera\",\"t_ms\":%lld,\"latency\":\"%s\",\"fb_count\":%u,\"width\":%u,"
+						   "\"max_age_ms\":%u,\"frames\":%u,\"discarded\":%u,\"discarded_total\":%u,"
+						   "\"age_ms_avg\":%u.%u,\"age_ms_max\":%u.%u,\"supervisor\":%s}",
+						   (long long)(now_us / 1000), cam_latency_name(cam_latency_active),
+						   (unsigned)cam_fb_count_active, (unsigned)cam_frame_width_active, (unsigned)cam_max_age_ms,
+						   (unsigned)st.frames,
+						   (unsigned)st.discarded, (unsigned)discarded_total, (unsigned)(avg_us / 1000),
+						   (unsigned)(avg_us % 1000 / 100), (unsigned)(st.age_max_us / 1000),
+						   (unsigned)(st.age_max_us % 1000 / 100), sup_json);
+	return (n > 0 && (size_t)n < len) ? (size_t)n : 0;
+}
+
 static uint32_t frame_interval_ms(void)
 {
 	if (STREAM_FPS <= 0)
@@ -52,7 +537,8 @@ static uint32_t frame_interval_ms(void)
 	return 1000U / (uint32_t)STREAM_FPS;
 }
 
-static void ensure_mdns_started(void)
+// Caller holds mdns_lock.
+static void mdns_start_locked(void)
 {
 	if (mdns_started)
 		return;
@@ -64,9 +550,17 @@ static void ensure_mdns_started(void)
 	ESP_LOGI(TAG, "mDNS started: %s.local", MDNS_HOSTNAME);
 }
 
+static void ensure_mdns_started(void)
+{
+	xSemaphoreTake(mdns_lock, portMAX_DELAY);
+	mdns_start_locked();
+	xSemaphoreGive(mdns_lock);
+}
+
 static void mdns_advertise_rc_ws(void)
 {
-	ensure_mdns_started();
+	xSemaphoreTake(mdns_lock, portMAX_DELAY);
+	mdns_start_locked();
 	mdns_txt_item_t txt[] = {{"path", "/"}, {"proto", "ws"}};
 
 	// Android app is searching for: _esp_rc._tcp.
@@ -83,17 +577,20 @@ static void mdns_advertise_rc_ws(void)
 		mdns_service_added_rcws = true;
 		(void)mdns_service_add(NULL, "_rcws", "_tcp", RC_WS_PORT, txt, sizeof(txt) / sizeof(txt[0]));
 	}
+	xSemaphoreGive(mdns_lock);
 }
 
 static void mdns_advertise_provision_http(void)
 {
-	ensure_mdns_started();
-	if (mdns_service_added_http)
-		return;
-	mdns_service_added_http = true;
-
-	mdns_txt_item_t txt[] = {{"path", "/"}, {"role", "provision"}};
-	(void)mdns_service_add(NULL, "_http", "_tcp", 80, txt, sizeof(txt) / sizeof(txt[0]));
+	xSemaphoreTake(mdns_lock, portMAX_DELAY);
+	mdns_start_locked();
+	if (!mdns_service_added_http)
+	{
+		mdns_service_added_http = true;
+		mdns_txt_item_t txt[] = {{"path", "/"}, {"role", "provision"}};
+		(void)mdns_service_add(NULL, "_http", "_tcp", 80, txt, sizeof(txt) / sizeof(txt[0]));
+	}
+	xSemaphoreGive(mdns_lock);
 }
 
 static void log_wifi_password(const char *context, const char *pass)
@@ -212,6 +709,73 @@ static void nvs_clear_wifi_creds(void)
 	nvs_close(nvs);
 }
 
+// Live credential test from the setup page (see prov_test.h): /api/save connects the STA with the
+// new credentials while the provisioning AP keeps running (APSTA), the Wi-Fi events decide, GET
+// /api/status reports back. The steps that need the driver or NVS run on wifi_recovery_task;
+// prov_timer only marks the next one due and wakes the task (its callback shares the esp_timer task
+// with actuation_tick). Fields under prov_lock.
+static const prov_test_config_t PROV_TEST_CONFIG = {
+	.attempts_max = PROVISION_TEST_ATTEMPTS,
+	.timeout_us = PROVISION_TEST_TIMEOUT_MS * 1000u,
+	.retry_delay_us = 500000,
+	.switch_delay_us = PROVISION_SWITCH_DELAY_MS * 1000u,
+};
+static struct
+{
+	prov_test_t test;
+	char ssid[33];
+	char pass[65];
+	esp_ip4_addr_t ip;
+} prov;
+static portMUX_TYPE prov_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t prov_timer = NULL;
+
+static void prov_timer_cb(void *arg)
+{
+	(void)arg;
+	portENTER_CRITICAL(&prov_lock);
+	prov_test_timer_fired(&prov.test);
+	portEXIT_CRITICAL(&prov_lock);
+	if (wifi_rec_task_handle)
+		xTaskNotifyGive(wifi_rec_task_handle);
+}
+
+static void prov_timer_arm(int64_t delay_us)
+{
+	(void)esp_timer_stop(prov_timer);
+	(void)esp_timer_start_once(prov_timer, (delay_us > 0) ? (uint64_t)delay_us : 1);
+}
+
+static prov_fail_t prov_fail_kind(uint16_t reason)
+{
+	if (reason == WIFI_REASON_AUTH_FAIL || reason == WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT ||
+		reason == WIFI_REASON_HANDSHAKE_TIMEOUT || reason == WIFI_REASON_AUTH_EXPIRE)
+		return PROV_FAIL_AUTH;
+	return (reason == WIFI_REASON_NO_AP_FOUND) ? PROV_FAIL_NOT_FOUND : PROV_FAIL_OTHER;
+}
+
+static void prov_test_on_disconnect(uint16_t reason)
+{
+	if (reason == WIFI_REASON_ASSOC_LEAVE)
+		return; // our own esp_wifi_disconnect() before the test
+	portENTER_CRITICAL(&prov_lock);
+	const bool retry = prov_test_disconnected(&prov.test, reason, prov_fail_kind(reason));
+	portEXIT_CRITICAL(&prov_lock);
+	if (retry)
+		prov_timer_arm(PROV_TEST_CONFIG.retry_delay_us);
+}
+
+static void prov_test_on_got_ip(esp_ip4_addr_t ip)
+{
+	portENTER_CRITICAL(&prov_lock);
+	const bool testing = prov_test_got_ip(&prov.test);
+	if (testing)
+		prov.ip = ip;
+	portEXIT_CRITICAL(&prov_lock);
+	if (testing)
+		prov_timer_arm(0);
+}
+
 static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id,
 							   void *event_data)
 {
@@ -223,6 +787,7 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
 		{
 		case WIFI_EVENT_AP_START:
 			ESP_LOGI(TAG, "WiFi AP started");
+			boot_timeline_mark(BOOT_MS_AP_STARTED);
 			ensure_mdns_started();
 			break;
 		case WIFI_EVENT_AP_STOP:
@@ -239,30 +804,33 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
 			const wifi_event_ap_stadisconnected_t *e =
 				(const wifi_event_ap_stadisconnected_t *)event_data;
 			ESP_LOGI(TAG, "AP station disconnected: " MACSTR " (aid=%d)", MAC2STR(e->mac), e->aid);
-			memset(controlState, 0, sizeof(controlState));
+			control_reset();
 			break;
 		}
 		case WIFI_EVENT_STA_START:
 			ESP_LOGI(TAG, "WiFi STA start");
 			break;
 		case WIFI_EVENT_STA_CONNECTED:
-			ESP_LOGI(TAG, "WiFi STA connected");
-			sta_retry_count = 0;
+		{
+			const wifi_event_sta_connected_t *e = (const wifi_event_sta_connected_t *)event_data;
+			ESP_LOGI(TAG, "WiFi STA connected (channel %u)", (unsigned)e->channel);
+			portENTER_CRITICAL(&wifi_rec_lock);
+			wifi_rec_connected(&wifi_rec, e->channel, e->bssid);
+			portEXIT_CRITICAL(&wifi_rec_lock);
 			break;
+		}
 		case WIFI_EVENT_STA_DISCONNECTED:
 		{
+			// Retries are wifi_recovery_task's job (driver calls don't belong in the event loop).
 			const wifi_event_sta_disconnected_t *e = (const wifi_event_sta_disconnected_t *)event_data;
 			ESP_LOGW(TAG, "WiFi STA disconnected (reason=%d)", (int)e->reason);
-			if (sta_retry_count < WIFI_STA_MAX_RETRY)
-			{
-				sta_retry_count++;
-				ESP_LOGI(TAG, "Retrying STA connect (%d/%d)...", sta_retry_count, WIFI_STA_MAX_RETRY);
-				(void)esp_wifi_connect();
-			}
-			else if (wifi_event_group)
-			{
-				xEventGroupSetBits(wifi_event_group, WIFI_FAIL_BIT);
-			}
+			const int64_t now_us = esp_timer_get_time();
+			portENTER_CRITICAL(&wifi_rec_lock);
+			wifi_rec_disconnected(&wifi_rec, e->reason, now_us);
+			portEXIT_CRITICAL(&wifi_rec_lock);
+			if (wifi_rec_task_handle)
+				xTaskNotifyGive(wifi_rec_task_handle);
+			prov_test_on_disconnect(e->reason);
 			break;
 		}
 		default:
@@ -277,6 +845,14 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
 		{
 			const ip_event_got_ip_t *e = (const ip_event_got_ip_t *)event_data;
 			ESP_LOGI(TAG, "Got IP: " IPSTR, IP2STR(&e->ip_info.ip));
+			boot_timeline_mark(BOOT_MS_STA_GOT_IP);
+			const int64_t now_us = esp_timer_get_time();
+			portENTER_CRITICAL(&wifi_rec_lock);
+			wifi_rec_got_ip(&wifi_rec, now_us);
+			portEXIT_CRITICAL(&wifi_rec_lock);
+			if (wifi_rec_task_handle)
+				xTaskNotifyGive(wifi_rec_task_handle);
+			prov_test_on_got_ip(e->ip_info.ip);
 			if (wifi_event_group)
 				xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
 			ensure_mdns_started();
@@ -288,6 +864,53 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
 	}
 }
 
+// Sensor frame sizes by width, largest first.
+static const struct
+{
+	uint16_t width;
+	framesize_t size;
+} CAM_FRAME_SIZES[] = {
+	{640, FRAMESIZE_VGA}, {480, FRAMESIZE_HVGA}, {400, FRAMESIZE_CIF}, {320, FRAMESIZE_QVGA},
+	{240, FRAMESIZE_HQVGA}, {176, FRAMESIZE_QCIF}, {160, FRAMESIZE_QQVGA},
+};
+
+static const char *pixformat_name(pixformat_t format)
+{
+	switch (format)
+	{
+	case PIXFORMAT_JPEG:
+		return "jpeg";
+	case PIXFORMAT_RGB565:
+		return "rgb565";
+	case PIXFORMAT_GRAYSCALE:
+		return "grayscale";
+	case PIXFORMAT_YUV422:
+		return "yuv422";
+	default:
+		return "other";
+	}
+}
+
+static framesize_t frame_size_for_width(uint16_t max_width)
+{
+	for (size_t i = 0; i < sizeof(CAM_FRAME_SIZES) / sizeof(CAM_FRAME_SIZES[0]); i++)
+	{
+		if (CAM_FRAME_SIZES[i].width <= max_width)
+			return CAM_FRAME_SIZES[i].size;
+	}
+	return FRAMESIZE_QQVGA;
+}
+
+static uint16_t frame_size_width(framesize_t size)
+{
+	for (size_t i = 0; i < sizeof(CAM_FRAME_SIZES) / sizeof(CAM_FRAME_SIZES[0]); i++)
+	{
+		if (CAM_FRAME_SIZES[i].size == size)
+			return CAM_FRAME_SIZES[i].width;
+	}
+	return 0;
+}
+
 static esp_err_t init_camera(void)
 {
 	camera_config_t config = {
@@ -311,20 +934,49 @@ static esp_err_t init_camera(void)
 		.pin_reset = CAM_PIN_RESET,
 		.xclk_freq_hz = 20000000,
 		.pixel_format =
-#if (CAM_STREAM_MODE == CAM_STREAM_MODE_RGB565_RAW) || (CAM_STREAM_MODE == CAM_STREAM_MODE_GRAY8)
+#if (CAM_STREAM_MODE == CAM_STREAM_MODE_RGB565_RAW) || (CAM_STREAM_MODE == CAM_STREAM_MODE_GRAY8) ||          \
+	(CAM_STREAM_MODE == CAM_STREAM_MODE_PACKED)
 			PIXFORMAT_RGB565,
+#elif (CAM_STREAM_MODE == CAM_STREAM_MODE_GRAY_SENSOR)
+			PIXFORMAT_GRAYSCALE,
+#elif (CAM_STREAM_MODE == CAM_STREAM_MODE_YUV422)
+			PIXFORMAT_YUV422,
 #else
 			PIXFORMAT_JPEG,
 #endif
 		.frame_size = FRAMESIZE_QVGA,
 		.jpeg_quality = 12,
-		.fb_count = 2,
+		.fb_count = CAM_FB_COUNT_SMOOTH,
 		.fb_location = CAMERA_FB_IN_PSRAM,
 		.grab_mode = CAMERA_GRAB_WHEN_EMPTY,
 	};
 
+	const uint8_t latency = cam_latency_mode;
+	if (latency == CAM_LATENCY_LOW)
+	{
+		config.fb_count = CAM_FB_COUNT_LOW_LATENCY;
+		config.grab_mode = CAMERA_GRAB_LATEST;
+	}
+
+	const uint8_t tier = mem_tier;
+	const mem_tier_limits_t *lim = &MEM_TIER_LIMITS[tier];
+	config.frame_size = frame_size_for_width(lim->frame_width);
+	if (config.fb_count > lim->fb_count)
+		config.fb_count = lim->fb_count;
+
 	esp_err_t err = esp_camera_init(&config);
-#if (CAM_STREAM_MODE != CAM_STREAM_MODE_RGB565_RAW) && (CAM_STREAM_MODE != CAM_STREAM_MODE_GRAY8)
+#if (CAM_STREAM_MODE == CAM_STREAM_MODE_GRAY_SENSOR) || (CAM_STREAM_MODE == CAM_STREAM_MODE_YUV422)
+	// Sensor drivers report an unsupported output format with different errors, so any failure
+	// gets one RGB565 retry; the stream path then converts to GRAY8 like CAM_STREAM_MODE_GRAY8.
+	if (err != ESP_OK)
+	{
+		ESP_LOGW(TAG, "Sensor rejected %s (%s), retrying with RGB565 + software luma",
+				 pixformat_name(config.pixel_format), esp_err_to_name(err));
+		(void)esp_camera_deinit();
+		config.pixel_format = PIXFORMAT_RGB565;
+		err = esp_camera_init(&config);
+	}
+#elif (CAM_STREAM_MODE == CAM_STREAM_MODE_JPEG)
 	if (err == ESP_ERR_NOT_SUPPORTED && config.pixel_format == PIXFORMAT_JPEG)
 	{
 		ESP_LOGW(TAG, "Sensor does not support JPEG, retrying with RGB565 + software JPEG");
@@ -343,21 +995,40 @@ static esp_err_t init_camera(void)
 			config.frame_size = FRAMESIZE_QQVGA;
 		err = esp_camera_init(&config);
 	}
+	if (err == ESP_OK)
+	{
+		cam_latency_active = latency;
+		cam_fb_count_active = config.fb_count;
+		cam_frame_width_active = frame_size_width(config.frame_size);
+		cam_tier_active = tier;
+		cam_pixformat_active = config.pixel_format;
+	}
 	return err;
 }
 
+// TCP/IP stack + default event loop. Enough for httpd to bind, no NVS or Wi-Fi driver needed.
+static void netif_stack_init(void)
+{
+	if (netif_stack_initialized)
+		return;
+	netif_stack_initialized = true;
+	ESP_ERROR_CHECK(esp_netif_init());
+
+	esp_err_t loop_err = esp_event_loop_create_default();
+	if (loop_err != ESP_OK && loop_err != ESP_ERR_INVALID_STATE)
+		ESP_ERROR_CHECK(loop_err);
+}
+
 static void wifi_init_common(void)
 {
+	netif_stack_init();
+
 	if (!wifi_stack_initialized)
 	{
 		wifi_stack_initialized = true;
-		ESP_ERROR_CHECK(esp_netif_init());
-
-		esp_err_t loop_err = esp_event_loop_create_default();
-		if (loop_err != ESP_OK && loop_err != ESP_ERR_INVALID_STATE)
-			ESP_ERROR_CHECK(loop_err);
-
-		ESP_ERROR_CHECK(esp_wifi_init(&(wifi_init_config_t)WIFI_INIT_CONFIG_DEFAULT()));
+		wifi_init_config_t init_cfg = WIFI_INIT_CONFIG_DEFAULT();
+		wifi_link_patch_init_config(&init_cfg);
+		ESP_ERROR_CHECK(esp_wifi_init(&init_cfg));
 		ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
 	}
 
@@ -379,27 +1050,46 @@ static void wifi_ensure_netifs(bool need_ap, bool need_sta)
 		wifi_netif_sta = esp_netif_create_default_wifi_sta();
 }
 
+static void wifi_ap_config(wifi_config_t *ap_config)
+{
+	memset(ap_config, 0, sizeof(*ap_config));
+	strncpy((char *)ap_config->ap.ssid, AP_SSID, sizeof(ap_config->ap.ssid));
+	ap_config->ap.ssid_len = (uint8_t)strlen(AP_SSID);
+	ap_config->ap.channel = 1;
+	ap_config->ap.max_connection = 2;
+	ap_config->ap.authmode = (strlen(AP_PASS) == 0) ? WIFI_AUTH_OPEN : WIFI_AUTH_WPA_WPA2_PSK;
+	strncpy((char *)ap_config->ap.password, AP_PASS, sizeof(ap_config->ap.password));
+}
+
 static esp_err_t wifi_start_ap(bool include_sta)
 {
 	wifi_init_common();
 	wifi_ensure_netifs(true, include_sta);
 
-	wifi_config_t ap_config = {0};
-	strncpy((char *)ap_config.ap.ssid, AP_SSID, sizeof(ap_config.ap.ssid));
-	ap_config.ap.ssid_len = (uint8_t)strlen(AP_SSID);
-	ap_config.ap.channel = 1;
-	ap_config.ap.max_connection = 2;
-	ap_config.ap.authmode = (strlen(AP_PASS) == 0) ? WIFI_AUTH_OPEN : WIFI_AUTH_WPA_WPA2_PSK;
-	strncpy((char *)ap_config.ap.password, AP_PASS, sizeof(ap_config.ap.password));
+	wifi_config_t ap_config;
+	wifi_ap_config(&ap_config);
 
 	(void)esp_wifi_stop();
 	ESP_ERROR_CHECK(esp_wifi_set_mode(include_sta ? WIFI_MODE_APSTA : WIFI_MODE_AP));
 	ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &ap_config));
 	ESP_ERROR_CHECK(esp_wifi_start());
+	wifi_link_reapply();
+	boot_timeline_mark(BOOT_MS_WIFI_STARTED);
 	ESP_LOGI(TAG, "SoftAP started: SSID=%s", AP_SSID);
 	return ESP_OK;
 }
 
+static void wifi_sta_config(wifi_config_t *sta_config, const char *ssid, const char *pass)
+{
+	memset(sta_config, 0, sizeof(*sta_config));
+	strncpy((char *)sta_config->sta.ssid, ssid, sizeof(sta_config->sta.ssid));
+	strncpy((char *)sta_config->sta.password, pass ? pass : "", sizeof(sta_config->sta.password));
+	// Allow connecting to both OPEN and secured networks; if password is wrong, disconnect reason
+	// will show it and provisioning can be re-run.
+	sta_config->sta.threshold.authmode = WIFI_AUTH_OPEN;
+	sta_config->sta.pmf_cfg = (wifi_pmf_config_t){.capable = true, .required = false};
+}
+
 static esp_err_t wifi_start_sta_with_creds(const char *ssid, const char *pass)
 {
 	if (!ssid || strlen(ssid) == 0)
@@ -410,23 +1100,228 @@ static esp_err_t wifi_start_sta_with_creds(const char *ssid, const char *pass)
 	ESP_LOGI(TAG, "WiFi STA connect attempt: ssid='%s'", ssid);
 	log_wifi_password("WiFi STA connect attempt", pass ? pass : "");
 
-	wifi_config_t sta_config = {0};
-	strncpy((char *)sta_config.sta.ssid, ssid, sizeof(sta_config.sta.ssid));
-	strncpy((char *)sta_config.sta.password, pass ? pass : "", sizeof(sta_config.sta.password));
-	// Allow connecting to both OPEN and secured networks; if password is wrong, disconnect reason
-	// will show it and provisioning can be re-run.
-	sta_config.sta.threshold.authmode = WIFI_AUTH_OPEN;
-	sta_config.sta.pmf_cfg = (wifi_pmf_config_t){.capable = true, .required = false};
+	wifi_config_t sta_config;
+	wifi_sta_config(&sta_config, ssid, pass);
 
 	(void)esp_wifi_stop();
 	ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
 	ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &sta_config));
 	ESP_ERROR_CHECK(esp_wifi_start());
+	wifi_link_reapply();
+	boot_timeline_mark(BOOT_MS_WIFI_STARTED);
 	ESP_ERROR_CHECK(esp_wifi_connect());
 	ESP_LOGI(TAG, "WiFi STA connecting: SSID=%s", ssid);
 	return ESP_OK;
 }
 
+// Reconnect attempt with the stored credentials: pinned to `channel` / `bssid` (no scan), or with a
+// full scan when `channel` is 0.
+static void wifi_sta_reconnect(uint8_t channel, const uint8_t bssid[6])
+{
+	wifi_config_t sta_config = {0};
+	if (esp_wifi_get_config(WIFI_IF_STA, &sta_config) == ESP_OK)
+	{
+		sta_config.sta.channel = channel;
+		sta_config.sta.bssid_set = (channel != 0);
+		if (channel != 0)
+			memcpy(sta_config.sta.bssid, bssid, sizeof(sta_config.sta.bssid));
+		sta_config.sta.scan_method = (channel != 0) ? WIFI_FAST_SCAN : WIFI_ALL_CHANNEL_SCAN;
+		(void)esp_wifi_set_config(WIFI_IF_STA, &sta_config);
+	}
+	wifi_link_note_sta_retry();
+	const esp_err_t err = esp_wifi_connect();
+	if (err != ESP_OK)
+		ESP_LOGW(TAG, "STA reconnect failed to start: %s", esp_err_to_name(err));
+	else if (channel != 0)
+		ESP_LOGI(TAG, "STA reconnect on channel %u, BSSID " MACSTR, (unsigned)channel, MAC2STR(bssid));
+	else
+		ESP_LOGI(TAG, "STA reconnect (full scan)");
+}
+
+// SoftAP fallback during an outage: the AP comes up next to the STA without restarting the driver,
+// so the STA keeps its config and goes on retrying. It is only taken down when no station uses it.
+static bool wifi_fallback_ap(bool on)
+{
+	if (!on)
+	{
+		wifi_sta_list_t stations = {0};
+		if (esp_wifi_ap_get_sta_list(&stations) == ESP_OK && stations.num > 0)
+			return false;
+		const esp_err_t err = esp_wifi_set_mode(WIFI_MODE_STA);
+		if (err == ESP_OK)
+			ESP_LOGI(TAG, "Fallback AP stopped (STA is back)");
+		return err == ESP_OK;
+	}
+	wifi_ensure_netifs(true, false);
+	wifi_config_t ap_config;
+	wifi_ap_config(&ap_config);
+	esp_err_t err = esp_wifi_set_mode(WIFI_MODE_APSTA);
+	if (err == ESP_OK)
+		err = esp_wifi_set_config(WIFI_IF_AP, &ap_config);
+	if (err == ESP_OK)
+		ESP_LOGW(TAG, "STA still down, fallback AP started: SSID=%s", AP_SSID);
+	else
+		ESP_LOGE(TAG, "Fallback AP failed: %s", esp_err_to_name(err));
+	return err == ESP_OK;
+}
+
+// Link edges: while the link is down the motors are zeroed (as when the AP client leaves) and the
+// camera stops producing frames for WS viewers; local consumers (vision, recorder) keep it running.
+static void wifi_link_edge(bool up, wifi_rec_state_t state, const wifi_rec_stats_t *st)
+{
+	if (up)
+	{
+		xEventGroupSetBits(camera_demand_group, CAM_DEMAND_LINK);
+		if (state == WIFI_REC_CONNECTED)
+			ESP_LOGI(TAG, "Link back after %u ms (%u outages)", (unsigned)st->outage_ms_last,
+					 (unsigned)st->outages);
+		else
+			ESP_LOGI(TAG, "Link up (%s)", wifi_rec_state_name(state));
+		return;
+	}
+	control_reset();
+	xEventGroupClearBits(camera_demand_group, CAM_DEMAND_LINK);
+	ESP_LOGW(TAG, "Link down: motors stopped, video idle until it is back");
+}
+
+// Provisioning is done: STA only, setup server off, link recovery takes over from CONNECTED (this
+// runs on wifi_recovery_task, which polls it next). The camera, the WS server and its sessions are
+// not touched.
+static void provision_switch_to_sta(void)
+{
+	const esp_err_t err = esp_wifi_set_mode(WIFI_MODE_STA);
+	if (err != ESP_OK)
+	{
+		// The credentials are saved; a restart gets there the old way.
+		ESP_LOGE(TAG, "Provisioning: switch to STA failed: %s, restarting", esp_err_to_name(err));
+		schedule_restart_ms(800);
+		return;
+	}
+	if (provisionServer)
+	{
+		(void)httpd_stop(provisionServer);
+		provisionServer = NULL;
+	}
+	const int64_t now_us = esp_timer_get_time();
+	portENTER_CRITICAL(&wifi_rec_lock);
+	wifi_rec_begin(&wifi_rec, now_us);
+	wifi_rec_got_ip(&wifi_rec, now_us);
+	portEXIT_CRITICAL(&wifi_rec_lock);
+	ESP_LOGI(TAG, "Provisioning done: STA only, no restart");
+}
+
+// Runs the provisioning step prov_timer marked due, if any. wifi_recovery_task only.
+static void prov_run_step(void)
+{
+	const int64_t now_us = esp_timer_get_time();
+	char ssid[33];
+	char pass[65];
+	int64_t arm_us = 0;
+	portENTER_CRITICAL(&prov_lock);
+	const prov_action_t action = prov_test_next(&prov.test, now_us, &arm_us);
+	memcpy(ssid, prov.ssid, sizeof(ssid));
+	memcpy(pass, prov.pass, sizeof(pass));
+	portEXIT_CRITICAL(&prov_lock);
+
+	switch (action)
+	{
+	case PROV_ACT_NONE:
+		break;
+	case PROV_ACT_CONNECT:
+		ESP_LOGI(TAG, "Provisioning test: retrying '%s'", ssid);
+		(void)esp_wifi_connect();
+		prov_timer_arm(arm_us);
+		break;
+	case PROV_ACT_GIVE_UP:
+		ESP_LOGW(TAG, "Provisioning test: no IP from '%s' in %u ms", ssid, (unsigned)PROVISION_TEST_TIMEOUT_MS);
+		(void)esp_wifi_disconnect();
+		break;
+	case PROV_ACT_SAVE:
+	{
+		const esp_err_t err = nvs_save_wifi_creds(ssid, pass);
+		portENTER_CRITICAL(&prov_lock);
+		const bool saved = prov_test_saved(&prov.test, err == ESP_OK, now_us);
+		portEXIT_CRITICAL(&prov_lock);
+		if (!saved)
+			break;
+		ESP_LOGI(TAG, "Provisioning test: '%s' works, saved; STA only in %u ms", ssid,
+				 (unsigned)PROVISION_SWITCH_DELAY_MS);
+		prov_timer_arm(PROV_TEST_CONFIG.switch_delay_us);
+		break;
+	}
+	case PROV_ACT_SWITCH:
+		provision_switch_to_sta();
+		break;
+	}
+}
+
+static void wifi_recovery_task(void *arg)
+{
+	(void)arg;
+	bool link_up = true;
+	while (true)
+	{
+		prov_run_step();
+		uint32_t wait_us = UINT32_MAX;
+		portENTER_CRITICAL(&wifi_rec_lock);
+		const wifi_rec_action_t action = wifi_rec_poll(&wifi_rec, esp_timer_get_time(), &wait_us);
+		const bool up = wifi_rec.link_up;
+		const wifi_rec_state_t state = wifi_rec.state;
+		const wifi_rec_stats_t st = wifi_rec.stats;
+		const uint8_t channel = wifi_rec.channel;
+		uint8_t bssid[6];
+		memcpy(bssid, wifi_rec.bssid, sizeof(bssid));
+		portEXIT_CRITICAL(&wifi_rec_lock);
+
+		if (up != link_up)
+		{
+			link_up = up;
+			wifi_link_edge(up, state, &st);
+		}
+		switch (action)
+		{
+		case WIFI_REC_CONNECT_FAST:
+			wifi_sta_reconnect(channel, bssid);
+			break;
+		case WIFI_REC_CONNECT_SCAN:
+			wifi_sta_reconnect(0, bssid);
+			break;
+		case WIFI_REC_START_SOFTAP:
+			(void)wifi_fallback_ap(true);
+			break;
+		case WIFI_REC_STOP_SOFTAP:
+		{
+			const bool stopped = wifi_fallback_ap(false);
+			const int64_t now_us = esp_timer_get_time();
+			portENTER_CRITICAL(&wifi_rec_lock);
+			wifi_rec_softap_stopped(&wifi_rec, stopped, now_us);
+			portEXIT_CRITICAL(&wifi_rec_lock);
+			break;
+		}
+		case WIFI_REC_BOOT_FAILED:
+			ESP_LOGW(TAG, "STA connect failed after %u attempts", (unsigned)st.attempts);
+			xEventGroupSetBits(wifi_event_group, WIFI_FAIL_BIT);
+			break;
+		case WIFI_REC_NONE:
+			// Sleeps until the next deadline or a Wi-Fi event.
+			(void)ulTaskNotifyTake(pdTRUE, (wait_us == UINT32_MAX) ? portMAX_DELAY
+																	: pdMS_TO_TICKS(wait_us / 1000) + 1);
+			break;
+		}
+	}
+}
+
+// Link telemetry with the recovery state and outage stats embedded.
+static size_t link_telemetry_json(char *buf, size_t len)
+{
+	portENTER_CRITICAL(&wifi_rec_lock);
+	const wifi_rec_t rec = wifi_rec;
+	portEXIT_CRITICAL(&wifi_rec_lock);
+	char rec_json[320];
+	const bool have_rec = wifi_rec_json(rec_json, sizeof(rec_json), &rec, esp_timer_get_time()) > 0;
+	return wifi_link_telemetry_json(buf, len, have_rec ? rec_json : NULL);
+}
+
 static bool url_decode_inplace(char *s)
 {
 	if (!s)
@@ -497,51 +1392,38 @@ static bool form_get_value(char *body, const char *key, char *out, size_t out_le
 	return false;
 }
 
+// Embedded pages and assets (web/embed.py): gzip as stored, revalidated by ETag. Responses close the
+// connection so a browser's idle keep-alive sockets don't hold WS client slots.
+static esp_err_t web_send_asset(httpd_req_t *req, const web_asset_t *asset)
+{
+	if (!asset)
+		return httpd_resp_send_404(req);
+
+	httpd_resp_set_hdr(req, "ETag", asset->etag);
+	httpd_resp_set_hdr(req, "Cache-Control", asset->cache_control);
+	httpd_resp_set_hdr(req, "Connection", "close");
+	char inm[96];
+	const bool cached = httpd_req_get_hdr_value_str(req, "If-None-Match", inm, sizeof(inm)) == ESP_OK &&
+						web_etag_match(inm, asset->etag);
+	esp_err_t err;
+	if (cached)
+	{
+		httpd_resp_set_status(req, "304 Not Modified");
+		err = httpd_resp_send(req, NULL, 0);
+	}
+	else
+	{
+		httpd_resp_set_type(req, asset->mime);
+		httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+		err = httpd_resp_send(req, (const char *)asset->data, asset->len);
+	}
+	httpd_sess_trigger_close(req->handle, httpd_req_to_sockfd(req));
+	return err;
+}
+
 static esp_err_t provision_index_handler(httpd_req_t *req)
 {
-	static const char html[] =
-		"<!doctype html><html><head><meta charset='utf-8'/>"
-		"<meta name='viewport' content='width=device-width,initial-scale=1'/>"
-		"<title>ESP32 Wi-Fi setup</title>"
-		"<style>body{font-family:sans-serif;max-width:720px;margin:24px auto;padding:0 12px}"
-		"button,input,select{font-size:16px;padding:10px} .row{margin:12px 0}"
-		"small{color:#555} pre{background:#f3f3f3;padding:12px;overflow:auto}</style>"
-		"</head><body>"
-		"<h2>Wi-Fi setup</h2>"
-		"<div class='row'><button onclick='scan()'>Scan networks</button> "
-		"<small id='status'></small></div>"
-		"<div class='row'><label>SSID<br/><select id='ssid'></select></label></div>"
-		"<div class='row'><label>Password<br/><input id='pass' type='password' "
-		"placeholder='(empty for open network)'/></label></div>"
-		"<div class='row'><button onclick='save()'>Save and reboot</button> "
-		"<button onclick='forget()'>Forget saved</button></div>"
-		"<pre id='log'></pre>"
-		"<script>"
-		"async function scan(){"
-		"document.getElementById('status').textContent='scanning...';"
-		"const r=await fetch('/api/scan'); const j=await r.json();"
-		"const s=document.getElementById('ssid'); s.innerHTML='';"
-		"j.aps.forEach(ap=>{const o=document.createElement('option');"
-		"o.value=ap.ssid; o.textContent=`${ap.ssid} (RSSI ${ap.rssi})`; s.appendChild(o);});"
-		"document.getElementById('status').textContent=`found ${j.aps.length}`;"
-		"document.getElementById('log').textContent=JSON.stringify(j,null,2);"
-		"}"
-		"async function save(){"
-		"const ssid=document.getElementById('ssid').value;"
-		"const pass=document.getElementById('pass').value;"
-		"const body=new URLSearchParams({ssid,pass}).toString();"
-		"const r=await fetch('/api/save',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},body});"
-		"document.getElementById('log').textContent=await r.text();"
-		"}"
-		"async function forget(){"
-		"const r=await fetch('/api/forget',{method:'POST'});"
-		"document.getElementById('log').textContent=await r.text();"
-		"}"
-		"scan();"
-		"</script></body></html>";
-
-	httpd_resp_set_type(req, "text/html");
-	return httpd_resp_send(req, html, HTTPD_RESP_USE_STRLEN);
+	return web_send_asset(req, web_asset_find("/setup.html"));
 }
 
 static esp_err_t provision_scan_handler(httpd_req_t *req)
@@ -605,6 +1487,38 @@ static esp_err_t provision_scan_handler(httpd_req_t *req)
 	return resp_err;
 }
 
+// {"state":"connecting"|"ok"|"failed"|"idle","ssid":..,"attempts":..,"elapsed_ms":..,"reason":..,
+//  "error":..,"ip":..,"switch_in_ms":..}
+static esp_err_t provision_status_handler(httpd_req_t *req)
+{
+	const int64_t now_us = esp_timer_get_time();
+	portENTER_CRITICAL(&prov_lock);
+	const prov_test_state_t state = prov.test.state;
+	const esp_ip4_addr_t ip = prov.ip;
+	const uint32_t attempts = prov.test.attempts;
+	const uint16_t reason = prov.test.reason;
+	const char *error = prov.test.error;
+	const int64_t start_us = prov.test.start_us;
+	const int64_t switch_us = (prov.test.step == PROV_STEP_SWITCH) ? prov.test.switch_us : 0;
+	char ssid[33];
+	memcpy(ssid, prov.ssid, sizeof(ssid));
+	portEXIT_CRITICAL(&prov_lock);
+
+	char ip_str[16];
+	snprintf(ip_str, sizeof(ip_str), IPSTR, IP2STR(&ip));
+	const int64_t switch_in_us = (switch_us > now_us) ? switch_us - now_us : 0;
+	char json[256];
+	snprintf(json, sizeof(json),
+			 "{\"state\":\"%s\",\"ssid\":\"%s\",\"attempts\":%u,\"elapsed_ms\":%u,\"reason\":%u,"
+			 "\"error\":\"%s\",\"ip\":\"%s\",\"switch_in_ms\":%u}",
+			 prov_test_state_name(state), ssid, (unsigned)attempts,
+			 (unsigned)((state == PROV_TEST_IDLE) ? 0 : (now_us - start_us) / 1000), (unsigned)reason,
+			 error ? error : "", (state == PROV_TEST_OK) ? ip_str : "", (unsigned)(switch_in_us / 1000));
+	httpd_resp_set_type(req, "application/json");
+	httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+	return httpd_resp_send(req, json, HTTPD_RESP_USE_STRLEN);
+}
+
 static esp_err_t provision_save_handler(httpd_req_t *req)
 {
 	const int total_len = req->content_len;
@@ -649,17 +1563,55 @@ static esp_err_t provision_save_handler(httpd_req_t *req)
 
 	ESP_LOGI(TAG, "Provisioning save request: ssid='%s', pass_len=%u", ssid, (unsigned)strlen(pass));
 	log_wifi_password("Provisioning save request", pass);
-	esp_err_t err = nvs_save_wifi_creds(ssid, pass);
+
+	// Test before saving: connect the STA next to the setup AP; the events and prov_timer do the rest.
+	if (!prov_timer)
+	{
+		const esp_timer_create_args_t args = {
+			.callback = &prov_timer_cb,
+			.arg = NULL,
+			.dispatch_method = ESP_TIMER_TASK,
+			.name = "prov_test",
+			.skip_unhandled_events = true,
+		};
+		ESP_ERROR_CHECK(esp_timer_create(&args, &prov_timer));
+	}
+	(void)esp_timer_stop(prov_timer);
+	portENTER_CRITICAL(&prov_lock);
+	prov.test.due = false;
+	const bool switching = prov.test.state == PROV_TEST_OK;
+	portEXIT_CRITICAL(&prov_lock);
+	if (switching)
+	{
+		httpd_resp_set_status(req, "409");
+		return httpd_resp_send(req, "already_connected", HTTPD_RESP_USE_STRLEN);
+	}
+	(void)esp_wifi_disconnect();
+
+	const int64_t now_us = esp_timer_get_time();
+	portENTER_CRITICAL(&prov_lock);
+	memcpy(prov.ssid, ssid, sizeof(prov.ssid));
+	memcpy(prov.pass, pass, sizeof(prov.pass));
+	prov_test_start(&prov.test, now_us);
+	portEXIT_CRITICAL(&prov_lock);
+
+	wifi_config_t sta_config;
+	wifi_sta_config(&sta_config, ssid, pass);
+	esp_err_t err = esp_wifi_set_config(WIFI_IF_STA, &sta_config);
+	if (err == ESP_OK)
+		err = esp_wifi_connect();
 	if (err != ESP_OK)
 	{
-		httpd_resp_set_status(req, "500");
-		return httpd_resp_send(req, "save_failed", HTTPD_RESP_USE_STRLEN);
+		ESP_LOGE(TAG, "Provisioning test: connect failed: %s", esp_err_to_name(err));
+		portENTER_CRITICAL(&prov_lock);
+		prov_test_fail(&prov.test, "connect_failed");
+		portEXIT_CRITICAL(&prov_lock);
 	}
-
-	httpd_resp_set_type(req, "text/plain");
-	httpd_resp_send(req, "saved. rebooting...", HTTPD_RESP_USE_STRLEN);
-	schedule_restart_ms(800);
-	return ESP_OK;
+	else
+	{
+		prov_timer_arm(PROV_TEST_CONFIG.timeout_us);
+	}
+	return provision_status_handler(req);
 }
 
 static esp_err_t provision_forget_handler(httpd_req_t *req)
@@ -691,11 +1643,13 @@ static esp_err_t start_provision_server(void)
 	httpd_uri_t index_uri = {.uri = "/", .method = HTTP_GET, .handler = provision_index_handler};
 	httpd_uri_t scan_uri = {.uri = "/api/scan", .method = HTTP_GET, .handler = provision_scan_handler};
 	httpd_uri_t save_uri = {.uri = "/api/save", .method = HTTP_POST, .handler = provision_save_handler};
+	httpd_uri_t status_uri = {.uri = "/api/status", .method = HTTP_GET, .handler = provision_status_handler};
 	httpd_uri_t forget_uri = {.uri = "/api/forget", .method = HTTP_POST, .handler = provision_forget_handler};
 
 	ESP_ERROR_CHECK(httpd_register_uri_handler(provisionServer, &index_uri));
 	ESP_ERROR_CHECK(httpd_register_uri_handler(provisionServer, &scan_uri));
 	ESP_ERROR_CHECK(httpd_register_uri_handler(provisionServer, &save_uri));
+	ESP_ERROR_CHECK(httpd_register_uri_handler(provisionServer, &status_uri));
 	ESP_ERROR_CHECK(httpd_register_uri_handler(provisionServer, &forget_uri));
 
 	// Common captive-portal probes (serve the same setup page).
@@ -714,14 +1668,154 @@ static esp_err_t start_provision_server(void)
 	return ESP_OK;
 }
 
-static esp_err_t ws_root_handler(httpd_req_t *req)
+static void egress_queue(uint32_t mask, egress_class_t cls, uint8_t opcode, const void *data, size_t len)
 {
-	if (req->method == HTTP_GET)
-	{
-		ESP_LOGI(TAG, "WS handshake done (fd=%d)", httpd_req_to_sockfd(req));
-		return ESP_OK;
+	if (!mask || !egress_lock)
+		return;
+	xSemaphoreTake(egress_lock, portMAX_DELAY);
+	const size_t queued = egress_push(&egress, mask, cls, opcode, data, len, esp_timer_get_time());
+	xSemaphoreGive(egress_lock);
+	if (queued)
+		xTaskNotifyGive(egress_task_handle);
+}
+
+// Replies to a client's control message (HELLO_ACK, ACK), ahead of any queued telemetry/video.
+static void ws_send_to_req(httpd_req_t *req, const uint8_t *data, size_t len)
+{
+	const ws_client_t *client = (const ws_client_t *)req->sess_ctx;
+	if (client)
+	{
+		egress_queue(1u << ws_clients_index(client), EGRESS_CONTROL, EGRESS_WS_BINARY, data, len);
+		return;
+	}
+	httpd_ws_frame_t frame = {
+		.final = true,
+		.type = HTTPD_WS_TYPE_BINARY,
+		.payload = (uint8_t *)data,
+		.len = len,
+	};
+	if (httpd_ws_send_frame(req, &frame) != ESP_OK)
+		wifi_link_note_tx_fail();
+}
+
+// Hot path: runs for every control packet (~20 Hz per sender). No allocation, no logging.
+static void ws_handle_binary(httpd_req_t *req, const uint8_t *data, size_t len)
+{
+	rc_msg_t msg;
+	if (rc_proto_parse(data, len, &msg) != RC_PARSE_OK)
+	{
+		control_malformed++;
+		return;
+	}
+
+	ws_client_t *client = (ws_client_t *)req->sess_ctx;
+	rc_proto_session_t *sess = client ? &client->session : NULL;
+	uint8_t reply[RC_PROTO_HELLO_ACK_LEN];
+	switch (msg.type)
+	{
+	case RC_MSG_HELLO:
+	{
+		const uint32_t caps = msg.hello.caps & RC_DEVICE_CAPS;
+		if (client)
+		{
+			sess->caps = caps;
+			ws_clients_set_topics(client, (caps & RC_CAP_CONTROL_ONLY) ? WS_TOPIC_BIT(WS_TOPIC_TELEMETRY)
+																	 : WS_TOPICS_ALL);
+			xSemaphoreTake(egress_lock, portMAX_DELAY);
+			egress_client_set_chunked(&egress, ws_clients_index(client), (caps & RC_CAP_VIDEO_CHUNKED) != 0);
+			egress_client_set_abbrev(&egress, ws_clients_index(client), (caps & RC_CAP_VIDEO_JPEG_ABBREV) != 0);
+			xSemaphoreGive(egress_lock);
+		}
+		ws_send_to_req(req, reply, rc_proto_write_hello_ack(reply, sizeof(reply), caps));
+		break;
+	}
+	case RC_MSG_CONTROL:
+	{
+		const rc_control_t *ctrl = &msg.control;
+		// Legacy frames carry no sequence number; they are applied in arrival order.
+		const bool fresh = (ctrl->flags & RC_CTRL_FLAG_LEGACY) ||
+						   rc_proto_session_accept(sess, ctrl->seq, esp_timer_get_time());
+		if (fresh)
+			control_set(ctrl, httpd_req_to_sockfd(req));
+		else
+			control_stale++;
+
+		if (ctrl->flags & RC_CTRL_FLAG_ACK_REQ)
+			ws_send_to_req(req, reply,
+						   rc_proto_write_ack(reply, sizeof(reply), ctrl->seq,
+											  fresh ? RC_ACK_APPLIED : RC_ACK_STALE));
+		break;
+	}
+	default:
+		control_malformed++;
+		break;
+	}
+}
+
+#if RECORDER_SESSION
+// Entry time is taken under the lock so it increases with the sequence number across both producers.
+static void session_push(const uint8_t *head, size_t head_len, const uint8_t *data, size_t len, uint32_t flags)
+{
+	if (!recorder_ready || !data || len == 0)
+		return;
+	xSemaphoreTake(session_lock, portMAX_DELAY);
+	(void)rec_writer_push2(&rec_writer, head, (uint32_t)head_len, data, (uint32_t)len, esp_timer_get_time(), flags);
+	xSemaphoreGive(session_lock);
+}
+
+// Waits for the lock at most as long as the camera task takes to copy one frame into staging.
+static void session_capture_control(httpd_req_t *req, uint8_t event, const uint8_t *data, size_t len)
+{
+	const ws_client_t *client = (const ws_client_t *)req->sess_ctx;
+	session_push(NULL, 0, data, len,
+				 session_control_flags(client ? ws_clients_index(client) : SESSION_SLOT_NONE, event));
+}
+#endif
+
+static void ws_client_ctx_free(void *ctx)
+{
+	(void)ctx;
+}
+
+static esp_err_t ws_root_handler(httpd_req_t *req)
+{
+	if (req->method == HTTP_GET && httpd_req_get_hdr_value_len(req, "Upgrade") == 0)
+	{
+		// A plain GET / (no WS upgrade) is a browser asking for the driving page.
+#if WEB_UI_ENABLE
+		return web_send_asset(req, web_asset_find("/"));
+#else
+		return httpd_resp_send_404(req);
+#endif
+	}
+	if (req->method == HTTP_GET)
+	{
+		ESP_LOGI(TAG, "WS handshake done (fd=%d)", httpd_req_to_sockfd(req));
+		// The registry slot lives until close_fn; httpd must not free it.
+		ws_client_t *client = ws_clients_on_handshake(httpd_req_to_sockfd(req));
+		if (!client)
+			return ESP_FAIL; // over the memory tier's client cap: httpd closes the connection
+		// From here on egress_task writes to this socket; httpd's send_wait_timeout (whole seconds,
+		// still used for plain HTTP responses) would let one client stall it that long.
+		const struct timeval send_timeout = {.tv_sec = EGRESS_SEND_TIMEOUT_MS / 1000,
+											 .tv_usec = (EGRESS_SEND_TIMEOUT_MS % 1000) * 1000};
+		(void)setsockopt(client->fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+		xSemaphoreTake(egress_lock, portMAX_DELAY);
+		const bool released = egress_client_open(&egress, ws_clients_index(client), false);
+		xSemaphoreGive(egress_lock);
+		if (released)
+			xSemaphoreGive(egress_video_done);
+		req->sess_ctx = client;
+		req->free_ctx = ws_client_ctx_free;
+#if RECORDER_SESSION
+		const uint32_t fd = (uint32_t)httpd_req_to_sockfd(req);
+		const uint8_t fd_le[4] = {(uint8_t)fd, (uint8_t)(fd >> 8), (uint8_t)(fd >> 16), (uint8_t)(fd >> 24)};
+		session_capture_control(req, SESSION_CTRL_OPEN, fd_le, sizeof(fd_le));
+#endif
+		return ESP_OK;
 	}
 
+	uint8_t payload[RC_WS_RX_MAX_LEN];
 	httpd_ws_frame_t frame = {0};
 	esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
 	if (err != ESP_OK)
@@ -732,40 +1826,824 @@ static esp_err_t ws_root_handler(httpd_req_t *req)
 		return err;
 	}
 
+	if (req->sess_ctx)
+		((ws_client_t *)req->sess_ctx)->rx_msgs++;
 	if (frame.len == 0)
 		return ESP_OK;
 
-	uint8_t *payload = (uint8_t *)malloc(frame.len);
-	if (!payload)
-		return ESP_ERR_NO_MEM;
+	// Clients only send small control/text messages; anything larger is a protocol violation.
+	if (frame.len > sizeof(payload))
+	{
+		ESP_LOGW(TAG, "WS frame too large (fd=%d, len=%u)", httpd_req_to_sockfd(req),
+				 (unsigned)frame.len);
+		httpd_sess_trigger_close(req->handle, httpd_req_to_sockfd(req));
+		return ESP_ERR_INVALID_SIZE;
+	}
+
 	frame.payload = payload;
-	err = httpd_ws_recv_frame(req, &frame, frame.len);
+	err = httpd_ws_recv_frame(req, &frame, sizeof(payload));
 	if (err != ESP_OK)
 	{
 		ESP_LOGW(TAG, "WS recv payload failed (fd=%d): %s", httpd_req_to_sockfd(req),
 				 esp_err_to_name(err));
-		free(payload);
 		httpd_sess_trigger_close(req->handle, httpd_req_to_sockfd(req));
 		return err;
 	}
 
-	if (frame.type == HTTPD_WS_TYPE_BINARY && frame.len == RC_CONTROL_LEN)
+	if (frame.type == HTTPD_WS_TYPE_BINARY)
 	{
-		if (memcmp(controlState, payload, RC_CONTROL_LEN) != 0)
-		{
-			memcpy(controlState, payload, RC_CONTROL_LEN);
-			ESP_LOGI(TAG, "[RC State] UP:%u DOWN:%u LEFT:%u RIGHT:%u STOP:%u STEER:%u", controlState[0],
-					 controlState[1], controlState[2], controlState[3], controlState[4], controlState[5]);
-		}
+#if RECORDER_SESSION
+		session_capture_control(req, SESSION_CTRL_MSG, payload, frame.len);
+#endif
+		ws_handle_binary(req, payload, frame.len);
 	}
 	else if (frame.type == HTTPD_WS_TYPE_TEXT)
 	{
 		ESP_LOGI(TAG, "[WS Text] %.*s", (int)frame.len, (const char *)payload);
 	}
 
-	free(payload);
+	return ESP_OK;
+}
+
+#if WEB_UI_ENABLE
+static esp_err_t web_ui_handler(httpd_req_t *req)
+{
+	return web_send_asset(req, web_asset_find(req->uri));
+}
+#endif
+
+static esp_err_t link_status_handler(httpd_req_t *req)
+{
+	char json[768];
+	(void)link_telemetry_json(json, sizeof(json));
+	httpd_resp_set_type(req, "application/json");
+	return httpd_resp_send(req, json, HTTPD_RESP_USE_STRLEN);
+}
+
+// Reads a small form body into `body` (NUL-terminated). On failure the error response is already
+// sent and its result is stored in `*resp_err`.
+static bool api_recv_form(httpd_req_t *req, char *body, size_t body_len, esp_err_t *resp_err)
+{
+	const int total_len = req->content_len;
+	if (total_len <= 0 || total_len >= (int)body_len)
+	{
+		httpd_resp_set_status(req, "400");
+		*resp_err = httpd_resp_send(req, "bad_request", HTTPD_RESP_USE_STRLEN);
+		return false;
+	}
+
+	int cur_len = 0;
+	while (cur_len < total_len)
+	{
+		int r = httpd_req_recv(req, body + cur_len, total_len - cur_len);
+		if (r <= 0)
+		{
+			httpd_resp_set_status(req, "500");
+			*resp_err = httpd_resp_send(req, "recv_failed", HTTPD_RESP_USE_STRLEN);
+			return false;
+		}
+		cur_len += r;
+	}
+	body[cur_len] = '\0';
+	return true;
+}
+
+static esp_err_t link_profile_handler(httpd_req_t *req)
+{
+	char body[64] = {0};
+	esp_err_t resp_err = ESP_OK;
+	if (!api_recv_form(req, body, sizeof(body), &resp_err))
+		return resp_err;
+
+	char name[24] = {0};
+	wifi_link_profile_t profile;
+	if (!form_get_value(body, "profile", name, sizeof(name)) ||
+		!wifi_link_profile_from_name(name, &profile))
+	{
+		httpd_resp_set_status(req, "400");
+		return httpd_resp_send(req, "unknown_profile", HTTPD_RESP_USE_STRLEN);
+	}
+
+	if (wifi_link_apply(profile, true) != ESP_OK)
+	{
+		httpd_resp_set_status(req, "500");
+		return httpd_resp_send(req, "apply_failed", HTTPD_RESP_USE_STRLEN);
+	}
+	return link_status_handler(req);
+}
+
+static bool stream_packed_format_valid(uint8_t format)
+{
+	return format == RC_FRAME_GRAY4 || format == RC_FRAME_GRAY2 || format == RC_FRAME_RGB332;
+}
+
+static esp_err_t stream_status_handler(httpd_req_t *req)
+{
+	char json[192];
+	snprintf(json, sizeof(json),
+			 "{\"mode\":%d,\"sensor_format\":\"%s\",\"scale\":%u,\"quality\":%d,\"packed\":\"%s\",\"dither\":%s}",
+			 CAM_STREAM_MODE, pixformat_name(cam_pixformat_active), (unsigned)stream_scale, CAM_SW_JPEG_QUALITY,
+			 rc_frame_format_name(stream_packed_format), stream_dither ? "true" : "false");
+	httpd_resp_set_type(req, "application/json");
+	return httpd_resp_send(req, json, HTTPD_RESP_USE_STRLEN);
+}
+
+static esp_err_t stream_config_handler(httpd_req_t *req)
+{
+	char body[64] = {0};
+	esp_err_t resp_err = ESP_OK;
+	if (!api_recv_form(req, body, sizeof(body), &resp_err))
+		return resp_err;
+
+	// Every field is optional, but at least one has to be there; nothing is applied unless all are valid.
+	char value[8] = {0};
+	const bool has_scale = form_get_value(body, "scale", value, sizeof(value));
+	const int scale = has_scale ? atoi(value) : stream_scale;
+	uint8_t packed = stream_packed_format;
+	const bool has_packed = form_get_value(body, "packed", value, sizeof(value));
+	if (has_packed)
+	{
+		packed = RC_FRAME_FORMAT_COUNT;
+		for (uint8_t f = 0; f < RC_FRAME_FORMAT_COUNT; f++)
+			if (stream_packed_format_valid(f) && strcmp(value, rc_frame_format_name(f)) == 0)
+				packed = f;
+	}
+	const bool has_dither = form_get_value(body, "dither", value, sizeof(value));
+	const bool dither = has_dither ? atoi(value) != 0 : stream_dither;
+	if (!has_scale && !has_packed && !has_dither)
+	{
+		httpd_resp_set_status(req, "400");
+		return httpd_resp_send(req, "bad_request", HTTPD_RESP_USE_STRLEN);
+	}
+	if (!img_scale_factor_valid(scale))
+	{
+		httpd_resp_set_status(req, "400");
+		return httpd_resp_send(req, "bad_scale", HTTPD_RESP_USE_STRLEN);
+	}
+	if (!stream_packed_format_valid(packed))
+	{
+		httpd_resp_set_status(req, "400");
+		return httpd_resp_send(req, "bad_packed", HTTPD_RESP_USE_STRLEN);
+	}
+
+	stream_scale = (uint8_t)scale;
+	stream_packed_format = packed;
+	stream_dither = dither;
+	ESP_LOGI(TAG, "Stream scale set to 1/%d, packed %s%s", scale, rc_frame_format_name(packed),
+			 dither ? " (dithered)" : "");
+	return stream_status_handler(req);
+}
+
+static const char *vision_mode_name(uint8_t mode)
+{
+	switch (mode)
+	{
+	case VISION_MODE_TELEMETRY: return "telemetry";
+	case VISION_MODE_STEER: return "steer";
+	default: return "off";
+	}
+}
+
+static esp_err_t vision_status_handler(httpd_req_t *req)
+{
+	portENTER_CRITICAL(&vision_lock);
+	const vision_result_t res = vision_last;
+	const vision_config_t cfg = vision_cfg;
+	const int64_t last_us = vision_last_us;
+	const uint32_t frames = vision_frames;
+	const uint32_t cost_us = vision_cost_us;
+	portEXIT_CRITICAL(&vision_lock);
+
+	char result[320];
+	(void)vision_result_json(result, sizeof(result), &res, last_us / 1000);
+
+	char json[512];
+	snprintf(json, sizeof(json),
+			 "{\"mode\":\"%s\",\"threshold\":%u,\"dark\":%d,\"step\":%u,\"roi_top\":%u,\"gain\":%d,"
+			 "\"frames\":%lu,\"cost_us\":%lu,\"result\":%s}",
+			 vision_mode_name(vision_mode), (unsigned)cfg.threshold, cfg.dark_target ? 1 : 0, (unsigned)cfg.step,
+			 (unsigned)cfg.roi_top_pct, vision_gain_pct, (unsigned long)frames, (unsigned long)cost_us, result);
+	httpd_resp_set_type(req, "application/json");
+	return httpd_resp_send(req, json, HTTPD_RESP_USE_STRLEN);
+}
+
+// Form fields (all optional): mode=off|telemetry|steer, threshold=0..255 (0 = auto), dark=0|1,
+// step=1..8, roi_top=0..95, gain=0..400.
+static esp_err_t vision_config_handler(httpd_req_t *req)
+{
+	char body[128] = {0};
+	esp_err_t resp_err = ESP_OK;
+	if (!api_recv_form(req, body, sizeof(body), &resp_err))
+		return resp_err;
+
+	portENTER_CRITICAL(&vision_lock);
+	vision_config_t cfg = vision_cfg;
+	portEXIT_CRITICAL(&vision_lock);
+	int mode = vision_mode;
+	int gain = vision_gain_pct;
+
+	char value[16];
+	bool ok = true;
+	if (form_get_value(body, "mode", value, sizeof(value)))
+	{
+		if (strcmp(value, "off") == 0)
+			mode = VISION_MODE_OFF;
+		else if (strcmp(value, "telemetry") == 0)
+			mode = VISION_MODE_TELEMETRY;
+		else if (strcmp(value, "steer") == 0)
+			mode = VISION_MODE_STEER;
+		else
+			ok = false;
+	}
+	if (form_get_value(body, "threshold", value, sizeof(value)))
+	{
+		const int v = atoi(value);
+		ok = ok && v >= 0 && v <= 255;
+		cfg.threshold = (uint8_t)v;
+	}
+	if (form_get_value(body, "dark", value, sizeof(value)))
+		cfg.dark_target = atoi(value) != 0;
+	if (form_get_value(body, "step", value, sizeof(value)))
+	{
+		const int v = atoi(value);
+		ok = ok && v >= 1 && v <= 8;
+		cfg.step = (uint8_t)v;
+	}
+	if (form_get_value(body, "roi_top", value, sizeof(value)))
+	{
+		const int v = atoi(value);
+		ok = ok && v >= 0 && v <= 95;
+		cfg.roi_top_pct = (uint8_t)v;
+	}
+	if (form_get_value(body, "gain", value, sizeof(value)))
+	{
+		gain = atoi(value);
+		ok = ok && gain >= 0 && gain <= 400;
+	}
+	if (!ok)
+	{
+		httpd_resp_set_status(req, "400");
+		return httpd_resp_send(req, "bad_value", HTTPD_RESP_USE_STRLEN);
+	}
+
+	portENTER_CRITICAL(&vision_lock);
+	vision_cfg = cfg;
+	if (mode == VISION_MODE_STEER && vision_mode != VISION_MODE_STEER)
+		vision_line_seen_us = 0; // no stale steering from before the switch
+	portEXIT_CRITICAL(&vision_lock);
+	vision_gain_pct = gain;
+	vision_mode = (uint8_t)mode;
+	if (mode == VISION_MODE_STEER)
+		xEventGroupSetBits(camera_demand_group, CAM_DEMAND_VISION);
+	else
+		xEventGroupClearBits(camera_demand_group, CAM_DEMAND_VISION);
+	ESP_LOGI(TAG, "Vision mode=%s thr=%u step=%u gain=%d", vision_mode_name(vision_mode), (unsigned)cfg.threshold,
+			 (unsigned)cfg.step, gain);
+	return vision_status_handler(req);
+}
+
+static esp_err_t camera_status_handler(httpd_req_t *req)
+{
+	char json[768];
+	(void)camera_telemetry_json(json, sizeof(json), false);
+	httpd_resp_set_type(req, "application/json");
+	return httpd_resp_send(req, json, HTTPD_RESP_USE_STRLEN);
+}
+
+// Form fields (optional): latency=low|smooth, max_age_ms=1..1000. A latency change re-initializes
+// the camera from the camera task; the response shows the mode still active until that happens.
+static esp_err_t camera_config_handler(httpd_req_t *req)
+{
+	char body[64] = {0};
+	esp_err_t resp_err = ESP_OK;
+	if (!api_recv_form(req, body, sizeof(body), &resp_err))
+		return resp_err;
+
+	char value[16];
+	int latency = cam_latency_mode;
+	int max_age_ms = (int)cam_max_age_ms;
+	bool ok = true;
+	if (form_get_value(body, "latency", value, sizeof(value)))
+	{
+		if (strcmp(value, "low") == 0)
+			latency = CAM_LATENCY_LOW;
+		else if (strcmp(value, "smooth") == 0)
+			latency = CAM_LATENCY_SMOOTH;
+		else
+			ok = false;
+	}
+	if (form_get_value(body, "max_age_ms", value, sizeof(value)))
+	{
+		max_age_ms = atoi(value);
+		ok = ok && max_age_ms >= 1 && max_age_ms <= 1000;
+	}
+	if (!ok)
+	{
+		httpd_resp_set_status(req, "400");
+		return httpd_resp_send(req, "bad_value", HTTPD_RESP_USE_STRLEN);
+	}
+
+	cam_max_age_ms = (uint32_t)max_age_ms;
+	if (latency != cam_latency_mode)
+	{
+		cam_latency_mode = (uint8_t)latency;
+		xEventGroupSetBits(camera_demand_group, CAM_DEMAND_REINIT);
+	}
+	return camera_status_handler(req);
+}
+
+static esp_err_t recorder_status_handler(httpd_req_t *req)
+{
+	char json[384];
+	if (!recorder_ready)
+	{
+		snprintf(json, sizeof(json), "{\"enabled\":%s,\"ready\":false}", RECORDER_ENABLE ? "true" : "false");
+	}
+	else
+	{
+		const rec_stats_t st = rec_writer_stats(&rec_writer);
+		snprintf(json, sizeof(json),
+				 "{\"enabled\":true,\"ready\":true,\"path\":\"%s\",\"frames\":%lu,\"dropped\":%lu,"
+				 "\"indexed\":%lu,\"batches\":%lu,\"write_errors\":%lu,\"bytes_written\":%llu,"
+				 "\"staging_fill\":%lu,\"staging_peak\":%lu,\"staging_size\":%lu}",
+				 RECORDER_PATH, (unsigned long)st.frames, (unsigned long)st.dropped, (unsigned long)st.indexed,
+				 (unsigned long)st.batches, (unsigned long)st.write_errors, (unsigned long long)st.bytes_written,
+				 (unsigned long)rec_writer_staging_fill(&rec_writer), (unsigned long)st.staging_peak,
+				 (unsigned long)rec_writer.staging_size);
+	}
+	httpd_resp_set_type(req, "application/json");
+	return httpd_resp_send(req, json, HTTPD_RESP_USE_STRLEN);
+}
+
+static esp_err_t boot_timeline_handler(httpd_req_t *req)
+{
+	char json[512];
+	(void)boot_timeline_to_json(json, sizeof(json));
+	httpd_resp_set_type(req, "application/json");
+	return httpd_resp_send(req, json, HTTPD_RESP_USE_STRLEN);
+}
+
+static esp_err_t mem_status_handler(httpd_req_t *req)
+{
+	char json[sizeof(mem_json_cache)];
+	portENTER_CRITICAL(&mem_lock);
+	memcpy(json, mem_json_cache, sizeof(json));
+	portEXIT_CRITICAL(&mem_lock);
+	httpd_resp_set_type(req, "application/json");
+	return httpd_resp_send(req, json, HTTPD_RESP_USE_STRLEN);
+}
+
+static esp_err_t egress_status_handler(httpd_req_t *req)
+{
+	char json[768];
+	xSemaphoreTake(egress_lock, portMAX_DELAY);
+	const size_t len = egress_json(json, sizeof(json), &egress);
+	xSemaphoreGive(egress_lock);
+	if (len == 0)
+	{
+		httpd_resp_set_status(req, "500");
+		return httpd_resp_send(req, "no_mem", HTTPD_RESP_USE_STRLEN);
+	}
+	httpd_resp_set_type(req, "application/json");
+	return httpd_resp_send(req, json, HTTPD_RESP_USE_STRLEN);
+}
+
+#if OTA_ENABLE
+static bool ota_sink_begin(void *ctx, size_t image_len)
+{
+	(void)ctx;
+	ota_partition = esp_ota_get_next_update_partition(NULL);
+	if (!ota_partition || image_len > ota_partition->size)
+		return false;
+	// Sectors are erased as they are written, not all up front: no multi-second flash stall.
+	const esp_err_t err = esp_ota_begin(ota_partition, OTA_WITH_SEQUENTIAL_WRITES, &ota_handle);
+	if (err != ESP_OK)
+	{
+		ESP_LOGE(TAG, "esp_ota_begin failed: %s", esp_err_to_name(err));
+		return false;
+	}
+	ESP_LOGI(TAG, "OTA: receiving %u bytes into %s", (unsigned)image_len, ota_partition->label);
+	return true;
+}
+
+static bool ota_sink_write(void *ctx, const uint8_t *data, size_t len)
+{
+	(void)ctx;
+	const esp_err_t err = esp_ota_write(ota_handle, data, len);
+	if (err != ESP_OK)
+		ESP_LOGE(TAG, "esp_ota_write failed: %s", esp_err_to_name(err));
+	return err == ESP_OK;
+}
+
+static bool ota_sink_finish(void *ctx)
+{
+	(void)ctx;
+	esp_err_t err = esp_ota_end(ota_handle);
+	ota_handle = 0;
+	if (err == ESP_OK)
+		err = esp_ota_set_boot_partition(ota_partition);
+	if (err != ESP_OK)
+		ESP_LOGE(TAG, "OTA: image rejected: %s", esp_err_to_name(err));
+	return err == ESP_OK;
+}
+
+static void ota_sink_abort(void *ctx)
+{
+	(void)ctx;
+	if (ota_handle)
+		(void)esp_ota_abort(ota_handle);
+	ota_handle = 0;
+}
+
+static void ota_hash_start(void *ctx)
+{
+	mbedtls_sha256_init((mbedtls_sha256_context *)ctx);
+	(void)mbedtls_sha256_starts((mbedtls_sha256_context *)ctx, 0);
+}
+
+static void ota_hash_update(void *ctx, const uint8_t *data, size_t len)
+{
+	(void)mbedtls_sha256_update((mbedtls_sha256_context *)ctx, data, len);
+}
+
+static void ota_hash_finish(void *ctx, uint8_t digest[OTA_SHA256_LEN])
+{
+	(void)mbedtls_sha256_finish((mbedtls_sha256_context *)ctx, digest);
+	mbedtls_sha256_free((mbedtls_sha256_context *)ctx);
+}
+
+static esp_err_t ota_send_status(httpd_req_t *req, const char *status)
+{
+	char json[384];
+	const esp_partition_t *running = esp_ota_get_running_partition();
+	const esp_partition_t *next = esp_ota_get_next_update_partition(NULL);
+	int n = snprintf(json, sizeof(json), "{\"version\":\"%s\",\"running\":\"%s\",\"next\":\"%s\",\"pending_verify\":%s,"
+					 "\"upload\":",
+					 esp_app_get_description()->version, running ? running->label : "", next ? next->label : "",
+					 ota_pending_verify ? "true" : "false");
+	xSemaphoreTake(ota_lock, portMAX_DELAY);
+	const size_t len = ota_stream_json(json + n, sizeof(json) - (size_t)n - 1, &ota);
+	xSemaphoreGive(ota_lock);
+	if (n <= 0 || len == 0)
+	{
+		httpd_resp_set_status(req, "500");
+		return httpd_resp_send(req, "no_mem", HTTPD_RESP_USE_STRLEN);
+	}
+	n += (int)len;
+	json[n++] = '}';
+	json[n] = '\0';
+	if (status)
+		httpd_resp_set_status(req, status);
+	httpd_resp_set_type(req, "application/json");
+	return httpd_resp_send(req, json, n);
+}
+
+static esp_err_t ota_status_handler(httpd_req_t *req)
+{
+	return ota_send_status(req, NULL);
+}
+
+// POST /api/ota. Headers: X-Image-SHA256 (hex, required), Content-Range "bytes first-last/total"
+// to upload or resume part of the image (without it the body is the whole image).
+static esp_err_t ota_upload_handler(httpd_req_t *req)
+{
+	char value[80];
+	ota_job_t job = {0};
+	if (httpd_req_get_hdr_value_str(req, "X-Image-SHA256", value, sizeof(value)) != ESP_OK ||
+		!ota_parse_sha256_hex(value, job.sha256))
+	{
+		httpd_resp_set_status(req, "400");
+		return httpd_resp_send(req, "sha256_required", HTTPD_RESP_USE_STRLEN);
+	}
+
+	size_t last = 0;
+	job.total = req->content_len;
+	if (httpd_req_get_hdr_value_str(req, "Content-Range", value, sizeof(value)) == ESP_OK &&
+		(!ota_parse_content_range(value, &job.offset, &last, &job.total) ||
+		 last - job.offset + 1 != req->content_len))
+	{
+		httpd_resp_set_status(req, "400");
+		return httpd_resp_send(req, "bad_range", HTTPD_RESP_USE_STRLEN);
+	}
+	if (req->content_len == 0)
+	{
+		httpd_resp_set_status(req, "400");
+		return httpd_resp_send(req, "empty_body", HTTPD_RESP_USE_STRLEN);
+	}
+
+	xSemaphoreTake(ota_lock, portMAX_DELAY);
+	const bool busy = ota_busy;
+	ota_busy = true;
+	xSemaphoreGive(ota_lock);
+	if (busy)
+	{
+		httpd_resp_set_status(req, "409");
+		return httpd_resp_send(req, "ota_busy", HTTPD_RESP_USE_STRLEN);
+	}
+	// The body is read by ota_task; the httpd task goes back to serving WS control and video.
+	if (httpd_req_async_handler_begin(req, &job.req) != ESP_OK)
+	{
+		xSemaphoreTake(ota_lock, portMAX_DELAY);
+		ota_busy = false;
+		xSemaphoreGive(ota_lock);
+		httpd_resp_set_status(req, "500");
+		return httpd_resp_send(req, "no_mem", HTTPD_RESP_USE_STRLEN);
+	}
+	(void)xQueueSend(ota_jobs, &job, portMAX_DELAY);
+	return ESP_OK;
+}
+
+static const char *ota_http_status(ota_err_t err)
+{
+	switch (err)
+	{
+	case OTA_OK:
+		return NULL;
+	case OTA_ERR_RANGE:
+	case OTA_ERR_MISMATCH:
+		return "409"; // the status body says where to resume
+	case OTA_ERR_SIZE:
+		return "413";
+	case OTA_ERR_HASH:
+		return "400";
+	default:
+		return "500";
+	}
+}
+
+// Streams one request body into the partition. Returns true if the image is complete and bootable.
+static bool ota_run_job(const ota_job_t *job, uint8_t *buf)
+{
+	httpd_req_t *req = job->req;
+	xSemaphoreTake(ota_lock, portMAX_DELAY);
+	ota_err_t err = ota_stream_open(&ota, job->offset, job->total, job->sha256, esp_timer_get_time());
+	xSemaphoreGive(ota_lock);
+
+	size_t left = req->content_len;
+	int timeouts = 0;
+	while (err == OTA_OK && left > 0)
+	{
+		const int r = httpd_req_recv(req, (char *)buf, (left < OTA_CHUNK_BYTES) ? left : OTA_CHUNK_BYTES);
+		if (r == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts < 3)
+			continue;
+		if (r <= 0)
+			break; // connection lost: the upload stays open for a resume from `received`
+		timeouts = 0;
+		left -= (size_t)r;
+		// The flash write runs without ota_lock so GET /api/ota (httpd task) never waits on it; only this
+		// task changes `ota`, so the state checked in begin still holds at end.
+		xSemaphoreTake(ota_lock, portMAX_DELAY);
+		err = ota_stream_write_begin(&ota, (size_t)r);
+		xSemaphoreGive(ota_lock);
+		if (err != OTA_OK)
+			break;
+		const bool ok = ota_stream_write_data(&ota, buf, (size_t)r);
+		xSemaphoreTake(ota_lock, portMAX_DELAY);
+		err = ota_stream_write_end(&ota, (size_t)r, ok, esp_timer_get_time());
+		xSemaphoreGive(ota_lock);
+	}
+
+	bool done = false;
+	if (err == OTA_OK && left == 0)
+	{
+		xSemaphoreTake(ota_lock, portMAX_DELAY);
+		err = ota_stream_close(&ota);
+		done = (ota.state == OTA_DONE);
+		xSemaphoreGive(ota_lock);
+	}
+	if (err != OTA_OK)
+		ESP_LOGW(TAG, "OTA: upload failed (%s)", ota_err_name(err));
+	if (left > 0 && err == OTA_OK)
+	{
+		httpd_resp_set_status(req, "500");
+		(void)httpd_resp_send(req, "recv_failed", HTTPD_RESP_USE_STRLEN);
+	}
+	else
+	{
+		(void)ota_send_status(req, ota_http_status(err));
+	}
+	httpd_req_async_handler_complete(req);
+	return done;
+}
+
+// Runs below the camera, egress and httpd tasks: it only gets the CPU they leave over.
+static void ota_task(void *arg)
+{
+	(void)arg;
+	static uint8_t buf[OTA_CHUNK_BYTES];
+	while (true)
+	{
+		ota_job_t job;
+		if (xQueueReceive(ota_jobs, &job, pdMS_TO_TICKS(1000)) == pdTRUE)
+		{
+			if (!ota_run_job(&job, buf))
+			{
+				xSemaphoreTake(ota_lock, portMAX_DELAY);
+				ota_busy = false;
+				xSemaphoreGive(ota_lock);
+			}
+			else
+			{
+				// ota_busy stays set: further uploads get 409 until the restart.
+				ESP_LOGI(TAG, "OTA: image verified, rebooting into %s", ota_partition->label);
+				vTaskDelay(pdMS_TO_TICKS(OTA_REBOOT_DELAY_MS));
+				esp_restart();
+			}
+		}
+
+		xSemaphoreTake(ota_lock, portMAX_DELAY);
+		if (ota_stream_expire(&ota, esp_timer_get_time(), (int64_t)OTA_IDLE_TIMEOUT_MS * 1000))
+			ESP_LOGW(TAG, "OTA: partial upload expired");
+		xSemaphoreGive(ota_lock);
+
+		// The new image is confirmed once it reached the point where the car can be driven.
+		if (ota_pending_verify && boot_timeline_get_us(BOOT_MS_DRIVABLE) >= 0)
+		{
+			ota_pending_verify = false;
+			(void)esp_timer_stop(ota_verify_timer);
+			ESP_ERROR_CHECK_WITHOUT_ABORT(esp_ota_mark_app_valid_cancel_rollback());
+			ESP_LOGI(TAG, "OTA: image marked valid");
+		}
+	}
+}
+
+static void ota_verify_timeout(void *arg)
+{
+	(void)arg;
+	ESP_LOGE(TAG, "OTA: not drivable %d ms after update, rolling back", OTA_VERIFY_TIMEOUT_MS);
+	esp_ota_mark_app_invalid_rollback_and_reboot();
+}
+
+static void ota_init(void)
+{
+	const esp_partition_t *running = esp_ota_get_running_partition();
+	esp_ota_img_states_t state;
+	if (running && esp_ota_get_state_partition(running, &state) == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY)
+	{
+		ESP_LOGW(TAG, "OTA: first boot of %s, waiting for drivable", running->label);
+		ota_pending_verify = true;
+		const esp_timer_create_args_t args = {.callback = ota_verify_timeout, .name = "ota_verify"};
+		ESP_ERROR_CHECK(esp_timer_create(&args, &ota_verify_timer));
+		ESP_ERROR_CHECK(esp_timer_start_once(ota_verify_timer, (uint64_t)OTA_VERIFY_TIMEOUT_MS * 1000));
+	}
+
+	const esp_partition_t *next = esp_ota_get_next_update_partition(NULL);
+	if (!next)
+		ESP_LOGW(TAG, "OTA: no update partition (flash partitions.csv over USB once)");
+	const ota_sink_t sink = {NULL, ota_sink_begin, ota_sink_write, ota_sink_finish, ota_sink_abort};
+	const ota_hash_t hash = {&ota_sha, ota_hash_start, ota_hash_update, ota_hash_finish};
+	ota_stream_init(&ota, &sink, &hash, next ? next->size : 0);
+	ota_lock = xSemaphoreCreateMutex();
+	ota_jobs = xQueueCreate(1, sizeof(ota_job_t));
+	xTaskCreate(ota_task, "ota", 4096, NULL, OTA_TASK_PRIORITY, NULL);
+}
+#endif
+
+#if TASK_PROF_ACTIVE
+// Snapshot of every task. uxTaskGetSystemState suspends the scheduler for the copy (tens of µs for
+// ~20 tasks); the run-time counter is the µs esp_timer, so counter deltas compare to wall time.
+static void task_prof_sample(void *arg)
+{
+	(void)arg;
+	task_prof_state_t *st = task_prof_state;
+	uint32_t total_runtime = 0;
+	const UBaseType_t count = uxTaskGetSystemState(st->status, TASK_PROF_MAX_TASKS, &total_runtime);
+	TaskHandle_t idle[portNUM_PROCESSORS];
+	for (int core = 0; core < portNUM_PROCESSORS; core++)
+		idle[core] = xTaskGetIdleTaskHandleForCore(core);
+
+	for (UBaseType_t i = 0; i < count; i++)
+	{
+		const TaskStatus_t *ts = &st->status[i];
+		task_prof_sample_t *s = &st->samples[i];
+		s->id = (uintptr_t)ts->xHandle;
+		s->name = ts->pcTaskName;
+#if configTASKLIST_INCLUDE_COREID
+		s->core = (ts->xCoreID == tskNO_AFFINITY) ? TASK_PROF_NO_CORE : (int8_t)ts->xCoreID;
+#else
+		s->core = TASK_PROF_NO_CORE;
+#endif
+		s->idle = false;
+		for (int core = 0; core < portNUM_PROCESSORS; core++)
+		{
+			if (ts->xHandle == idle[core])
+			{
+				s->idle = true;
+				s->core = (int8_t)core;
+			}
+		}
+		s->priority = (uint8_t)ts->uxCurrentPriority;
+		s->runtime = (uint32_t)ts->ulRunTimeCounter;
+		s->stack_free = (uint32_t)ts->usStackHighWaterMark; // bytes on ESP-IDF
+	}
+
+	xSemaphoreTake(task_prof_lock, portMAX_DELAY);
+	const size_t warnings = task_prof_add(&st->prof, esp_timer_get_time(), st->samples, count);
+	if (warnings > 0)
+	{
+		size_t pos = 0;
+		for (const task_prof_task_t *t; (t = task_prof_low_stack(&st->prof, &pos)) != NULL;)
+			ESP_LOGW(TAG, "Task %s: only %lu stack bytes never used", t->name, (unsigned long)t->stack_free);
+	}
+	xSemaphoreGive(task_prof_lock);
+}
+
+static void task_prof_start(void)
+{
+	// ~5 KB of tables; PSRAM if there is some.
+	task_prof_state = (task_prof_state_t *)heap_caps_malloc(sizeof(task_prof_state_t), MALLOC_CAP_SPIRAM);
+	if (!task_prof_state)
+		task_prof_state = (task_prof_state_t *)malloc(sizeof(task_prof_state_t));
+	task_prof_lock = xSemaphoreCreateMutex();
+	if (!task_prof_state || !task_prof_lock)
+	{
+		ESP_LOGW(TAG, "Task profiler disabled (no memory)");
+		return;
+	}
+	task_prof_init(&task_prof_state->prof, TASK_PROF_STACK_WARN_BYTES);
+
+	esp_timer_handle_t timer = NULL;
+	const esp_timer_create_args_t args = {
+		.callback = task_prof_sample,
+		.dispatch_method = ESP_TIMER_TASK,
+		.name = "task_prof",
+		.skip_unhandled_events = true,
+	};
+	ESP_ERROR_CHECK(esp_timer_create(&args, &timer));
+	ESP_ERROR_CHECK(esp_timer_start_periodic(timer, (uint64_t)TASK_PROF_PERIOD_MS * 1000));
+}
+#endif
+
+static esp_err_t tasks_status_handler(httpd_req_t *req)
+{
+#if TASK_PROF_ACTIVE
+	const size_t cap = 160 + (size_t)TASK_PROF_MAX_TASKS * 128;
+	char *json = task_prof_lock ? (char *)malloc(cap) : NULL;
+	if (!json)
+	{
+		httpd_resp_set_status(req, "500");
+		return httpd_resp_send(req, "no_mem", HTTPD_RESP_USE_STRLEN);
+	}
+	xSemaphoreTake(task_prof_lock, portMAX_DELAY);
+	const size_t len = task_prof_json(json, cap, &task_prof_state->prof);
+	xSemaphoreGive(task_prof_lock);
+
+	httpd_resp_set_type(req, "application/json");
+	const esp_err_t err = httpd_resp_send(req, json, (ssize_t)len);
+	free(json);
+	return err;
+#else
+	httpd_resp_set_status(req, "501");
+	return httpd_resp_send(req, "runtime_stats_disabled", HTTPD_RESP_USE_STRLEN);
+#endif
+}
+
+static esp_err_t clients_status_handler(httpd_req_t *req)
+{
+	const size_t cap = 160 + (size_t)RC_WS_MAX_CLIENTS * 176;
+	char *json = (char *)malloc(cap);
+	if (!json)
+	{
+		httpd_resp_set_status(req, "500");
+		return httpd_resp_send(req, "no_mem", HTTPD_RESP_USE_STRLEN);
+	}
+
+	int n = snprintf(json, cap, "{\"max\":%d,\"video\":%u,\"telemetry\":%u,\"clients\":", RC_WS_MAX_CLIENTS,
+					 (unsigned)ws_clients_count(WS_TOPIC_VIDEO), (unsigned)ws_clients_count(WS_TOPIC_TELEMETRY));
+	const size_t list_len = ws_clients_to_json(json + n, cap - (size_t)n - 1);
+	n += (int)list_len;
+	if (list_len == 0)
+		n += snprintf(json + n, cap - (size_t)n, "[]");
+	snprintf(json + n, cap - (size_t)n, "}");
+
+	httpd_resp_set_type(req, "application/json");
+	const esp_err_t err = httpd_resp_send(req, json, HTTPD_RESP_USE_STRLEN);
+	free(json);
+	return err;
+}
+
+// httpd session hooks: every connection on the WS server gets a registry slot until it closes.
+static esp_err_t ws_server_open_fn(httpd_handle_t hd, int sockfd)
+{
+	(void)hd;
+	return ws_clients_on_open(sockfd);
+}
 
-	return ESP_OK;
+static void ws_server_close_fn(httpd_handle_t hd, int sockfd)
+{
+	(void)hd;
+	const ws_client_t *client = ws_clients_get(sockfd);
+	if (client && client->is_ws)
+	{
+		xSemaphoreTake(egress_lock, portMAX_DELAY);
+		const bool released = egress_client_close(&egress, ws_clients_index(client));
+		xSemaphoreGive(egress_lock);
+		if (released)
+			xSemaphoreGive(egress_video_done);
+	}
+	control_release(sockfd);
+	ws_clients_on_close(sockfd);
+	close(sockfd); // a custom close_fn owns the socket
 }
 
 static esp_err_t start_http_ws_server(void)
@@ -773,6 +2651,11 @@ static esp_err_t start_http_ws_server(void)
 	httpd_config_t config = HTTPD_DEFAULT_CONFIG();
 	config.server_port = RC_WS_PORT;
 	config.ctrl_port = RC_WS_PORT + 1;
+	config.max_uri_handlers = 20;
+	config.max_open_sockets = RC_WS_MAX_CLIENTS;
+	config.open_fn = ws_server_open_fn;
+	config.close_fn = ws_server_close_fn;
+	config.uri_match_fn = httpd_uri_match_wildcard; // /ui/*; the other URIs have no wildcards
 
 	ESP_LOGI(TAG, "Starting HTTPD/WS on port %u", (unsigned)config.server_port);
 	esp_err_t err = httpd_start(&httpServer, &config);
@@ -787,62 +2670,271 @@ static esp_err_t start_http_ws_server(void)
 		.is_websocket = true,
 	};
 	ESP_ERROR_CHECK(httpd_register_uri_handler(httpServer, &ws_uri));
-	mdns_advertise_rc_ws();
+
+	httpd_uri_t boot_uri = {.uri = "/api/boot", .method = HTTP_GET, .handler = boot_timeline_handler};
+	ESP_ERROR_CHECK(httpd_register_uri_handler(httpServer, &boot_uri));
+
+	httpd_uri_t link_get_uri = {.uri = "/api/link", .method = HTTP_GET, .handler = link_status_handler};
+	httpd_uri_t link_post_uri = {.uri = "/api/link", .method = HTTP_POST, .handler = link_profile_handler};
+	ESP_ERROR_CHECK(httpd_register_uri_handler(httpServer, &link_get_uri));
+	ESP_ERROR_CHECK(httpd_register_uri_handler(httpServer, &link_post_uri));
+
+	httpd_uri_t stream_get_uri = {.uri = "/api/stream", .method = HTTP_GET, .handler = stream_status_handler};
+	httpd_uri_t stream_post_uri = {.uri = "/api/stream", .method = HTTP_POST, .handler = stream_config_handler};
+	ESP_ERROR_CHECK(httpd_register_uri_handler(httpServer, &stream_get_uri));
+	ESP_ERROR_CHECK(httpd_register_uri_handler(httpServer, &stream_post_uri));
+
+	httpd_uri_t vision_get_uri = {.uri = "/api/vision", .method = HTTP_GET, .handler = vision_status_handler};
+	httpd_uri_t vision_post_uri = {.uri = "/api/vision", .method = HTTP_POST, .handler = vision_config_handler};
+	ESP_ERROR_CHECK(httpd_register_uri_handler(httpServer, &vision_get_uri));
+	ESP_ERROR_CHECK(httpd_register_uri_handler(httpServer, &vision_post_uri));
+
+	httpd_uri_t cam_get_uri = {.uri = "/api/camera", .method = HTTP_GET, .handler = camera_status_handler};
+	httpd_uri_t cam_post_uri = {.uri = "/api/camera", .method = HTTP_POST, .handler = camera_config_handler};
+	ESP_ERROR_CHECK(httpd_register_uri_handler(httpServer, &cam_get_uri));
+	ESP_ERROR_CHECK(httpd_register_uri_handler(httpServer, &cam_post_uri));
+
+	httpd_uri_t rec_uri = {.uri = "/api/rec", .method = HTTP_GET, .handler = recorder_status_handler};
+	ESP_ERROR_CHECK(httpd_register_uri_handler(httpServer, &rec_uri));
+
+	httpd_uri_t clients_uri = {.uri = "/api/clients", .method = HTTP_GET, .handler = clients_status_handler};
+	ESP_ERROR_CHECK(httpd_register_uri_handler(httpServer, &clients_uri));
+
+	httpd_uri_t mem_uri = {.uri = "/api/mem", .method = HTTP_GET, .handler = mem_status_handler};
+	ESP_ERROR_CHECK(httpd_register_uri_handler(httpServer, &mem_uri));
+
+	httpd_uri_t egress_uri = {.uri = "/api/egress", .method = HTTP_GET, .handler = egress_status_handler};
+	ESP_ERROR_CHECK(httpd_register_uri_handler(httpServer, &egress_uri));
+
+	httpd_uri_t tasks_uri = {.uri = "/api/tasks", .method = HTTP_GET, .handler = tasks_status_handler};
+	ESP_ERROR_CHECK(httpd_register_uri_handler(httpServer, &tasks_uri));
+
+#if OTA_ENABLE
+	httpd_uri_t ota_get_uri = {.uri = "/api/ota", .method = HTTP_GET, .handler = ota_status_handler};
+	httpd_uri_t ota_post_uri = {.uri = "/api/ota", .method = HTTP_POST, .handler = ota_upload_handler};
+	ESP_ERROR_CHECK(httpd_register_uri_handler(httpServer, &ota_get_uri));
+	ESP_ERROR_CHECK(httpd_register_uri_handler(httpServer, &ota_post_uri));
+#endif
+#if WEB_UI_ENABLE
+	httpd_uri_t web_ui_uri = {.uri = "/ui/*", .method = HTTP_GET, .handler = web_ui_handler};
+	ESP_ERROR_CHECK(httpd_register_uri_handler(httpServer, &web_ui_uri));
+#endif
 	return ESP_OK;
 }
 
-static void ws_broadcast_binary_sync(httpd_handle_t server, const uint8_t *data, size_t len)
+// Slots whose sockets can take data right now. If select fails (a socket closed under us) every
+// slot counts as writable and the send reports the error.
+static uint32_t egress_writable(void)
+{
+	const uint32_t mask = ws_clients_snapshot(WS_TOPIC_VIDEO) | ws_clients_snapshot(WS_TOPIC_TELEMETRY);
+	fd_set fds;
+	FD_ZERO(&fds);
+	int max_fd = -1;
+	for (uint32_t m = mask; m;)
+	{
+		const int fd = ws_clients_slot(ws_clients_next(&m))->fd;
+		FD_SET(fd, &fds);
+		if (fd > max_fd)
+			max_fd = fd;
+	}
+	struct timeval tv = {0};
+	if (max_fd < 0 || select(max_fd + 1, NULL, &fds, NULL, &tv) < 0)
+		return UINT32_MAX;
+	uint32_t writable = ~mask; // not a WS client (yet): nothing queued, nothing to check
+	for (uint32_t m = mask; m;)
+	{
+		const int i = ws_clients_next(&m);
+		if (FD_ISSET(ws_clients_slot(i)->fd, &fds))
+			writable |= 1u << i;
+	}
+	return writable;
+}
+
+// Writes whatever the scheduler hands out, one WS frame at a time, only to sockets with room. Runs
+// above the camera task so a queued ack is written as soon as the current fragment is done.
+static void egress_task(void *arg)
+{
+	(void)arg;
+	while (true)
+	{
+		egress_tx_t tx;
+		int64_t wait_us = 0;
+		const uint32_t writable = egress_writable();
+		xSemaphoreTake(egress_lock, portMAX_DELAY);
+		const bool skipped = egress_set_writable(&egress, writable, esp_timer_get_time());
+		const egress_next_t next = egress_next(&egress, esp_timer_get_time(), &tx, &wait_us);
+		xSemaphoreGive(egress_lock);
+		if (skipped)
+			xSemaphoreGive(egress_video_done);
+		if (next == EGRESS_IDLE)
+		{
+			(void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			continue;
+		}
+		if (next == EGRESS_WAIT)
+		{
+			(void)ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_us / 1000) + 1);
+			continue;
+		}
+
+		ws_client_t *client = ws_clients_slot(tx.slot);
+		httpd_ws_frame_t frame = {
+			.final = tx.final,
+			.fragmented = tx.fragmented,
+			.type = (httpd_ws_type_t)tx.opcode,
+			.payload = (uint8_t *)tx.data,
+			.len = tx.len,
+		};
+		const httpd_handle_t server = httpServer;
+		const bool ok = server && httpd_ws_send_data(server, client->fd, &frame) == ESP_OK;
+		if (tx.final || !ok)
+			ws_clients_note_tx(client, tx.msg_len, ok);
+		if (!ok)
+		{
+			// A timed-out write may have left half a WS frame on the socket.
+			wifi_link_note_tx_fail();
+			if (server)
+				(void)httpd_sess_trigger_close(server, client->fd);
+		}
+
+		xSemaphoreTake(egress_lock, portMAX_DELAY);
+		const bool released = egress_done(&egress, &tx, ok, esp_timer_get_time());
+		xSemaphoreGive(egress_lock);
+		if (released)
+			xSemaphoreGive(egress_video_done);
+	}
+}
+
+// Sends a video frame (optional RAWH header message, then the payload; or a JPEG with its
+// abbreviated form) to the video subscribers and blocks until every one of them got it or dropped
+// out, so the caller can reuse the buffers.
+static void ws_broadcast_video_sync(httpd_handle_t server, const uint8_t *hdr, size_t hdr_len, const uint8_t *data,
+									size_t len, const egress_jpeg_abbrev_t *abbrev)
 {
 	if (!server || !data || len == 0)
 		return;
-
-	int client_fds[8];
-	size_t client_fd_count = sizeof(client_fds) / sizeof(client_fds[0]);
-	if (httpd_get_client_list(server, &client_fd_count, client_fds) != ESP_OK)
+	// Same recipients for header and payload, so a client joining in between never gets a headerless payload.
+	const uint32_t mask = ws_clients_snapshot(WS_TOPIC_VIDEO);
+	if (!mask)
 		return;
 
-	httpd_ws_frame_t frame = {
-		.final = true,
-		.fragmented = false,
-		.type = HTTPD_WS_TYPE_BINARY,
-		.payload = (uint8_t *)data,
-		.len = len,
-	};
+	xSemaphoreTake(egress_lock, portMAX_DELAY);
+	const int64_t now_us = esp_timer_get_time();
+	const bool queued = abbrev ? egress_video_submit_jpeg(&egress, mask, data, len, abbrev, now_us)
+							   : egress_video_submit(&egress, mask, hdr, hdr_len, data, len, now_us);
+	xSemaphoreGive(egress_lock);
+	if (!queued)
+		return;
+	xTaskNotifyGive(egress_task_handle);
+	xSemaphoreTake(egress_video_done, portMAX_DELAY);
+}
 
-	for (size_t i = 0; i < client_fd_count; i++)
+static void ws_broadcast_jpeg_sync(httpd_handle_t server, const uint8_t *jpeg, size_t len)
+{
+#if JPEG_ABBREV_ENABLE
+	// Camera task only. The broadcast is synchronous, so egress is done with both buffers by the
+	// time the next frame updates them.
+	static rc_jpeg_tables_t tables;
+	static uint8_t ref[RC_FRAME_JREF_LEN];
+	const size_t scan_off = rc_jpeg_tables_update(&tables, jpeg, len);
+	if (scan_off)
 	{
-		const int fd = client_fds[i];
-		if (httpd_ws_get_fd_info(server, fd) != HTTPD_WS_CLIENT_WEBSOCKET)
-			continue;
-		(void)httpd_ws_send_data(server, fd, &frame);
+		const egress_jpeg_abbrev_t abbrev = {
+			.tables = tables.msg,
+			.tables_len = tables.len,
+			.id = tables.id,
+			.ref = ref,
+			.ref_len = rc_jref_write(ref, sizeof(ref), tables.id, (uint32_t)(len - scan_off)),
+			.scan_off = scan_off,
+		};
+		ws_broadcast_video_sync(server, NULL, 0, jpeg, len, &abbrev);
+		return;
 	}
+#endif
+	ws_broadcast_video_sync(server, NULL, 0, jpeg, len, NULL);
+}
+
+// Queued for the telemetry subscribers; returns without waiting for the writes.
+static void ws_broadcast_text(const char *text)
+{
+	egress_queue(ws_clients_snapshot(WS_TOPIC_TELEMETRY), EGRESS_TELEMETRY, EGRESS_WS_TEXT, text, strlen(text));
 }
 
 static void ws_broadcast_raw_sync(httpd_handle_t server, uint8_t raw_format, uint16_t width, uint16_t height,
 								  const uint8_t *payload, size_t payload_len)
 {
-	if (!server || !payload || payload_len == 0 || width == 0 || height == 0)
+	if (!payload || payload_len == 0 || width == 0 || height == 0)
 		return;
 
-	uint8_t header[14] = {0};
-	// magic "RAWH" + version(1) + format(1) + w(u16 LE) + h(u16 LE) + len(u32 LE)
-	header[0] = 'R';
-	header[1] = 'A';
-	header[2] = 'W';
-	header[3] = 'H';
-	header[4] = 1; // version
-	header[5] = raw_format; // 0 = RGB565, 1 = GRAY8
-	header[6] = (uint8_t)(width & 0xFF);
-	header[7] = (uint8_t)((width >> 8) & 0xFF);
-	header[8] = (uint8_t)(height & 0xFF);
-	header[9] = (uint8_t)((height >> 8) & 0xFF);
-	header[10] = (uint8_t)(payload_len & 0xFF);
-	header[11] = (uint8_t)((payload_len >> 8) & 0xFF);
-	header[12] = (uint8_t)((payload_len >> 16) & 0xFF);
-	header[13] = (uint8_t)((payload_len >> 24) & 0xFF);
-
-	ws_broadcast_binary_sync(server, header, sizeof(header));
-	ws_broadcast_binary_sync(server, payload, payload_len);
+	uint8_t header[RC_FRAME_RAWH_LEN];
+	(void)rc_rawh_write(header, sizeof(header), raw_format, width, height, (uint32_t)payload_len);
+	ws_broadcast_video_sync(server, header, sizeof(header), payload, payload_len, NULL);
+}
+
+// Number of complete rows in the frame buffer (some sensors deliver a short last frame).
+static uint16_t fb_rows(const camera_fb_t *fb, size_t bytes_per_pixel)
+{
+	const size_t row_bytes = fb->width * bytes_per_pixel;
+	const size_t rows = (row_bytes > 0) ? (fb->len / row_bytes) : (size_t)fb->height;
+	return (uint16_t)((rows < fb->height) ? rows : fb->height);
+}
+
+static uint16_t fb_rgb565_rows(const camera_fb_t *fb)
+{
+	return fb_rows(fb, 2);
+}
+
+static void vision_process_gray(const uint8_t *gray, int w, int h)
+{
+	if (vision_mode == VISION_MODE_OFF || !gray)
+		return;
+
+	portENTER_CRITICAL(&vision_lock);
+	const vision_config_t cfg = vision_cfg;
+	portEXIT_CRITICAL(&vision_lock);
+
+	vision_result_t res;
+	const int64_t t0 = esp_timer_get_time();
+	if (!vision_analyze(gray, w, h, &cfg, &res))
+		return;
+	const int64_t t1 = esp_timer_get_time();
+	const int16_t steer = vision_steer(&res, vision_gain_pct);
+
+	portENTER_CRITICAL(&vision_lock);
+	vision_last = res;
+	vision_last_us = t1;
+	if (res.line_found)
+	{
+		vision_line_seen_us = t1;
+		vision_steer_cmd = steer;
+	}
+	vision_frames++;
+	vision_cost_us = (uint32_t)(t1 - t0);
+	portEXIT_CRITICAL(&vision_lock);
+}
+
+// Vision for stream modes other than GRAY8: derive a downscaled luma frame from RGB565.
+static void vision_process_fb(const camera_fb_t *fb)
+{
+	if (vision_mode == VISION_MODE_OFF || !fb || !fb->buf || fb->format != PIXFORMAT_RGB565)
+		return;
+
+	const uint16_t rows = fb_rgb565_rows(fb);
+	const int w = img_scale_dim(fb->width, VISION_RGB565_SCALE);
+	const int h = img_scale_dim(rows, VISION_RGB565_SCALE);
+	const size_t len = (size_t)w * h;
+	if (len == 0)
+		return;
+	if (len > vision_gray_cap)
+	{
+		uint8_t *buf = (uint8_t *)realloc(vision_gray, len);
+		if (!buf)
+			return;
+		vision_gray = buf;
+		vision_gray_cap = len;
+	}
+	(void)img_scale_rgb565_to_gray8(fb->buf, fb->width, rows, VISION_RGB565_SCALE, vision_gray);
+	vision_process_gray(vision_gray, w, h);
 }
 
 static void ws_broadcast_raw_rgb565_from_fb(httpd_handle_t server, const camera_fb_t *fb)
@@ -852,141 +2944,354 @@ static void ws_broadcast_raw_rgb565_from_fb(httpd_handle_t server, const camera_
 	if (fb->format != PIXFORMAT_RGB565)
 		return;
 
-	const size_t bytes_per_pixel = 2;
-	const size_t row_bytes = fb->width * bytes_per_pixel;
-	const uint16_t effective_height =
-		(uint16_t)((row_bytes > 0) ? (fb->len / row_bytes) : (size_t)fb->height);
-	const size_t effective_len = row_bytes * (size_t)effective_height;
-	if (effective_height == 0 || effective_len == 0)
+	const int scale = stream_scale;
+	const uint16_t rows = fb_rgb565_rows(fb);
+	const uint16_t out_w = (uint16_t)img_scale_dim(fb->width, scale);
+	const uint16_t out_h = (uint16_t)img_scale_dim(rows, scale);
+	const size_t out_len = (size_t)out_w * out_h * 2;
+	if (out_len == 0)
+		return;
+
+	if (scale == 1)
+	{
+		ws_broadcast_raw_sync(server, RC_FRAME_RGB565, out_w, out_h, fb->buf, out_len);
 		return;
+	}
 
-	ws_broadcast_raw_sync(server, 0, (uint16_t)fb->width, effective_height, fb->buf, effective_len);
+	uint8_t *scaled = stream_scratch_get(out_len);
+	if (!scaled)
+		return;
+	(void)img_scale_rgb565(fb->buf, fb->width, rows, scale, scaled);
+	ws_broadcast_raw_sync(server, RC_FRAME_RGB565, out_w, out_h, scaled, out_len);
 }
 
+// GRAY8 stream modes. The luma plane comes from whatever the sensor delivered: GRAYSCALE is used as
+// captured (no copy at scale 1), YUV422 is reduced to Y with a strided copy, RGB565 (the fallback
+// when the sensor refuses the other formats) goes through the integer luma conversion. Vision runs
+// on the result even when nobody is watching.
 static void ws_broadcast_raw_gray8_from_fb(httpd_handle_t server, const camera_fb_t *fb)
 {
-	if (!server || !fb || !fb->buf || fb->len == 0)
-		return;
-	if (fb->format != PIXFORMAT_RGB565)
+	if (!fb || !fb->buf || fb->len == 0)
 		return;
 
-	const size_t bytes_per_pixel = 2;
-	const size_t row_bytes = fb->width * bytes_per_pixel;
-	const uint16_t effective_height =
-		(uint16_t)((row_bytes > 0) ? (fb->len / row_bytes) : (size_t)fb->height);
-	const size_t pixel_count = (size_t)fb->width * (size_t)effective_height;
-	const size_t effective_len = row_bytes * (size_t)effective_height;
-	if (effective_height == 0 || effective_len == 0 || pixel_count == 0)
+	size_t bpp;
+	switch (fb->format)
+	{
+	case PIXFORMAT_GRAYSCALE:
+		bpp = 1;
+		break;
+	case PIXFORMAT_YUV422:
+	case PIXFORMAT_RGB565:
+		bpp = 2;
+		break;
+	default:
 		return;
+	}
 
-	uint8_t *gray = (uint8_t *)malloc(pixel_count);
-	if (!gray)
+	const int scale = stream_scale;
+	const uint16_t rows = fb_rows(fb, bpp);
+	const uint16_t out_w = (uint16_t)img_scale_dim(fb->width, scale);
+	const uint16_t out_h = (uint16_t)img_scale_dim(rows, scale);
+	const size_t out_len = (size_t)out_w * out_h;
+	if (out_len == 0)
 		return;
 
-	// RGB565 is typically MSB-first in ESP32 camera buffers.
-	for (size_t i = 0, p = 0; i + 1 < effective_len && p < pixel_count; i += 2, p++)
+	const uint8_t *gray = fb->buf;
+	if (fb->format != PIXFORMAT_GRAYSCALE || scale != 1)
 	{
-		const uint16_t pix = ((uint16_t)fb->buf[i] << 8) | (uint16_t)fb->buf[i + 1];
-		const uint8_t r5 = (uint8_t)((pix >> 11) & 0x1F);
-		const uint8_t g6 = (uint8_t)((pix >> 5) & 0x3F);
-		const uint8_t b5 = (uint8_t)(pix & 0x1F);
-		const uint8_t r8 = (uint8_t)((r5 << 3) | (r5 >> 2));
-		const uint8_t g8 = (uint8_t)((g6 << 2) | (g6 >> 4));
-		const uint8_t b8 = (uint8_t)((b5 << 3) | (b5 >> 2));
-		const uint16_t y = (uint16_t)r8 * 77 + (uint16_t)g8 * 150 + (uint16_t)b8 * 29;
-		gray[p] = (uint8_t)(y >> 8);
+		uint8_t *out = stream_scratch_get(out_len);
+		if (!out)
+			return;
+		// Luma extraction and downscale in one pass over the frame buffer.
+		if (fb->format == PIXFORMAT_GRAYSCALE)
+			(void)img_scale_gray8(fb->buf, fb->width, rows, scale, out);
+		else if (fb->format == PIXFORMAT_YUV422)
+			(void)img_scale_yuv422_to_gray8(fb->buf, fb->width, rows, scale, out);
+		else
+			(void)img_scale_rgb565_to_gray8(fb->buf, fb->width, rows, scale, out);
+		gray = out;
 	}
+	vision_process_gray(gray, out_w, out_h);
+	ws_broadcast_raw_sync(server, RC_FRAME_GRAY8, out_w, out_h, gray, out_len);
+}
 
-	ws_broadcast_raw_sync(server, 1, (uint16_t)fb->width, effective_height, gray, pixel_count);
-	free(gray);
+// Packed RAWH mode: luma (or RGB332) conversion, downscale, dithering and bit packing in one pass
+// over the RGB565 frame buffer.
+static void ws_broadcast_raw_packed_from_fb(httpd_handle_t server, const camera_fb_t *fb)
+{
+	if (!server || !fb || !fb->buf || fb->len == 0 || fb->format != PIXFORMAT_RGB565)
+		return;
+
+	const uint8_t format = stream_packed_format;
+	const int dither = stream_dither;
+	const int scale = stream_scale;
+	const uint16_t rows = fb_rgb565_rows(fb);
+	const uint16_t out_w = (uint16_t)img_scale_dim(fb->width, scale);
+	const uint16_t out_h = (uint16_t)img_scale_dim(rows, scale);
+	const size_t out_len = rc_frame_payload_len(format, out_w, out_h);
+	if (out_len == 0)
+		return;
+
+	uint8_t *out = stream_scratch_get(out_len);
+	if (!out)
+		return;
+	if (format == RC_FRAME_RGB332)
+		(void)img_scale_rgb565_to_rgb332(fb->buf, fb->width, rows, scale, dither, out);
+	else
+		(void)img_scale_rgb565_to_gray_packed(fb->buf, fb->width, rows, scale, (int)rc_frame_bits(format), dither, out);
+	ws_broadcast_raw_sync(server, format, out_w, out_h, out, out_len);
 }
 
-static bool ws_has_clients(httpd_handle_t server)
+// The camera driver stamps frames with esp_timer time, so they line up with everything else on the device.
+static int64_t fb_timestamp_us(const camera_fb_t *fb)
 {
-	if (!server)
-		return false;
+	return (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+}
 
-	int client_fds[8];
-	size_t client_fd_count = sizeof(client_fds) / sizeof(client_fds[0]);
-	if (httpd_get_client_list(server, &client_fd_count, client_fds) != ESP_OK)
-		return false;
+static void recorder_push_jpeg(const uint8_t *data, size_t len, int64_t t_us)
+{
+	if (RECORDER_SESSION || !recorder_ready || !data || len == 0)
+		return;
+	(void)rec_writer_push(&rec_writer, data, (uint32_t)len, t_us, REC_FMT_JPEG);
+}
 
-	for (size_t i = 0; i < client_fd_count; i++)
+#if RECORDER_SESSION
+// The pipeline input as the driver handed it over, before scaling, vision or encoding.
+static void session_capture_frame(const camera_fb_t *fb)
+{
+	session_camera_t cam = {.width = (uint16_t)fb->width, .height = (uint16_t)fb->height,
+							.sensor_us = fb_timestamp_us(fb)};
+	switch (fb->format)
 	{
-		const int fd = client_fds[i];
-		if (httpd_ws_get_fd_info(server, fd) == HTTPD_WS_CLIENT_WEBSOCKET)
-			return true;
+	case PIXFORMAT_JPEG:
+		cam.pixformat = SESSION_PIX_JPEG;
+		break;
+	case PIXFORMAT_RGB565:
+		cam.pixformat = SESSION_PIX_RGB565;
+		break;
+	case PIXFORMAT_YUV422:
+		cam.pixformat = SESSION_PIX_YUV422;
+		break;
+	case PIXFORMAT_GRAYSCALE:
+		cam.pixformat = SESSION_PIX_GRAY8;
+		break;
+	default:
+		return;
 	}
-
-	return false;
+	uint8_t hdr[SESSION_CAMERA_HDR_LEN];
+	session_push(hdr, session_camera_write(hdr, sizeof(hdr), &cam), fb->buf, fb->len, REC_FMT_CAMERA);
 }
+#endif
 
-static void camera_stream_task(void *arg)
+static void frame_age_note(int64_t age_us, uint32_t discarded)
 {
-	(void)arg;
+	if (age_us < 0)
+		age_us = 0;
+	portENTER_CRITICAL(&frame_age_lock);
+	frame_age_window.frames++;
+	frame_age_window.discarded += discarded;
+	frame_age_window.age_sum_us += (uint64_t)age_us;
+	if ((uint64_t)age_us > frame_age_window.age_max_us)
+		frame_age_window.age_max_us = (age_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)age_us;
+	frame_discarded_total += discarded;
+	portEXIT_CRITICAL(&frame_age_lock);
+}
 
-	int retries_left = CAM_INIT_MAX_RETRIES;
-	while (retries_left != 0)
+// Grabs a frame. In low-latency mode a frame older than cam_max_age_ms goes straight back to the
+// driver and a newer one is taken instead, at most fb_count times so a stalled sensor can't spin here.
+static camera_fb_t *camera_grab(void)
+{
+	camera_fb_t *fb = esp_camera_fb_get();
+	uint32_t discarded = 0;
+	if (cam_latency_active == CAM_LATENCY_LOW)
 	{
-		const esp_err_t cam_err = init_camera();
-		if (cam_err == ESP_OK)
+		const int64_t max_age_us = (int64_t)cam_max_age_ms * 1000;
+		while (fb && discarded < cam_fb_count_active && esp_timer_get_time() - fb_timestamp_us(fb) > max_age_us)
 		{
-			camera_ok = true;
-			ESP_LOGI(TAG, "Camera ready");
-			break;
+			esp_camera_fb_return(fb);
+			discarded++;
+			fb = esp_camera_fb_get();
 		}
+	}
+	if (fb)
+		frame_age_note(esp_timer_get_time() - fb_timestamp_us(fb), discarded);
+	return fb;
+}
 
-		camera_ok = false;
-		ESP_LOGE(TAG, "Camera init failed: %s", esp_err_to_name(cam_err));
+static void cam_sup_init_result(bool ok)
+{
+	const int64_t now_us = esp_timer_get_time();
+	portENTER_CRITICAL(&cam_sup_lock);
+	cam_supervisor_init_result(&cam_sup, ok, now_us);
+	portEXIT_CRITICAL(&cam_sup_lock);
+}
 
-		if (retries_left > 0)
-			retries_left--;
-		if (retries_left == 0)
-			break;
+// Applies a latency mode change requested via /api/camera and the frame size / fb count of the current
+// memory tier. Runs in the camera task, between frames.
+static void camera_apply_settings(void)
+{
+	xEventGroupClearBits(camera_demand_group, CAM_DEMAND_REINIT);
+	const uint8_t previous = cam_latency_active;
+	if (cam_latency_mode == previous && mem_tier == cam_tier_active)
+		return;
 
-		vTaskDelay(pdMS_TO_TICKS(CAM_INIT_RETRY_DELAY_MS));
+	(void)esp_camera_deinit();
+	esp_err_t err = init_camera();
+	if (err != ESP_OK)
+	{
+		ESP_LOGE(TAG, "Camera re-init for latency=%s tier=%s failed: %s", cam_latency_name(cam_latency_mode),
+				 mem_tier_name((mem_tier_t)mem_tier), esp_err_to_name(err));
+		cam_latency_mode = previous;
+		(void)esp_camera_deinit();
+		err = init_camera();
 	}
+	if (err == ESP_OK)
+		ESP_LOGI(TAG, "Camera latency=%s fb_count=%u width=%u", cam_latency_name(cam_latency_active),
+				 (unsigned)cam_fb_count_active, (unsigned)cam_frame_width_active);
+	cam_sup_init_result(err == ESP_OK);
+}
 
-	if (!camera_ok)
+// Brings the driver (back) up with the current latency mode and memory tier. Runs in the camera task
+// whenever the supervisor asks: at boot, after a stall, after a failed settings re-init.
+static void camera_reinit(void)
+{
+	xEventGroupClearBits(camera_demand_group, CAM_DEMAND_REINIT);
+	(void)esp_camera_deinit();
+	const esp_err_t err = init_camera();
+	cam_sup_init_result(err == ESP_OK);
+
+	portENTER_CRITICAL(&cam_sup_lock);
+	const cam_sup_state_t state = cam_sup.state;
+	const cam_sup_stats_t st = cam_sup.stats;
+	const uint32_t next_ms = (uint32_t)((cam_sup.next_init_us - esp_timer_get_time()) / 1000);
+	portEXIT_CRITICAL(&cam_sup_lock);
+	if (err == ESP_OK)
 	{
-		ESP_LOGW(TAG, "Camera task stopped (camera not available)");
-		vTaskDelete(NULL);
+		boot_timeline_mark(BOOT_MS_CAMERA_READY);
+		ESP_LOGI(TAG, "Camera ready (init %u, %s)", (unsigned)st.inits, cam_sup_state_name(state));
 		return;
 	}
+	ESP_LOGE(TAG, "Camera init failed: %s (attempt %u, next in %u ms)", esp_err_to_name(err),
+			 (unsigned)st.inits, (unsigned)next_ms);
+	if (CAM_INIT_MAX_RETRIES > 0 && state == CAM_SUP_STARTING && st.init_failures >= CAM_INIT_MAX_RETRIES)
+		boot_timeline_mark(BOOT_MS_CAMERA_FAILED);
+}
+
+static void camera_stream_task(void *arg)
+{
+	(void)arg;
+
+	const cam_sup_config_t sup_cfg = {
+		.slow_us = CAM_SLOW_GET_MS * 1000u,
+		.stall_grabs = CAM_STALL_GRABS,
+		.stall_us = CAM_STALL_MS * 1000u,
+		.backoff_min_us = CAM_REINIT_BACKOFF_MIN_MS * 1000u,
+		.backoff_max_us = CAM_REINIT_BACKOFF_MAX_MS * 1000u,
+	};
+	portENTER_CRITICAL(&cam_sup_lock);
+	cam_supervisor_init(&cam_sup, &sup_cfg, esp_timer_get_time());
+	portEXIT_CRITICAL(&cam_sup_lock);
 
+	const EventBits_t want_frames = CAM_DEMAND_VIDEO | CAM_DEMAND_VISION | CAM_DEMAND_RECORDER;
+	const EventBits_t local_frames = CAM_DEMAND_VISION | CAM_DEMAND_RECORDER;
 	while (true)
 	{
+		// The driver is (re-)initialized here, never given up on: WS sessions, control and the rest of
+		// the car keep running while the camera is down.
+		uint32_t wait_us = 0;
+		portENTER_CRITICAL(&cam_sup_lock);
+		const cam_sup_action_t action = cam_supervisor_next(&cam_sup, esp_timer_get_time(), &wait_us);
+		portEXIT_CRITICAL(&cam_sup_lock);
+		if (action == CAM_SUP_REINIT)
+		{
+			camera_reinit();
+			continue;
+		}
+		if (action == CAM_SUP_WAIT)
+		{
+			vTaskDelay(pdMS_TO_TICKS(wait_us / 1000) + 1);
+			continue;
+		}
+
+		// Sleeps until frames are needed: a video subscriber, line following, the recorder, or a reinit.
+		const EventBits_t demand = xEventGroupWaitBits(camera_demand_group, want_frames | CAM_DEMAND_REINIT,
+													   pdFALSE, pdFALSE, portMAX_DELAY);
+		if (demand & CAM_DEMAND_REINIT)
+		{
+			camera_apply_settings();
+			continue;
+		}
+		if (!(demand & (CAM_DEMAND_LINK | local_frames)))
+		{
+			// Only WS viewers want frames and the link is down (Wi-Fi recovery): idle until it is back.
+			(void)xEventGroupWaitBits(camera_demand_group, CAM_DEMAND_LINK | local_frames | CAM_DEMAND_REINIT,
+									  pdFALSE, pdFALSE, portMAX_DELAY);
+			continue;
+		}
+
 		const httpd_handle_t server = httpServer;
-		if (server && ws_has_clients(server))
+		if (demand & want_frames)
 		{
-			camera_fb_t *fb = esp_camera_fb_get();
+			const int64_t grab_start_us = esp_timer_get_time();
+			camera_fb_t *fb = camera_grab();
+			const int64_t grab_end_us = esp_timer_get_time();
+			portENTER_CRITICAL(&cam_sup_lock);
+			const bool stalled =
+				cam_supervisor_grab(&cam_sup, fb != NULL, (uint32_t)(grab_end_us - grab_start_us), grab_end_us);
+			const uint32_t stalls = cam_sup.stats.stalls;
+			portEXIT_CRITICAL(&cam_sup_lock);
+			if (stalled)
+				ESP_LOGW(TAG, "Camera stalled (%s, stall %u), re-initializing", fb ? "slow frames" : "no frames",
+						 (unsigned)stalls);
 			if (fb)
 			{
+				boot_timeline_mark(BOOT_MS_FIRST_FRAME);
+#if RECORDER_SESSION
+				session_capture_frame(fb);
+#endif
+#if !CAM_STREAM_MODE_IS_GRAY(CAM_STREAM_MODE)
+				vision_process_fb(fb);
+#endif
 #if (CAM_STREAM_MODE == CAM_STREAM_MODE_RGB565_RAW)
 				ws_broadcast_raw_rgb565_from_fb(server, fb);
-#elif (CAM_STREAM_MODE == CAM_STREAM_MODE_GRAY8)
+#elif CAM_STREAM_MODE_IS_GRAY(CAM_STREAM_MODE)
 				ws_broadcast_raw_gray8_from_fb(server, fb);
+#elif (CAM_STREAM_MODE == CAM_STREAM_MODE_PACKED)
+				ws_broadcast_raw_packed_from_fb(server, fb);
 #else
 				if (fb->format == PIXFORMAT_JPEG)
 				{
-					ws_broadcast_binary_sync(server, fb->buf, fb->len);
+					recorder_push_jpeg(fb->buf, fb->len, fb_timestamp_us(fb));
+					ws_broadcast_jpeg_sync(server, fb->buf, fb->len);
 				}
 				else
 				{
-					const size_t bytes_per_pixel = (fb->format == PIXFORMAT_RGB565) ? 2 : 0;
-					const size_t row_bytes = fb->width * bytes_per_pixel;
-					const size_t effective_height =
-						(row_bytes > 0) ? (fb->len / row_bytes) : (size_t)fb->height;
-					const size_t effective_len = row_bytes * effective_height;
+					const bool is_rgb565 = (fb->format == PIXFORMAT_RGB565);
+					const int scale = stream_scale;
+					const uint16_t rows = is_rgb565 ? fb_rgb565_rows(fb) : (uint16_t)fb->height;
+					const uint16_t out_w = (uint16_t)img_scale_dim(fb->width, scale);
+					const uint16_t out_h = (uint16_t)img_scale_dim(rows, scale);
+					const size_t out_len = (size_t)out_w * out_h * 2;
+
+					// Downscaling before encoding cuts fmt2jpg time roughly by scale^2.
+					const uint8_t *src = fb->buf;
+					if (is_rgb565 && scale != 1)
+					{
+						uint8_t *scaled = stream_scratch_get(out_len);
+						if (scaled)
+							(void)img_scale_rgb565(fb->buf, fb->width, rows, scale, scaled);
+						src = scaled;
+					}
 
 					uint8_t *jpg_buf = NULL;
 					size_t jpg_len = 0;
-					const bool ok = (bytes_per_pixel > 0) &&
-									fmt2jpg(fb->buf, effective_len, fb->width, effective_height, fb->format,
-											CAM_SW_JPEG_QUALITY, &jpg_buf, &jpg_len);
+					const bool ok = is_rgb565 && src && out_len > 0 &&
+									fmt2jpg((uint8_t *)src, out_len, out_w, out_h, fb->format, CAM_SW_JPEG_QUALITY,
+											&jpg_buf, &jpg_len);
 					if (ok && jpg_buf && jpg_len > 0)
 					{
-						ws_broadcast_binary_sync(server, jpg_buf, jpg_len);
+						recorder_push_jpeg(jpg_buf, jpg_len, fb_timestamp_us(fb));
+						ws_broadcast_jpeg_sync(server, jpg_buf, jpg_len);
 						free(jpg_buf);
 					}
 					else
@@ -1000,23 +3305,293 @@ static void camera_stream_task(void *arg)
 				esp_camera_fb_return(fb);
 			}
 			vTaskDelay(pdMS_TO_TICKS(frame_interval_ms()));
+		}
+	}
+}
+
+static size_t control_telemetry_json(char *buf, size_t len, const rc_control_t *ctrl)
+{
+	portENTER_CRITICAL(&act_lock);
+	const actuator_t act = actuator;
+	portEXIT_CRITICAL(&act_lock);
+	char act_json[256];
+	if (actuator_json(act_json, sizeof(act_json), &act) == 0)
+		snprintf(act_json, sizeof(act_json), "null");
+
+	const int n = snprintf(buf, len,
+						   "{\"type\":\"control\",\"seq\":%u,\"flags\":%u,\"throttle\":%d,\"steer\":%d,"
+						   "\"applied\":%u,\"stale\":%u,\"malformed\":%u,\"act\":%s}",
+						   (unsigned)ctrl->seq, (unsigned)ctrl->flags, (int)ctrl->throttle,
+						   (int)ctrl->steer, (unsigned)control_applied, (unsigned)control_stale,
+						   (unsigned)control_malformed, act_json);
+	return (n > 0) ? (size_t)n : 0;
+}
+
+static void mem_probe_heap(void *ctx, mem_sample_t *out)
+{
+	(void)ctx;
+	const uint32_t dram = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+	out->dram.free = heap_caps_get_free_size(dram);
+	out->dram.largest = heap_caps_get_largest_free_block(dram);
+	out->dram.min_free = heap_caps_get_minimum_free_size(dram);
+	out->psram_present = heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
+	if (out->psram_present)
+	{
+		out->psram.free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+		out->psram.largest = heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM);
+		out->psram.min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM);
+	}
+	else
+	{
+		memset(&out->psram, 0, sizeof(out->psram));
+	}
+}
+
+// httpd work item: closes the newest WS clients beyond the tier's cap.
+static void ws_enforce_client_cap(void *arg)
+{
+	const httpd_handle_t server = (httpd_handle_t)arg;
+	int fds[RC_WS_MAX_CLIENTS];
+	const size_t n = ws_clients_over_cap(fds, RC_WS_MAX_CLIENTS);
+	for (size_t i = 0; i < n; i++)
+	{
+		ESP_LOGW(TAG, "Closing WS client fd=%d (memory tier client cap)", fds[i]);
+		(void)httpd_sess_trigger_close(server, fds[i]);
+	}
+}
+
+// Called by telemetry_task after a tier transition. The camera re-initializes at the tier's frame
+// size / fb count between frames; WS clients beyond the cap are closed on the httpd task.
+static void mem_apply_tier(void)
+{
+	const mem_tier_t tier = mem_budget.tier;
+	const mem_tier_limits_t *lim = mem_budget_limits(&mem_budget);
+	ESP_LOGW(TAG, "Memory tier %s -> %s (dram free=%u largest=%u, psram free=%u largest=%u)",
+			 mem_tier_name(mem_budget.prev_tier), mem_tier_name(tier), (unsigned)mem_budget.last.dram.free,
+			 (unsigned)mem_budget.last.dram.largest, (unsigned)mem_budget.last.psram.free,
+			 (unsigned)mem_budget.last.psram.largest);
+
+	mem_tier = (uint8_t)tier;
+	ws_clients_set_max(lim->max_clients);
+	xSemaphoreTake(egress_lock, portMAX_DELAY);
+	egress_set_queue_depth(&egress, lim->queue_depth);
+	xSemaphoreGive(egress_lock);
+	const httpd_handle_t server = httpServer;
+	if (server)
+		(void)httpd_queue_work(server, ws_enforce_client_cap, server);
+	xEventGroupSetBits(camera_demand_group, CAM_DEMAND_REINIT);
+}
+
+// Pushes link and control state to WS clients as text frames so stream latency can be correlated
+// with it. Control changes are logged here, at most once per period, instead of per packet.
+static void telemetry_task(void *arg)
+{
+	(void)arg;
+	char json[768];
+	rc_control_t last_logged = {0};
+	TickType_t last_wake = xTaskGetTickCount();
+	while (true)
+	{
+		vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(TELEMETRY_INTERVAL_MS));
+
+		const rc_control_t ctrl = control_get();
+		if (ctrl.throttle != last_logged.throttle || ctrl.steer != last_logged.steer ||
+			ctrl.flags != last_logged.flags)
+		{
+			ESP_LOGI(TAG, "[RC State] throttle:%d steer:%d flags:0x%02x (applied=%u stale=%u bad=%u)",
+					 (int)ctrl.throttle, (int)ctrl.steer, (unsigned)ctrl.flags, (unsigned)control_applied,
+					 (unsigned)control_stale, (unsigned)control_malformed);
+			last_logged = ctrl;
+		}
+
+		if (mem_budget_update(&mem_budget))
+			mem_apply_tier();
+		const size_t mem_len = mem_budget_json(json, sizeof(json), &mem_budget);
+		portENTER_CRITICAL(&mem_lock);
+		memcpy(mem_json_cache, json, mem_len + 1);
+		portEXIT_CRITICAL(&mem_lock);
+
+		const httpd_handle_t server = httpServer;
+		const bool have_clients = server && ws_clients_count(WS_TOPIC_TELEMETRY) > 0;
+		if (have_clients && mem_len > 0)
+			ws_broadcast_text(json);
+
+		(void)camera_telemetry_json(json, sizeof(json), true);
+		if (!have_clients)
 			continue;
+		ws_broadcast_text(json);
+		(void)link_telemetry_json(json, sizeof(json));
+		ws_broadcast_text(json);
+		(void)control_telemetry_json(json, sizeof(json), &ctrl);
+		ws_broadcast_text(json);
+
+		if (vision_mode != VISION_MODE_OFF)
+		{
+			portENTER_CRITICAL(&vision_lock);
+			const vision_result_t res = vision_last;
+			const int64_t last_us = vision_last_us;
+			portEXIT_CRITICAL(&vision_lock);
+			if (last_us > 0)
+			{
+				(void)vision_result_json(json, sizeof(json), &res, last_us / 1000);
+				ws_broadcast_text(json);
+			}
 		}
+	}
+}
+
+#if RECORDER_ENABLE
+static esp_err_t recorder_mount_sd(void)
+{
+	sdmmc_host_t host = SDMMC_HOST_DEFAULT();
+	host.max_freq_khz = SDMMC_FREQ_HIGHSPEED;
+	sdmmc_slot_config_t slot = SDMMC_SLOT_CONFIG_DEFAULT();
+	slot.width = 1;
+	slot.flags |= SDMMC_SLOT_FLAG_INTERNAL_PULLUP;
+
+	const esp_vfs_fat_sdmmc_mount_config_t mount = {
+		.format_if_mount_failed = false,
+		.max_files = 2,
+		.allocation_unit_size = 32 * 1024,
+	};
+	sdmmc_card_t *card = NULL;
+	const esp_err_t err = esp_vfs_fat_sdmmc_mount(RECORDER_MOUNT_POINT, &host, &slot, &mount, &card);
+	if (err == ESP_OK)
+		ESP_LOGI(TAG, "SD card mounted at %s (%llu MB)", RECORDER_MOUNT_POINT,
+				 (unsigned long long)card->csd.capacity * (unsigned long long)card->csd.sector_size / (1024 * 1024));
+	return err;
+}
+
+// Everything that touches the SD card runs here, at low priority; the camera task only copies
+// frames into the staging ring and drops them if the card falls behind.
+static void recorder_task(void *arg)
+{
+	(void)arg;
+
+	const esp_err_t err = recorder_mount_sd();
+	if (err != ESP_OK)
+	{
+		ESP_LOGW(TAG, "Recorder disabled, SD mount failed: %s", esp_err_to_name(err));
+		vTaskDelete(NULL);
+		return;
+	}
+
+	const size_t staging_len = (size_t)RECORDER_STAGING_KB * 1024;
+	uint8_t *staging = (uint8_t *)heap_caps_malloc(staging_len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+	const bool store_ok =
+		staging && rec_store_file_open(&rec_store, RECORDER_PATH, (uint64_t)RECORDER_FILE_MB << 20, true) == 0;
+	if (!store_ok || rec_writer_init(&rec_writer, &rec_store, staging, (uint32_t)staging_len, RECORDER_INDEX_ENTRIES,
+									 esp_random()) != 0)
+	{
+		ESP_LOGW(TAG, "Recorder disabled, can't set up %s", RECORDER_PATH);
+		if (store_ok)
+			rec_store_file_close(&rec_store);
+		free(staging);
+		vTaskDelete(NULL);
+		return;
+	}
+
+	ESP_LOGI(TAG, "Recording to %s (%u MB ring, next frame %u)", RECORDER_PATH, (unsigned)RECORDER_FILE_MB,
+			 (unsigned)rec_writer.hdr.next_seq);
+#if RECORDER_SESSION
+	session_lock = xSemaphoreCreateMutex();
+	ESP_LOGI(TAG, "Session capture on: raw sensor frames and WS control input");
+#endif
+	recorder_ready = true;
+	xEventGroupSetBits(camera_demand_group, CAM_DEMAND_RECORDER);
+
+	TickType_t last_wake = xTaskGetTickCount();
+	int64_t last_flush_us = esp_timer_get_time();
+	uint32_t logged_errors = 0;
+	while (true)
+	{
+		vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(RECORDER_DRAIN_MS));
 
-		vTaskDelay(pdMS_TO_TICKS(CAM_STREAM_IDLE_DELAY_MS));
+		const int64_t now_us = esp_timer_get_time();
+		const bool flush = now_us - last_flush_us >= (int64_t)RECORDER_FLUSH_MS * 1000;
+		if (flush)
+			last_flush_us = now_us;
+		if (rec_writer_drain(&rec_writer, flush) < 0)
+		{
+			const rec_stats_t st = rec_writer_stats(&rec_writer);
+			if (st.write_errors - logged_errors >= 100 || logged_errors == 0)
+			{
+				ESP_LOGW(TAG, "Recorder write errors: %u", (unsigned)st.write_errors);
+				logged_errors = st.write_errors;
+			}
+		}
 	}
 }
+#endif
 
-void app_main(void)
+// Starts the WS server as soon as lwIP is up, in parallel with NVS load and Wi-Fi connect.
+// Binding to INADDR_ANY does not need an IP, so clients can connect the moment the link exists.
+static void boot_httpd_task(void *arg)
 {
-	ESP_ERROR_CHECK(nvs_flash_init());
+	(void)arg;
+	xEventGroupWaitBits(boot_event_group, BOOT_NETIF_READY_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
 
+	ESP_ERROR_CHECK(start_http_ws_server());
+	boot_timeline_mark(BOOT_MS_HTTPD_READY);
+	xEventGroupSetBits(boot_event_group, BOOT_HTTPD_READY_BIT);
+	vTaskDelete(NULL);
+}
+
+void app_main(void)
+{
+	boot_timeline_mark(BOOT_MS_APP_MAIN);
+	boot_event_group = xEventGroupCreate();
 	wifi_event_group = xEventGroupCreate();
+	mdns_lock = xSemaphoreCreateMutex();
+	camera_demand_group = xEventGroupCreate();
+	xEventGroupSetBits(camera_demand_group, CAM_DEMAND_LINK);
+	if (vision_mode == VISION_MODE_STEER)
+		xEventGroupSetBits(camera_demand_group, CAM_DEMAND_VISION);
+	ws_clients_init(camera_demand_group, CAM_DEMAND_VIDEO);
+
+	// Starting tier from the heap as it is now, so the camera comes up at a size that fits.
+	mem_budget_init(&mem_budget, &MEM_BUDGET_CONFIG, MEM_TIER_LIMITS, mem_probe_heap, NULL);
+	mem_tier = (uint8_t)mem_budget.tier;
+	ws_clients_set_max(mem_budget_limits(&mem_budget)->max_clients);
+	ESP_LOGI(TAG, "Memory tier %s at boot", mem_tier_name(mem_budget.tier));
+
+	egress_lock = xSemaphoreCreateMutex();
+	egress_video_done = xSemaphoreCreateBinary();
+	egress_init(&egress, &EGRESS_CONFIG, egress_scratch, esp_timer_get_time());
+	egress_set_queue_depth(&egress, mem_budget_limits(&mem_budget)->queue_depth);
+	xTaskCreate(egress_task, "egress", 3072, NULL, 6, &egress_task_handle);
+	actuation_start();
+#if OTA_ENABLE
+	ota_init(); // before the WS server can take uploads
+#endif
+#if TASK_PROF_ACTIVE
+	task_prof_start();
+#endif
+
+	// Boot runs as a small dependency graph instead of a straight line:
+	//   camera_task  : no dependencies (SCCB probe + format/fb fallbacks overlap everything else)
+	//   boot_httpd   : netif
+	//   Wi-Fi driver : netif + NVS (PHY calibration data lives in NVS)
+	//   STA connect  : Wi-Fi driver + credentials from NVS
+	xTaskCreate(camera_stream_task, "camera_task", 6144, NULL, 5, NULL);
+#if RECORDER_ENABLE
+	xTaskCreate(recorder_task, "recorder", 4096, NULL, 1, NULL);
+#endif
+
+	netif_stack_init();
+	boot_timeline_mark(BOOT_MS_NETIF_READY);
+	xEventGroupSetBits(boot_event_group, BOOT_NETIF_READY_BIT);
+	xTaskCreate(boot_httpd_task, "boot_httpd", 4096, NULL, 5, NULL);
+
+	ESP_ERROR_CHECK(nvs_flash_init());
+	boot_timeline_mark(BOOT_MS_NVS_READY);
+	wifi_link_load();
 
 	char ssid[33] = {0};
 	char pass[65] = {0};
 	bool have_saved = (nvs_load_wifi_creds(ssid, sizeof(ssid), pass, sizeof(pass)) == ESP_OK) &&
 					  (strlen(ssid) > 0);
+	boot_timeline_mark(BOOT_MS_CREDS_LOADED);
 
 	const char *ssid_use = NULL;
 	const char *pass_use = NULL;
@@ -1033,12 +3608,18 @@ void app_main(void)
 		ESP_LOGI(TAG, "Using Wi-Fi credentials from rc_config.h (SSID=%s)", ssid_use);
 	}
 
+	wifi_rec_init(&wifi_rec, &WIFI_REC_CONFIG);
+	prov_test_init(&prov.test, &PROV_TEST_CONFIG);
+	// 4 KB: also runs the provisioning steps (NVS write, httpd_stop).
+	xTaskCreate(wifi_recovery_task, "wifi_rec", 4096, NULL, 4, &wifi_rec_task_handle);
 	if (ssid_use)
 	{
-		sta_retry_count = 0;
 		if (wifi_event_group)
 			xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
 
+		portENTER_CRITICAL(&wifi_rec_lock);
+		wifi_rec_begin(&wifi_rec, esp_timer_get_time());
+		portEXIT_CRITICAL(&wifi_rec_lock);
 		ESP_ERROR_CHECK(wifi_start_sta_with_creds(ssid_use, pass_use));
 		EventBits_t bits =
 			xEventGroupWaitBits(wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT, pdTRUE, pdFALSE,
@@ -1050,6 +3631,9 @@ void app_main(void)
 		else
 		{
 			ESP_LOGW(TAG, "WiFi connect failed, starting provisioning AP...");
+			portENTER_CRITICAL(&wifi_rec_lock);
+			wifi_rec_idle(&wifi_rec);
+			portEXIT_CRITICAL(&wifi_rec_lock);
 			ESP_ERROR_CHECK(wifi_start_ap(true));
 			ESP_ERROR_CHECK(start_provision_server());
 			ESP_LOGI(TAG, "Open http://192.168.4.1/ to configure Wi-Fi");
@@ -1063,6 +3647,8 @@ void app_main(void)
 		ESP_LOGI(TAG, "Open http://192.168.4.1/ to configure Wi-Fi");
 	}
 
-	ESP_ERROR_CHECK(start_http_ws_server());
-	xTaskCreate(camera_stream_task, "camera_task", 6144, NULL, 5, NULL);
+	// mDNS is started from the Wi-Fi event handler; advertise the WS service once both are up.
+	xEventGroupWaitBits(boot_event_group, BOOT_HTTPD_READY_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+	mdns_advertise_rc_ws();
+	xTaskCreate(telemetry_task, "telemetry", 4096, NULL, 3, NULL);
 }
@@ -0,0 +1,141 @@
+#include "mem_budget.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static bool below(size_t value, size_t threshold, uint32_t margin_pct)
+{
+	if (threshold == 0)
+		return false;
+	const uint64_t limit = (uint64_t)threshold * (100u + margin_pct) / 100u;
+	return (uint64_t)value < limit;
+}
+
+static void pool_low(mem_pool_sample_t *low, const mem_pool_sample_t *s)
+{
+	if (s->free < low->free)
+		low->free = s->free;
+	if (s->largest < low->largest)
+		low->largest = s->largest;
+	if (s->min_free && (low->min_free == 0 || s->min_free < low->min_free))
+		low->min_free = s->min_free;
+}
+
+static size_t sub_clamped(size_t value, size_t cur_cost, size_t next_cost)
+{
+	const size_t extra = (next_cost > cur_cost) ? next_cost - cur_cost : 0;
+	return (value > extra) ? value - extra : 0;
+}
+
+// Would the sample still clear the next better tier's thresholds (with margin) once that tier's
+// extra memory is allocated?
+static bool recover_ok(const mem_budget_t *mb)
+{
+	const mem_tier_limits_t *cur = &mb->limits[mb->tier];
+	const mem_tier_limits_t *next = &mb->limits[mb->tier - 1];
+	mem_sample_t s = mb->last;
+	s.dram.free = sub_clamped(s.dram.free, cur->dram_cost, next->dram_cost);
+	s.psram.free = sub_clamped(s.psram.free, cur->psram_cost, next->psram_cost);
+	return mem_budget_classify(&mb->cfg, &s, mb->cfg.recover_pct) < mb->tier;
+}
+
+mem_tier_t mem_budget_classify(const mem_budget_config_t *cfg, const mem_sample_t *s, uint32_t margin_pct)
+{
+	mem_tier_t tier = MEM_TIER_FULL;
+	for (int t = MEM_TIER_REDUCED; t < MEM_TIER_COUNT; t++)
+	{
+		bool hit = below(s->dram.free, cfg->dram_free[t], margin_pct) ||
+				   below(s->dram.largest, cfg->dram_block[t], margin_pct);
+		if (s->psram_present)
+			hit = hit || below(s->psram.free, cfg->psram_free[t], margin_pct) ||
+				  below(s->psram.largest, cfg->psram_block[t], margin_pct);
+		if (hit)
+			tier = (mem_tier_t)t;
+	}
+	if (!s->psram_present && tier < cfg->no_psram_tier)
+		tier = cfg->no_psram_tier;
+	return tier;
+}
+
+void mem_budget_init(mem_budget_t *mb, const mem_budget_config_t *cfg, const mem_tier_limits_t limits[MEM_TIER_COUNT],
+					 mem_probe_fn probe, void *probe_ctx)
+{
+	memset(mb, 0, sizeof(*mb));
+	mb->cfg = *cfg;
+	memcpy(mb->limits, limits, sizeof(mb->limits));
+	mb->probe = probe;
+	mb->probe_ctx = probe_ctx;
+
+	mb->probe(mb->probe_ctx, &mb->last);
+	mb->samples = 1;
+	mb->dram_low = mb->last.dram;
+	mb->psram_low = mb->last.psram;
+	mb->tier = mem_budget_classify(&mb->cfg, &mb->last, 0);
+	mb->prev_tier = mb->tier;
+}
+
+bool mem_budget_update(mem_budget_t *mb)
+{
+	mb->probe(mb->probe_ctx, &mb->last);
+	mb->samples++;
+	pool_low(&mb->dram_low, &mb->last.dram);
+	pool_low(&mb->psram_low, &mb->last.psram);
+
+	mem_tier_t next = mb->tier;
+	const mem_tier_t worst = mem_budget_classify(&mb->cfg, &mb->last, 0);
+	if (worst > mb->tier)
+	{
+		next = worst;
+	}
+	else if (mb->tier > MEM_TIER_FULL && recover_ok(mb))
+	{
+		if (++mb->recover_run >= mb->cfg.recover_samples)
+			next = (mem_tier_t)(mb->tier - 1);
+	}
+	else
+	{
+		mb->recover_run = 0;
+	}
+
+	if (next == mb->tier)
+		return false;
+	mb->prev_tier = mb->tier;
+	mb->tier = next;
+	mb->recover_run = 0;
+	mb->transitions++;
+	return true;
+}
+
+const char *mem_tier_name(mem_tier_t tier)
+{
+	switch (tier)
+	{
+	case MEM_TIER_FULL:
+		return "full";
+	case MEM_TIER_REDUCED:
+		return "reduced";
+	case MEM_TIER_SURVIVAL:
+		return "survival";
+	default:
+		return "?";
+	}
+}
+
+size_t mem_budget_json(char *buf, size_t len, const mem_budget_t *mb)
+{
+	const mem_tier_limits_t *lim = mem_budget_limits(mb);
+	const mem_sample_t *s = &mb->last;
+	const int n = snprintf(
+		buf, len,
+		"{\"type\":\"mem\",\"tier\":\"%s\",\"prev_tier\":\"%s\",\"transitions\":%u,"
+		"\"limits\":{\"frame_width\":%u,\"fb_count\":%u,\"max_clients\":%u,\"queue_depth\":%u},"
+		"\"dram\":{\"free\":%lu,\"largest\":%lu,\"min_free\":%lu,\"low_free\":%lu,\"low_largest\":%lu},"
+		"\"psram\":{\"present\":%s,\"free\":%lu,\"largest\":%lu,\"min_free\":%lu,\"low_free\":%lu,\"low_largest\":%lu}}",
+		mem_tier_name(mb->tier), mem_tier_name(mb->prev_tier), (unsigned)mb->transitions, (unsigned)lim->frame_width,
+		(unsigned)lim->fb_count, (unsigned)lim->max_clients, (unsigned)lim->queue_depth, (unsigned long)s->dram.free,
+		(unsigned long)s->dram.largest, (unsigned long)mb->dram_low.min_free, (unsigned long)mb->dram_low.free,
+		(unsigned long)mb->dram_low.largest, s->psram_present ? "true" : "false", (unsigned long)s->psram.free,
+		(unsigned long)s->psram.largest, (unsigned long)mb->psram_low.min_free, (unsigned long)mb->psram_low.free,
+		(unsigned long)mb->psram_low.largest);
+	return (n > 0 && (size_t)n < len) ? (size_t)n : 0;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+// Memory-budget tiers. Portable C (also built on the Linux host).
+//
+// A probe reports free bytes, the largest free block and the low-water mark for internal RAM
+// (DRAM) and PSRAM. Each sample is classified into a tier; the tier picks the limits the firmware
+// runs with (frame size, frame buffers, WS clients, send queue depth):
+// - full:     normal operation
+// - reduced:  smaller frames, fewer buffers and clients
+// - survival: keep driving; minimum video, one client
+// Degrading is immediate (to the worst tier the sample indicates). Recovering goes one tier at a
+// time and only after `recover_samples` consecutive samples clear the thresholds by `recover_pct`
+// with the better tier's extra memory (its `*_cost` minus the current one) already subtracted, so
+// stepping up doesn't push the heap straight back below the threshold it just left.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum
+{
+	MEM_TIER_FULL = 0,
+	MEM_TIER_REDUCED,
+	MEM_TIER_SURVIVAL,
+	MEM_TIER_COUNT,
+} mem_tier_t;
+
+typedef struct
+{
+	size_t free;
+	size_t largest;  // largest allocatable block
+	size_t min_free; // low-water mark since boot, as tracked by the allocator (0 = unknown)
+} mem_pool_sample_t;
+
+typedef struct
+{
+	mem_pool_sample_t dram;
+	mem_pool_sample_t psram;
+	bool psram_present;
+} mem_sample_t;
+
+// Fills `out` with the current heap state. Firmware: heap_caps; host: an injected test allocator.
+typedef void (*mem_probe_fn)(void *ctx, mem_sample_t *out);
+
+typedef struct
+{
+	// A tier is entered when free memory or the largest block drops below its thresholds (bytes).
+	// PSRAM thresholds only apply when PSRAM is present.
+	size_t dram_free[MEM_TIER_COUNT];
+	size_t dram_block[MEM_TIER_COUNT];
+	size_t psram_free[MEM_TIER_COUNT];
+	size_t psram_block[MEM_TIER_COUNT];
+	uint32_t recover_pct;
+	uint32_t recover_samples;
+	mem_tier_t no_psram_tier; // best tier reachable without PSRAM
+} mem_budget_config_t;
+
+typedef struct
+{
+	uint16_t frame_width; // widest frame size allowed
+	uint8_t fb_count;     // camera frame buffers
+	uint8_t max_clients;  // simultaneous WS connections
+	uint8_t queue_depth;  // queued messages per client
+	size_t dram_cost;     // approximate memory these limits use, bytes
+	size_t psram_cost;
+} mem_tier_limits_t;
+
+typedef struct
+{
+	mem_budget_config_t cfg;
+	mem_tier_limits_t limits[MEM_TIER_COUNT];
+	mem_probe_fn probe;
+	void *probe_ctx;
+
+	mem_tier_t tier;
+	mem_tier_t prev_tier; // tier before the last transition
+	uint32_t recover_run; // consecutive samples good enough for the next better tier
+	mem_sample_t last;
+	mem_pool_sample_t dram_low; // lowest free / largest seen by this module
+	mem_pool_sample_t psram_low;
+	uint32_t samples;
+	uint32_t transitions;
+} mem_budget_t;
+
+// Thresholds for tier FULL are ignored (nothing is better than full). Takes one sample to set the
+// starting tier without counting it as a transition.
+void mem_budget_init(mem_budget_t *mb, const mem_budget_config_t *cfg, const mem_tier_limits_t limits[MEM_TIER_COUNT],
+					 mem_probe_fn probe, void *probe_ctx);
+
+// Tier a sample falls into. `margin_pct` raises every threshold by that percentage.
+mem_tier_t mem_budget_classify(const mem_budget_config_t *cfg, const mem_sample_t *s, uint32_t margin_pct);
+
+// Samples the heap and updates the tier. Returns true on a tier transition.
+bool mem_budget_update(mem_budget_t *mb);
+
+static inline const mem_tier_limits_t *mem_budget_limits(const mem_budget_t *mb)
+{
+	return &mb->limits[mb->tier];
+}
+
+const char *mem_tier_name(mem_tier_t tier);
+
+// {"type":"mem",...}: tier, limits, last sample and low-water marks. Returns bytes written.
+size_t mem_budget_json(char *buf, size_t len, const mem_budget_t *mb);
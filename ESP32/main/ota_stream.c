@@ -0,0 +1,247 @@
+#include "ota_stream.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void ota_stream_init(ota_stream_t *o, const ota_sink_t *sink, const ota_hash_t *hash, size_t max_image)
+{
+	memset(o, 0, sizeof(*o));
+	o->sink = *sink;
+	o->hash = *hash;
+	o->max_image = max_image;
+}
+
+static bool parse_size(const char **p, size_t *out)
+{
+	const char *s = *p;
+	if (*s < '0' || *s > '9')
+		return false;
+	size_t v = 0;
+	while (*s >= '0' && *s <= '9')
+	{
+		const size_t d = (size_t)(*s - '0');
+		if (v > ((size_t)-1 - d) / 10)
+			return false;
+		v = v * 10 + d;
+		s++;
+	}
+	*p = s;
+	*out = v;
+	return true;
+}
+
+bool ota_parse_content_range(const char *s, size_t *first, size_t *last, size_t *total)
+{
+	if (!s || strncmp(s, "bytes ", 6) != 0)
+		return false;
+	s += 6;
+	if (!parse_size(&s, first) || *s++ != '-' || !parse_size(&s, last) || *s++ != '/' || !parse_size(&s, total))
+		return false;
+	return *s == '\0' && *first <= *last && *last < *total;
+}
+
+static int hex_digit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+bool ota_parse_sha256_hex(const char *s, uint8_t out[OTA_SHA256_LEN])
+{
+	if (!s || strlen(s) != 2 * OTA_SHA256_LEN)
+		return false;
+	for (int i = 0; i < OTA_SHA256_LEN; i++)
+	{
+		const int hi = hex_digit(s[2 * i]);
+		const int lo = hex_digit(s[2 * i + 1]);
+		if (hi < 0 || lo < 0)
+			return false;
+		out[i] = (uint8_t)((hi << 4) | lo);
+	}
+	return true;
+}
+
+static void fail(ota_stream_t *o, ota_err_t reason, bool abort_sink)
+{
+	if (abort_sink && o->state == OTA_RECEIVING)
+		o->sink.abort(o->sink.ctx);
+	o->state = OTA_FAILED;
+	o->last_error = reason;
+	o->failures++;
+}
+
+ota_err_t ota_stream_open(ota_stream_t *o, size_t offset, size_t total, const uint8_t sha256[OTA_SHA256_LEN],
+						  int64_t now_us)
+{
+	if (total == 0 || total > o->max_image)
+		return OTA_ERR_SIZE;
+	if (offset >= total)
+		return OTA_ERR_RANGE;
+
+	if (offset > 0)
+	{
+		// Resume: a mismatch is answered without touching the upload in progress.
+		if (o->state != OTA_RECEIVING)
+			return OTA_ERR_RANGE;
+		if (total != o->total || memcmp(sha256, o->expected, OTA_SHA256_LEN) != 0)
+			return OTA_ERR_MISMATCH;
+		if (offset != o->received)
+			return OTA_ERR_RANGE;
+		o->resumes++;
+		o->last_us = now_us;
+		return OTA_OK;
+	}
+
+	if (o->state == OTA_RECEIVING)
+		o->sink.abort(o->sink.ctx);
+	o->state = OTA_IDLE;
+	o->uploads++;
+	if (!o->sink.begin(o->sink.ctx, total))
+	{
+		fail(o, OTA_ERR_SINK, false);
+		return OTA_ERR_SINK;
+	}
+	o->hash.start(o->hash.ctx);
+	o->state = OTA_RECEIVING;
+	o->total = total;
+	o->received = 0;
+	memcpy(o->expected, sha256, OTA_SHA256_LEN);
+	o->last_error = OTA_OK;
+	o->last_us = now_us;
+	return OTA_OK;
+}
+
+ota_err_t ota_stream_write_begin(ota_stream_t *o, size_t len)
+{
+	if (o->state != OTA_RECEIVING)
+		return OTA_ERR_RANGE;
+	if (len > o->total - o->received)
+	{
+		fail(o, OTA_ERR_SIZE, true);
+		return OTA_ERR_SIZE;
+	}
+	return OTA_OK;
+}
+
+bool ota_stream_write_data(ota_stream_t *o, const uint8_t *data, size_t len)
+{
+	if (len == 0)
+		return true;
+	if (!o->sink.write(o->sink.ctx, data, len))
+		return false;
+	o->hash.update(o->hash.ctx, data, len);
+	return true;
+}
+
+ota_err_t ota_stream_write_end(ota_stream_t *o, size_t len, bool ok, int64_t now_us)
+{
+	if (!ok)
+	{
+		fail(o, OTA_ERR_SINK, true);
+		return OTA_ERR_SINK;
+	}
+	if (len == 0)
+		return OTA_OK;
+	o->received += len;
+	o->last_us = now_us;
+	return OTA_OK;
+}
+
+ota_err_t ota_stream_write(ota_stream_t *o, const uint8_t *data, size_t len, int64_t now_us)
+{
+	const ota_err_t err = ota_stream_write_begin(o, len);
+	if (err != OTA_OK)
+		return err;
+	return ota_stream_write_end(o, len, ota_stream_write_data(o, data, len), now_us);
+}
+
+ota_err_t ota_stream_close(ota_stream_t *o)
+{
+	if (o->state != OTA_RECEIVING || o->received < o->total)
+		return OTA_OK;
+
+	uint8_t digest[OTA_SHA256_LEN];
+	o->hash.finish(o->hash.ctx, digest);
+	if (memcmp(digest, o->expected, OTA_SHA256_LEN) != 0)
+	{
+		fail(o, OTA_ERR_HASH, true);
+		return OTA_ERR_HASH;
+	}
+	// The sink releases its handle whether or not finishing succeeds.
+	if (!o->sink.finish(o->sink.ctx))
+	{
+		fail(o, OTA_ERR_SINK, false);
+		return OTA_ERR_SINK;
+	}
+	o->state = OTA_DONE;
+	return OTA_OK;
+}
+
+void ota_stream_abort(ota_stream_t *o, ota_err_t reason)
+{
+	fail(o, reason, true);
+}
+
+bool ota_stream_expire(ota_stream_t *o, int64_t now_us, int64_t idle_us)
+{
+	if (o->state != OTA_RECEIVING || now_us - o->last_us < idle_us)
+		return false;
+	fail(o, OTA_ERR_TIMEOUT, true);
+	return true;
+}
+
+const char *ota_state_name(ota_state_t state)
+{
+	switch (state)
+	{
+	case OTA_IDLE:
+		return "idle";
+	case OTA_RECEIVING:
+		return "receiving";
+	case OTA_DONE:
+		return "done";
+	case OTA_FAILED:
+		return "failed";
+	default:
+		return "?";
+	}
+}
+
+const char *ota_err_name(ota_err_t err)
+{
+	switch (err)
+	{
+	case OTA_OK:
+		return "none";
+	case OTA_ERR_RANGE:
+		return "range";
+	case OTA_ERR_SIZE:
+		return "size";
+	case OTA_ERR_MISMATCH:
+		return "mismatch";
+	case OTA_ERR_SINK:
+		return "flash";
+	case OTA_ERR_HASH:
+		return "sha256";
+	case OTA_ERR_TIMEOUT:
+		return "timeout";
+	default:
+		return "?";
+	}
+}
+
+size_t ota_stream_json(char *buf, size_t len, const ota_stream_t *o)
+{
+	const int n = snprintf(buf, len,
+						   "{\"state\":\"%s\",\"received\":%lu,\"total\":%lu,\"max_image\":%lu,\"uploads\":%lu,"
+						   "\"resumes\":%lu,\"failures\":%lu,\"last_error\":\"%s\"}",
+						   ota_state_name(o->state), (unsigned long)o->received, (unsigned long)o->total,
+						   (unsigned long)o->max_image, (unsigned long)o->uploads, (unsigned long)o->resumes,
+						   (unsigned long)o->failures, ota_err_name(o->last_error));
+	return (n < 0 || (size_t)n >= len) ? 0 : (size_t)n;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+// Streamed, resumable firmware upload. Portable C (also built on the Linux host): the flash
+// partition and the SHA-256 implementation are plugged in through small vtables, so the same
+// range/resume/verify logic runs against esp_ota_* on the car and a file on the host.
+//
+// An upload is one or more HTTP bodies, each covering a byte range of the image (Content-Range
+// "bytes first-last/total"). Ranges must arrive in order: a body starting at 0 (re)starts the
+// upload, any other body must start exactly at `received` and carry the same total and SHA-256.
+// The image is hashed as it is written; when the last byte arrives the digest is compared and only
+// then is the sink asked to make the image bootable.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define OTA_SHA256_LEN 32
+
+typedef struct
+{
+	void *ctx;
+	bool (*begin)(void *ctx, size_t image_len);
+	// Sequential writes; `len` is whatever the transport delivered (not aligned).
+	bool (*write)(void *ctx, const uint8_t *data, size_t len);
+	// Validates the image and selects it for the next boot.
+	bool (*finish)(void *ctx);
+	void (*abort)(void *ctx);
+} ota_sink_t;
+
+typedef struct
+{
+	void *ctx;
+	void (*start)(void *ctx);
+	void (*update)(void *ctx, const uint8_t *data, size_t len);
+	void (*finish)(void *ctx, uint8_t digest[OTA_SHA256_LEN]);
+} ota_hash_t;
+
+typedef enum
+{
+	OTA_IDLE = 0,
+	OTA_RECEIVING, // partial image written, waiting for the next range
+	OTA_DONE,      // verified and bootable
+	OTA_FAILED,    // last upload was aborted (see last_error)
+} ota_state_t;
+
+typedef enum
+{
+	OTA_OK = 0,
+	OTA_ERR_RANGE,    // body doesn't start where the upload stands (resume from `received`)
+	OTA_ERR_SIZE,     // image larger than the partition, or more bytes than announced
+	OTA_ERR_MISMATCH, // resumed with a different total or SHA-256
+	OTA_ERR_SINK,     // flash begin/write/finish failed
+	OTA_ERR_HASH,     // SHA-256 of the received image differs
+	OTA_ERR_TIMEOUT,  // idle too long, upload dropped
+} ota_err_t;
+
+typedef struct
+{
+	ota_sink_t sink;
+	ota_hash_t hash;
+	size_t max_image;
+
+	ota_state_t state;
+	size_t total;
+	size_t received;
+	uint8_t expected[OTA_SHA256_LEN];
+	int64_t last_us;
+	ota_err_t last_error;
+
+	uint32_t uploads; // started from offset 0
+	uint32_t resumes; // ranges continuing an upload
+	uint32_t failures;
+} ota_stream_t;
+
+void ota_stream_init(ota_stream_t *o, const ota_sink_t *sink, const ota_hash_t *hash, size_t max_image);
+
+// "bytes first-last/total" (the form with a known total only). Returns false if malformed.
+bool ota_parse_content_range(const char *s, size_t *first, size_t *last, size_t *total);
+// 64 hex digits (either case). Returns false if malformed.
+bool ota_parse_sha256_hex(const char *s, uint8_t out[OTA_SHA256_LEN]);
+
+// Prepares for a body starting at `offset` of a `total`-byte image. Offset 0 starts over (an upload
+// in progress is aborted).
+ota_err_t ota_stream_open(ota_stream_t *o, size_t offset, size_t total, const uint8_t sha256[OTA_SHA256_LEN],
+						  int64_t now_us);
+ota_err_t ota_stream_write(ota_stream_t *o, const uint8_t *data, size_t len, int64_t now_us);
+// ota_stream_write in three steps, for callers that guard the stream with a lock but must not hold
+// it across the (slow) flash write: begin and end update the state under the lock, data only
+// touches the sink and hash and runs without it. Only one task may drive the stream between begin
+// and end. data returns false if the sink failed; pass that to end.
+ota_err_t ota_stream_write_begin(ota_stream_t *o, size_t len);
+bool ota_stream_write_data(ota_stream_t *o, const uint8_t *data, size_t len);
+ota_err_t ota_stream_write_end(ota_stream_t *o, size_t len, bool ok, int64_t now_us);
+// Call after each body. Once the whole image is in, verifies it and finishes the sink (OTA_DONE);
+// before that it only returns OTA_OK and the upload stays OTA_RECEIVING.
+ota_err_t ota_stream_close(ota_stream_t *o);
+// Drops the upload (sink aborted, OTA_FAILED with `reason`).
+void ota_stream_abort(ota_stream_t *o, ota_err_t reason);
+// Aborts an upload nobody has written to for `idle_us`. Returns true if it did.
+bool ota_stream_expire(ota_stream_t *o, int64_t now_us, int64_t idle_us);
+
+const char *ota_state_name(ota_state_t state);
+const char *ota_err_name(ota_err_t err);
+// {"state":..,"received":..,"total":..,...}. Returns bytes written, 0 if `len` is too small.
+size_t ota_stream_json(char *buf, size_t len, const ota_stream_t *o);
@@ -0,0 +1,118 @@
+#include "prov_test.h"
+
+#include <string.h>
+
+void prov_test_init(prov_test_t *t, const prov_test_config_t *cfg)
+{
+	memset(t, 0, sizeof(*t));
+	t->cfg = *cfg;
+	if (t->cfg.attempts_max == 0)
+		t->cfg.attempts_max = 1;
+}
+
+void prov_test_start(prov_test_t *t, int64_t now_us)
+{
+	t->state = PROV_TEST_CONNECTING;
+	t->step = PROV_STEP_TIMEOUT;
+	t->due = false;
+	t->attempts = 1;
+	t->reason = 0;
+	t->error = NULL;
+	t->start_us = now_us;
+	t->deadline_us = now_us + t->cfg.timeout_us;
+	t->switch_us = 0;
+}
+
+void prov_test_fail(prov_test_t *t, const char *error)
+{
+	t->state = PROV_TEST_FAILED;
+	t->error = error;
+}
+
+bool prov_test_disconnected(prov_test_t *t, uint16_t reason, prov_fail_t fail)
+{
+	if (t->state != PROV_TEST_CONNECTING)
+		return false;
+	t->reason = reason;
+	if (fail == PROV_FAIL_OTHER && t->attempts < t->cfg.attempts_max)
+	{
+		t->step = PROV_STEP_RETRY;
+		return true;
+	}
+	t->step = PROV_STEP_TIMEOUT;
+	prov_test_fail(t, (fail == PROV_FAIL_AUTH)        ? "wrong_password"
+					  : (fail == PROV_FAIL_NOT_FOUND) ? "not_found"
+													  : "connect_failed");
+	return false;
+}
+
+bool prov_test_got_ip(prov_test_t *t)
+{
+	if (t->state != PROV_TEST_CONNECTING)
+		return false;
+	t->state = PROV_TEST_OK;
+	t->step = PROV_STEP_COMMIT;
+	return true;
+}
+
+void prov_test_timer_fired(prov_test_t *t)
+{
+	t->due = true;
+}
+
+prov_action_t prov_test_next(prov_test_t *t, int64_t now_us, int64_t *arm_us)
+{
+	if (!t->due)
+		return PROV_ACT_NONE;
+	t->due = false;
+	switch (t->step)
+	{
+	case PROV_STEP_RETRY:
+		if (t->state != PROV_TEST_CONNECTING)
+			break;
+		if (now_us < t->deadline_us)
+		{
+			// The deadline stays; until the next event, the timer firing means it passed.
+			t->attempts++;
+			t->step = PROV_STEP_TIMEOUT;
+			if (arm_us)
+				*arm_us = t->deadline_us - now_us;
+			return PROV_ACT_CONNECT;
+		}
+		// fall through
+	case PROV_STEP_TIMEOUT:
+		if (t->state != PROV_TEST_CONNECTING)
+			break;
+		prov_test_fail(t, "timeout");
+		return PROV_ACT_GIVE_UP;
+	case PROV_STEP_COMMIT:
+		return (t->state == PROV_TEST_OK) ? PROV_ACT_SAVE : PROV_ACT_NONE;
+	case PROV_STEP_SWITCH:
+		return (t->state == PROV_TEST_OK) ? PROV_ACT_SWITCH : PROV_ACT_NONE;
+	}
+	return PROV_ACT_NONE;
+}
+
+bool prov_test_saved(prov_test_t *t, bool ok, int64_t now_us)
+{
+	if (!ok)
+	{
+		prov_test_fail(t, "save_failed");
+		return false;
+	}
+	t->step = PROV_STEP_SWITCH;
+	t->switch_us = now_us + t->cfg.switch_delay_us;
+	return true;
+}
+
+const char *prov_test_state_name(prov_test_state_t state)
+{
+	switch (state)
+	{
+	case PROV_TEST_IDLE: return "idle";
+	case PROV_TEST_CONNECTING: return "connecting";
+	case PROV_TEST_OK: return "ok";
+	case PROV_TEST_FAILED: return "failed";
+	}
+	return "unknown";
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+// Live credential test of the setup portal. Portable C (also built on the Linux host).
+//
+// /api/save starts a test, the Wi-Fi events feed in, and a one-shot timer (prov_timer in main.c)
+// marks the next step due. The task that owns the driver then asks for the action and runs it:
+// a transient failure retries after retry_delay_us (attempts_max connects in total, within
+// timeout_us), a wrong password fails at once, an IP commits the credentials, and switch_delay_us
+// after the commit the portal leaves APSTA. Nothing here touches the driver, NVS or the timer; the
+// functions return the delay the caller arms the timer with.
+//
+// Not thread-safe; main.c serializes access with a spinlock (all calls are O(1)).
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct
+{
+	uint32_t attempts_max;    // connects per test, the first included
+	uint32_t timeout_us;      // no IP by then: the test failed
+	uint32_t retry_delay_us;  // after a transient failure
+	uint32_t switch_delay_us; // committed: AP stays up this long
+} prov_test_config_t;
+
+typedef enum
+{
+	PROV_TEST_IDLE = 0,
+	PROV_TEST_CONNECTING,
+	PROV_TEST_OK, // connected and saved; switching to STA after switch_delay_us
+	PROV_TEST_FAILED,
+} prov_test_state_t;
+
+typedef enum
+{
+	PROV_STEP_TIMEOUT = 0, // no IP by the deadline
+	PROV_STEP_RETRY,       // connect again after a transient failure
+	PROV_STEP_COMMIT,      // connected: save the credentials
+	PROV_STEP_SWITCH,      // leave APSTA for STA
+} prov_step_t;
+
+// How a failed connect ended (the caller maps the driver's reason codes).
+typedef enum
+{
+	PROV_FAIL_OTHER = 0, // transient: retried
+	PROV_FAIL_AUTH,      // wrong password
+	PROV_FAIL_NOT_FOUND, // SSID not seen
+} prov_fail_t;
+
+typedef enum
+{
+	PROV_ACT_NONE = 0,
+	PROV_ACT_CONNECT, // connect again, arm the timer for the returned delay
+	PROV_ACT_GIVE_UP, // timed out: disconnect the STA
+	PROV_ACT_SAVE,    // save the credentials, report prov_test_saved()
+	PROV_ACT_SWITCH,  // leave APSTA for STA
+} prov_action_t;
+
+typedef struct
+{
+	prov_test_config_t cfg;
+	prov_test_state_t state;
+	prov_step_t step;
+	bool due;          // the timer fired, `step` waits for prov_test_next()
+	uint32_t attempts;
+	uint16_t reason;   // last disconnect reason
+	const char *error; // why it failed, for the page
+	int64_t start_us;
+	int64_t deadline_us;
+	int64_t switch_us;
+} prov_test_t;
+
+void prov_test_init(prov_test_t *t, const prov_test_config_t *cfg);
+
+// A test with new credentials starts (the first connect is the caller's). Arm the timer for
+// cfg.timeout_us.
+void prov_test_start(prov_test_t *t, int64_t now_us);
+
+// The test could not start or run on (`error` is a static string for the page).
+void prov_test_fail(prov_test_t *t, const char *error);
+
+// STA disconnected. Returns true if a retry is scheduled: arm the timer for cfg.retry_delay_us.
+bool prov_test_disconnected(prov_test_t *t, uint16_t reason, prov_fail_t fail);
+
+// STA got an IP. Returns true if that ends a running test: arm the timer for 0.
+bool prov_test_got_ip(prov_test_t *t);
+
+// The timer fired.
+void prov_test_timer_fired(prov_test_t *t);
+
+// The action for the step the timer marked due, if any; consumes it. `arm_us` gets the timer delay
+// for PROV_ACT_CONNECT.
+prov_action_t prov_test_next(prov_test_t *t, int64_t now_us, int64_t *arm_us);
+
+// Result of PROV_ACT_SAVE. Returns true on success: arm the timer for cfg.switch_delay_us.
+bool prov_test_saved(prov_test_t *t, bool ok, int64_t now_us);
+
+const char *prov_test_state_name(prov_test_state_t state);
@@ -20,6 +20,57 @@
 #define WIFI_STA_CONNECT_TIMEOUT_MS 15000
 #endif
 
+// Runtime link recovery (see wifi_recovery.h). After a drop: WIFI_FAST_RECONNECT_TRIES connects on
+// the last channel/BSSID, then full-scan connects backing off from WIFI_RECONNECT_BACKOFF_MIN_MS to
+// _MAX_MS. An attempt without a result within WIFI_RECONNECT_TIMEOUT_MS failed. After
+// WIFI_FALLBACK_AP_AFTER_MS of outage the SoftAP comes up next to the STA (0 = never) and the STA is
+// retried every WIFI_FALLBACK_STA_RETRY_MS (each retry scans, which briefly takes the radio off
+// the AP's channel).
+#ifndef WIFI_FAST_RECONNECT_TRIES
+#define WIFI_FAST_RECONNECT_TRIES 3
+#endif
+
+#ifndef WIFI_RECONNECT_TIMEOUT_MS
+#define WIFI_RECONNECT_TIMEOUT_MS 5000
+#endif
+
+#ifndef WIFI_RECONNECT_BACKOFF_MIN_MS
+#define WIFI_RECONNECT_BACKOFF_MIN_MS 500
+#endif
+
+#ifndef WIFI_RECONNECT_BACKOFF_MAX_MS
+#define WIFI_RECONNECT_BACKOFF_MAX_MS 8000
+#endif
+
+#ifndef WIFI_FALLBACK_AP_AFTER_MS
+#define WIFI_FALLBACK_AP_AFTER_MS 30000
+#endif
+
+#ifndef WIFI_FALLBACK_STA_RETRY_MS
+#define WIFI_FALLBACK_STA_RETRY_MS 30000
+#endif
+
+// Radio profile used until one is picked at runtime (POST /api/link, persisted in NVS):
+// "balanced" (IDF defaults: modem sleep, 11b/g/n), "low-latency" (no modem sleep, 11g/n only: more
+// power, no 11b-only clients; opt-in), "battery".
+#ifndef WIFI_LINK_PROFILE
+#define WIFI_LINK_PROFILE "balanced"
+#endif
+
+// Setup portal: credentials are tested live (AP+STA) before they are saved. A wrong password fails
+// at once, other failures are retried up to PROVISION_TEST_ATTEMPTS within PROVISION_TEST_TIMEOUT_MS.
+// On success the AP stays up PROVISION_SWITCH_DELAY_MS (the page shows the new address), then the
+// car switches to STA only without a restart.
+#ifndef PROVISION_TEST_TIMEOUT_MS
+#define PROVISION_TEST_TIMEOUT_MS 15000
+#endif
+#ifndef PROVISION_TEST_ATTEMPTS
+#define PROVISION_TEST_ATTEMPTS 3
+#endif
+#ifndef PROVISION_SWITCH_DELAY_MS
+#define PROVISION_SWITCH_DELAY_MS 5000
+#endif
+
 // Debug: log sensitive data (Wi‑Fi password) to serial output.
 // Keep this disabled for normal use.
 #ifndef PROVISION_LOG_SENSITIVE
@@ -52,8 +103,60 @@
 #define RC_WS_PORT 8888
 #endif
 
-// Control bytes: [UP, DOWN, LEFT, RIGHT, STOP, STEER]
-#define RC_CONTROL_LEN 6
+// Simultaneous HTTP/WS connections (httpd max_open_sockets). Each needs an lwIP socket; httpd itself
+// uses 3 more, so keep this <= CONFIG_LWIP_MAX_SOCKETS - 3.
+#ifndef RC_WS_MAX_CLIENTS
+#define RC_WS_MAX_CLIENTS 7
+#endif
+
+// Control messages: protocol v2 (see rc_proto.h) or legacy bytes [UP, DOWN, LEFT, RIGHT, STOP, STEER].
+// Incoming WS messages are parsed from a stack buffer of this size; larger frames close the session.
+#ifndef RC_WS_RX_MAX_LEN
+#define RC_WS_RX_MAX_LEN 128
+#endif
+
+// === WS egress ===
+// All outbound WS traffic goes through a scheduler with three classes: control (acks) before
+// telemetry before video. Video is written in fragments of EGRESS_FRAGMENT_BYTES so acks and
+// telemetry wait at most one fragment (clients with RC_CAP_VIDEO_CHUNKED) or one video message.
+#ifndef EGRESS_FRAGMENT_BYTES
+#define EGRESS_FRAGMENT_BYTES 4096
+#endif
+// Per-class bandwidth budgets: bytes/s (0 = unlimited) and burst bytes. A class over budget yields
+// to the classes below it until its bucket refills.
+#ifndef EGRESS_CONTROL_RATE_BPS
+#define EGRESS_CONTROL_RATE_BPS 0
+#endif
+#ifndef EGRESS_CONTROL_BURST
+#define EGRESS_CONTROL_BURST 0
+#endif
+#ifndef EGRESS_TELEMETRY_RATE_BPS
+#define EGRESS_TELEMETRY_RATE_BPS 16384
+#endif
+#ifndef EGRESS_TELEMETRY_BURST
+#define EGRESS_TELEMETRY_BURST 8192
+#endif
+#ifndef EGRESS_VIDEO_RATE_BPS
+#define EGRESS_VIDEO_RATE_BPS 0
+#endif
+#ifndef EGRESS_VIDEO_BURST
+#define EGRESS_VIDEO_BURST 65536
+#endif
+// egress_task only writes to sockets that have room (select), so a slow reader never holds up the
+// others. One that stays full for EGRESS_STALL_MS skips video frames until it drains. Writes that
+// still block (a slow client in the middle of a non-chunked frame) give up after
+// EGRESS_SEND_TIMEOUT_MS and the session is closed.
+#ifndef EGRESS_STALL_MS
+#define EGRESS_STALL_MS 40
+#endif
+#ifndef EGRESS_SEND_TIMEOUT_MS
+#define EGRESS_SEND_TIMEOUT_MS 200
+#endif
+
+// Link telemetry is pushed to WS clients as JSON text frames at this period.
+#ifndef TELEMETRY_INTERVAL_MS
+#define TELEMETRY_INTERVAL_MS 1000
+#endif
 
 // === Stream ===
 #ifndef STREAM_FPS
@@ -64,9 +167,23 @@
 // - `CAM_STREAM_MODE_JPEG`: send binary JPEG frames (GC2145 uses software JPEG).
 // - `CAM_STREAM_MODE_RGB565_RAW`: send RAW RGB565 frames with "RAWH" header.
 // - `CAM_STREAM_MODE_GRAY8`: send RAW GRAY8 frames with "RAWH" header (format=1).
+// - `CAM_STREAM_MODE_GRAY_SENSOR`: like GRAY8, but the sensor outputs PIXFORMAT_GRAYSCALE (half the
+//   bus bandwidth, no conversion: the luma plane is sent as captured).
+// - `CAM_STREAM_MODE_YUV422`: like GRAY8, but the sensor outputs PIXFORMAT_YUV422 and Y is taken with
+//   a strided copy (no color math).
+// - `CAM_STREAM_MODE_PACKED`: RGB565 capture sent as a packed RAWH format (CAM_STREAM_PACKED_FORMAT:
+//   4- or 2-bit luma, or RGB332 color); conversion, downscale, dithering and packing in one pass.
+// GRAY_SENSOR and YUV422 fall back to RGB565 capture + conversion if the sensor refuses the format.
 #define CAM_STREAM_MODE_JPEG 0
 #define CAM_STREAM_MODE_RGB565_RAW 1
 #define CAM_STREAM_MODE_GRAY8 2
+#define CAM_STREAM_MODE_GRAY_SENSOR 3
+#define CAM_STREAM_MODE_YUV422 4
+#define CAM_STREAM_MODE_PACKED 5
+
+// Modes that stream GRAY8 RAWH frames.
+#define CAM_STREAM_MODE_IS_GRAY(m)                                                                        \
+	((m) == CAM_STREAM_MODE_GRAY8 || (m) == CAM_STREAM_MODE_GRAY_SENSOR || (m) == CAM_STREAM_MODE_YUV422)
 
 #ifndef CAM_STREAM_MODE
 #define CAM_STREAM_MODE CAM_STREAM_MODE_JPEG
@@ -78,18 +195,351 @@
 #define CAM_SW_JPEG_QUALITY 80
 #endif
 
-// Camera task behavior
-// CAM_INIT_MAX_RETRIES: 1 = single attempt, 0 = retry forever
+// Integer downscale factor applied before streaming (1, 2 or 4). Used by the RAW modes and by
+// software JPEG; sensor JPEG frames are sent as captured. Can be changed at runtime via /api/stream.
+#ifndef CAM_STREAM_SCALE
+#define CAM_STREAM_SCALE 1
+#endif
+
+// Format of CAM_STREAM_MODE_PACKED (rc_frame_format_t): 2 = GRAY4 (QVGA: 38 KB/frame), 3 = GRAY2
+// (19 KB), 4 = RGB332 (77 KB, color). Runtime: POST /api/stream with packed=gray4|gray2|rgb332.
+#ifndef CAM_STREAM_PACKED_FORMAT
+#define CAM_STREAM_PACKED_FORMAT 2
+#endif
+
+// Ordered (4x4 Bayer) dithering for the packed formats; without it they round to the nearest level.
+// Runtime: POST /api/stream with dither=0|1.
+#ifndef CAM_STREAM_DITHER
+#define CAM_STREAM_DITHER 1
+#endif
+
+// Abbreviated JPEG for clients that negotiate it (HELLO cap VIDEO_JPEG_ABBREV, see rc_frame.h): the
+// ~600-byte table header goes out once per connection and again when it changes, not with every frame.
+#ifndef JPEG_ABBREV_ENABLE
+#define JPEG_ABBREV_ENABLE 1
+#endif
+
+// On-device vision (line/blob tracking on a GRAY8 frame, see vision.h). Runtime-switchable via /api/vision.
+// - `VISION_MODE_OFF`: disabled
+// - `VISION_MODE_TELEMETRY`: analyse every streamed frame, push {"type":"vision"} telemetry
+// - `VISION_MODE_STEER`: as above, and replace the operator's steer with line-follow steering
+#define VISION_MODE_OFF 0
+#define VISION_MODE_TELEMETRY 1
+#define VISION_MODE_STEER 2
+
+#ifndef VISION_MODE
+#define VISION_MODE VISION_MODE_OFF
+#endif
+
+// Steering gain in percent (100 = full lock when the line sits at the frame edge).
+#ifndef VISION_STEER_GAIN_PCT
+#define VISION_STEER_GAIN_PCT 100
+#endif
+
+// In steer mode the car brakes when the line hasn't been seen for this long.
+#ifndef VISION_LOST_BRAKE_MS
+#define VISION_LOST_BRAKE_MS 300
+#endif
+
+// Modes that don't stream GRAY8 analyse a luma frame downscaled by this factor (1, 2 or 4).
+#ifndef VISION_RGB565_SCALE
+#define VISION_RGB565_SCALE 2
+#endif
+
+// === Recorder ===
+// Continuous recording of encoded (JPEG) frames to a fixed-size ring file on the SD card
+// (see recorder.h). The slot runs in 1-bit mode (CLK=14, CMD=15, D0=2) so GPIO4/12/13 stay free.
+#ifndef RECORDER_ENABLE
+#define RECORDER_ENABLE 0
+#endif
+
+#ifndef RECORDER_MOUNT_POINT
+#define RECORDER_MOUNT_POINT "/sdcard"
+#endif
+
+#ifndef RECORDER_PATH
+#define RECORDER_PATH RECORDER_MOUNT_POINT "/rc.rec"
+#endif
+
+// Ring file size; the oldest footage is overwritten once it is full.
+#ifndef RECORDER_FILE_MB
+#define RECORDER_FILE_MB 512
+#endif
+
+// RAM (PSRAM) staging between the camera task and the writer. Power of two.
+#ifndef RECORDER_STAGING_KB
+#define RECORDER_STAGING_KB 512
+#endif
+
+// Index capacity in frames (~11 minutes at 25 fps).
+#ifndef RECORDER_INDEX_ENTRIES
+#define RECORDER_INDEX_ENTRIES 16384
+#endif
+
+// The writer task writes whole blocks every RECORDER_DRAIN_MS and flushes the partial tail plus
+// the header every RECORDER_FLUSH_MS (bounds how much is lost on power cut).
+#ifndef RECORDER_DRAIN_MS
+#define RECORDER_DRAIN_MS 100
+#endif
+
+#ifndef RECORDER_FLUSH_MS
+#define RECORDER_FLUSH_MS 1000
+#endif
+
+// Session capture: record what the car received (sensor frames before any processing, WS control
+// messages and handshakes) instead of the video it sent, for replay on Linux with host/rc_replay.
+// Raw frames are large (QVGA RGB565 is 150 KB): size RECORDER_STAGING_KB for several of them;
+// frames that don't fit are dropped and counted, and show up as gaps in the replay.
+#ifndef RECORDER_SESSION
+#define RECORDER_SESSION 0
+#endif
+
+// Camera supervisor (see cam_supervisor.h). A grab is bad if fb_get returns no frame or takes longer
+// than CAM_SLOW_GET_MS; CAM_STALL_GRABS bad grabs in a row, or bad grabs for CAM_STALL_MS, is a stall
+// and the driver is re-initialized in the camera task while WS sessions stay up. Re-init attempts
+// (and init retries at boot) back off from CAM_REINIT_BACKOFF_MIN_MS, doubling to _MAX_MS; the
+// supervisor never gives up.
+#ifndef CAM_SLOW_GET_MS
+#define CAM_SLOW_GET_MS 500
+#endif
+
+#ifndef CAM_STALL_GRABS
+#define CAM_STALL_GRABS 5
+#endif
+
+#ifndef CAM_STALL_MS
+#define CAM_STALL_MS 2000
+#endif
+
+#ifndef CAM_REINIT_BACKOFF_MIN_MS
+#define CAM_REINIT_BACKOFF_MIN_MS 250
+#endif
+
+#ifndef CAM_REINIT_BACKOFF_MAX_MS
+#define CAM_REINIT_BACKOFF_MAX_MS 30000
+#endif
+
+// Init attempts at boot before the boot timeline records camera_failed (0 = never); retrying goes on.
 #ifndef CAM_INIT_MAX_RETRIES
 #define CAM_INIT_MAX_RETRIES 1
 #endif
 
-#ifndef CAM_INIT_RETRY_DELAY_MS
-#define CAM_INIT_RETRY_DELAY_MS 2000
+// Frame grab policy (runtime-switchable via /api/camera; switching re-initializes the camera).
+// - `CAM_LATENCY_SMOOTH`: CAMERA_GRAB_WHEN_EMPTY, frames are delivered in order (may be a period old)
+// - `CAM_LATENCY_LOW`: CAMERA_GRAB_LATEST, plus frames older than CAM_FRAME_MAX_AGE_MS are discarded
+#define CAM_LATENCY_SMOOTH 0
+#define CAM_LATENCY_LOW 1
+
+#ifndef CAM_LATENCY_MODE
+#define CAM_LATENCY_MODE CAM_LATENCY_SMOOTH
+#endif
+
+#ifndef CAM_FB_COUNT_SMOOTH
+#define CAM_FB_COUNT_SMOOTH 2
+#endif
+
+// With GRAB_LATEST the driver keeps overwriting the spare buffers, so 2 is enough for the freshest
+// frame; more buffers only add PSRAM traffic.
+#ifndef CAM_FB_COUNT_LOW_LATENCY
+#define CAM_FB_COUNT_LOW_LATENCY 2
+#endif
+
+// Low-latency mode: a grabbed frame older than this (capture timestamp vs now) is dropped.
+#ifndef CAM_FRAME_MAX_AGE_MS
+#define CAM_FRAME_MAX_AGE_MS 60
+#endif
+
+// === Memory budget ===
+// Heap is sampled every TELEMETRY_INTERVAL_MS and mapped onto a tier (see mem_budget.h). A tier is
+// entered when DRAM or PSRAM free memory / largest free block drops below its thresholds (KB);
+// leaving it needs MEM_RECOVER_SAMPLES samples in a row that clear them by MEM_RECOVER_PCT percent.
+#ifndef MEM_REDUCED_DRAM_FREE_KB
+#define MEM_REDUCED_DRAM_FREE_KB 40
+#endif
+#ifndef MEM_REDUCED_DRAM_BLOCK_KB
+#define MEM_REDUCED_DRAM_BLOCK_KB 20
+#endif
+#ifndef MEM_SURVIVAL_DRAM_FREE_KB
+#define MEM_SURVIVAL_DRAM_FREE_KB 20
+#endif
+#ifndef MEM_SURVIVAL_DRAM_BLOCK_KB
+#define MEM_SURVIVAL_DRAM_BLOCK_KB 8
+#endif
+// A QVGA RGB565 frame buffer is 150 KB; below these the camera can't re-allocate at full size.
+#ifndef MEM_REDUCED_PSRAM_FREE_KB
+#define MEM_REDUCED_PSRAM_FREE_KB 512
+#endif
+#ifndef MEM_REDUCED_PSRAM_BLOCK_KB
+#define MEM_REDUCED_PSRAM_BLOCK_KB 160
+#endif
+#ifndef MEM_SURVIVAL_PSRAM_FREE_KB
+#define MEM_SURVIVAL_PSRAM_FREE_KB 160
+#endif
+#ifndef MEM_SURVIVAL_PSRAM_BLOCK_KB
+#define MEM_SURVIVAL_PSRAM_BLOCK_KB 64
+#endif
+
+#ifndef MEM_RECOVER_PCT
+#define MEM_RECOVER_PCT 25
+#endif
+#ifndef MEM_RECOVER_SAMPLES
+#define MEM_RECOVER_SAMPLES 5
+#endif
+
+// Per-tier limits. Frame width picks the largest sensor frame size that fits; fb count caps the
+// latency mode's count; client cap applies to WS clients; queue depth bounds per-client queued messages.
+// Without PSRAM the car never runs above the reduced tier.
+#ifndef MEM_FULL_FRAME_WIDTH
+#define MEM_FULL_FRAME_WIDTH 320
+#endif
+#ifndef MEM_REDUCED_FRAME_WIDTH
+#define MEM_REDUCED_FRAME_WIDTH 240
+#endif
+#ifndef MEM_SURVIVAL_FRAME_WIDTH
+#define MEM_SURVIVAL_FRAME_WIDTH 160
+#endif
+#ifndef MEM_FULL_FB_COUNT
+#define MEM_FULL_FB_COUNT 3
+#endif
+#ifndef MEM_REDUCED_FB_COUNT
+#define MEM_REDUCED_FB_COUNT 1
+#endif
+#ifndef MEM_SURVIVAL_FB_COUNT
+#define MEM_SURVIVAL_FB_COUNT 1
+#endif
+#ifndef MEM_REDUCED_MAX_CLIENTS
+#define MEM_REDUCED_MAX_CLIENTS 3
+#endif
+#ifndef MEM_SURVIVAL_MAX_CLIENTS
+#define MEM_SURVIVAL_MAX_CLIENTS 1
+#endif
+// DRAM per WS connection (socket buffers, httpd session), used to estimate what a tier costs.
+#ifndef MEM_CLIENT_DRAM_KB
+#define MEM_CLIENT_DRAM_KB 6
+#endif
+// Telemetry messages queued per WS client in the egress scheduler (oldest dropped; acks get EGRESS_QUEUE_MAX).
+#ifndef MEM_FULL_QUEUE_DEPTH
+#define MEM_FULL_QUEUE_DEPTH 4
+#endif
+#ifndef MEM_REDUCED_QUEUE_DEPTH
+#define MEM_REDUCED_QUEUE_DEPTH 2
+#endif
+#ifndef MEM_SURVIVAL_QUEUE_DEPTH
+#define MEM_SURVIVAL_QUEUE_DEPTH 1
+#endif
+
+// === OTA ===
+// POST /api/ota streams the image into the inactive app partition (needs the OTA partition table
+// in ESP32/partitions.csv). The body is read OTA_CHUNK_BYTES at a time by a low-priority task, so
+// video and control keep their CPU time during an upload.
+#ifndef OTA_ENABLE
+#define OTA_ENABLE 1
+#endif
+#ifndef OTA_CHUNK_BYTES
+#define OTA_CHUNK_BYTES 4096
+#endif
+#ifndef OTA_TASK_PRIORITY
+#define OTA_TASK_PRIORITY 1
+#endif
+// A partial upload nobody resumes within this is dropped.
+#ifndef OTA_IDLE_TIMEOUT_MS
+#define OTA_IDLE_TIMEOUT_MS 120000
+#endif
+// A freshly updated image must become drivable (WS server + link up) within this, otherwise the
+// bootloader rolls back to the previous one.
+#ifndef OTA_VERIFY_TIMEOUT_MS
+#define OTA_VERIFY_TIMEOUT_MS 90000
+#endif
+#ifndef OTA_REBOOT_DELAY_MS
+#define OTA_REBOOT_DELAY_MS 1000
+#endif
+
+// === Task profiler ===
+// GET /api/tasks: CPU % per task and per core (last period and a sliding window) and stack headroom,
+// from a FreeRTOS snapshot every TASK_PROF_PERIOD_MS. Needs run-time stats and the trace facility
+// in sdkconfig (see sdkconfig.defaults); without them the endpoint answers 501.
+#ifndef TASK_PROF_ENABLE
+#define TASK_PROF_ENABLE 1
+#endif
+#ifndef TASK_PROF_PERIOD_MS
+#define TASK_PROF_PERIOD_MS 1000
+#endif
+// A task whose stack never had more than this left unused is logged once (bytes).
+#ifndef TASK_PROF_STACK_WARN_BYTES
+#define TASK_PROF_STACK_WARN_BYTES 512
+#endif
+
+// === Web UI ===
+// A browser driving page at http://<device>:8888/ (GET / without a WS upgrade) plus its assets under
+// /ui/. The files in ESP32/web are gzip-compressed into the firmware at build time (web/embed.py).
+#ifndef WEB_UI_ENABLE
+#define WEB_UI_ENABLE 1
+#endif
+
+// === Actuation ===
+// A fixed-rate loop between control packets and the outputs (see actuator.h): interpolates the
+// ~20 Hz setpoints, limits slew and acceleration, bridges late packets and stops on silence.
+// Rates are axis units (full scale 32767) per second / per second^2; 0 = unlimited.
+#ifndef ACT_RATE_HZ
+#define ACT_RATE_HZ 200
 #endif
 
-#ifndef CAM_STREAM_IDLE_DELAY_MS
-#define CAM_STREAM_IDLE_DELAY_MS 200
+// Expected packet interval (the app sends every 50 ms); measured at runtime from there.
+#ifndef ACT_INTERVAL_MS
+#define ACT_INTERVAL_MS 50
+#endif
+
+// Full throttle in 250 ms, reached after 50 ms of acceleration.
+#ifndef ACT_THROTTLE_SLEW
+#define ACT_THROTTLE_SLEW 131068
+#endif
+#ifndef ACT_THROTTLE_ACCEL
+#define ACT_THROTTLE_ACCEL 2621360
+#endif
+
+// Full lock in 125 ms.
+#ifndef ACT_STEER_SLEW
+#define ACT_STEER_SLEW 262136
+#endif
+#ifndef ACT_STEER_ACCEL
+#define ACT_STEER_ACCEL 5242720
+#endif
+
+// Throttle to 0 within 100 ms on BRAKE (0 = immediately).
+#ifndef ACT_BRAKE_SLEW
+#define ACT_BRAKE_SLEW 327670
+#endif
+
+// A late packet is bridged by continuing the last trend this long; no packet for ACT_TIMEOUT_MS
+// stops the car.
+#ifndef ACT_EXTRAPOLATE_MS
+#define ACT_EXTRAPOLATE_MS 60
+#endif
+#ifndef ACT_TIMEOUT_MS
+#define ACT_TIMEOUT_MS 500
+#endif
+
+// Outputs, -1 = not connected (the loop still runs and reports its outputs in telemetry).
+// Throttle drives a two-input H-bridge (DRV8833 / L9110S style: PWM on FWD or REV, both low to
+// coast, both high to brake); steering a hobby servo. With the SD card in 1-bit mode GPIO 12/13 are
+// free on the AI Thinker board. LEDC timer/channel 0 belong to the camera clock.
+#ifndef MOTOR_PIN_FWD
+#define MOTOR_PIN_FWD -1
+#endif
+#ifndef MOTOR_PIN_REV
+#define MOTOR_PIN_REV -1
+#endif
+#ifndef MOTOR_PWM_HZ
+#define MOTOR_PWM_HZ 20000
+#endif
+#ifndef STEER_SERVO_PIN
+#define STEER_SERVO_PIN -1
+#endif
+#ifndef STEER_SERVO_MIN_US
+#define STEER_SERVO_MIN_US 1000
+#endif
+#ifndef STEER_SERVO_MAX_US
+#define STEER_SERVO_MAX_US 2000
 #endif
 
 // === Camera (AI Thinker ESP32-CAM pinout) ===
@@ -0,0 +1,457 @@
+#include "rc_frame.h"
+
+#include <string.h>
+
+static uint16_t rd_u16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] | ((uint16_t)p[1] << 8));
+}
+
+static uint32_t rd_u32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void wr_u16(uint8_t *p, uint16_t v)
+{
+	p[0] = (uint8_t)(v & 0xFF);
+	p[1] = (uint8_t)(v >> 8);
+}
+
+static void wr_u32(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t)(v & 0xFF);
+	p[1] = (uint8_t)((v >> 8) & 0xFF);
+	p[2] = (uint8_t)((v >> 16) & 0xFF);
+	p[3] = (uint8_t)(v >> 24);
+}
+
+size_t rc_frame_bpp(uint8_t format)
+{
+	switch (format)
+	{
+	case RC_FRAME_RGB565:
+		return 2;
+	case RC_FRAME_GRAY8:
+	case RC_FRAME_RGB332:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+unsigned rc_frame_bits(uint8_t format)
+{
+	switch (format)
+	{
+	case RC_FRAME_GRAY4:
+		return 4;
+	case RC_FRAME_GRAY2:
+		return 2;
+	default:
+		return (unsigned)rc_frame_bpp(format) * 8;
+	}
+}
+
+size_t rc_frame_payload_len(uint8_t format, uint16_t width, uint16_t height)
+{
+	return ((size_t)width * rc_frame_bits(format) + 7) / 8 * height;
+}
+
+const char *rc_frame_format_name(uint8_t format)
+{
+	switch (format)
+	{
+	case RC_FRAME_RGB565:
+		return "rgb565";
+	case RC_FRAME_GRAY8:
+		return "gray8";
+	case RC_FRAME_GRAY4:
+		return "gray4";
+	case RC_FRAME_GRAY2:
+		return "gray2";
+	case RC_FRAME_RGB332:
+		return "rgb332";
+	default:
+		return "?";
+	}
+}
+
+size_t rc_rawh_write(uint8_t *buf, size_t cap, uint8_t format, uint16_t width, uint16_t height,
+					 uint32_t payload_len)
+{
+	if (cap < RC_FRAME_RAWH_LEN)
+		return 0;
+	memcpy(buf, "RAWH", 4);
+	buf[4] = RC_FRAME_RAWH_VERSION;
+	buf[5] = format;
+	wr_u16(buf + 6, width);
+	wr_u16(buf + 8, height);
+	wr_u32(buf + 10, payload_len);
+	return RC_FRAME_RAWH_LEN;
+}
+
+rc_rawh_result_t rc_rawh_parse(const uint8_t *buf, size_t len, rc_rawh_t *out)
+{
+	if (len < 4 || memcmp(buf, "RAWH", 4) != 0)
+		return RC_RAWH_BAD_MAGIC;
+	if (len != RC_FRAME_RAWH_LEN)
+		return RC_RAWH_BAD_LEN;
+	if (buf[4] != RC_FRAME_RAWH_VERSION)
+		return RC_RAWH_BAD_VERSION;
+
+	if (rc_frame_bits(buf[5]) == 0)
+		return RC_RAWH_BAD_FORMAT;
+	out->format = buf[5];
+	out->width = rd_u16(buf + 6);
+	out->height = rd_u16(buf + 8);
+	out->payload_len = rd_u32(buf + 10);
+	if (out->width == 0 || out->height == 0 ||
+		rc_frame_payload_len(out->format, out->width, out->height) != out->payload_len)
+		return RC_RAWH_BAD_SIZE;
+	return RC_RAWH_OK;
+}
+
+size_t rc_jpeg_header_len(const uint8_t *buf, size_t len)
+{
+	if (!rc_frame_is_jpeg(buf, len))
+		return 0;
+	size_t pos = 2;
+	while (pos + 4 <= len)
+	{
+		if (buf[pos] != 0xFF)
+			return 0;
+		const uint8_t marker = buf[pos + 1];
+		if (marker == 0xFF)
+		{
+			pos++; // fill byte
+			continue;
+		}
+		// SOI/EOI/RSTn/TEM have no length and don't belong before the first scan.
+		if (marker == 0xD8 || marker == 0xD9 || (marker >= 0xD0 && marker <= 0xD7) || marker == 0x01)
+			return 0;
+		const size_t seg = ((size_t)buf[pos + 2] << 8) | buf[pos + 3];
+		if (seg < 2 || seg > len - pos - 2)
+			return 0;
+		pos += 2 + seg;
+		if (marker == 0xDA)
+			return (pos < len) ? pos : 0;
+	}
+	return 0;
+}
+
+size_t rc_jpeg_tables_update(rc_jpeg_tables_t *t, const uint8_t *jpeg, size_t len)
+{
+	const size_t hdr_len = rc_jpeg_header_len(jpeg, len);
+	if (hdr_len == 0 || hdr_len > RC_JPEG_TABLES_MAX)
+		return 0;
+	if (t->len == RC_FRAME_JTAB_HDR_LEN + hdr_len && memcmp(t->msg + RC_FRAME_JTAB_HDR_LEN, jpeg, hdr_len) == 0)
+		return hdr_len;
+
+	if (t->len)
+		t->changes++;
+	t->id = (uint8_t)(t->id + 1);
+	if (t->id == 0)
+		t->id = 1;
+	memcpy(t->msg, "JTAB", 4);
+	t->msg[4] = RC_FRAME_JPEG_VERSION;
+	t->msg[5] = t->id;
+	wr_u16(t->msg + 6, (uint16_t)hdr_len);
+	memcpy(t->msg + RC_FRAME_JTAB_HDR_LEN, jpeg, hdr_len);
+	t->len = RC_FRAME_JTAB_HDR_LEN + hdr_len;
+	return hdr_len;
+}
+
+size_t rc_jref_write(uint8_t *buf, size_t cap, uint8_t table_id, uint32_t scan_len)
+{
+	if (cap < RC_FRAME_JREF_LEN)
+		return 0;
+	memcpy(buf, "JREF", 4);
+	buf[4] = RC_FRAME_JPEG_VERSION;
+	buf[5] = table_id;
+	wr_u32(buf + 6, scan_len);
+	return RC_FRAME_JREF_LEN;
+}
+
+// JTAB: stores the tables. Other messages don't touch a pending header (see rc_frame_rx_feed()).
+static rc_frame_rx_result_t rx_tables(rc_frame_rx_t *rx, const uint8_t *buf, size_t len)
+{
+	const size_t n = (len >= RC_FRAME_JTAB_HDR_LEN) ? rd_u16(buf + 6) : 0;
+	if (len < RC_FRAME_JTAB_HDR_LEN || buf[4] != RC_FRAME_JPEG_VERSION || buf[5] == 0 || n == 0 ||
+		n > RC_JPEG_TABLES_MAX || len != RC_FRAME_JTAB_HDR_LEN + n)
+	{
+		rx->bad_headers++;
+		return RC_FRAME_RX_ERROR;
+	}
+	memcpy(rx->tables, buf + RC_FRAME_JTAB_HDR_LEN, n);
+	rx->tables_len = (uint16_t)n;
+	rx->tables_id = buf[5];
+	return RC_FRAME_RX_NONE;
+}
+
+rc_frame_rx_result_t rc_frame_rx_feed(rc_frame_rx_t *rx, const uint8_t *buf, size_t len, rc_frame_t *out)
+{
+	// The payload check comes first: pixel data may well start with FF D8 or "RAWH".
+	if (rx->have_header && len == rx->pending.payload_len)
+	{
+		rx->have_header = false;
+		memset(out, 0, sizeof(*out));
+		out->data = buf;
+		out->len = len;
+		if (!rx->pending_jref)
+		{
+			rx->frames++;
+			out->hdr = rx->pending;
+			return RC_FRAME_RX_RAW;
+		}
+		if (rx->tables_id == 0 || rx->tables_id != rx->pending_id)
+		{
+			rx->missing_tables++;
+			return RC_FRAME_RX_ERROR;
+		}
+		rx->frames++;
+		out->prefix = rx->tables;
+		out->prefix_len = rx->tables_len;
+		return RC_FRAME_RX_JPEG;
+	}
+
+	if (rc_frame_is_jpeg(buf, len))
+	{
+		if (rx->have_header)
+			rx->orphans++;
+		rx->have_header = false;
+		rx->frames++;
+		memset(out, 0, sizeof(*out));
+		out->data = buf;
+		out->len = len;
+		return RC_FRAME_RX_JPEG;
+	}
+
+	if (len >= 4 && memcmp(buf, "JTAB", 4) == 0)
+		return rx_tables(rx, buf, len);
+
+	if (len >= 4 && memcmp(buf, "JREF", 4) == 0)
+	{
+		if (rx->have_header)
+			rx->orphans++;
+		rx->have_header = len == RC_FRAME_JREF_LEN && buf[4] == RC_FRAME_JPEG_VERSION && rd_u32(buf + 6) > 0;
+		if (!rx->have_header)
+		{
+			rx->bad_headers++;
+			return RC_FRAME_RX_ERROR;
+		}
+		memset(&rx->pending, 0, sizeof(rx->pending));
+		rx->pending.payload_len = rd_u32(buf + 6);
+		rx->pending_jref = true;
+		rx->pending_id = buf[5];
+		return RC_FRAME_RX_NONE;
+	}
+
+	rc_rawh_t hdr;
+	const rc_rawh_result_t res = rc_rawh_parse(buf, len, &hdr);
+	if (res == RC_RAWH_BAD_MAGIC)
+		return RC_FRAME_RX_NONE;
+
+	if (rx->have_header)
+		rx->orphans++;
+	rx->have_header = (res == RC_RAWH_OK);
+	if (!rx->have_header)
+	{
+		rx->bad_headers++;
+		return RC_FRAME_RX_ERROR;
+	}
+	rx->pending = hdr;
+	rx->pending_jref = false;
+	return RC_FRAME_RX_NONE;
+}
+
+size_t rc_frame_jpeg_rebuild(const rc_frame_t *f, uint8_t *dst, size_t cap)
+{
+	if (f->prefix_len > cap || f->len > cap - f->prefix_len)
+		return 0;
+	if (f->prefix_len)
+		memcpy(dst, f->prefix, f->prefix_len);
+	memcpy(dst + f->prefix_len, f->data, f->len);
+	return f->prefix_len + f->len;
+}
+
+size_t rc_chunk_write_header(uint8_t *buf, size_t cap, uint16_t seq, uint32_t offset, bool last)
+{
+	if (cap < RC_FRAME_CHUNK_HDR_LEN)
+		return 0;
+	buf[0] = RC_FRAME_CHUNK_MAGIC;
+	buf[1] = last ? RC_FRAME_CHUNK_LAST : 0;
+	wr_u16(buf + 2, seq);
+	wr_u32(buf + 4, offset);
+	return RC_FRAME_CHUNK_HDR_LEN;
+}
+
+rc_chunk_result_t rc_chunk_rx_feed(rc_chunk_rx_t *rx, const uint8_t *buf, size_t len, const uint8_t **msg,
+								   size_t *msg_len)
+{
+	if (len < RC_FRAME_CHUNK_HDR_LEN || buf[0] != RC_FRAME_CHUNK_MAGIC)
+		return RC_CHUNK_NONE;
+
+	const uint16_t seq = rd_u16(buf + 2);
+	const uint32_t offset = rd_u32(buf + 4);
+	const size_t n = len - RC_FRAME_CHUNK_HDR_LEN;
+	if (offset == 0)
+	{
+		if (rx->active)
+			rx->dropped++;
+		rx->active = true;
+		rx->seq = seq;
+		rx->len = 0;
+	}
+	// Chunks of one message arrive in order (one TCP stream, one sender), so anything else is a loss.
+	if (!rx->active || seq != rx->seq || offset != rx->len || n > rx->cap - rx->len)
+	{
+		if (rx->active)
+			rx->dropped++;
+		rx->active = false;
+		return RC_CHUNK_ERROR;
+	}
+	memcpy(rx->buf + rx->len, buf + RC_FRAME_CHUNK_HDR_LEN, n);
+	rx->len += n;
+	if (!(buf[1] & RC_FRAME_CHUNK_LAST))
+		return RC_CHUNK_PARTIAL;
+	rx->active = false;
+	*msg = rx->buf;
+	*msg_len = rx->len;
+	return RC_CHUNK_DONE;
+}
+
+// The pixel loops below work on 8 bytes at a time (memcpy compiles to plain loads/stores) and
+// finish the tail per pixel.
+
+void rc_px_swap16(uint8_t *dst, const uint8_t *src, size_t pixels)
+{
+	size_t i = 0;
+	for (; i + 4 <= pixels; i += 4)
+	{
+		uint64_t v;
+		memcpy(&v, src + 2 * i, sizeof(v));
+		v = ((v & 0x00FF00FF00FF00FFull) << 8) | ((v >> 8) & 0x00FF00FF00FF00FFull);
+		memcpy(dst + 2 * i, &v, sizeof(v));
+	}
+	for (; i < pixels; i++)
+	{
+		const uint8_t hi = src[2 * i];
+		dst[2 * i] = src[2 * i + 1];
+		dst[2 * i + 1] = hi;
+	}
+}
+
+static inline uint16_t gray_to_rgb565(uint8_t y)
+{
+	return (uint16_t)(((y >> 3) << 11) | ((y >> 2) << 5) | (y >> 3));
+}
+
+void rc_px_gray8_to_rgb565le(uint8_t *dst, const uint8_t *src, size_t pixels)
+{
+	size_t i = 0;
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+	for (; i + 4 <= pixels; i += 4)
+	{
+		const uint64_t v = (uint64_t)gray_to_rgb565(src[i]) | ((uint64_t)gray_to_rgb565(src[i + 1]) << 16) |
+						   ((uint64_t)gray_to_rgb565(src[i + 2]) << 32) |
+						   ((uint64_t)gray_to_rgb565(src[i + 3]) << 48);
+		memcpy(dst + 2 * i, &v, sizeof(v));
+	}
+#endif
+	for (; i < pixels; i++)
+	{
+		const uint16_t pix = gray_to_rgb565(src[i]);
+		dst[2 * i] = (uint8_t)(pix & 0xFF);
+		dst[2 * i + 1] = (uint8_t)(pix >> 8);
+	}
+}
+
+void rc_px_rgb565be_to_rgb888(uint8_t *dst, const uint8_t *src, size_t pixels)
+{
+	for (size_t i = 0; i < pixels; i++)
+	{
+		const unsigned v = ((unsigned)src[2 * i] << 8) | src[2 * i + 1];
+		const unsigned r = v >> 11, g = (v >> 5) & 63, b = v & 31;
+		dst[3 * i] = (uint8_t)((r << 3) | (r >> 2));
+		dst[3 * i + 1] = (uint8_t)((g << 2) | (g >> 4));
+		dst[3 * i + 2] = (uint8_t)((b << 3) | (b >> 2));
+	}
+}
+
+// One packed byte -> its 2 (GRAY4) or 4 (GRAY2) luma bytes, first pixel in the low byte (memory
+// order on little-endian hosts).
+static inline uint32_t unpack_gray_byte(uint8_t b, unsigned bits)
+{
+	if (bits == 4)
+		return (uint32_t)((b >> 4) * 17u) | ((uint32_t)((b & 15u) * 17u) << 8);
+	return (uint32_t)((b >> 6) * 85u) | ((uint32_t)(((b >> 4) & 3u) * 85u) << 8) |
+		   ((uint32_t)(((b >> 2) & 3u) * 85u) << 16) | ((uint32_t)((b & 3u) * 85u) << 24);
+}
+
+static void unpack_gray_row(uint8_t *dst, const uint8_t *src, unsigned bits, size_t width)
+{
+	const size_t per_byte = 8 / bits;
+	size_t x = 0;
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+	// 8 output pixels per store.
+	for (; x + 8 <= width; x += 8)
+	{
+		uint64_t v;
+		if (bits == 4)
+			v = (uint64_t)unpack_gray_byte(src[0], 4) | ((uint64_t)unpack_gray_byte(src[1], 4) << 16) |
+				((uint64_t)unpack_gray_byte(src[2], 4) << 32) | ((uint64_t)unpack_gray_byte(src[3], 4) << 48);
+		else
+			v = (uint64_t)unpack_gray_byte(src[0], 2) | ((uint64_t)unpack_gray_byte(src[1], 2) << 32);
+		memcpy(dst + x, &v, sizeof(v));
+		src += 8 / per_byte;
+	}
+#endif
+	for (; x < width; x++)
+	{
+		const size_t i = x % per_byte;
+		const unsigned q = (src[0] >> (8 - bits * (i + 1))) & ((1u << bits) - 1);
+		dst[x] = (uint8_t)(q * ((bits == 4) ? 17u : 85u));
+		if (i + 1 == per_byte)
+			src++;
+	}
+}
+
+size_t rc_px_unpack_gray8(uint8_t *dst, const uint8_t *src, uint8_t format, uint16_t width, uint16_t height)
+{
+	const size_t pixels = (size_t)width * height;
+	if (format == RC_FRAME_GRAY8)
+	{
+		memcpy(dst, src, pixels);
+		return pixels;
+	}
+	if (format != RC_FRAME_GRAY4 && format != RC_FRAME_GRAY2)
+		return 0;
+	const unsigned bits = rc_frame_bits(format);
+	const size_t row = rc_frame_payload_len(format, width, 1);
+	for (uint16_t y = 0; y < height; y++)
+		unpack_gray_row(dst + (size_t)y * width, src + (size_t)y * row, bits, width);
+	return pixels;
+}
+
+void rc_px_rgb332_to_rgb565le(uint8_t *dst, const uint8_t *src, size_t pixels)
+{
+	for (size_t i = 0; i < pixels; i++)
+	{
+		const unsigned r = src[i] >> 5, g = (src[i] >> 2) & 7, b = src[i] & 3;
+		const unsigned pix = (((r << 2) | (r >> 1)) << 11) | (((g << 3) | g) << 5) | ((b << 3) | (b << 1) | (b >> 1));
+		dst[2 * i] = (uint8_t)(pix & 0xFF);
+		dst[2 * i + 1] = (uint8_t)(pix >> 8);
+	}
+}
+
+void rc_px_rgb332_to_rgb888(uint8_t *dst, const uint8_t *src, size_t pixels)
+{
+	for (size_t i = 0; i < pixels; i++)
+	{
+		const unsigned r = src[i] >> 5, g = (src[i] >> 2) & 7, b = src[i] & 3;
+		dst[3 * i] = (uint8_t)((r << 5) | (r << 2) | (r >> 1));
+		dst[3 * i + 1] = (uint8_t)((g << 5) | (g << 2) | (g >> 1));
+		dst[3 * i + 2] = (uint8_t)(b * 85u);
+	}
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+// Video frame codec (binary WS messages). Portable C: no ESP-IDF dependencies, compiled into the
+// firmware and the Linux host tools.
+//
+// A RAW frame is sent as two messages: a 14-byte RAWH header, then the pixel payload.
+//   [0..3]  "RAWH"
+//   [4]     version (1)
+//   [5]     format (rc_frame_format_t)
+//   [6..7]  width u16, [8..9] height u16, [10..13] payload length u32 (little-endian)
+// Packed formats (GRAY4, GRAY2, RGB332) store rows MSB-first: the first pixel of a row is in the
+// high bits of its first byte, and each row is padded to a whole byte. GRAY4/GRAY2 levels map back
+// to 0..255 as q * 17 / q * 85; RGB332 is RRRGGGBB.
+// JPEG frames are sent as a single message starting with FF D8.
+//
+// Clients that negotiated RC_CAP_VIDEO_CHUNKED get video messages (JPEG, RAWH payload) split into
+// chunk messages, so other messages can be sent between them:
+//   [0] RC_FRAME_CHUNK_MAGIC, [1] flags (RC_FRAME_CHUNK_LAST), [2..3] message seq u16,
+//   [4..7] offset of this chunk in the message u32, then the data.
+// The RAWH header itself is never chunked.
+//
+// Clients that negotiated RC_CAP_VIDEO_JPEG_ABBREV get JPEG frames without the ~600 bytes of
+// DQT/DHT/SOF/SOS header that every frame repeats. The header (SOI up to the end of the SOS segment)
+// is sent once in a JTAB message, and again whenever it changes (quality, resolution):
+//   [0..3] "JTAB", [4] version (1), [5] table id u8, [6..7] header length u16, then the header.
+// Each frame is then a 10-byte JREF message and the rest of the JPEG (scan data through EOI):
+//   [0..3] "JREF", [4] version (1), [5] table id u8, [6..9] scan length u32.
+// JTAB header + scan data is the original JPEG, byte for byte. Like RAWH, the reference messages
+// are never chunked; the scan message may be.
+//
+// Pixel conversions for receivers: RGB565 payloads are big-endian (camera byte order), displays
+// usually want little-endian RGB565 or RGB888.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RC_FRAME_RAWH_LEN 14
+#define RC_FRAME_RAWH_VERSION 1
+
+#define RC_FRAME_CHUNK_MAGIC 0xC6
+#define RC_FRAME_CHUNK_HDR_LEN 8
+#define RC_FRAME_CHUNK_LAST 0x01
+
+#define RC_FRAME_JTAB_HDR_LEN 8
+#define RC_FRAME_JREF_LEN 10
+#define RC_FRAME_JPEG_VERSION 1
+// Largest JPEG header that is sent as tables (baseline headers are ~600 bytes).
+#define RC_JPEG_TABLES_MAX 1024
+
+typedef enum
+{
+	RC_FRAME_RGB565 = 0, // 2 bytes per pixel, MSB first
+	RC_FRAME_GRAY8 = 1,  // 1 byte per pixel
+	RC_FRAME_GRAY4 = 2,  // 2 pixels per byte
+	RC_FRAME_GRAY2 = 3,  // 4 pixels per byte
+	RC_FRAME_RGB332 = 4, // 1 byte per pixel, RRRGGGBB
+	RC_FRAME_FORMAT_COUNT,
+} rc_frame_format_t;
+
+typedef struct
+{
+	uint8_t format; // rc_frame_format_t
+	uint16_t width;
+	uint16_t height;
+	uint32_t payload_len;
+} rc_rawh_t;
+
+typedef enum
+{
+	RC_RAWH_OK = 0,
+	RC_RAWH_BAD_LEN,   // not 14 bytes
+	RC_RAWH_BAD_MAGIC, // not a RAWH header
+	RC_RAWH_BAD_VERSION,
+	RC_RAWH_BAD_FORMAT,
+	RC_RAWH_BAD_SIZE, // zero dimension or payload_len != rc_frame_payload_len()
+} rc_rawh_result_t;
+
+// Bytes per pixel, 0 for packed (GRAY4, GRAY2) and unknown formats.
+size_t rc_frame_bpp(uint8_t format);
+// Bits per pixel, 0 for unknown formats.
+unsigned rc_frame_bits(uint8_t format);
+// Payload bytes of a width x height frame (rows padded to whole bytes), 0 for unknown formats.
+size_t rc_frame_payload_len(uint8_t format, uint16_t width, uint16_t height);
+const char *rc_frame_format_name(uint8_t format);
+
+// Writes the header for `payload_len` bytes of `format` pixels. Returns RC_FRAME_RAWH_LEN, or 0 if
+// `cap` is too small.
+size_t rc_rawh_write(uint8_t *buf, size_t cap, uint8_t format, uint16_t width, uint16_t height,
+					 uint32_t payload_len);
+rc_rawh_result_t rc_rawh_parse(const uint8_t *buf, size_t len, rc_rawh_t *out);
+
+static inline bool rc_frame_is_jpeg(const uint8_t *buf, size_t len)
+{
+	return len >= 2 && buf[0] == 0xFF && buf[1] == 0xD8;
+}
+
+// Offset of the scan data: the length of the JPEG header from SOI through the first SOS segment.
+// 0 if `buf` isn't a JPEG or the header is truncated/malformed.
+size_t rc_jpeg_header_len(const uint8_t *buf, size_t len);
+
+// Sender side of abbreviated JPEG: the current tables as a ready-to-send JTAB message.
+// Zero-initialize before first use.
+typedef struct
+{
+	uint8_t msg[RC_FRAME_JTAB_HDR_LEN + RC_JPEG_TABLES_MAX];
+	size_t len;       // JTAB message length, 0 before the first frame
+	uint8_t id;       // 1..255, bumped whenever the header changes
+	uint32_t changes; // header changes after the first
+} rc_jpeg_tables_t;
+
+// Compares the JPEG's header with the cached one and replaces it (new id) if it differs. Returns
+// the scan offset, or 0 if the frame can't be abbreviated (not a parseable JPEG, header too large);
+// such frames go out whole.
+size_t rc_jpeg_tables_update(rc_jpeg_tables_t *t, const uint8_t *jpeg, size_t len);
+size_t rc_jref_write(uint8_t *buf, size_t cap, uint8_t table_id, uint32_t scan_len);
+
+// Receiver state for the header + payload message pair. Zero-initialize before first use.
+typedef struct
+{
+	rc_rawh_t pending;
+	bool have_header;
+	bool pending_jref; // the pending header is a JREF (payload = scan data)
+	uint8_t pending_id;
+	uint8_t tables[RC_JPEG_TABLES_MAX]; // last JTAB
+	uint16_t tables_len;
+	uint8_t tables_id; // 0 = none yet
+	uint32_t frames;
+	uint32_t bad_headers;    // RAWH/JTAB/JREF magic with an invalid header
+	uint32_t orphans;        // header not followed by its payload (next frame arrived first)
+	uint32_t missing_tables; // JREF frames whose tables weren't received
+} rc_frame_rx_t;
+
+typedef enum
+{
+	RC_FRAME_RX_NONE = 0, // not a frame (e.g. a control message), a header awaiting its payload or JTAB
+	RC_FRAME_RX_JPEG,
+	RC_FRAME_RX_RAW,
+	RC_FRAME_RX_ERROR, // counted in the rx stats; the message is dropped
+} rc_frame_rx_result_t;
+
+typedef struct
+{
+	rc_rawh_t hdr;       // RAW only
+	const uint8_t *data; // points into the fed message
+	size_t len;
+	// Abbreviated JPEG: the header that goes before `data` (points into the rx state), else NULL.
+	const uint8_t *prefix;
+	size_t prefix_len;
+} rc_frame_t;
+
+// Feeds one binary WS message. On RC_FRAME_RX_JPEG / RC_FRAME_RX_RAW `out` describes the frame.
+// Other messages (e.g. a control ACK sent between a header and its payload) return NONE and leave
+// the pending header in place; a message of exactly the pending payload length is always taken as
+// the payload, so check for NONE before parsing anything else.
+rc_frame_rx_result_t rc_frame_rx_feed(rc_frame_rx_t *rx, const uint8_t *buf, size_t len, rc_frame_t *out);
+
+// Writes prefix + data (the complete JPEG for an abbreviated frame). Returns its length, or 0 if
+// `cap` is too small.
+size_t rc_frame_jpeg_rebuild(const rc_frame_t *f, uint8_t *dst, size_t cap);
+
+size_t rc_chunk_write_header(uint8_t *buf, size_t cap, uint16_t seq, uint32_t offset, bool last);
+
+// Chunk reassembly into a caller-provided buffer. Zero-initialize, then set `buf` and `cap`.
+typedef struct
+{
+	uint8_t *buf;
+	size_t cap;
+	size_t len;
+	uint16_t seq;
+	bool active;
+	uint32_t dropped; // messages lost to gaps, restarts or overflow
+} rc_chunk_rx_t;
+
+typedef enum
+{
+	RC_CHUNK_NONE = 0, // not a chunk message: handle it as is
+	RC_CHUNK_PARTIAL,  // stored, message not complete yet
+	RC_CHUNK_DONE,     // *msg / *msg_len hold the reassembled message (valid until the next feed)
+	RC_CHUNK_ERROR,    // dropped (counted)
+} rc_chunk_result_t;
+
+rc_chunk_result_t rc_chunk_rx_feed(rc_chunk_rx_t *rx, const uint8_t *buf, size_t len, const uint8_t **msg,
+								   size_t *msg_len);
+
+// --- pixel conversions (`dst` may equal `src` for rc_px_swap16) ---
+
+// Swaps the bytes of every 16-bit pixel (big-endian <-> little-endian RGB565).
+void rc_px_swap16(uint8_t *dst, const uint8_t *src, size_t pixels);
+// GRAY8 -> little-endian RGB565 (5/6/5 bits of the same luma).
+void rc_px_gray8_to_rgb565le(uint8_t *dst, const uint8_t *src, size_t pixels);
+// Big-endian RGB565 -> packed RGB888 with bit replication (0x1F -> 0xFF).
+void rc_px_rgb565be_to_rgb888(uint8_t *dst, const uint8_t *src, size_t pixels);
+// GRAY8 / GRAY4 / GRAY2 payload -> GRAY8 (width * height bytes). Returns the bytes written, 0 for
+// other formats.
+size_t rc_px_unpack_gray8(uint8_t *dst, const uint8_t *src, uint8_t format, uint16_t width, uint16_t height);
+// RGB332 -> little-endian RGB565 / packed RGB888, channels bit-replicated.
+void rc_px_rgb332_to_rgb565le(uint8_t *dst, const uint8_t *src, size_t pixels);
+void rc_px_rgb332_to_rgb888(uint8_t *dst, const uint8_t *src, size_t pixels);
@@ -0,0 +1,166 @@
+#include "rc_proto.h"
+
+static uint16_t rd_u16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] | ((uint16_t)p[1] << 8));
+}
+
+static uint32_t rd_u32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void wr_u16(uint8_t *p, uint16_t v)
+{
+	p[0] = (uint8_t)(v & 0xFF);
+	p[1] = (uint8_t)(v >> 8);
+}
+
+static void wr_u32(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t)(v & 0xFF);
+	p[1] = (uint8_t)((v >> 8) & 0xFF);
+	p[2] = (uint8_t)((v >> 16) & 0xFF);
+	p[3] = (uint8_t)(v >> 24);
+}
+
+static int16_t clamp_axis(int32_t v)
+{
+	if (v > RC_AXIS_MAX)
+		return RC_AXIS_MAX;
+	if (v < RC_AXIS_MIN)
+		return RC_AXIS_MIN;
+	return (int16_t)v;
+}
+
+void rc_proto_from_legacy(const uint8_t legacy[RC_PROTO_LEGACY_LEN], rc_control_t *out)
+{
+	const bool up = legacy[0] != 0;
+	const bool down = legacy[1] != 0;
+	const bool left = legacy[2] != 0;
+	const bool right = legacy[3] != 0;
+	const bool stop = legacy[4] != 0;
+	const int32_t steer_raw = (legacy[5] > 10) ? 10 : legacy[5];
+
+	out->seq = 0;
+	out->flags = RC_CTRL_FLAG_LEGACY | (stop ? RC_CTRL_FLAG_BRAKE : 0);
+	out->throttle = (stop || up == down) ? 0 : (up ? RC_AXIS_MAX : RC_AXIS_MIN);
+
+	// Buttons override the slider; the slider is 0..10 with 5 as center.
+	if (left != right)
+		out->steer = left ? RC_AXIS_MIN : RC_AXIS_MAX;
+	else
+		out->steer = clamp_axis((steer_raw - 5) * RC_AXIS_MAX / 5);
+}
+
+rc_parse_result_t rc_proto_parse(const uint8_t *buf, size_t len, rc_msg_t *out)
+{
+	if (!buf || !out || len < 2)
+		return RC_PARSE_BAD_LEN;
+
+	if (buf[0] != RC_PROTO_MAGIC)
+	{
+		// Legacy frames start with a 0/1 button byte, never with the magic.
+		if (len != RC_PROTO_LEGACY_LEN)
+			return RC_PARSE_BAD_MAGIC;
+		out->type = RC_MSG_CONTROL;
+		rc_proto_from_legacy(buf, &out->control);
+		return RC_PARSE_OK;
+	}
+
+	if ((buf[1] >> 4) != RC_PROTO_VERSION)
+		return RC_PARSE_BAD_VERSION;
+
+	const rc_msg_type_t type = (rc_msg_type_t)(buf[1] & 0x0F);
+	out->type = type;
+	switch (type)
+	{
+	case RC_MSG_CONTROL:
+		if (len != RC_PROTO_CONTROL_LEN)
+			return RC_PARSE_BAD_LEN;
+		out->control.seq = rd_u16(buf + 2);
+		out->control.flags = buf[4] & (uint8_t)~RC_CTRL_FLAG_LEGACY;
+		out->control.throttle = clamp_axis((int16_t)rd_u16(buf + 5));
+		out->control.steer = clamp_axis((int16_t)rd_u16(buf + 7));
+		return RC_PARSE_OK;
+	case RC_MSG_HELLO:
+	case RC_MSG_HELLO_ACK:
+		if (len != RC_PROTO_HELLO_LEN)
+			return RC_PARSE_BAD_LEN;
+		out->hello.version = buf[2];
+		out->hello.caps = rd_u32(buf + 3);
+		return RC_PARSE_OK;
+	case RC_MSG_ACK:
+		if (len != RC_PROTO_ACK_LEN)
+			return RC_PARSE_BAD_LEN;
+		out->ack.seq = rd_u16(buf + 2);
+		out->ack.status = buf[4];
+		return RC_PARSE_OK;
+	default:
+		return RC_PARSE_UNKNOWN_TYPE;
+	}
+}
+
+bool rc_proto_session_accept(rc_proto_session_t *sess, uint16_t seq, int64_t now_us)
+{
+	if (!sess)
+		return true;
+
+	const bool resync = !sess->have_seq || (now_us - sess->last_rx_us) > RC_PROTO_SEQ_RESYNC_US;
+	sess->last_rx_us = now_us;
+	// Serial-number arithmetic: newer iff the 16-bit difference is positive.
+	if (!resync && (int16_t)(seq - sess->last_seq) <= 0)
+		return false;
+
+	sess->last_seq = seq;
+	sess->have_seq = true;
+	return true;
+}
+
+static void write_prefix(uint8_t *buf, rc_msg_type_t type)
+{
+	buf[0] = RC_PROTO_MAGIC;
+	buf[1] = (uint8_t)((RC_PROTO_VERSION << 4) | (type & 0x0F));
+}
+
+size_t rc_proto_write_control(uint8_t *buf, size_t cap, const rc_control_t *ctrl)
+{
+	if (!buf || !ctrl || cap < RC_PROTO_CONTROL_LEN)
+		return 0;
+	write_prefix(buf, RC_MSG_CONTROL);
+	wr_u16(buf + 2, ctrl->seq);
+	buf[4] = ctrl->flags & (uint8_t)~RC_CTRL_FLAG_LEGACY;
+	wr_u16(buf + 5, (uint16_t)ctrl->throttle);
+	wr_u16(buf + 7, (uint16_t)ctrl->steer);
+	return RC_PROTO_CONTROL_LEN;
+}
+
+static size_t write_hello_common(uint8_t *buf, size_t cap, rc_msg_type_t type, uint32_t caps)
+{
+	if (!buf || cap < RC_PROTO_HELLO_LEN)
+		return 0;
+	write_prefix(buf, type);
+	buf[2] = RC_PROTO_VERSION;
+	wr_u32(buf + 3, caps);
+	return RC_PROTO_HELLO_LEN;
+}
+
+size_t rc_proto_write_hello(uint8_t *buf, size_t cap, uint32_t caps)
+{
+	return write_hello_common(buf, cap, RC_MSG_HELLO, caps);
+}
+
+size_t rc_proto_write_hello_ack(uint8_t *buf, size_t cap, uint32_t caps)
+{
+	return write_hello_common(buf, cap, RC_MSG_HELLO_ACK, caps);
+}
+
+size_t rc_proto_write_ack(uint8_t *buf, size_t cap, uint16_t seq, rc_ack_status_t status)
+{
+	if (!buf || cap < RC_PROTO_ACK_LEN)
+		return 0;
+	write_prefix(buf, RC_MSG_ACK);
+	wr_u16(buf + 2, seq);
+	buf[4] = (uint8_t)status;
+	return RC_PROTO_ACK_LEN;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+// Control protocol v2 (binary WS messages). Portable C: no ESP-IDF dependencies, so the same code
+// is compiled into the firmware and the Linux host tools.
+//
+// Every v2 message starts with:
+//   [0] RC_PROTO_MAGIC
+//   [1] (version << 4) | type
+// Multi-byte fields are little-endian.
+//
+//   CONTROL   (client -> car, 9 bytes):  seq u16, flags u8, throttle i16, steer i16
+//   HELLO     (client -> car, 7 bytes):  max_version u8, caps u32
+//   HELLO_ACK (car -> client, 7 bytes):  version u8, caps u32 (negotiated = client & car)
+//   ACK       (car -> client, 5 bytes):  seq u16, status u8 (sent for CONTROL with ACK_REQ)
+//
+// Legacy 6-byte frames [UP, DOWN, LEFT, RIGHT, STOP, STEER(0..10)] are still accepted and mapped
+// onto the axes (see rc_proto_from_legacy).
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RC_PROTO_MAGIC 0xC5
+#define RC_PROTO_VERSION 2
+
+#define RC_PROTO_CONTROL_LEN 9
+#define RC_PROTO_HELLO_LEN 7
+#define RC_PROTO_HELLO_ACK_LEN 7
+#define RC_PROTO_ACK_LEN 5
+#define RC_PROTO_LEGACY_LEN 6
+
+// Axes are signed full-scale 16-bit; 8-bit senders shift left by 8.
+#define RC_AXIS_MAX 32767
+#define RC_AXIS_MIN (-32767)
+
+typedef enum
+{
+	RC_MSG_CONTROL = 1,
+	RC_MSG_HELLO = 2,
+	RC_MSG_HELLO_ACK = 3,
+	RC_MSG_ACK = 4,
+} rc_msg_type_t;
+
+// CONTROL flags
+#define RC_CTRL_FLAG_BRAKE 0x01
+#define RC_CTRL_FLAG_ACK_REQ 0x02
+// Set by the parser for frames converted from the legacy 6-byte format (never on the wire).
+#define RC_CTRL_FLAG_LEGACY 0x80
+
+// Capabilities exchanged in HELLO / HELLO_ACK.
+#define RC_CAP_CONTROL_V2 (1u << 0)
+#define RC_CAP_CONTROL_ACK (1u << 1)
+#define RC_CAP_TELEMETRY_TEXT (1u << 2)
+// Client only drives; the device stops sending it video frames.
+#define RC_CAP_CONTROL_ONLY (1u << 3)
+// Client reassembles video chunk messages (rc_frame.h), so acks/telemetry can go out mid-frame.
+#define RC_CAP_VIDEO_CHUNKED (1u << 4)
+// Client takes abbreviated JPEG: tables once (JTAB), then JREF + scan data per frame (rc_frame.h).
+#define RC_CAP_VIDEO_JPEG_ABBREV (1u << 5)
+
+typedef enum
+{
+	RC_ACK_APPLIED = 0,
+	RC_ACK_STALE = 1,
+} rc_ack_status_t;
+
+typedef struct
+{
+	uint16_t seq;
+	uint8_t flags;
+	int16_t throttle;
+	int16_t steer;
+} rc_control_t;
+
+typedef struct
+{
+	rc_msg_type_t type;
+	union
+	{
+		rc_control_t control;
+		struct
+		{
+			uint8_t version;
+			uint32_t caps;
+		} hello; // HELLO and HELLO_ACK
+		struct
+		{
+			uint16_t seq;
+			uint8_t status;
+		} ack;
+	};
+} rc_msg_t;
+
+typedef enum
+{
+	RC_PARSE_OK = 0,
+	RC_PARSE_BAD_LEN,
+	RC_PARSE_BAD_MAGIC,
+	RC_PARSE_BAD_VERSION,
+	RC_PARSE_UNKNOWN_TYPE,
+} rc_parse_result_t;
+
+// Per-connection sequencing state. Zero-initialize before first use.
+typedef struct
+{
+	uint32_t caps;
+	uint16_t last_seq;
+	bool have_seq;
+	int64_t last_rx_us;
+} rc_proto_session_t;
+
+// After this much silence any sequence number is accepted again (sender restarted its counter).
+#define RC_PROTO_SEQ_RESYNC_US 1000000LL
+
+// Parses one WS binary message. Does not allocate and does not keep references to `buf`.
+rc_parse_result_t rc_proto_parse(const uint8_t *buf, size_t len, rc_msg_t *out);
+
+// Maps [UP, DOWN, LEFT, RIGHT, STOP, STEER] onto a control message (flags include LEGACY).
+void rc_proto_from_legacy(const uint8_t legacy[RC_PROTO_LEGACY_LEN], rc_control_t *out);
+
+// Returns true if `seq` is newer than anything seen on this session and records it.
+// Duplicates and out-of-order (older) packets return false.
+bool rc_proto_session_accept(rc_proto_session_t *sess, uint16_t seq, int64_t now_us);
+
+// Writers return the number of bytes written, or 0 if `cap` is too small.
+size_t rc_proto_write_control(uint8_t *buf, size_t cap, const rc_control_t *ctrl);
+size_t rc_proto_write_hello(uint8_t *buf, size_t cap, uint32_t caps);
+size_t rc_proto_write_hello_ack(uint8_t *buf, size_t cap, uint32_t caps);
+size_t rc_proto_write_ack(uint8_t *buf, size_t cap, uint16_t seq, rc_ack_status_t status);
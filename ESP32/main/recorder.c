@@ -0,0 +1,569 @@
+#include "recorder.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define REC_MAGIC "RCREC1\0\0"
+#define REC_FRAME_MAGIC 0x52464352u // "RCFR"
+#define REC_HDR_CRC_OFF 56u
+#define REC_ENTRIES_PER_BLOCK (REC_BLOCK_SIZE / REC_INDEX_ENTRY_SIZE)
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+	p[2] = (uint8_t)(v >> 16);
+	p[3] = (uint8_t)(v >> 24);
+}
+
+static void put_u64(uint8_t *p, uint64_t v)
+{
+	put_u32(p, (uint32_t)v);
+	put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t get_u64(const uint8_t *p)
+{
+	return (uint64_t)get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+
+static uint64_t align_up64(uint64_t v, uint64_t a)
+{
+	return (v + a - 1) / a * a;
+}
+
+static uint32_t fnv1a(const uint8_t *p, size_t len)
+{
+	uint32_t h = 2166136261u;
+	for (size_t i = 0; i < len; i++)
+		h = (h ^ p[i]) * 16777619u;
+	return h;
+}
+
+// --- POSIX file backend ---
+
+static int file_pwrite(void *ctx, const void *buf, size_t len, uint64_t off)
+{
+	const int fd = (int)(intptr_t)ctx;
+	const uint8_t *p = (const uint8_t *)buf;
+	while (len > 0)
+	{
+		const ssize_t n = pwrite(fd, p, len, (off_t)off);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		p += n;
+		off += (uint64_t)n;
+		len -= (size_t)n;
+	}
+	return 0;
+}
+
+static int file_pread(void *ctx, void *buf, size_t len, uint64_t off)
+{
+	const int fd = (int)(intptr_t)ctx;
+	uint8_t *p = (uint8_t *)buf;
+	while (len > 0)
+	{
+		const ssize_t n = pread(fd, p, len, (off_t)off);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		p += n;
+		off += (uint64_t)n;
+		len -= (size_t)n;
+	}
+	return 0;
+}
+
+static int file_sync(void *ctx)
+{
+	return fsync((int)(intptr_t)ctx);
+}
+
+int rec_store_file_open(rec_store_t *st, const char *path, uint64_t size, bool create)
+{
+	memset(st, 0, sizeof(*st));
+	const int fd = open(path, create ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+	if (fd < 0)
+		return -1;
+
+	struct stat sb;
+	if (fstat(fd, &sb) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	if (create && (uint64_t)sb.st_size != size)
+	{
+		// Some filesystems can't extend with ftruncate; writing the last byte does the same.
+		const uint8_t zero = 0;
+		if (ftruncate(fd, (off_t)size) != 0 && file_pwrite((void *)(intptr_t)fd, &zero, 1, size - 1) != 0)
+		{
+			close(fd);
+			return -1;
+		}
+	}
+
+	st->ctx = (void *)(intptr_t)fd;
+	st->pwrite = file_pwrite;
+	st->pread = file_pread;
+	st->sync = file_sync;
+	st->size = create ? size : (uint64_t)sb.st_size;
+	return 0;
+}
+
+void rec_store_file_close(rec_store_t *st)
+{
+	if (st->pwrite)
+		close((int)(intptr_t)st->ctx);
+	memset(st, 0, sizeof(*st));
+}
+
+// --- on-storage encodings ---
+
+static void header_encode(uint8_t *b, const rec_header_t *h)
+{
+	memset(b, 0, REC_BLOCK_SIZE);
+	memcpy(b, REC_MAGIC, 8);
+	put_u32(b + 8, REC_BLOCK_SIZE);
+	put_u32(b + 12, h->file_id);
+	put_u32(b + 16, h->index_cap);
+	put_u32(b + 20, h->next_seq);
+	put_u64(b + 24, h->index_off);
+	put_u64(b + 32, h->data_off);
+	put_u64(b + 40, h->data_size);
+	put_u64(b + 48, h->head);
+	put_u32(b + REC_HDR_CRC_OFF, fnv1a(b, REC_HDR_CRC_OFF));
+}
+
+static bool header_decode(const uint8_t *b, rec_header_t *h)
+{
+	if (memcmp(b, REC_MAGIC, 8) != 0 || get_u32(b + 8) != REC_BLOCK_SIZE ||
+		get_u32(b + REC_HDR_CRC_OFF) != fnv1a(b, REC_HDR_CRC_OFF))
+		return false;
+	h->file_id = get_u32(b + 12);
+	h->index_cap = get_u32(b + 16);
+	h->next_seq = get_u32(b + 20);
+	h->index_off = get_u64(b + 24);
+	h->data_off = get_u64(b + 32);
+	h->data_size = get_u64(b + 40);
+	h->head = get_u64(b + 48);
+	return h->index_cap > 0 && h->data_size >= REC_BLOCK_SIZE;
+}
+
+static void entry_encode(uint8_t *p, const rec_entry_t *e, uint32_t file_id)
+{
+	put_u64(p, e->pos);
+	put_u64(p + 8, (uint64_t)e->t_us);
+	put_u32(p + 16, e->seq);
+	put_u32(p + 20, e->len);
+	put_u32(p + 24, e->flags);
+	put_u32(p + 28, file_id);
+}
+
+static void frame_hdr_encode(uint8_t *p, uint32_t seq, uint32_t len, uint32_t flags, int64_t t_us)
+{
+	put_u32(p, REC_FRAME_MAGIC);
+	put_u32(p + 4, seq);
+	put_u32(p + 8, len);
+	put_u32(p + 12, flags);
+	put_u64(p + 16, (uint64_t)t_us);
+}
+
+static uint32_t record_len(uint32_t payload_len)
+{
+	return (REC_FRAME_HDR_SIZE + payload_len + 3u) & ~3u;
+}
+
+// --- writer ---
+
+static void staging_copy_in(rec_writer_t *w, uint32_t pos, const uint8_t *src, uint32_t len)
+{
+	const uint32_t off = pos & (w->staging_size - 1);
+	const uint32_t first = (len < w->staging_size - off) ? len : w->staging_size - off;
+	memcpy(w->staging + off, src, first);
+	if (first < len)
+		memcpy(w->staging, src + first, len - first);
+}
+
+static void staging_copy_out(const rec_writer_t *w, uint32_t pos, uint8_t *dst, uint32_t len)
+{
+	const uint32_t off = pos & (w->staging_size - 1);
+	const uint32_t first = (len < w->staging_size - off) ? len : w->staging_size - off;
+	memcpy(dst, w->staging + off, first);
+	if (first < len)
+		memcpy(dst + first, w->staging, len - first);
+}
+
+static int write_header(rec_writer_t *w)
+{
+	header_encode(w->block_buf, &w->hdr);
+	return w->store->pwrite(w->store->ctx, w->block_buf, REC_BLOCK_SIZE, 0);
+}
+
+static int flush_index_block(rec_writer_t *w)
+{
+	if (!w->index_dirty)
+		return 0;
+	const uint64_t off = w->hdr.index_off + (uint64_t)w->index_block * REC_BLOCK_SIZE;
+	if (w->store->pwrite(w->store->ctx, w->index_buf, REC_BLOCK_SIZE, off) != 0)
+		return -1;
+	w->index_dirty = false;
+	return 0;
+}
+
+static int index_put(rec_writer_t *w, const rec_entry_t *e)
+{
+	const uint32_t slot = e->seq % w->hdr.index_cap;
+	const uint32_t block = slot / REC_ENTRIES_PER_BLOCK;
+	if (block != w->index_block)
+	{
+		if (flush_index_block(w) != 0)
+			return -1;
+		// Keep the older entries that share this block.
+		const uint64_t off = w->hdr.index_off + (uint64_t)block * REC_BLOCK_SIZE;
+		if (w->store->pread(w->store->ctx, w->index_buf, REC_BLOCK_SIZE, off) != 0)
+			memset(w->index_buf, 0, REC_BLOCK_SIZE);
+		w->index_block = block;
+	}
+	entry_encode(w->index_buf + (slot % REC_ENTRIES_PER_BLOCK) * REC_INDEX_ENTRY_SIZE, e, w->hdr.file_id);
+	w->index_dirty = true;
+	return 0;
+}
+
+int rec_writer_init(rec_writer_t *w, rec_store_t *store, uint8_t *staging, uint32_t staging_size, uint32_t index_cap,
+					uint32_t file_id)
+{
+	memset(w, 0, sizeof(*w));
+	if (!store || !staging || staging_size < 4 * REC_BLOCK_SIZE || (staging_size & (staging_size - 1)) != 0 ||
+		index_cap == 0)
+		return -1;
+
+	// Whole index blocks only, so no block is shared between the index and anything else.
+	index_cap = (uint32_t)align_up64(index_cap, REC_ENTRIES_PER_BLOCK);
+	rec_header_t want = {0};
+	want.file_id = file_id;
+	want.index_cap = index_cap;
+	want.index_off = REC_BLOCK_SIZE;
+	want.data_off = want.index_off + align_up64((uint64_t)index_cap * REC_INDEX_ENTRY_SIZE, REC_BLOCK_SIZE);
+	if (store->size < want.data_off)
+		return -1;
+	want.data_size = (store->size - want.data_off) / REC_BLOCK_SIZE * REC_BLOCK_SIZE;
+	// A staged batch must never lap the ring within a single drain.
+	if (want.data_size < 2ull * staging_size)
+		return -1;
+
+	w->block_buf = (uint8_t *)malloc(REC_BLOCK_SIZE);
+	w->index_buf = (uint8_t *)malloc(REC_BLOCK_SIZE);
+	if (!w->block_buf || !w->index_buf)
+	{
+		rec_writer_deinit(w);
+		return -1;
+	}
+
+	w->store = store;
+	w->staging = staging;
+	w->staging_size = staging_size;
+	w->index_block = UINT32_MAX;
+
+	rec_header_t have;
+	if (store->pread(store->ctx, w->block_buf, REC_BLOCK_SIZE, 0) == 0 && header_decode(w->block_buf, &have) &&
+		have.index_cap == want.index_cap && have.index_off == want.index_off && have.data_off == want.data_off &&
+		have.data_size == want.data_size)
+	{
+		// Resume: continue after the last flushed block; the gap is never referenced by the index.
+		w->hdr = have;
+		w->hdr.head = align_up64(have.head, REC_BLOCK_SIZE);
+	}
+	else
+	{
+		w->hdr = want;
+		if (write_header(w) != 0)
+		{
+			rec_writer_deinit(w);
+			return -1;
+		}
+	}
+
+	w->prod_seq = w->hdr.next_seq;
+	w->written_pos = w->hdr.head;
+	atomic_init(&w->staged, 0);
+	atomic_init(&w->released, 0);
+	atomic_init(&w->dropped, 0);
+	return 0;
+}
+
+void rec_writer_deinit(rec_writer_t *w)
+{
+	free(w->block_buf);
+	free(w->index_buf);
+	w->block_buf = NULL;
+	w->index_buf = NULL;
+}
+
+bool rec_writer_push(rec_writer_t *w, const uint8_t *data, uint32_t len, int64_t t_us, uint32_t flags)
+{
+	return rec_writer_push2(w, NULL, 0, data, len, t_us, flags);
+}
+
+bool rec_writer_push2(rec_writer_t *w, const uint8_t *head, uint32_t head_len, const uint8_t *data, uint32_t len,
+					  int64_t t_us, uint32_t flags)
+{
+	const uint32_t total = head_len + len;
+	const uint32_t rec_len = record_len(total);
+	if ((head_len > 0 && !head) || !data || len == 0 || total < len || rec_len > w->staging_size / 2)
+	{
+		atomic_fetch_add_explicit(&w->dropped, 1, memory_order_relaxed);
+		return false;
+	}
+
+	const uint32_t released = atomic_load_explicit(&w->released, memory_order_acquire);
+	const uint32_t fill = w->prod_pos - released;
+	if (fill + rec_len > w->staging_size)
+	{
+		atomic_fetch_add_explicit(&w->dropped, 1, memory_order_relaxed);
+		return false;
+	}
+
+	uint8_t hdr[REC_FRAME_HDR_SIZE];
+	frame_hdr_encode(hdr, w->prod_seq, total, flags, t_us);
+	staging_copy_in(w, w->prod_pos, hdr, sizeof(hdr));
+	if (head_len > 0)
+		staging_copy_in(w, w->prod_pos + REC_FRAME_HDR_SIZE, head, head_len);
+	staging_copy_in(w, w->prod_pos + REC_FRAME_HDR_SIZE + head_len, data, len);
+
+	w->prod_pos += rec_len;
+	w->prod_seq++;
+	w->stats.frames++;
+	if (fill + rec_len > w->stats.staging_peak)
+		w->stats.staging_peak = fill + rec_len;
+	atomic_store_explicit(&w->staged, w->prod_pos, memory_order_release);
+	return true;
+}
+
+// Indexes every staged record that is now completely on storage.
+static int index_written_records(rec_writer_t *w, uint32_t staged)
+{
+	while (w->parse_pos != staged)
+	{
+		if (!w->pending_valid)
+		{
+			uint8_t h[REC_FRAME_HDR_SIZE];
+			staging_copy_out(w, w->parse_pos, h, sizeof(h));
+			w->pending.seq = get_u32(h + 4);
+			w->pending.len = get_u32(h + 8);
+			w->pending.flags = get_u32(h + 12);
+			w->pending.t_us = (int64_t)get_u64(h + 16);
+			w->pending.pos = (uint64_t)((int64_t)w->written_pos + (int32_t)(w->parse_pos - w->written));
+			w->pending_valid = true;
+		}
+
+		const uint32_t rec_len = record_len(w->pending.len);
+		if ((int32_t)(w->written - (w->parse_pos + rec_len)) < 0)
+			break; // tail not on storage yet
+
+		if (index_put(w, &w->pending) != 0)
+			return -1;
+		w->hdr.next_seq = w->pending.seq + 1;
+		w->parse_pos += rec_len;
+		w->pending_valid = false;
+		w->stats.indexed++;
+	}
+	return flush_index_block(w);
+}
+
+int rec_writer_drain(rec_writer_t *w, bool flush_partial)
+{
+	const uint32_t staged = atomic_load_explicit(&w->staged, memory_order_acquire);
+	const uint32_t block_mask = REC_BLOCK_SIZE - 1;
+	const uint32_t target = flush_partial ? staged : (staged & ~block_mask);
+	if ((int32_t)(target - w->written) <= 0)
+		return 0;
+
+	// Always write whole blocks, starting at the block holding `written` (it may have been
+	// written partially by the previous flush).
+	const uint32_t start = w->written & ~block_mask;
+	const uint32_t end = (target + block_mask) & ~block_mask;
+	uint64_t fpos = w->written_pos - (w->written - start);
+	uint32_t sp = start;
+	while (sp != end)
+	{
+		uint32_t n = end - sp;
+		const uint32_t s_off = sp & (w->staging_size - 1);
+		if (n > w->staging_size - s_off)
+			n = w->staging_size - s_off;
+		const uint64_t d_off = fpos % w->hdr.data_size;
+		if (n > w->hdr.data_size - d_off)
+			n = (uint32_t)(w->hdr.data_size - d_off);
+		if (w->store->pwrite(w->store->ctx, w->staging + s_off, n, w->hdr.data_off + d_off) != 0)
+		{
+			w->stats.write_errors++;
+			return -1;
+		}
+		sp += n;
+		fpos += n;
+	}
+
+	w->written_pos += target - w->written;
+	w->written = target;
+	w->stats.bytes_written += end - start;
+	w->stats.batches++;
+
+	int rc = index_written_records(w, staged);
+	if (rc == 0)
+	{
+		w->hdr.head = w->written_pos;
+		rc = write_header(w);
+	}
+	if (rc == 0 && flush_partial && w->store->sync)
+		rc = w->store->sync(w->store->ctx);
+	if (rc != 0)
+		w->stats.write_errors++;
+
+	// The block holding `written` stays reserved: it is rewritten by the next drain.
+	atomic_store_explicit(&w->released, w->written & ~block_mask, memory_order_release);
+	return (rc == 0) ? (int)(end - start) : -1;
+}
+
+uint32_t rec_writer_staging_fill(rec_writer_t *w)
+{
+	return atomic_load_explicit(&w->staged, memory_order_acquire) -
+		   atomic_load_explicit(&w->released, memory_order_acquire);
+}
+
+rec_stats_t rec_writer_stats(rec_writer_t *w)
+{
+	rec_stats_t s = w->stats;
+	s.dropped = atomic_load_explicit(&w->dropped, memory_order_relaxed);
+	return s;
+}
+
+// --- reader ---
+
+static int data_read(const rec_reader_t *r, uint64_t pos, uint8_t *dst, size_t len)
+{
+	while (len > 0)
+	{
+		const uint64_t off = pos % r->hdr.data_size;
+		size_t n = len;
+		if (n > r->hdr.data_size - off)
+			n = (size_t)(r->hdr.data_size - off);
+		if (r->store->pread(r->store->ctx, dst, n, r->hdr.data_off + off) != 0)
+			return -1;
+		pos += n;
+		dst += n;
+		len -= n;
+	}
+	return 0;
+}
+
+bool rec_reader_entry(const rec_reader_t *r, uint32_t seq, rec_entry_t *e)
+{
+	if ((int32_t)(seq - r->hdr.next_seq) >= 0)
+		return false;
+
+	uint8_t p[REC_INDEX_ENTRY_SIZE];
+	const uint64_t off = r->hdr.index_off + (uint64_t)(seq % r->hdr.index_cap) * REC_INDEX_ENTRY_SIZE;
+	if (r->store->pread(r->store->ctx, p, sizeof(p), off) != 0)
+		return false;
+	if (get_u32(p + 28) != r->hdr.file_id || get_u32(p + 16) != seq)
+		return false;
+
+	e->pos = get_u64(p);
+	e->t_us = (int64_t)get_u64(p + 8);
+	e->seq = seq;
+	e->len = get_u32(p + 20);
+	e->flags = get_u32(p + 24);
+
+	// The writer may already have overwritten up to the end of the head block.
+	const uint64_t end = align_up64(r->hdr.head, REC_BLOCK_SIZE);
+	const uint64_t oldest = (end > r->hdr.data_size) ? end - r->hdr.data_size : 0;
+	return e->pos >= oldest && e->pos + record_len(e->len) <= r->hdr.head;
+}
+
+int rec_reader_open(rec_reader_t *r, rec_store_t *store)
+{
+	memset(r, 0, sizeof(*r));
+	uint8_t *b = (uint8_t *)malloc(REC_BLOCK_SIZE);
+	if (!b)
+		return -1;
+	const bool ok = store->pread(store->ctx, b, REC_BLOCK_SIZE, 0) == 0 && header_decode(b, &r->hdr);
+	free(b);
+	if (!ok)
+		return -1;
+	r->store = store;
+
+	// Entries are valid for a contiguous range of seqs ending at next_seq; find where it starts.
+	uint32_t lo = (r->hdr.next_seq > r->hdr.index_cap) ? r->hdr.next_seq - r->hdr.index_cap : 0;
+	uint32_t hi = r->hdr.next_seq;
+	while (lo < hi)
+	{
+		const uint32_t mid = lo + (hi - lo) / 2;
+		rec_entry_t e;
+		if (rec_reader_entry(r, mid, &e))
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	r->first_seq = lo;
+	return 0;
+}
+
+uint32_t rec_reader_seek_time(const rec_reader_t *r, int64_t t_us)
+{
+	uint32_t lo = r->first_seq;
+	uint32_t hi = r->hdr.next_seq;
+	while (lo < hi)
+	{
+		const uint32_t mid = lo + (hi - lo) / 2;
+		rec_entry_t e;
+		if (!rec_reader_entry(r, mid, &e) || e.t_us < t_us)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+int rec_reader_read(const rec_reader_t *r, uint32_t seq, uint8_t *buf, size_t cap, rec_entry_t *e)
+{
+	if (!rec_reader_entry(r, seq, e) || e->len > cap)
+		return -1;
+
+	uint8_t h[REC_FRAME_HDR_SIZE];
+	if (data_read(r, e->pos, h, sizeof(h)) != 0 || get_u32(h) != REC_FRAME_MAGIC || get_u32(h + 4) != seq ||
+		get_u32(h + 8) != e->len)
+		return -1;
+	if (data_read(r, e->pos + REC_FRAME_HDR_SIZE, buf, e->len) != 0)
+		return -1;
+	return (int)e->len;
+}
+
+const char *rec_fmt_name(uint32_t flags)
+{
+	switch (flags & 0xFF)
+	{
+	case REC_FMT_JPEG:
+		return "jpeg";
+	case REC_FMT_RAWH:
+		return "rawh";
+	case REC_FMT_CAMERA:
+		return "cam";
+	case REC_FMT_CONTROL:
+		return "ctrl";
+	default:
+		return "?";
+	}
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+// Ring-file frame recorder. Portable C (also built on the Linux host).
+//
+// File layout (offsets block-aligned, integers little-endian):
+//   block 0        header
+//   index region   index_cap entries of REC_INDEX_ENTRY_SIZE bytes; frame `seq` lives in slot seq % index_cap
+//   data region    byte ring of frame records (frame header + payload, padded to 4 bytes). A record at
+//                  logical position `pos` is stored at data_off + pos % data_size and may wrap.
+//
+// Writing is split between one producer and one consumer:
+// - rec_writer_push() (camera task) only copies the frame into a RAM staging ring. It never blocks
+//   and never touches storage; if staging is full the frame is dropped and counted.
+// - rec_writer_drain() (a low-priority task) writes staged data in whole aligned blocks, then the
+//   index entries of the frames that are now fully on storage, then the header. A partial last
+//   block is only written when asked to flush, and is rewritten in full once it fills up.
+// The index is always written after the data it points to and the header after the index, so a
+// reader (or a power cut) never sees an entry for data that isn't there.
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define REC_BLOCK_SIZE 4096u
+#define REC_INDEX_ENTRY_SIZE 32u
+#define REC_FRAME_HDR_SIZE 24u
+
+// Frame payload formats (rec_entry_t.flags, low byte).
+#define REC_FMT_JPEG 0u
+#define REC_FMT_RAWH 1u
+// Session capture (main/session.h): sensor frames and received WS control messages.
+#define REC_FMT_CAMERA 2u
+#define REC_FMT_CONTROL 3u
+
+// Storage backend. Both calls transfer exactly `len` bytes at `off` and return 0 on success.
+typedef struct
+{
+	void *ctx;
+	int (*pwrite)(void *ctx, const void *buf, size_t len, uint64_t off);
+	int (*pread)(void *ctx, void *buf, size_t len, uint64_t off);
+	int (*sync)(void *ctx); // may be NULL
+	uint64_t size;
+} rec_store_t;
+
+// Plain file through POSIX pread/pwrite: FATFS on the SD card, or a regular file on Linux.
+// With `create`, the file is created if needed and sized to `size`; otherwise its current size is used.
+int rec_store_file_open(rec_store_t *st, const char *path, uint64_t size, bool create);
+void rec_store_file_close(rec_store_t *st);
+
+typedef struct
+{
+	uint32_t file_id; // random per format; index entries from an older layout never match
+	uint32_t index_cap;
+	uint64_t index_off;
+	uint64_t data_off;
+	uint64_t data_size;
+	uint64_t head;     // logical end of data on storage
+	uint32_t next_seq; // sequence number of the next frame to be indexed
+} rec_header_t;
+
+typedef struct
+{
+	uint64_t pos; // logical position of the frame record in the data ring
+	int64_t t_us;
+	uint32_t seq;
+	uint32_t len; // payload bytes
+	uint32_t flags;
+} rec_entry_t;
+
+typedef struct
+{
+	uint32_t frames;     // staged by push
+	uint32_t dropped;    // rejected by push (staging full / frame too large)
+	uint32_t indexed;    // frames fully on storage
+	uint32_t batches;    // drain calls that wrote something
+	uint32_t write_errors;
+	uint64_t bytes_written; // data bytes, including rewrites of partial blocks
+	uint32_t staging_peak;  // highest staging fill seen by push, bytes
+} rec_stats_t;
+
+typedef struct
+{
+	rec_store_t *store;
+	rec_header_t hdr;
+
+	uint8_t *staging;
+	uint32_t staging_size; // power of two, multiple of REC_BLOCK_SIZE
+
+	// Producer side.
+	uint32_t prod_pos;
+	uint32_t prod_seq;
+	_Atomic uint32_t staged;   // end of the last complete staged record (producer -> consumer)
+	_Atomic uint32_t released; // staging before this position may be reused (consumer -> producer)
+	_Atomic uint32_t dropped;
+
+	// Consumer side. Staging positions wrap at 2^32; `written` maps to logical file position `written_pos`.
+	uint32_t written;
+	uint64_t written_pos;
+	uint32_t parse_pos; // staging position of the first record not yet indexed
+	bool pending_valid; // header of the record at parse_pos, cached once read
+	rec_entry_t pending;
+	uint8_t *block_buf;   // header block scratch, REC_BLOCK_SIZE bytes
+	uint8_t *index_buf;   // cached index block, REC_BLOCK_SIZE bytes
+	uint32_t index_block; // which index block index_buf holds, UINT32_MAX if none
+	bool index_dirty;
+
+	rec_stats_t stats;
+} rec_writer_t;
+
+// Opens (or formats) a recording on `store`. Resumes appending when the existing header matches
+// the requested index size; otherwise starts a new recording. `staging` must stay valid for the
+// writer's lifetime. Returns 0 on success, -1 on bad geometry or storage error.
+int rec_writer_init(rec_writer_t *w, rec_store_t *store, uint8_t *staging, uint32_t staging_size, uint32_t index_cap,
+					uint32_t file_id);
+void rec_writer_deinit(rec_writer_t *w);
+
+// Producer: never blocks. Returns false if the frame was dropped.
+bool rec_writer_push(rec_writer_t *w, const uint8_t *data, uint32_t len, int64_t t_us, uint32_t flags);
+
+// Same, with the payload in two pieces (`head` may be NULL when head_len is 0): saves the caller a
+// copy when a small header goes in front of a frame buffer.
+bool rec_writer_push2(rec_writer_t *w, const uint8_t *head, uint32_t head_len, const uint8_t *data, uint32_t len,
+					  int64_t t_us, uint32_t flags);
+
+// Consumer: writes everything staged. With `flush_partial` the trailing partial block is written
+// too (and the header updated), otherwise only whole blocks. Returns bytes written, -1 on error.
+int rec_writer_drain(rec_writer_t *w, bool flush_partial);
+
+// Bytes currently staged but not yet released.
+uint32_t rec_writer_staging_fill(rec_writer_t *w);
+
+// Snapshot of counters (dropped is merged from the producer side).
+rec_stats_t rec_writer_stats(rec_writer_t *w);
+
+typedef struct
+{
+	rec_store_t *store;
+	rec_header_t hdr;
+	uint32_t first_seq; // oldest frame still readable
+} rec_reader_t;
+
+int rec_reader_open(rec_reader_t *r, rec_store_t *store);
+
+// Frames [first_seq, hdr.next_seq) are readable unless overwritten since open.
+static inline uint32_t rec_reader_count(const rec_reader_t *r)
+{
+	return r->hdr.next_seq - r->first_seq;
+}
+
+// Index lookup. False if the frame isn't (or is no longer) available.
+bool rec_reader_entry(const rec_reader_t *r, uint32_t seq, rec_entry_t *e);
+
+// First frame with t_us >= t (binary search over the index); hdr.next_seq if none.
+uint32_t rec_reader_seek_time(const rec_reader_t *r, int64_t t_us);
+
+// Reads the payload of frame `seq` into buf. Returns payload length, or -1 if unavailable or
+// `cap` is too small (e->len then tells the required size).
+int rec_reader_read(const rec_reader_t *r, uint32_t seq, uint8_t *buf, size_t cap, rec_entry_t *e);
+
+// "jpeg", "rawh", "cam", "ctrl" for the payload format in `flags`, "?" if unknown.
+const char *rec_fmt_name(uint32_t flags);
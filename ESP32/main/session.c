@@ -0,0 +1,84 @@
+#include "session.h"
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+	put_u16(p, (uint16_t)v);
+	put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+	return (uint32_t)get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+size_t session_camera_write(uint8_t *buf, size_t cap, const session_camera_t *cam)
+{
+	if (!buf || !cam || cap < SESSION_CAMERA_HDR_LEN)
+		return 0;
+	put_u32(buf, SESSION_CAMERA_MAGIC);
+	buf[4] = cam->pixformat;
+	buf[5] = 0;
+	put_u16(buf + 6, cam->width);
+	put_u16(buf + 8, cam->height);
+	put_u16(buf + 10, 0);
+	put_u32(buf + 12, (uint32_t)cam->sensor_us);
+	put_u32(buf + 16, (uint32_t)((uint64_t)cam->sensor_us >> 32));
+	return SESSION_CAMERA_HDR_LEN;
+}
+
+bool session_camera_parse(const uint8_t *buf, size_t len, session_camera_t *cam)
+{
+	if (!buf || !cam || len < SESSION_CAMERA_HDR_LEN || get_u32(buf) != SESSION_CAMERA_MAGIC)
+		return false;
+	cam->pixformat = buf[4];
+	cam->width = get_u16(buf + 6);
+	cam->height = get_u16(buf + 8);
+	cam->sensor_us = (int64_t)((uint64_t)get_u32(buf + 12) | ((uint64_t)get_u32(buf + 16) << 32));
+	if (cam->pixformat > SESSION_PIX_GRAY8 || cam->width == 0 || cam->height == 0)
+		return false;
+	// Raw frames may be short (a truncated last row band) but never longer than width x height.
+	const size_t bpp = session_pixfmt_bpp(cam->pixformat);
+	return bpp == 0 || len - SESSION_CAMERA_HDR_LEN <= (size_t)cam->width * cam->height * bpp;
+}
+
+size_t session_pixfmt_bpp(uint8_t pixformat)
+{
+	switch (pixformat)
+	{
+	case SESSION_PIX_RGB565:
+	case SESSION_PIX_YUV422:
+		return 2;
+	case SESSION_PIX_GRAY8:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+const char *session_pixfmt_name(uint8_t pixformat)
+{
+	switch (pixformat)
+	{
+	case SESSION_PIX_JPEG:
+		return "jpeg";
+	case SESSION_PIX_RGB565:
+		return "rgb565";
+	case SESSION_PIX_YUV422:
+		return "yuv422";
+	case SESSION_PIX_GRAY8:
+		return "gray8";
+	default:
+		return "?";
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+// Session capture records. Portable C (also built on the Linux host).
+//
+// A session is a recorder file (main/recorder.h) holding what the firmware received instead of what
+// it sent, so a drive can be fed through the host build of the pipeline again (host/rc_replay.c):
+// - REC_FMT_CAMERA: one sensor frame as camera_stream_task got it from the driver, before any
+//   scaling, vision or encoding. Payload = SESSION_CAMERA_HDR_LEN header + the frame buffer bytes.
+// - REC_FMT_CONTROL: an event seen by ws_root_handler. Flags bits 8..15 hold the client slot
+//   (0xFF if unknown), bits 16..23 the event: SESSION_CTRL_MSG carries one WS binary message,
+//   unparsed; SESSION_CTRL_OPEN marks a WS handshake on the slot (new client, new sequencing).
+// Entry timestamps are when the firmware saw the frame / message (esp_timer), taken under the
+// capture lock so they increase with the sequence number. The sensor timestamp of a frame is kept
+// in its header.
+//
+// Camera header (little-endian):
+//   0  u32  magic "SCAM"
+//   4  u8   pixel format (session_pixfmt_t)
+//   5  u8   reserved (0)
+//   6  u16  width
+//   8  u16  height
+//   10 u16  reserved (0)
+//   12 i64  sensor timestamp, us
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "recorder.h"
+
+#define SESSION_CAMERA_HDR_LEN 20u
+#define SESSION_CAMERA_MAGIC 0x4D414353u // "SCAM"
+
+typedef enum
+{
+	SESSION_PIX_JPEG = 0,
+	SESSION_PIX_RGB565 = 1, // big-endian, as the sensor delivers it
+	SESSION_PIX_YUV422 = 2, // YUYV
+	SESSION_PIX_GRAY8 = 3,
+} session_pixfmt_t;
+
+typedef struct
+{
+	uint8_t pixformat; // session_pixfmt_t
+	uint16_t width;
+	uint16_t height;
+	int64_t sensor_us;
+} session_camera_t;
+
+size_t session_camera_write(uint8_t *buf, size_t cap, const session_camera_t *cam);
+
+// Parses the header of a REC_FMT_CAMERA payload. False on a bad magic, format or geometry.
+bool session_camera_parse(const uint8_t *buf, size_t len, session_camera_t *cam);
+
+// Bytes per pixel of a raw format, 0 for JPEG.
+size_t session_pixfmt_bpp(uint8_t pixformat);
+const char *session_pixfmt_name(uint8_t pixformat);
+
+// REC_FMT_CONTROL events.
+#define SESSION_CTRL_MSG 0u  // payload: the WS binary message
+#define SESSION_CTRL_OPEN 1u // payload: u32 socket fd
+#define SESSION_SLOT_NONE 0xFF
+
+static inline uint32_t session_control_flags(int slot, uint8_t event)
+{
+	return REC_FMT_CONTROL | ((uint32_t)(slot & 0xFF) << 8) | ((uint32_t)event << 16);
+}
+
+static inline int session_control_slot(uint32_t flags)
+{
+	return (int)((flags >> 8) & 0xFF);
+}
+
+static inline uint8_t session_control_event(uint32_t flags)
+{
+	return (uint8_t)(flags >> 16);
+}
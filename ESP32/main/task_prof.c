@@ -0,0 +1,199 @@
+#include "task_prof.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void task_prof_init(task_prof_t *p, uint32_t stack_warn)
+{
+	memset(p, 0, sizeof(*p));
+	p->stack_warn = stack_warn;
+}
+
+static task_prof_task_t *find_slot(task_prof_t *p, uintptr_t id)
+{
+	task_prof_task_t *free_slot = NULL;
+	for (size_t i = 0; i < TASK_PROF_MAX_TASKS; i++)
+	{
+		if (p->tasks[i].id == id)
+			return &p->tasks[i];
+		if (!free_slot && p->tasks[i].id == 0)
+			free_slot = &p->tasks[i];
+	}
+	if (free_slot)
+	{
+		memset(free_slot, 0, sizeof(*free_slot));
+		free_slot->id = id;
+		free_slot->first = p->snapshots;
+	}
+	return free_slot;
+}
+
+size_t task_prof_add(task_prof_t *p, int64_t now_us, const task_prof_sample_t *samples, size_t count)
+{
+	const uint32_t snap = p->snapshots;
+	const size_t idx = snap % TASK_PROF_WINDOW;
+	size_t warnings = 0;
+
+	// Tasks missing from the snapshot have ended; free their slots before new tasks need them.
+	for (size_t i = 0; i < TASK_PROF_MAX_TASKS; i++)
+	{
+		bool seen = false;
+		for (size_t j = 0; j < count && !seen; j++)
+			seen = p->tasks[i].id == samples[j].id;
+		if (!seen)
+			p->tasks[i].id = 0;
+	}
+
+	p->t_us[idx] = now_us;
+	p->overflow = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		const task_prof_sample_t *s = &samples[i];
+		task_prof_task_t *t = (s->id != 0) ? find_slot(p, s->id) : NULL;
+		if (!t)
+		{
+			p->overflow++;
+			continue;
+		}
+		snprintf(t->name, sizeof(t->name), "%s", s->name ? s->name : "?");
+		t->core = s->core;
+		t->priority = s->priority;
+		t->idle = s->idle;
+		t->stack_free = s->stack_free;
+		t->runtime[idx] = s->runtime;
+		if (p->stack_warn > 0 && s->stack_free < p->stack_warn && !t->warned)
+		{
+			t->warned = true;
+			warnings++;
+		}
+	}
+	p->snapshots = snap + 1;
+	return warnings;
+}
+
+// CPU % between snapshot `from` and the newest one, or -1.
+static float task_cpu(const task_prof_t *p, const task_prof_task_t *t, uint32_t from)
+{
+	if (p->snapshots < 2)
+		return -1.0f;
+	const uint32_t newest = p->snapshots - 1;
+	if (from < t->first)
+		from = t->first;
+	if (from >= newest)
+		return -1.0f;
+	const size_t a = from % TASK_PROF_WINDOW;
+	const size_t b = newest % TASK_PROF_WINDOW;
+	const int64_t wall_us = p->t_us[b] - p->t_us[a];
+	if (wall_us <= 0)
+		return -1.0f;
+	const uint32_t ran = t->runtime[b] - t->runtime[a]; // modulo 2^32
+	const float pct = 100.0f * (float)ran / (float)wall_us;
+	return (pct > 100.0f) ? 100.0f : pct;
+}
+
+static uint32_t window_start(const task_prof_t *p)
+{
+	return (p->snapshots > TASK_PROF_WINDOW) ? p->snapshots - TASK_PROF_WINDOW : 0;
+}
+
+size_t task_prof_loads(const task_prof_t *p, task_prof_load_t *out, size_t cap)
+{
+	const uint32_t last = (p->snapshots >= 2) ? p->snapshots - 2 : 0;
+	size_t n = 0;
+	for (size_t i = 0; i < TASK_PROF_MAX_TASKS && n < cap; i++)
+	{
+		const task_prof_task_t *t = &p->tasks[i];
+		if (t->id == 0)
+			continue;
+		task_prof_load_t l = {t, task_cpu(p, t, last), task_cpu(p, t, window_start(p))};
+		// Insertion sort: a few dozen tasks.
+		size_t j = n++;
+		while (j > 0 && out[j - 1].cpu_window < l.cpu_window)
+		{
+			out[j] = out[j - 1];
+			j--;
+		}
+		out[j] = l;
+	}
+	return n;
+}
+
+float task_prof_core_load(const task_prof_t *p, int core, bool window)
+{
+	const uint32_t from = window ? window_start(p) : ((p->snapshots >= 2) ? p->snapshots - 2 : 0);
+	for (size_t i = 0; i < TASK_PROF_MAX_TASKS; i++)
+	{
+		const task_prof_task_t *t = &p->tasks[i];
+		if (t->id != 0 && t->idle && t->core == core)
+		{
+			const float idle = task_cpu(p, t, from);
+			return (idle < 0.0f) ? -1.0f : 100.0f - idle;
+		}
+	}
+	return -1.0f;
+}
+
+const task_prof_task_t *task_prof_low_stack(const task_prof_t *p, size_t *pos)
+{
+	for (; *pos < TASK_PROF_MAX_TASKS; (*pos)++)
+	{
+		const task_prof_task_t *t = &p->tasks[*pos];
+		if (t->id != 0 && t->stack_free < p->stack_warn)
+		{
+			(*pos)++;
+			return t;
+		}
+	}
+	return NULL;
+}
+
+size_t task_prof_json(char *buf, size_t len, const task_prof_t *p)
+{
+	int64_t period_us = 0, window_us = 0;
+	if (p->snapshots >= 2)
+	{
+		const int64_t newest_us = p->t_us[(p->snapshots - 1) % TASK_PROF_WINDOW];
+		period_us = newest_us - p->t_us[(p->snapshots - 2) % TASK_PROF_WINDOW];
+		window_us = newest_us - p->t_us[window_start(p) % TASK_PROF_WINDOW];
+	}
+	int n = snprintf(buf, len, "{\"period_ms\":%lld,\"window_ms\":%lld,\"overflow\":%lu,\"cores\":[",
+					 (long long)(period_us / 1000), (long long)(window_us / 1000), (unsigned long)p->overflow);
+	if (n < 0 || (size_t)n >= len)
+		return 0;
+	size_t off = (size_t)n;
+	const char *comma = "";
+	for (int core = 0; core < TASK_PROF_MAX_CORES; core++)
+	{
+		const float load = task_prof_core_load(p, core, false);
+		if (load < 0.0f)
+			continue;
+		n = snprintf(buf + off, len - off, "%s{\"core\":%d,\"load\":%.1f,\"load_window\":%.1f}", comma, core,
+					 (double)load, (double)task_prof_core_load(p, core, true));
+		if (n < 0 || (size_t)n >= len - off)
+			return 0;
+		off += (size_t)n;
+		comma = ",";
+	}
+
+	n = snprintf(buf + off, len - off, "],\"tasks\":[");
+	if (n < 0 || (size_t)n >= len - off)
+		return 0;
+	off += (size_t)n;
+	task_prof_load_t loads[TASK_PROF_MAX_TASKS];
+	const size_t count = task_prof_loads(p, loads, TASK_PROF_MAX_TASKS);
+	for (size_t i = 0; i < count; i++)
+	{
+		const task_prof_task_t *t = loads[i].task;
+		n = snprintf(buf + off, len - off,
+					 "%s{\"name\":\"%s\",\"core\":%d,\"prio\":%u,\"cpu\":%.1f,\"cpu_window\":%.1f,\"stack_free\":%lu}",
+					 (i > 0) ? "," : "", t->name, (int)t->core, (unsigned)t->priority, (double)loads[i].cpu,
+					 (double)loads[i].cpu_window, (unsigned long)t->stack_free);
+		if (n < 0 || (size_t)n >= len - off)
+			return 0;
+		off += (size_t)n;
+	}
+	n = snprintf(buf + off, len - off, "]}");
+	if (n < 0 || (size_t)n >= len - off)
+		return 0;
+	return off + (size_t)n;
+}
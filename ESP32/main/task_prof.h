@@ -0,0 +1,80 @@
+#pragma once
+
+// Sampling task profiler. Portable C (also built on the Linux host).
+//
+// Every period the firmware snapshots all tasks (FreeRTOS uxTaskGetSystemState: run-time counter,
+// stack high-water mark, core, priority) and feeds the snapshot here. The module keeps the last
+// TASK_PROF_WINDOW snapshots per task and derives:
+// - CPU % per task over the last period and over the whole window (run-time delta / wall time);
+// - load % per core: 100 minus the share of that core's idle task;
+// - the smallest stack headroom seen, with a one-time warning below `stack_warn` bytes.
+// Run-time counters are 32-bit and wrap; deltas are taken modulo 2^32, which is fine as long as a
+// period is shorter than the wrap time (~71 min at 1 MHz).
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TASK_PROF_MAX_TASKS 32
+#define TASK_PROF_WINDOW 11 // snapshots kept: the window covers WINDOW - 1 periods
+#define TASK_PROF_MAX_CORES 2
+#define TASK_PROF_NAME_LEN 16
+#define TASK_PROF_NO_CORE (-1)
+
+typedef struct
+{
+	uintptr_t id; // stable while the task lives (task handle)
+	const char *name;
+	int8_t core; // pinned core or TASK_PROF_NO_CORE
+	uint8_t priority;
+	bool idle; // the idle task of `core`
+	uint32_t runtime;
+	uint32_t stack_free; // bytes never used (high-water mark)
+} task_prof_sample_t;
+
+typedef struct
+{
+	uintptr_t id; // 0 = free slot
+	char name[TASK_PROF_NAME_LEN];
+	int8_t core;
+	uint8_t priority;
+	bool idle;
+	bool warned;
+	uint32_t stack_free;
+	uint32_t first; // snapshot number the task was first seen in
+	uint32_t runtime[TASK_PROF_WINDOW];
+} task_prof_task_t;
+
+typedef struct
+{
+	uint32_t stack_warn;
+	uint32_t snapshots;
+	uint32_t overflow; // tasks that didn't fit into the table (last snapshot)
+	int64_t t_us[TASK_PROF_WINDOW];
+	task_prof_task_t tasks[TASK_PROF_MAX_TASKS];
+} task_prof_t;
+
+typedef struct
+{
+	const task_prof_task_t *task;
+	float cpu;        // % of one core, last period (-1 = not enough data)
+	float cpu_window; // % of one core, over the window
+} task_prof_load_t;
+
+void task_prof_init(task_prof_t *p, uint32_t stack_warn);
+
+// Adds a snapshot taken at `now_us`. Tasks missing from it have ended and are dropped. Returns the
+// number of tasks whose stack headroom just fell below `stack_warn` (reported once per task; see
+// task_prof_low_stack).
+size_t task_prof_add(task_prof_t *p, int64_t now_us, const task_prof_sample_t *samples, size_t count);
+
+// Per-task loads, busiest (over the window) first. Returns the count.
+size_t task_prof_loads(const task_prof_t *p, task_prof_load_t *out, size_t cap);
+// Load of `core` in %, last period or window. -1 if the core's idle task hasn't been seen twice.
+float task_prof_core_load(const task_prof_t *p, int core, bool window);
+// Iterates tasks whose headroom is below `stack_warn`: pass *pos = 0, returns NULL when done.
+const task_prof_task_t *task_prof_low_stack(const task_prof_t *p, size_t *pos);
+
+// {"period_ms":..,"window_ms":..,"cores":[{"core":0,"load":..,"load_window":..}],"tasks":[...]}.
+// Returns bytes written, 0 if `len` is too small.
+size_t task_prof_json(char *buf, size_t len, const task_prof_t *p);
@@ -0,0 +1,192 @@
+#include "vision.h"
+
+#include <stdio.h>
+#include <string.h>
+
+_Static_assert(VISION_BANDS == 4, "vision_result_json prints exactly four bands");
+
+uint8_t vision_mean(const uint8_t *img, int w, int h, int step)
+{
+	if (!img || w <= 0 || h <= 0 || step <= 0)
+		return 0;
+
+	uint32_t sum = 0;
+	uint32_t n = 0;
+	for (int y = 0; y < h; y += step)
+	{
+		const uint8_t *row = img + (size_t)y * w;
+		for (int x = 0; x < w; x += step)
+			sum += row[x];
+		n += (uint32_t)((w + step - 1) / step);
+	}
+	return (uint8_t)(sum / n);
+}
+
+uint32_t vision_row_scan(const uint8_t *row, int w, int step, uint8_t threshold, bool dark_target, uint32_t *sum_x,
+						 uint16_t *min_x, uint16_t *max_x)
+{
+	// Flipping both sides turns "darker than" into "brighter than", so the loop has no polarity branch.
+	const uint8_t flip = dark_target ? 0xFF : 0x00;
+	const uint8_t t = threshold ^ flip;
+
+	uint32_t count = 0;
+	uint32_t sx = 0;
+	int first = -1;
+	int last = -1;
+	for (int x = 0; x < w; x += step)
+	{
+		if ((uint8_t)(row[x] ^ flip) > t)
+		{
+			count++;
+			sx += (uint32_t)x;
+			if (first < 0)
+				first = x;
+			last = x;
+		}
+	}
+
+	*sum_x = sx;
+	if (count > 0)
+	{
+		*min_x = (uint16_t)first;
+		*max_x = (uint16_t)last;
+	}
+	return count;
+}
+
+static int16_t scale_to_offset(int32_t delta2, int w)
+{
+	// delta2 is twice the pixel distance, so the frame edges map to +-VISION_OFFSET_MAX.
+	if (w <= 1)
+		return 0;
+	int32_t v = (delta2 * VISION_OFFSET_MAX) / (w - 1);
+	if (v > VISION_OFFSET_MAX)
+		v = VISION_OFFSET_MAX;
+	if (v < -VISION_OFFSET_MAX)
+		v = -VISION_OFFSET_MAX;
+	return (int16_t)v;
+}
+
+bool vision_analyze(const uint8_t *img, int w, int h, const vision_config_t *cfg, vision_result_t *out)
+{
+	if (!out)
+		return false;
+	memset(out, 0, sizeof(*out));
+	for (int b = 0; b < VISION_BANDS; b++)
+		out->band_x[b] = -1;
+	if (!img || !cfg || w <= 0 || h <= 0 || w > UINT16_MAX || h > UINT16_MAX || cfg->step < 1 || cfg->step > 8)
+		return false;
+
+	const int step = cfg->step;
+	out->width = (uint16_t)w;
+	out->height = (uint16_t)h;
+	out->mean = vision_mean(img, w, h, step * 2);
+
+	uint8_t thr = cfg->threshold;
+	if (thr == 0)
+		thr = cfg->dark_target ? (uint8_t)(out->mean - out->mean / 4) : (uint8_t)(out->mean + (255 - out->mean) / 4);
+	out->threshold = thr;
+
+	const int roi_pct = (cfg->roi_top_pct > 95) ? 95 : cfg->roi_top_pct;
+	const int roi_y0 = (h * roi_pct) / 100;
+	const int roi_h = h - roi_y0;
+
+	uint32_t band_sum[VISION_BANDS] = {0};
+	uint32_t band_cnt[VISION_BANDS] = {0};
+	uint16_t bx0 = UINT16_MAX, by0 = UINT16_MAX, bx1 = 0, by1 = 0;
+	uint32_t blob_pixels = 0;
+
+	for (int y = 0; y < h; y += step)
+	{
+		uint32_t sx = 0;
+		uint16_t mn = 0, mx = 0;
+		const uint32_t cnt = vision_row_scan(img + (size_t)y * w, w, step, thr, cfg->dark_target, &sx, &mn, &mx);
+		if (cnt == 0)
+			continue;
+
+		blob_pixels += cnt;
+		if (mn < bx0)
+			bx0 = mn;
+		if (mx > bx1)
+			bx1 = mx;
+		if (by0 == UINT16_MAX)
+			by0 = (uint16_t)y;
+		by1 = (uint16_t)y;
+
+		if (y >= roi_y0)
+		{
+			int band = ((h - 1 - y) * VISION_BANDS) / roi_h;
+			if (band >= VISION_BANDS)
+				band = VISION_BANDS - 1;
+			band_sum[band] += sx;
+			band_cnt[band] += cnt;
+		}
+	}
+
+	const uint32_t band_min = (cfg->min_pixels / VISION_BANDS) ? (cfg->min_pixels / VISION_BANDS) : 1;
+	int near_band = -1;
+	int far_band = -1;
+	for (int b = 0; b < VISION_BANDS; b++)
+	{
+		out->band_pixels[b] = (uint16_t)((band_cnt[b] > UINT16_MAX) ? UINT16_MAX : band_cnt[b]);
+		if (band_cnt[b] < band_min)
+			continue;
+		out->band_x[b] = (int16_t)(band_sum[b] / band_cnt[b]);
+		if (near_band < 0)
+			near_band = b;
+		far_band = b;
+	}
+
+	if (near_band >= 0)
+	{
+		const int near_x = out->band_x[near_band];
+		const int far_x = out->band_x[far_band];
+		out->line_found = true;
+		out->line_offset = scale_to_offset(2 * near_x - (w - 1), w);
+		out->line_heading = scale_to_offset(2 * (far_x - near_x), w);
+	}
+
+	if (blob_pixels >= cfg->min_pixels && blob_pixels > 0)
+	{
+		out->blob_found = true;
+		out->blob_x0 = bx0;
+		out->blob_y0 = by0;
+		out->blob_x1 = bx1;
+		out->blob_y1 = by1;
+		out->blob_pixels = blob_pixels;
+	}
+	return true;
+}
+
+int16_t vision_steer(const vision_result_t *r, int gain_pct)
+{
+	if (!r || !r->line_found)
+		return 0;
+
+	int32_t v = (int32_t)r->line_offset + (int32_t)r->line_heading / 2;
+	v = (v * gain_pct) / 100;
+	if (v > VISION_OFFSET_MAX)
+		v = VISION_OFFSET_MAX;
+	if (v < -VISION_OFFSET_MAX)
+		v = -VISION_OFFSET_MAX;
+	return (int16_t)v;
+}
+
+size_t vision_result_json(char *buf, size_t len, const vision_result_t *r, int64_t t_ms)
+{
+	if (!buf || len == 0 || !r)
+		return 0;
+
+	const int n = snprintf(buf, len,
+						   "{\"type\":\"vision\",\"t_ms\":%lld,\"w\":%u,\"h\":%u,\"mean\":%u,\"thr\":%u,"
+						   "\"line\":%s,\"offset\":%d,\"heading\":%d,\"bands\":[%d,%d,%d,%d],"
+						   "\"blob\":%s,\"bbox\":[%u,%u,%u,%u],\"blob_px\":%lu}",
+						   (long long)t_ms, (unsigned)r->width, (unsigned)r->height, (unsigned)r->mean,
+						   (unsigned)r->threshold, r->line_found ? "true" : "false", r->line_offset, r->line_heading,
+						   r->band_x[0], r->band_x[1], r->band_x[2], r->band_x[3], r->blob_found ? "true" : "false",
+						   (unsigned)r->blob_x0, (unsigned)r->blob_y0, (unsigned)r->blob_x1, (unsigned)r->blob_y1,
+						   (unsigned long)r->blob_pixels);
+	if (n < 0)
+		return 0;
+	return ((size_t)n < len) ? (size_t)n : len - 1;
+}
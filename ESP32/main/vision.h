@@ -0,0 +1,64 @@
+#pragma once
+
+// Lightweight line/blob tracking on GRAY8 frames. Portable C (also built on the Linux host).
+//
+// Everything is integer-only and subsampled: `step` = 2 reads a quarter of the pixels, which keeps a
+// 320x240 frame well inside the per-frame budget at stream rate. One threshold produces one mask;
+// the mask is summarized two ways:
+// - line: per-band centroids over the lower part of the frame (band 0 is nearest the car)
+// - blob: bounding box of all mask pixels in the frame
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define VISION_BANDS 4
+// Offsets/headings are scaled like control axes: -32767 (left edge) .. 32767 (right edge).
+#define VISION_OFFSET_MAX 32767
+
+typedef struct
+{
+	uint8_t threshold;   // 0 = automatic (derived from the frame mean)
+	bool dark_target;    // true: track pixels darker than threshold (black tape on a light floor)
+	uint8_t step;        // subsample step in pixels, both axes (1..8)
+	uint8_t roi_top_pct; // line search starts at this percentage of the frame height
+	uint16_t min_pixels; // sampled mask pixels below this count as "not found" (noise floor)
+} vision_config_t;
+
+#define VISION_CONFIG_DEFAULT {.threshold = 0, .dark_target = true, .step = 2, .roi_top_pct = 50, .min_pixels = 8}
+
+typedef struct
+{
+	uint16_t width;
+	uint16_t height;
+	uint8_t mean;
+	uint8_t threshold; // threshold actually used
+
+	int16_t band_x[VISION_BANDS]; // centroid column in pixels, -1 if the band is empty
+	uint16_t band_pixels[VISION_BANDS];
+	bool line_found;
+	int16_t line_offset;  // nearest non-empty band, relative to the frame center
+	int16_t line_heading; // farthest minus nearest non-empty band (positive: line bends right)
+
+	bool blob_found;
+	uint16_t blob_x0, blob_y0, blob_x1, blob_y1; // inclusive
+	uint32_t blob_pixels;                        // sampled mask pixels
+} vision_result_t;
+
+// Mean of every `step`-th pixel of every `step`-th row.
+uint8_t vision_mean(const uint8_t *img, int w, int h, int step);
+
+// Scans one row. Returns the number of mask pixels; sum of their x, min and max x are written
+// to the out pointers (min/max untouched when the count is 0).
+uint32_t vision_row_scan(const uint8_t *row, int w, int step, uint8_t threshold, bool dark_target, uint32_t *sum_x,
+						 uint16_t *min_x, uint16_t *max_x);
+
+// Full analysis. Returns false (and an all-zero result) on bad arguments.
+bool vision_analyze(const uint8_t *img, int w, int h, const vision_config_t *cfg, vision_result_t *out);
+
+// Proportional steering from a result: offset plus half the heading, scaled by gain_pct
+// (100 = full lock when the line is at the frame edge). Returns 0 when no line was found.
+int16_t vision_steer(const vision_result_t *r, int gain_pct);
+
+// Telemetry text frame: {"type":"vision",...}.
+size_t vision_result_json(char *buf, size_t len, const vision_result_t *r, int64_t t_ms);
@@ -0,0 +1,36 @@
+#include "web_assets.h"
+
+#include <string.h>
+
+const web_asset_t *web_asset_find(const char *path)
+{
+	const size_t len = strcspn(path, "?#");
+	for (size_t i = 0; i < web_asset_count; i++)
+	{
+		const web_asset_t *a = &web_assets[i];
+		if (strlen(a->path) == len && memcmp(a->path, path, len) == 0)
+			return a;
+	}
+	return NULL;
+}
+
+bool web_etag_match(const char *if_none_match, const char *etag)
+{
+	const size_t tag_len = strlen(etag);
+	const char *p = if_none_match;
+	while (*p)
+	{
+		while (*p == ' ' || *p == ',')
+			p++;
+		if (*p == '*')
+			return true;
+		// If-None-Match uses weak comparison: W/"x" matches "x".
+		if (p[0] == 'W' && p[1] == '/')
+			p += 2;
+		const size_t n = strcspn(p, ", ");
+		if (n == tag_len && memcmp(p, etag, n) == 0)
+			return true;
+		p += n;
+	}
+	return false;
+}
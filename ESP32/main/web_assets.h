@@ -0,0 +1,31 @@
+#pragma once
+
+// Web UI assets, gzip-compressed at build time by web/embed.py (the generated web_assets_data.c
+// defines the table). Portable C: served by the firmware's HTTP server and by rc_hostsim.
+//
+// Responses carry Content-Encoding: gzip, the asset's ETag and Cache-Control. Pages (*.html) are
+// "no-cache" and revalidate with If-None-Match (a 304 costs a few hundred bytes); other assets are
+// referenced with ?v=<etag> and cached without revalidation.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+	const char *path; // "/", "/setup.html", "/ui/app.js", ...
+	const char *mime;
+	const char *etag; // quoted, as sent
+	const char *cache_control;
+	const uint8_t *data; // gzip
+	size_t len;
+	size_t raw_len;
+} web_asset_t;
+
+extern const web_asset_t web_assets[];
+extern const size_t web_asset_count;
+
+// Looks up a request path; a query string ("?v=...") is ignored. NULL if there is no such asset.
+const web_asset_t *web_asset_find(const char *path);
+// True if an If-None-Match header value (a list of tags, possibly weak, or "*") matches `etag`.
+bool web_etag_match(const char *if_none_match, const char *etag);
@@ -0,0 +1,251 @@
+#include "wifi_link.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+
+#include "rc_config.h"
+
+static const char *TAG = "wifi_link";
+
+typedef struct
+{
+	const char *name;
+	wifi_ps_type_t ps;
+	int8_t max_tx_power; // 0.25 dBm units, 8..84
+	uint8_t protocol;	 // WIFI_PROTOCOL_* mask
+	wifi_bandwidth_t bandwidth;
+	bool ampdu_tx;
+	bool ampdu_rx;
+	uint8_t rx_ba_win;
+} wifi_link_profile_cfg_t;
+
+static const wifi_link_profile_cfg_t profiles[WIFI_LINK_PROFILE_COUNT] = {
+	// No modem sleep (no DTIM wake-up delay on downlink), full power, no 11b fallback rates,
+	// HT20 for robustness, no TX aggregation delay.
+	[WIFI_LINK_PROFILE_LOW_LATENCY] = {
+		.name = "low-latency",
+		.ps = WIFI_PS_NONE,
+		.max_tx_power = 80,
+		.protocol = WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N,
+		.bandwidth = WIFI_BW_HT20,
+		.ampdu_tx = false,
+		.ampdu_rx = true,
+		.rx_ba_win = 6,
+	},
+	// IDF defaults (the default profile): what builds without profiles ran.
+	[WIFI_LINK_PROFILE_BALANCED] = {
+		.name = "balanced",
+		.ps = WIFI_PS_MIN_MODEM,
+		.max_tx_power = 80,
+		.protocol = WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N,
+		.bandwidth = WIFI_BW_HT20,
+		.ampdu_tx = true,
+		.ampdu_rx = true,
+		.rx_ba_win = 6,
+	},
+	[WIFI_LINK_PROFILE_BATTERY] = {
+		.name = "battery",
+		.ps = WIFI_PS_MAX_MODEM,
+		.max_tx_power = 44,
+		.protocol = WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N,
+		.bandwidth = WIFI_BW_HT20,
+		.ampdu_tx = true,
+		.ampdu_rx = true,
+		.rx_ba_win = 6,
+	},
+};
+
+static wifi_link_profile_t current_profile = WIFI_LINK_PROFILE_COUNT;
+static volatile uint32_t sta_retries = 0;
+static volatile uint32_t tx_fails = 0;
+
+const char *wifi_link_profile_name(wifi_link_profile_t profile)
+{
+	if ((unsigned)profile >= WIFI_LINK_PROFILE_COUNT)
+		return "unknown";
+	return profiles[profile].name;
+}
+
+bool wifi_link_profile_from_name(const char *name, wifi_link_profile_t *out)
+{
+	if (!name || !out)
+		return false;
+	for (int i = 0; i < WIFI_LINK_PROFILE_COUNT; i++)
+	{
+		if (strcmp(name, profiles[i].name) == 0)
+		{
+			*out = (wifi_link_profile_t)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+void wifi_link_load(void)
+{
+	wifi_link_profile_t profile = WIFI_LINK_PROFILE_COUNT;
+
+	nvs_handle_t nvs = 0;
+	if (nvs_open("wifi", NVS_READONLY, &nvs) == ESP_OK)
+	{
+		uint8_t stored = 0;
+		if (nvs_get_u8(nvs, "link_profile", &stored) == ESP_OK && stored < WIFI_LINK_PROFILE_COUNT)
+			profile = (wifi_link_profile_t)stored;
+		nvs_close(nvs);
+	}
+
+	if (profile == WIFI_LINK_PROFILE_COUNT &&
+		!wifi_link_profile_from_name(WIFI_LINK_PROFILE, &profile))
+	{
+		ESP_LOGW(TAG, "Unknown WIFI_LINK_PROFILE '%s', using balanced", WIFI_LINK_PROFILE);
+		profile = WIFI_LINK_PROFILE_BALANCED;
+	}
+	current_profile = profile;
+}
+
+static const wifi_link_profile_cfg_t *current_cfg(void)
+{
+	if (current_profile == WIFI_LINK_PROFILE_COUNT)
+		wifi_link_load();
+	return &profiles[current_profile];
+}
+
+void wifi_link_patch_init_config(wifi_init_config_t *cfg)
+{
+	if (!cfg)
+		return;
+	const wifi_link_profile_cfg_t *p = current_cfg();
+	cfg->ampdu_tx_enable = p->ampdu_tx;
+	cfg->ampdu_rx_enable = p->ampdu_rx;
+	cfg->rx_ba_win = p->rx_ba_win;
+}
+
+static esp_err_t apply_to_interface(wifi_interface_t ifx, const wifi_link_profile_cfg_t *p)
+{
+	esp_err_t err = esp_wifi_set_protocol(ifx, p->protocol);
+	if (err == ESP_OK)
+		err = esp_wifi_set_bandwidth(ifx, p->bandwidth);
+	return err;
+}
+
+esp_err_t wifi_link_apply(wifi_link_profile_t profile, bool persist)
+{
+	if ((unsigned)profile >= WIFI_LINK_PROFILE_COUNT)
+		return ESP_ERR_INVALID_ARG;
+
+	const wifi_link_profile_cfg_t *p = &profiles[profile];
+	wifi_mode_t mode = WIFI_MODE_NULL;
+	esp_err_t err = esp_wifi_get_mode(&mode);
+	if (err != ESP_OK)
+		return err;
+
+	if (mode == WIFI_MODE_STA || mode == WIFI_MODE_APSTA)
+		err = apply_to_interface(WIFI_IF_STA, p);
+	if (err == ESP_OK && (mode == WIFI_MODE_AP || mode == WIFI_MODE_APSTA))
+		err = apply_to_interface(WIFI_IF_AP, p);
+	// Modem sleep is not allowed while the SoftAP is up; the driver rejects it in AP/APSTA mode.
+	if (err == ESP_OK && mode == WIFI_MODE_STA)
+		err = esp_wifi_set_ps(p->ps);
+	if (err == ESP_OK)
+		err = esp_wifi_set_max_tx_power(p->max_tx_power);
+	if (err != ESP_OK)
+	{
+		ESP_LOGW(TAG, "Applying link profile '%s' failed: %s", p->name, esp_err_to_name(err));
+		return err;
+	}
+
+	const bool ampdu_changed = (current_profile != WIFI_LINK_PROFILE_COUNT) &&
+							   (profiles[current_profile].ampdu_tx != p->ampdu_tx ||
+								profiles[current_profile].ampdu_rx != p->ampdu_rx ||
+								profiles[current_profile].rx_ba_win != p->rx_ba_win);
+	current_profile = profile;
+	ESP_LOGI(TAG, "Link profile '%s' applied%s", p->name,
+			 ampdu_changed ? " (AMPDU settings apply after reboot)" : "");
+
+	if (persist)
+	{
+		nvs_handle_t nvs = 0;
+		err = nvs_open("wifi", NVS_READWRITE, &nvs);
+		if (err == ESP_OK)
+		{
+			err = nvs_set_u8(nvs, "link_profile", (uint8_t)profile);
+			if (err == ESP_OK)
+				err = nvs_commit(nvs);
+			nvs_close(nvs);
+		}
+	}
+	return err;
+}
+
+void wifi_link_reapply(void)
+{
+	(void)wifi_link_apply(wifi_link_current(), false);
+}
+
+wifi_link_profile_t wifi_link_current(void)
+{
+	(void)current_cfg();
+	return current_profile;
+}
+
+void wifi_link_note_sta_retry(void)
+{
+	sta_retries++;
+}
+
+void wifi_link_note_tx_fail(void)
+{
+	tx_fails++;
+}
+
+static const char *phy_mode_name(const wifi_ap_record_t *ap)
+{
+	if (ap->phy_11n)
+		return (ap->second != 0) ? "11n-ht40" : "11n";
+	if (ap->phy_11g)
+		return "11g";
+	if (ap->phy_11b)
+		return "11b";
+	return "unknown";
+}
+
+size_t wifi_link_telemetry_json(char *buf, size_t len, const char *recovery_json)
+{
+	if (!buf || len == 0)
+		return 0;
+
+	wifi_mode_t mode = WIFI_MODE_NULL;
+	(void)esp_wifi_get_mode(&mode);
+	int8_t tx_power = 0;
+	(void)esp_wifi_get_max_tx_power(&tx_power);
+	wifi_ps_type_t ps = WIFI_PS_NONE;
+	(void)esp_wifi_get_ps(&ps);
+
+	size_t off = 0;
+	off += snprintf(buf + off, len - off,
+					"{\"type\":\"link\",\"t_ms\":%lld,\"profile\":\"%s\",\"mode\":\"%s\",\"ps\":%d,"
+					"\"tx_power_qdbm\":%d,\"sta_retries\":%u,\"tx_fails\":%u",
+					(long long)(esp_timer_get_time() / 1000), wifi_link_profile_name(wifi_link_current()),
+					(mode == WIFI_MODE_STA)	   ? "sta"
+					: (mode == WIFI_MODE_AP)   ? "ap"
+					: (mode == WIFI_MODE_APSTA) ? "apsta"
+												: "off",
+					(int)ps, (int)tx_power, (unsigned)sta_retries, (unsigned)tx_fails);
+
+	wifi_ap_record_t ap = {0};
+	if (off < len && (mode == WIFI_MODE_STA || mode == WIFI_MODE_APSTA) &&
+		esp_wifi_sta_get_ap_info(&ap) == ESP_OK)
+	{
+		off += snprintf(buf + off, len - off, ",\"rssi\":%d,\"channel\":%u,\"phy\":\"%s\"", (int)ap.rssi,
+						(unsigned)ap.primary, phy_mode_name(&ap));
+	}
+	if (off < len && recovery_json)
+		off += snprintf(buf + off, len - off, ",\"recovery\":%s", recovery_json);
+	if (off < len)
+		off += snprintf(buf + off, len - off, "}");
+	return (off < len) ? off : len - 1;
+}
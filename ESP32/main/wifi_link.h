@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_wifi.h"
+
+// Named radio profiles. Power save, TX power, protocol mask and bandwidth are applied at runtime;
+// AMPDU/BA-window settings only take effect at the next esp_wifi_init() (i.e. after a reboot).
+typedef enum
+{
+	WIFI_LINK_PROFILE_LOW_LATENCY = 0,
+	WIFI_LINK_PROFILE_BALANCED,
+	WIFI_LINK_PROFILE_BATTERY,
+	WIFI_LINK_PROFILE_COUNT,
+} wifi_link_profile_t;
+
+const char *wifi_link_profile_name(wifi_link_profile_t profile);
+bool wifi_link_profile_from_name(const char *name, wifi_link_profile_t *out);
+
+// Loads the persisted profile from NVS (falls back to WIFI_LINK_PROFILE). Call after nvs_flash_init().
+void wifi_link_load(void);
+
+// Patches AMPDU settings of the active profile into the config passed to esp_wifi_init().
+void wifi_link_patch_init_config(wifi_init_config_t *cfg);
+
+// Applies the profile to the running driver (call after esp_wifi_start()). With `persist`, the
+// choice is stored in NVS so the next boot starts with it (including AMPDU settings).
+esp_err_t wifi_link_apply(wifi_link_profile_t profile, bool persist);
+
+// Re-applies the current profile, e.g. after a mode switch restarted the driver.
+void wifi_link_reapply(void);
+
+wifi_link_profile_t wifi_link_current(void);
+
+// Counters for link telemetry.
+void wifi_link_note_sta_retry(void);
+void wifi_link_note_tx_fail(void);
+
+// Samples the link (RSSI, PHY mode, channel, counters) and writes a JSON object; `recovery_json`
+// (optional) is embedded as "recovery".
+size_t wifi_link_telemetry_json(char *buf, size_t len, const char *recovery_json);
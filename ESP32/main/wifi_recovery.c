@@ -0,0 +1,262 @@
+#include "wifi_recovery.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static uint32_t ms_since(int64_t since_us, int64_t now_us)
+{
+	const int64_t ms = (now_us - since_us) / 1000;
+	return (ms < 0) ? 0 : (ms > UINT32_MAX) ? UINT32_MAX : (uint32_t)ms;
+}
+
+static void start_attempt(wifi_rec_t *r, bool fast, int64_t now_us)
+{
+	r->attempt_pending = true;
+	r->attempt_fast = fast;
+	r->deadline_us = now_us + r->cfg.attempt_timeout_us;
+	r->tries++;
+	r->stats.attempts++;
+}
+
+// The pending attempt failed (disconnect event or timeout): schedule the next one.
+static void attempt_failed(wifi_rec_t *r, int64_t now_us)
+{
+	r->attempt_pending = false;
+	switch (r->state)
+	{
+	case WIFI_REC_BOOT:
+		r->next_us = now_us;
+		break;
+	case WIFI_REC_FAST:
+		if (r->tries < r->cfg.fast_attempts)
+		{
+			r->next_us = now_us;
+			break;
+		}
+		r->state = WIFI_REC_BACKOFF;
+		r->tries = 0;
+		r->backoff_us = r->cfg.backoff_min_us;
+		// fall through
+	case WIFI_REC_BACKOFF:
+	{
+		r->next_us = now_us + r->backoff_us;
+		const uint64_t next = (uint64_t)r->backoff_us * 2;
+		r->backoff_us = (next > r->cfg.backoff_max_us) ? r->cfg.backoff_max_us : (uint32_t)next;
+		break;
+	}
+	case WIFI_REC_SOFTAP:
+		r->next_us = now_us + r->cfg.softap_retry_us;
+		break;
+	default:
+		break;
+	}
+}
+
+void wifi_rec_init(wifi_rec_t *r, const wifi_rec_config_t *cfg)
+{
+	memset(r, 0, sizeof(*r));
+	r->cfg = *cfg;
+	if (r->cfg.boot_attempts == 0)
+		r->cfg.boot_attempts = 1;
+	if (r->cfg.backoff_max_us < r->cfg.backoff_min_us)
+		r->cfg.backoff_max_us = r->cfg.backoff_min_us;
+	r->state = WIFI_REC_IDLE;
+	r->link_up = true;
+	r->backoff_us = r->cfg.backoff_min_us;
+}
+
+void wifi_rec_begin(wifi_rec_t *r, int64_t now_us)
+{
+	r->state = WIFI_REC_BOOT;
+	r->tries = 0;
+	r->softap = false;
+	r->down_since_us = now_us;
+	start_attempt(r, false, now_us);
+}
+
+void wifi_rec_idle(wifi_rec_t *r)
+{
+	r->state = WIFI_REC_IDLE;
+	r->link_up = true;
+	r->softap = false;
+	r->attempt_pending = false;
+}
+
+void wifi_rec_connected(wifi_rec_t *r, uint8_t channel, const uint8_t bssid[6])
+{
+	r->have_ap = channel != 0;
+	r->channel = channel;
+	memcpy(r->bssid, bssid, sizeof(r->bssid));
+}
+
+void wifi_rec_got_ip(wifi_rec_t *r, int64_t now_us)
+{
+	if (r->state == WIFI_REC_IDLE)
+		return;
+	if (r->state != WIFI_REC_BOOT && r->state != WIFI_REC_CONNECTED)
+	{
+		wifi_rec_stats_t *st = &r->stats;
+		const uint32_t ms = ms_since(r->down_since_us, now_us);
+		st->outage_ms_last = ms;
+		if (ms > st->outage_ms_max)
+			st->outage_ms_max = ms;
+		st->outage_ms_total += ms;
+		if (r->state == WIFI_REC_FAST)
+			st->fast_recoveries++;
+		else
+			st->scan_recoveries++;
+	}
+	r->state = WIFI_REC_CONNECTED;
+	r->link_up = true;
+	r->attempt_pending = false;
+	r->tries = 0;
+	r->backoff_us = r->cfg.backoff_min_us;
+	r->next_us = now_us; // takes the fallback AP down, if it runs
+}
+
+void wifi_rec_disconnected(wifi_rec_t *r, uint16_t reason, int64_t now_us)
+{
+	r->last_reason = reason;
+	switch (r->state)
+	{
+	case WIFI_REC_IDLE:
+		break;
+	case WIFI_REC_CONNECTED:
+		r->stats.outages++;
+		r->down_since_us = now_us;
+		r->link_up = r->softap;
+		r->attempt_pending = false;
+		r->tries = 0;
+		r->backoff_us = r->cfg.backoff_min_us;
+		r->state = (r->have_ap && r->cfg.fast_attempts > 0) ? WIFI_REC_FAST : WIFI_REC_BACKOFF;
+		r->next_us = now_us;
+		break;
+	default:
+		if (r->attempt_pending)
+			attempt_failed(r, now_us);
+		break;
+	}
+}
+
+static int64_t next_deadline(const wifi_rec_t *r)
+{
+	switch (r->state)
+	{
+	case WIFI_REC_IDLE:
+		return INT64_MAX;
+	case WIFI_REC_CONNECTED:
+		return r->softap ? r->next_us : INT64_MAX;
+	default:
+		break;
+	}
+	int64_t t = r->attempt_pending ? r->deadline_us : r->next_us;
+	if (r->state == WIFI_REC_BACKOFF && !r->softap && r->cfg.softap_after_us > 0)
+	{
+		const int64_t softap_at = r->down_since_us + r->cfg.softap_after_us;
+		if (softap_at < t)
+			t = softap_at;
+	}
+	return t;
+}
+
+static wifi_rec_action_t poll_state(wifi_rec_t *r, int64_t now_us)
+{
+	if (r->attempt_pending && now_us >= r->deadline_us)
+	{
+		r->stats.attempt_timeouts++;
+		attempt_failed(r, now_us);
+	}
+
+	switch (r->state)
+	{
+	case WIFI_REC_IDLE:
+		return WIFI_REC_NONE;
+	case WIFI_REC_CONNECTED:
+		if (!r->softap || now_us < r->next_us)
+			return WIFI_REC_NONE;
+		r->next_us = now_us + r->cfg.softap_retry_us; // until wifi_rec_softap_stopped()
+		return WIFI_REC_STOP_SOFTAP;
+	case WIFI_REC_BACKOFF:
+		if (r->softap)
+		{
+			r->state = WIFI_REC_SOFTAP; // the fallback AP from the last outage still runs
+			break;
+		}
+		if (r->cfg.softap_after_us > 0 && now_us - r->down_since_us >= (int64_t)r->cfg.softap_after_us)
+		{
+			// The mode switch aborts a pending connect; the STA retries continue from the AP+STA mode.
+			r->state = WIFI_REC_SOFTAP;
+			r->softap = true;
+			r->link_up = true;
+			r->attempt_pending = false;
+			r->next_us = now_us + r->cfg.softap_retry_us;
+			r->stats.softap_fallbacks++;
+			return WIFI_REC_START_SOFTAP;
+		}
+		break;
+	default:
+		break;
+	}
+
+	if (r->attempt_pending || now_us < r->next_us)
+		return WIFI_REC_NONE;
+	if (r->state == WIFI_REC_BOOT && r->tries >= r->cfg.boot_attempts)
+	{
+		wifi_rec_idle(r);
+		return WIFI_REC_BOOT_FAILED;
+	}
+	const bool fast = (r->state == WIFI_REC_FAST);
+	start_attempt(r, fast, now_us);
+	return fast ? WIFI_REC_CONNECT_FAST : WIFI_REC_CONNECT_SCAN;
+}
+
+wifi_rec_action_t wifi_rec_poll(wifi_rec_t *r, int64_t now_us, uint32_t *wait_us)
+{
+	const wifi_rec_action_t action = poll_state(r, now_us);
+	if (wait_us)
+	{
+		const int64_t t = next_deadline(r);
+		const int64_t wait = (t == INT64_MAX) ? UINT32_MAX : t - now_us;
+		*wait_us = (wait < 0) ? 0 : (wait > UINT32_MAX) ? UINT32_MAX : (uint32_t)wait;
+	}
+	return action;
+}
+
+void wifi_rec_softap_stopped(wifi_rec_t *r, bool stopped, int64_t now_us)
+{
+	if (stopped)
+		r->softap = false;
+	else
+		r->next_us = now_us + r->cfg.softap_retry_us;
+}
+
+const char *wifi_rec_state_name(wifi_rec_state_t state)
+{
+	switch (state)
+	{
+	case WIFI_REC_IDLE: return "idle";
+	case WIFI_REC_BOOT: return "boot";
+	case WIFI_REC_CONNECTED: return "connected";
+	case WIFI_REC_FAST: return "fast_reconnect";
+	case WIFI_REC_BACKOFF: return "backoff";
+	case WIFI_REC_SOFTAP: return "softap";
+	}
+	return "unknown";
+}
+
+size_t wifi_rec_json(char *buf, size_t len, const wifi_rec_t *r, int64_t now_us)
+{
+	const wifi_rec_stats_t *st = &r->stats;
+	const bool down = r->state == WIFI_REC_FAST || r->state == WIFI_REC_BACKOFF || r->state == WIFI_REC_SOFTAP;
+	const int n = snprintf(buf, len,
+						   "{\"state\":\"%s\",\"link_up\":%s,\"softap\":%s,\"outage_ms\":%u,\"outages\":%u,"
+						   "\"outage_ms_last\":%u,\"outage_ms_max\":%u,\"outage_ms_total\":%llu,\"fast\":%u,"
+						   "\"scan\":%u,\"softap_fallbacks\":%u,\"attempts\":%u,\"timeouts\":%u,\"reason\":%u}",
+						   wifi_rec_state_name(r->state), r->link_up ? "true" : "false",
+						   r->softap ? "true" : "false", (unsigned)(down ? ms_since(r->down_since_us, now_us) : 0),
+						   (unsigned)st->outages, (unsigned)st->outage_ms_last, (unsigned)st->outage_ms_max,
+						   (unsigned long long)st->outage_ms_total, (unsigned)st->fast_recoveries,
+						   (unsigned)st->scan_recoveries, (unsigned)st->softap_fallbacks, (unsigned)st->attempts,
+						   (unsigned)st->attempt_timeouts, (unsigned)r->last_reason);
+	return (n > 0 && (size_t)n < len) ? (size_t)n : 0;
+}
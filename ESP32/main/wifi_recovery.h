@@ -0,0 +1,116 @@
+#pragma once
+
+// STA link recovery. Portable C (also built on the Linux host).
+//
+// The Wi-Fi event handler feeds events in, a task polls for the next action and runs the driver
+// calls (esp_wifi_connect etc.); nothing here touches the driver. After a connected STA drops:
+// 1. fast reconnect: up to fast_attempts connects pinned to the last channel and BSSID (no scan,
+//    typically back within a few hundred ms if the AP is still there)
+// 2. backoff: full-scan connects (the AP may have moved channel, or another AP of the same SSID
+//    answers), backoff_min_us doubling to backoff_max_us between attempts
+// 3. SoftAP fallback: once the outage reaches softap_after_us the AP is brought up next to the STA
+//    so the car can be reached directly; the STA keeps trying every softap_retry_us, and once it is
+//    back the fallback AP is taken down again (when no station uses it)
+// An attempt that gets neither an IP nor a disconnect within attempt_timeout_us counts as failed.
+// `link_up` is false from the drop until the STA has an IP again or the fallback AP runs; the caller
+// zeroes the motors and idles the camera on the falling edge.
+//
+// At boot the same machine retries the first connect (boot_attempts, full scan) and then reports
+// WIFI_REC_BOOT_FAILED; provisioning takes over (wifi_rec_idle()).
+//
+// Not thread-safe; main.c serializes access with a spinlock (all calls are O(1)).
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+	uint32_t boot_attempts;      // connects at boot before giving up
+	uint32_t fast_attempts;      // pinned reconnects after a drop (0 = scan right away)
+	uint32_t attempt_timeout_us; // no result within this: the attempt failed
+	uint32_t backoff_min_us;
+	uint32_t backoff_max_us;
+	uint32_t softap_after_us;    // outage before the fallback AP (0 = never)
+	uint32_t softap_retry_us;    // STA retry period while the fallback AP runs
+} wifi_rec_config_t;
+
+typedef enum
+{
+	WIFI_REC_IDLE = 0,  // not managing the STA (AP / provisioning mode)
+	WIFI_REC_BOOT,      // first connect
+	WIFI_REC_CONNECTED, // STA has an IP
+	WIFI_REC_FAST,      // reconnecting to the last channel/BSSID
+	WIFI_REC_BACKOFF,   // full-scan reconnects with backoff
+	WIFI_REC_SOFTAP,    // fallback AP up, STA retried slowly
+} wifi_rec_state_t;
+
+typedef enum
+{
+	WIFI_REC_NONE = 0,
+	WIFI_REC_CONNECT_FAST, // connect pinned to `channel` / `bssid`
+	WIFI_REC_CONNECT_SCAN, // connect with a full scan
+	WIFI_REC_START_SOFTAP, // switch to AP+STA (then report nothing; the STA retries continue)
+	WIFI_REC_STOP_SOFTAP,  // back to STA only; report wifi_rec_softap_stopped()
+	WIFI_REC_BOOT_FAILED,  // boot connect gave up
+} wifi_rec_action_t;
+
+typedef struct
+{
+	uint32_t attempts;        // connect attempts, boot included
+	uint32_t attempt_timeouts;
+	uint32_t outages;
+	uint32_t fast_recoveries; // back on the pinned channel/BSSID
+	uint32_t scan_recoveries; // back after a full scan
+	uint32_t softap_fallbacks;
+	uint32_t outage_ms_last;
+	uint32_t outage_ms_max;
+	uint64_t outage_ms_total;
+} wifi_rec_stats_t;
+
+typedef struct
+{
+	wifi_rec_config_t cfg;
+	wifi_rec_state_t state;
+	bool link_up;
+	bool softap;           // fallback AP running
+	bool attempt_pending;  // connect issued, no result yet
+	bool attempt_fast;
+	bool have_ap;          // channel/bssid are valid
+	uint8_t channel;
+	uint8_t bssid[6];
+	uint32_t tries;        // attempts in the current phase
+	uint32_t backoff_us;
+	int64_t next_us;       // next attempt (or softap stop check)
+	int64_t deadline_us;   // pending attempt times out
+	int64_t down_since_us; // outage start
+	uint16_t last_reason;  // last disconnect reason
+	wifi_rec_stats_t stats;
+} wifi_rec_t;
+
+void wifi_rec_init(wifi_rec_t *r, const wifi_rec_config_t *cfg);
+
+// The first STA connect was issued (boot).
+void wifi_rec_begin(wifi_rec_t *r, int64_t now_us);
+
+// Stop managing the STA (AP-only or provisioning mode). The link counts as up (the AP is).
+void wifi_rec_idle(wifi_rec_t *r);
+
+// STA associated with `bssid` on `channel` (remembered for fast reconnects).
+void wifi_rec_connected(wifi_rec_t *r, uint8_t channel, const uint8_t bssid[6]);
+
+void wifi_rec_got_ip(wifi_rec_t *r, int64_t now_us);
+
+// STA disconnected, or a connect attempt failed.
+void wifi_rec_disconnected(wifi_rec_t *r, uint16_t reason, int64_t now_us);
+
+// Next action, if any. `wait_us` gets the time until the next deadline (UINT32_MAX if none).
+wifi_rec_action_t wifi_rec_poll(wifi_rec_t *r, int64_t now_us, uint32_t *wait_us);
+
+// Result of WIFI_REC_STOP_SOFTAP: `stopped` false (stations still use the AP) retries later.
+void wifi_rec_softap_stopped(wifi_rec_t *r, bool stopped, int64_t now_us);
+
+const char *wifi_rec_state_name(wifi_rec_state_t state);
+
+// {"state":..,"link_up":..,"outages":..,"outage_ms_last":..,...}. Returns bytes written, 0 if it didn't fit.
+size_t wifi_rec_json(char *buf, size_t len, const wifi_rec_t *r, int64_t now_us);
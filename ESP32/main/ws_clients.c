@@ -0,0 +1,230 @@
+#include "ws_clients.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "rc_config.h"
+
+_Static_assert(RC_WS_MAX_CLIENTS >= 1 && RC_WS_MAX_CLIENTS <= 32, "slot masks are 32-bit");
+
+static const char *TAG = "ws_clients";
+
+static ws_client_t slots[RC_WS_MAX_CLIENTS];
+static uint32_t open_mask; // httpd task only
+static int next_slot;      // round-robin allocation cursor, httpd task only
+static _Atomic uint32_t topic_masks[WS_TOPIC_COUNT];
+static _Atomic uint32_t ws_max = RC_WS_MAX_CLIENTS;
+
+static EventGroupHandle_t demand_group;
+static EventBits_t demand_video_bit;
+
+static void update_demand(void)
+{
+	if (!demand_group || !demand_video_bit)
+		return;
+	if (atomic_load_explicit(&topic_masks[WS_TOPIC_VIDEO], memory_order_relaxed))
+		xEventGroupSetBits(demand_group, demand_video_bit);
+	else
+		xEventGroupClearBits(demand_group, demand_video_bit);
+}
+
+static uint32_t ws_mask(void)
+{
+	uint32_t mask = 0;
+	for (uint32_t m = open_mask; m;)
+	{
+		const int i = ws_clients_next(&m);
+		if (slots[i].is_ws)
+			mask |= 1u << i;
+	}
+	return mask;
+}
+
+static int slot_index(int fd)
+{
+	for (uint32_t m = open_mask; m;)
+	{
+		const int i = ws_clients_next(&m);
+		if (slots[i].fd == fd)
+			return i;
+	}
+	return -1;
+}
+
+void ws_clients_init(EventGroupHandle_t group, EventBits_t video_bit)
+{
+	memset(slots, 0, sizeof(slots));
+	open_mask = 0;
+	next_slot = 0;
+	for (int t = 0; t < WS_TOPIC_COUNT; t++)
+		atomic_store(&topic_masks[t], 0);
+	demand_group = group;
+	demand_video_bit = video_bit;
+	update_demand();
+}
+
+esp_err_t ws_clients_on_open(int fd)
+{
+	for (int n = 0; n < RC_WS_MAX_CLIENTS; n++)
+	{
+		const int i = (next_slot + n) % RC_WS_MAX_CLIENTS;
+		if (open_mask & (1u << i))
+			continue;
+
+		ws_client_t *c = &slots[i];
+		memset(c, 0, sizeof(*c));
+		c->fd = fd;
+		c->opened_us = esp_timer_get_time();
+		open_mask |= 1u << i;
+		next_slot = (i + 1) % RC_WS_MAX_CLIENTS;
+		return ESP_OK;
+	}
+	ESP_LOGW(TAG, "no free slot for fd=%d", fd);
+	return ESP_ERR_NO_MEM;
+}
+
+void ws_clients_on_close(int fd)
+{
+	const int i = slot_index(fd);
+	if (i < 0)
+		return;
+
+	ws_client_t *c = &slots[i];
+	if (c->is_ws)
+	{
+		ESP_LOGI(TAG, "fd=%d closed (tx=%" PRIu32 " fail=%" PRIu32 " rx=%" PRIu32 ")", fd,
+				 atomic_load(&c->tx_msgs), atomic_load(&c->tx_fail), c->rx_msgs);
+	}
+	ws_clients_set_topics(c, 0);
+	open_mask &= ~(1u << i);
+}
+
+ws_client_t *ws_clients_on_handshake(int fd)
+{
+	const int i = slot_index(fd);
+	if (i < 0)
+		return NULL;
+
+	const uint32_t max = atomic_load(&ws_max);
+	if ((uint32_t)__builtin_popcount(ws_mask()) >= max)
+	{
+		ESP_LOGW(TAG, "fd=%d refused, WS client cap %" PRIu32 " reached", fd, max);
+		return NULL;
+	}
+
+	ws_client_t *c = &slots[i];
+	c->is_ws = true;
+	ws_clients_set_topics(c, WS_TOPICS_ALL);
+	return c;
+}
+
+void ws_clients_set_max(size_t max)
+{
+	atomic_store(&ws_max, (uint32_t)(max < RC_WS_MAX_CLIENTS ? max : RC_WS_MAX_CLIENTS));
+}
+
+size_t ws_clients_over_cap(int *fds, size_t cap)
+{
+	uint32_t mask = ws_mask();
+	const uint32_t max = atomic_load(&ws_max);
+	size_t n = 0;
+	while ((uint32_t)__builtin_popcount(mask) > max && n < cap)
+	{
+		// Newest first: the client that has been driving longest keeps its connection.
+		int newest = -1;
+		for (uint32_t m = mask; m;)
+		{
+			const int i = ws_clients_next(&m);
+			if (newest < 0 || slots[i].opened_us > slots[newest].opened_us)
+				newest = i;
+		}
+		fds[n++] = slots[newest].fd;
+		mask &= ~(1u << newest);
+	}
+	return n;
+}
+
+ws_client_t *ws_clients_get(int fd)
+{
+	const int i = slot_index(fd);
+	return i < 0 ? NULL : &slots[i];
+}
+
+void ws_clients_set_topics(ws_client_t *c, uint32_t topics)
+{
+	const uint32_t bit = 1u << (uint32_t)ws_clients_index(c);
+	c->topics = topics;
+	for (int t = 0; t < WS_TOPIC_COUNT; t++)
+	{
+		if (topics & WS_TOPIC_BIT(t))
+			atomic_fetch_or(&topic_masks[t], bit);
+		else
+			atomic_fetch_and(&topic_masks[t], ~bit);
+	}
+	update_demand();
+}
+
+uint32_t ws_clients_snapshot(ws_topic_t topic)
+{
+	return atomic_load_explicit(&topic_masks[topic], memory_order_acquire);
+}
+
+ws_client_t *ws_clients_slot(int index)
+{
+	return &slots[index];
+}
+
+int ws_clients_index(const ws_client_t *c)
+{
+	return (int)(c - slots);
+}
+
+void ws_clients_note_tx(ws_client_t *c, size_t len, bool ok)
+{
+	if (ok)
+	{
+		atomic_fetch_add_explicit(&c->tx_msgs, 1, memory_order_relaxed);
+		atomic_fetch_add_explicit(&c->tx_bytes, (uint32_t)len, memory_order_relaxed);
+	}
+	else
+	{
+		atomic_fetch_add_explicit(&c->tx_fail, 1, memory_order_relaxed);
+	}
+}
+
+size_t ws_clients_to_json(char *buf, size_t len)
+{
+	const int64_t now_us = esp_timer_get_time();
+	size_t off = 0;
+	int n = snprintf(buf, len, "[");
+	if (n < 0 || (size_t)n >= len)
+		return 0;
+	off = (size_t)n;
+
+	bool first = true;
+	for (uint32_t m = open_mask; m;)
+	{
+		const ws_client_t *c = &slots[ws_clients_next(&m)];
+		n = snprintf(buf + off, len - off,
+					 "%s{\"fd\":%d,\"ws\":%s,\"video\":%s,\"telemetry\":%s,\"caps\":%" PRIu32 ",\"age_s\":%" PRId64
+					 ",\"tx\":%" PRIu32 ",\"tx_fail\":%" PRIu32 ",\"tx_bytes\":%" PRIu32 ",\"rx\":%" PRIu32 "}",
+					 first ? "" : ",", c->fd, c->is_ws ? "true" : "false",
+					 (c->topics & WS_TOPIC_BIT(WS_TOPIC_VIDEO)) ? "true" : "false",
+					 (c->topics & WS_TOPIC_BIT(WS_TOPIC_TELEMETRY)) ? "true" : "false", c->session.caps,
+					 (now_us - c->opened_us) / 1000000, atomic_load(&c->tx_msgs), atomic_load(&c->tx_fail),
+					 atomic_load(&c->tx_bytes), c->rx_msgs);
+		if (n < 0 || (size_t)n >= len - off)
+			return 0;
+		off += (size_t)n;
+		first = false;
+	}
+
+	n = snprintf(buf + off, len - off, "]");
+	if (n < 0 || (size_t)n >= len - off)
+		return 0;
+	return off + (size_t)n;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+// Registry of WS subscribers, maintained from the httpd open/close callbacks and the WS handshake.
+//
+// Membership only changes on the httpd task. Senders (camera, telemetry) take a snapshot bitmask
+// of the slots subscribed to a topic and walk its set bits: no locks and O(subscribers) per frame.
+// A connection can close while a sender holds its slot; that send then fails like any other
+// dropped connection. Slots are handed out round-robin so a freed slot isn't reused immediately.
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+#include "rc_proto.h"
+
+typedef enum
+{
+	WS_TOPIC_VIDEO = 0, // binary frames (JPEG / RAWH)
+	WS_TOPIC_TELEMETRY, // JSON text frames
+	WS_TOPIC_COUNT,
+} ws_topic_t;
+
+#define WS_TOPIC_BIT(t) (1u << (t))
+#define WS_TOPICS_ALL (WS_TOPIC_BIT(WS_TOPIC_VIDEO) | WS_TOPIC_BIT(WS_TOPIC_TELEMETRY))
+
+typedef struct
+{
+	int fd;
+	bool is_ws;                 // handshake done
+	uint32_t topics;            // WS_TOPIC_BIT set
+	rc_proto_session_t session; // control sequencing and HELLO caps
+	int64_t opened_us;
+	uint32_t rx_msgs; // httpd task only
+	_Atomic uint32_t tx_msgs;
+	_Atomic uint32_t tx_fail;
+	_Atomic uint32_t tx_bytes; // wraps at 4 GiB
+} ws_client_t;
+
+// `video_bit` in `demand_group` is kept set while at least one client is subscribed to video,
+// so the camera can block on it instead of polling.
+void ws_clients_init(EventGroupHandle_t demand_group, EventBits_t video_bit);
+
+// httpd callbacks (open_fn / close_fn). on_open fails with ESP_ERR_NO_MEM when all slots are taken.
+esp_err_t ws_clients_on_open(int fd);
+void ws_clients_on_close(int fd);
+
+// Called from the WS handshake: the client becomes a subscriber to all topics. NULL if the fd isn't
+// registered or the WS client cap is reached (the caller should then fail the request).
+ws_client_t *ws_clients_on_handshake(int fd);
+
+// Cap on WS clients (memory tier), at most RC_WS_MAX_CLIENTS. Plain HTTP requests aren't affected.
+void ws_clients_set_max(size_t max);
+
+// httpd task only: fds of the newest WS clients beyond the cap, for the caller to close. Returns count.
+size_t ws_clients_over_cap(int *fds, size_t cap);
+
+// httpd task only. NULL if the fd isn't registered.
+ws_client_t *ws_clients_get(int fd);
+
+void ws_clients_set_topics(ws_client_t *c, uint32_t topics);
+
+// Bitmask of slots subscribed to `topic`; walk it with ws_clients_next().
+uint32_t ws_clients_snapshot(ws_topic_t topic);
+ws_client_t *ws_clients_slot(int index);
+int ws_clients_index(const ws_client_t *c);
+
+static inline int ws_clients_next(uint32_t *mask)
+{
+	const int i = __builtin_ctz(*mask);
+	*mask &= *mask - 1;
+	return i;
+}
+
+static inline size_t ws_clients_count(ws_topic_t topic)
+{
+	return (size_t)__builtin_popcount(ws_clients_snapshot(topic));
+}
+
+void ws_clients_note_tx(ws_client_t *c, size_t len, bool ok);
+
+// JSON array of connected clients with their stats. httpd task only.
+size_t ws_clients_to_json(char *buf, size_t len);
@@ -0,0 +1,338 @@
+'use strict';
+// Browser driving client. Talks to the car's WS endpoint with control protocol v2 (main/rc_proto.h)
+// and decodes the same video messages as the host tools (main/rc_frame.h): JPEG, RAWH + payload,
+// and chunked video and abbreviated JPEG (JTAB / JREF + scan data) when negotiated.
+
+const MAGIC = 0xC5, VERSION = 2;
+const MSG_CONTROL = 1, MSG_HELLO = 2, MSG_HELLO_ACK = 3, MSG_ACK = 4;
+const FLAG_BRAKE = 0x01, FLAG_ACK_REQ = 0x02;
+const CAP_CONTROL_V2 = 1, CAP_CONTROL_ACK = 2, CAP_TELEMETRY_TEXT = 4, CAP_CONTROL_ONLY = 8, CAP_VIDEO_CHUNKED = 16;
+const CAP_VIDEO_JPEG_ABBREV = 32;
+const CHUNK_MAGIC = 0xC6, CHUNK_HDR_LEN = 8, CHUNK_LAST = 0x01;
+const RAWH_LEN = 14, FMT_RGB565 = 0, FMT_GRAY8 = 1, FMT_GRAY4 = 2, FMT_GRAY2 = 3, FMT_RGB332 = 4;
+const JTAB_HDR_LEN = 8, JREF_LEN = 10;
+const AXIS_MAX = 32767;
+const SEND_MS = 50;   // same rate as the Android app
+const ACK_EVERY = 10; // every Nth control packet asks for an ack (round-trip time)
+const DEADZONE = 0.12;
+
+const $ = (id) => document.getElementById(id);
+const canvas = $('video');
+const ctx2d = canvas.getContext('2d');
+
+let ws = null;
+let caps = 0;
+let seq = 0;
+const ackSent = new Map(); // seq -> send time
+let rtt = -1;
+let rawHeader = null;      // RAWH / JREF header waiting for its payload
+let jpegTables = null;     // last JTAB: {id, bytes}
+const chunk = {active: false, seq: 0, len: 0, buf: new Uint8Array(64 * 1024), drops: 0};
+let decoding = false;
+let nextJpeg = null;       // newest JPEG (Blob parts) that arrived while the previous one was decoding
+const stats = {frames: 0, bytes: 0, fps: 0, kbps: 0, rssi: null};
+const telemetry = {};
+
+// --- input ---
+
+const held = new Set();
+const keymap = {
+	ArrowUp: 'up', KeyW: 'up', ArrowDown: 'down', KeyS: 'down',
+	ArrowLeft: 'left', KeyA: 'left', ArrowRight: 'right', KeyD: 'right', Space: 'brake',
+};
+
+function setHeld(key, on) {
+	if (on) held.add(key); else held.delete(key);
+	const btn = document.querySelector(`#pad [data-key="${key}"]`);
+	if (btn) btn.classList.toggle('active', on);
+}
+
+addEventListener('keydown', (e) => {
+	if (keymap[e.code]) { setHeld(keymap[e.code], true); e.preventDefault(); }
+});
+addEventListener('keyup', (e) => {
+	if (keymap[e.code]) { setHeld(keymap[e.code], false); e.preventDefault(); }
+});
+addEventListener('blur', () => [...held].forEach((k) => setHeld(k, false)));
+
+document.querySelectorAll('#pad button').forEach((btn) => {
+	const key = btn.dataset.key;
+	btn.addEventListener('pointerdown', (e) => { btn.setPointerCapture(e.pointerId); setHeld(key, true); });
+	btn.addEventListener('pointerup', () => setHeld(key, false));
+	btn.addEventListener('pointercancel', () => setHeld(key, false));
+	btn.addEventListener('contextmenu', (e) => e.preventDefault());
+});
+
+const limit = $('limit');
+limit.value = localStorage.getItem('limit') || limit.value;
+const showLimit = () => { $('limit-val').textContent = limit.value + '%'; localStorage.setItem('limit', limit.value); };
+limit.addEventListener('input', showLimit);
+showLimit();
+
+$('settings-btn').addEventListener('click', () => { $('settings').hidden = !$('settings').hidden; });
+$('video-off').addEventListener('change', () => { if (ws) ws.close(); });
+
+function axis(v) {
+	return Math.abs(v) < DEADZONE ? 0 : Math.max(-1, Math.min(1, v));
+}
+
+// Returns [throttle, steer] in -1..1 and the brake flag.
+function readInput() {
+	let throttle = (held.has('up') ? 1 : 0) - (held.has('down') ? 1 : 0);
+	let steer = (held.has('right') ? 1 : 0) - (held.has('left') ? 1 : 0);
+	let brake = held.has('brake');
+	for (const pad of navigator.getGamepads ? navigator.getGamepads() : []) {
+		if (!pad) continue;
+		const t = -axis(pad.axes[1] || 0), s = axis(pad.axes[0] || 0);
+		if (t || s) { throttle = t; steer = s; }
+		if (pad.buttons[1] && pad.buttons[1].pressed) brake = true;
+	}
+	return [throttle, steer, brake];
+}
+
+// --- protocol ---
+
+function sendHello() {
+	const b = new DataView(new ArrayBuffer(7));
+	let want = CAP_CONTROL_V2 | CAP_CONTROL_ACK | CAP_TELEMETRY_TEXT | CAP_VIDEO_CHUNKED | CAP_VIDEO_JPEG_ABBREV;
+	if ($('video-off').checked) want |= CAP_CONTROL_ONLY;
+	b.setUint8(0, MAGIC);
+	b.setUint8(1, (VERSION << 4) | MSG_HELLO);
+	b.setUint8(2, VERSION);
+	b.setUint32(3, want, true);
+	ws.send(b.buffer);
+}
+
+function sendControl() {
+	if (!ws || ws.readyState !== WebSocket.OPEN) return;
+	const [throttle, steer, brake] = readInput();
+	seq = (seq + 1) & 0xFFFF;
+	let flags = brake ? FLAG_BRAKE : 0;
+	if ((caps & CAP_CONTROL_ACK) && seq % ACK_EVERY === 0) {
+		flags |= FLAG_ACK_REQ;
+		ackSent.set(seq, performance.now());
+		if (ackSent.size > 32) ackSent.delete(ackSent.keys().next().value);
+	}
+	const b = new DataView(new ArrayBuffer(9));
+	b.setUint8(0, MAGIC);
+	b.setUint8(1, (VERSION << 4) | MSG_CONTROL);
+	b.setUint16(2, seq, true);
+	b.setUint8(4, flags);
+	b.setInt16(5, Math.round(throttle * AXIS_MAX * limit.value / 100), true);
+	b.setInt16(7, Math.round(steer * AXIS_MAX), true);
+	ws.send(b.buffer);
+}
+
+function onProto(u8) {
+	const type = u8[1] & 0x0F;
+	const dv = new DataView(u8.buffer, u8.byteOffset, u8.byteLength);
+	if (type === MSG_HELLO_ACK && u8.length === 7) {
+		caps = dv.getUint32(3, true);
+	} else if (type === MSG_ACK && u8.length === 5) {
+		const t = ackSent.get(dv.getUint16(2, true));
+		if (t !== undefined) {
+			ackSent.delete(dv.getUint16(2, true));
+			const sample = performance.now() - t;
+			rtt = rtt < 0 ? sample : rtt * 0.8 + sample * 0.2;
+		}
+	}
+}
+
+// Same rules as rc_chunk_rx_feed(): chunks of one message arrive in order, anything else is a loss.
+function chunkFeed(u8) {
+	const dv = new DataView(u8.buffer, u8.byteOffset, u8.byteLength);
+	const s = dv.getUint16(2, true), off = dv.getUint32(4, true);
+	const data = u8.subarray(CHUNK_HDR_LEN);
+	if (off === 0) {
+		if (chunk.active) chunk.drops++;
+		chunk.active = true;
+		chunk.seq = s;
+		chunk.len = 0;
+	}
+	if (!chunk.active || s !== chunk.seq || off !== chunk.len) {
+		if (chunk.active) chunk.drops++;
+		chunk.active = false;
+		return null;
+	}
+	if (chunk.len + data.length > chunk.buf.length) {
+		const bigger = new Uint8Array(Math.max(chunk.buf.length * 2, chunk.len + data.length));
+		bigger.set(chunk.buf.subarray(0, chunk.len));
+		chunk.buf = bigger;
+	}
+	chunk.buf.set(data, chunk.len);
+	chunk.len += data.length;
+	if (!(u8[1] & CHUNK_LAST)) return null;
+	chunk.active = false;
+	return chunk.buf.slice(0, chunk.len);
+}
+
+function onBinary(u8) {
+	if ((caps & CAP_VIDEO_CHUNKED) && u8.length >= CHUNK_HDR_LEN && u8[0] === CHUNK_MAGIC) {
+		const msg = chunkFeed(u8);
+		if (msg) onVideo(msg);
+		return;
+	}
+	// The payload check comes first: pixel data may well start with the control magic.
+	if (!(rawHeader && u8.length === rawHeader.len) && u8.length >= 2 && u8[0] === MAGIC) {
+		onProto(u8);
+		return;
+	}
+	onVideo(u8);
+}
+
+// --- video ---
+
+function onVideo(u8) {
+	const magic = u8.length >= 4 ? String.fromCharCode(u8[0], u8[1], u8[2], u8[3]) : '';
+	if (rawHeader && u8.length === rawHeader.len) {
+		const h = rawHeader;
+		rawHeader = null;
+		countFrame(u8.length);
+		if (!h.jref) drawRaw(h, u8);
+		// Abbreviated JPEG: the stored header + this scan data is the original file.
+		else if (jpegTables && jpegTables.id === h.id) drawJpeg([jpegTables.bytes, u8]);
+	} else if (u8.length > 2 && u8[0] === 0xFF && u8[1] === 0xD8) {
+		rawHeader = null;
+		countFrame(u8.length);
+		drawJpeg([u8]);
+	} else if (u8.length === RAWH_LEN && magic === 'RAWH') {
+		const dv = new DataView(u8.buffer, u8.byteOffset, u8.byteLength);
+		rawHeader = {format: u8[5], width: dv.getUint16(6, true), height: dv.getUint16(8, true), len: dv.getUint32(10, true)};
+	} else if (u8.length > JTAB_HDR_LEN && magic === 'JTAB') {
+		jpegTables = {id: u8[5], bytes: u8.slice(JTAB_HDR_LEN)};
+	} else if (u8.length === JREF_LEN && magic === 'JREF') {
+		const dv = new DataView(u8.buffer, u8.byteOffset, u8.byteLength);
+		rawHeader = {jref: true, id: u8[5], len: dv.getUint32(6, true)};
+	}
+}
+
+function countFrame(bytes) {
+	stats.frames++;
+	stats.bytes += bytes;
+}
+
+function fitCanvas(w, h) {
+	if (canvas.width !== w || canvas.height !== h) {
+		canvas.width = w;
+		canvas.height = h;
+	}
+}
+
+// Decodes off the main thread; frames that arrive meanwhile replace each other so the picture
+// never lags behind the car.
+function drawJpeg(parts) {
+	if (decoding) {
+		nextJpeg = parts;
+		return;
+	}
+	decoding = true;
+	createImageBitmap(new Blob(parts, {type: 'image/jpeg'})).then((bmp) => {
+		fitCanvas(bmp.width, bmp.height);
+		ctx2d.drawImage(bmp, 0, 0);
+		bmp.close();
+	}).catch(() => {}).finally(() => {
+		decoding = false;
+		if (nextJpeg) {
+			const next = nextJpeg;
+			nextJpeg = null;
+			drawJpeg(next);
+		}
+	});
+}
+
+function drawRaw(h, px) {
+	const n = h.width * h.height;
+	if (h.format > FMT_RGB332) return;
+	fitCanvas(h.width, h.height);
+	const img = ctx2d.createImageData(h.width, h.height);
+	const out = new Uint32Array(img.data.buffer); // RGBA in memory = 0xAABBGGRR on little-endian
+	if (h.format === FMT_GRAY8) {
+		for (let i = 0; i < n; i++) {
+			const y = px[i];
+			out[i] = 0xFF000000 | (y << 16) | (y << 8) | y;
+		}
+	} else if (h.format === FMT_GRAY4 || h.format === FMT_GRAY2) {
+		// Packed MSB-first, rows padded to whole bytes; levels scale back by 17 / 85.
+		const bits = h.format === FMT_GRAY4 ? 4 : 2, mask = (1 << bits) - 1, mul = 255 / mask;
+		const row = Math.ceil(h.width * bits / 8);
+		for (let y = 0, i = 0; y < h.height; y++) {
+			for (let x = 0; x < h.width; x++, i++) {
+				const bit = x * bits;
+				const v = ((px[y * row + (bit >> 3)] >> (8 - bits - (bit & 7))) & mask) * mul;
+				out[i] = 0xFF000000 | (v << 16) | (v << 8) | v;
+			}
+		}
+	} else if (h.format === FMT_RGB332) {
+		for (let i = 0; i < n; i++) {
+			const v = px[i], r = v >> 5, g = (v >> 2) & 7, b = v & 3;
+			out[i] = 0xFF000000 | ((b * 85) << 16) | (((g << 5) | (g << 2) | (g >> 1)) << 8) | ((r << 5) | (r << 2) | (r >> 1));
+		}
+	} else {
+		for (let i = 0; i < n; i++) {
+			const v = (px[2 * i] << 8) | px[2 * i + 1]; // big-endian RGB565
+			const r = v >> 11, g = (v >> 5) & 63, b = v & 31;
+			out[i] = 0xFF000000 | (((b << 3) | (b >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8) | ((r << 3) | (r >> 2));
+		}
+	}
+	ctx2d.putImageData(img, 0, 0);
+}
+
+// --- connection ---
+
+function setLink(text, ok) {
+	$('link').textContent = text;
+	$('link').className = ok ? 'ok' : 'bad';
+}
+
+function connect() {
+	caps = 0;
+	rawHeader = null;
+	jpegTables = null;
+	chunk.active = false;
+	ackSent.clear();
+	ws = new WebSocket(`ws://${location.host}/`);
+	ws.binaryType = 'arraybuffer';
+	ws.onopen = () => { setLink('connected', true); sendHello(); };
+	ws.onmessage = (e) => {
+		if (typeof e.data === 'string') onText(e.data);
+		else onBinary(new Uint8Array(e.data));
+	};
+	ws.onclose = () => {
+		ws = null;
+		setLink('disconnected', false);
+		setTimeout(connect, 1000);
+	};
+}
+
+function onText(text) {
+	let msg;
+	try { msg = JSON.parse(text); } catch (e) { return; }
+	if (!msg.type) return;
+	if (msg.type === 'link' && msg.rssi !== undefined) stats.rssi = msg.rssi;
+	telemetry[msg.type] = text;
+	if (!$('settings').hidden) $('telemetry').textContent = Object.values(telemetry).join('\n');
+}
+
+setInterval(sendControl, SEND_MS);
+
+setInterval(() => {
+	stats.fps = stats.frames;
+	stats.kbps = stats.bytes / 1024;
+	stats.frames = stats.bytes = 0;
+	const parts = [];
+	if (!(caps & CAP_CONTROL_ONLY)) parts.push(`${stats.fps} fps`, `${stats.kbps.toFixed(0)} KiB/s`);
+	if (rtt >= 0) parts.push(`rtt ${rtt.toFixed(0)} ms`);
+	if (stats.rssi !== null) parts.push(`rssi ${stats.rssi}`);
+	if (chunk.drops) parts.push(`${chunk.drops} lost`);
+	$('stats').textContent = parts.join(' · ');
+}, 1000);
+
+// A hidden tab stops its timers; make sure the car isn't left driving.
+document.addEventListener('visibilitychange', () => {
+	if (document.hidden) {
+		[...held].forEach((k) => setHeld(k, false));
+		sendControl();
+	}
+});
+
+connect();
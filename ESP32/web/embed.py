@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""Packs the web UI into a C file: gzip-compressed bytes, MIME type, ETag and Cache-Control per asset.
+
+    embed.py OUT.c FILE...
+
+*.html files are served at /<name> (index.html at /) and revalidated on every load; everything else
+is served at /ui/<name> and cached for good. That is safe because pages refer to assets as
+{{ui:name}}, which is replaced by /ui/name?v=<etag>, so a changed asset gets a new URL.
+
+The output only depends on the input bytes (gzip mtime is 0), so the ETag survives rebuilds.
+"""
+
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+MIME = {
+    ".html": "text/html",
+    ".js": "application/javascript",
+    ".css": "text/css",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".ico": "image/x-icon",
+}
+TEXT = (".html", ".js", ".css")
+
+
+def c_string(s):
+    return '"' + s.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def main():
+    out, files = sys.argv[1], sys.argv[2:]
+    # Assets first, then the pages that refer to them.
+    files.sort(key=lambda f: (os.path.splitext(f)[1] == ".html", os.path.splitext(f)[1] in TEXT, f))
+
+    versions = {}
+    assets = []
+    for path in files:
+        name = os.path.basename(path)
+        ext = os.path.splitext(name)[1]
+        with open(path, "rb") as f:
+            data = f.read()
+        if ext in TEXT:
+
+            def ref(m):
+                if m.group(1) not in versions:
+                    sys.exit("%s: unknown asset {{ui:%s}}" % (path, m.group(1)))
+                return "/ui/%s?v=%s" % (m.group(1), versions[m.group(1)])
+
+            data = re.sub(r"\{\{ui:([^}]+)\}\}", ref, data.decode("utf-8")).encode("utf-8")
+        packed = gzip.compress(data, compresslevel=9, mtime=0)
+        tag = hashlib.sha256(data).hexdigest()[:16]
+        if ext == ".html":
+            url = "/" if name == "index.html" else "/" + name
+            cache = "no-cache"
+        else:
+            url = "/ui/" + name
+            cache = "public, max-age=31536000, immutable"
+            versions[name] = tag[:8]
+        assets.append((url, MIME.get(ext, "application/octet-stream"), '"%s"' % tag, cache, packed, len(data)))
+
+    lines = ["// Generated by web/embed.py from " + ", ".join(sorted(os.path.basename(f) for f in files)),
+             "// Do not edit.", "", '#include "web_assets.h"', ""]
+    for i, (_, _, _, _, packed, _) in enumerate(assets):
+        lines.append("static const uint8_t asset_%d[%d] = {" % (i, len(packed)))
+        for j in range(0, len(packed), 16):
+            lines.append("\t" + ", ".join("0x%02x" % b for b in packed[j:j + 16]) + ",")
+        lines.append("};")
+        lines.append("")
+    lines.append("const web_asset_t web_assets[] = {")
+    for i, (url, mime, tag, cache, packed, raw_len) in enumerate(assets):
+        lines.append("\t{%s, %s, %s, %s, asset_%d, %d, %d}," %
+                     (c_string(url), c_string(mime), c_string(tag), c_string(cache), i, len(packed), raw_len))
+    lines.append("};")
+    lines.append("const size_t web_asset_count = %d;" % len(assets))
+
+    text = "\n".join(lines) + "\n"
+    with open(out, "w") as f:
+        f.write(text)
+    total = sum(len(a[4]) for a in assets)
+    raw = sum(a[5] for a in assets)
+    print("web UI: %d assets, %d bytes gzip (%d raw)" % (len(assets), total, raw))
+
+
+if __name__ == "__main__":
+    main()